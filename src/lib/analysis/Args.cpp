@@ -99,12 +99,20 @@ Args::Ctor()
   // Correlation arguments
   // -------------------------------------------------------
 
+  structureCache = false;
+
   doNormalizeTy = true;
 
   prof_metrics = Analysis::Args::MetricFlg_NULL;
 
   profflat_computeFinalMetricValues = true;
 
+  // -------------------------------------------------------
+  // Execution arguments
+  // -------------------------------------------------------
+
+  jobs = -1;
+
   // -------------------------------------------------------
   // Output arguments
   // -------------------------------------------------------
@@ -113,8 +121,11 @@ Args::Ctor()
   out_db_csv        = "";
   db_dir            = Analysis_DB_DIR_pfx "-" Analysis_DB_DIR_nm;
   db_copySrcFiles   = true;
+  db_mergeTraceFiles = true;
+  db_traceFilesWritten = false;
   out_db_config     = "";
   db_makeMetricDB   = true;
+  db_sparseMetricDB = false;
   db_addStructId    = false;
 
   out_txt           = Analysis_OUT_TXT;
@@ -126,6 +126,7 @@ public:
 
   // Structure files
   std::vector<std::string> structureFiles;
+  bool structureCache; // read/write binary copies of structure files
 
   // Group files
   std::vector<std::string> groupFiles;
@@ -181,12 +182,19 @@ public:
   // moment this is a sinking ship and not worth the time investment.
   bool profflat_computeFinalMetricValues;
 
+  // -------------------------------------------------------
+  // Execution arguments
+  // -------------------------------------------------------
+
+  int jobs; // threads per process; < 1: use the OpenMP default
+
   // -------------------------------------------------------
   // Output arguments: experiment database output
   // -------------------------------------------------------
 
 #define Analysis_OUT_DB_EXPERIMENT "experiment.xml"
 #define Analysis_OUT_DB_CSV        "experiment.csv"
+#define Analysis_OUT_DB_TRACE      "experiment.mt"
 
 #define Analysis_DB_DIR_pfx        "hpctoolkit"
 #define Analysis_DB_DIR_nm         "database"
@@ -198,10 +206,13 @@ public:
 
   std::string db_dir;            // disable: ""
   bool db_copySrcFiles;
+  bool db_mergeTraceFiles;       // write trace files as experiment.mt
+  bool db_traceFilesWritten;     // experiment.mt already written (hpcprof-mpi)
 
   std::string out_db_config;     // disable: "", stdout: "-"
 
   bool db_makeMetricDB;
+  bool db_sparseMetricDB;        // write the metric db in sparse form
   bool db_addStructId;
 
   // -------------------------------------------------------
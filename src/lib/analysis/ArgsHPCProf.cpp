@@ -72,6 +72,10 @@ using std::string;
 
 #include <include/hpctoolkit-config.h>
 
+#ifdef ENABLE_OPENMP
+#include <omp.h>
+#endif
+
 #include "ArgsHPCProf.hpp"
 
 #include "CallPath.hpp" /* for normalizeFilePath */
@@ -118,6 +122,11 @@ Options: General:\n\
   -V, --version        Print version information.\n\
   -h, --help           Print this help.\n\
   --debug [<n>]        Debug: use debug level <n>. {1}\n\
+  -j <num>, --jobs <num>\n\
+                       Use <num> threads per process to read and merge\n\
+                       profiles and to read load modules. For hpcprof-mpi,\n\
+                       this allows one rank per node to use every core.\n\
+                       {OMP_NUM_THREADS or all cores}\n\
 \n\
 Options: Source Code and Static Structure:\n\
   --name <name>, --title <name>\n\
@@ -129,6 +138,10 @@ Options: Source Code and Static Structure:\n\
   -S <file>, --structure <file>\n\
                        Use hpcstruct structure file <file> for correlation.\n\
                        May pass multiple times (e.g., for shared libraries).\n\
+  --struct-cache       Read each structure file <file> through a binary copy,\n\
+                       <file>.bin, that is written the first time <file> is\n\
+                       read and rewritten when <file> changes.  Load modules\n\
+                       in a binary copy are read only if they are profiled.\n\
   -R '<old-path>=<new-path>', --replace-path '<old-path>=<new-path>'\n\
                        Substitute instances of <old-path> with <new-path>;\n\
                        apply to all paths (profile's load map, source code)\n\
@@ -154,9 +167,13 @@ Options: Output:\n\
                        Specify Experiment database name <db-path>.\n\
                        {./" Analysis_DB_DIR "}\n\
                        Experiment format {" Analysis_OUT_DB_EXPERIMENT "}\n\
-  --metric-db <yes|no>\n\
+  --metric-db <yes|no|sparse>\n\
                        Control whether to generate a thread-level metric\n\
-                       value database for hpcviewer scatter plots. {yes}\n\
+                       value database for hpcviewer scatter plots.\n\
+                       hpcprof-mpi only: 'sparse' stores only non-zero\n\
+                       values, which is much smaller for large runs but\n\
+                       needs a reader that supports metric-db version 0.20.\n\
+                       {yes}\n\
   --remove-redundancy \n\
                        Eliminate procedure name redundancy in experiment.xml\n\
   --struct-id          Add 'str=nnn' field to profile data with the hpcstruct\n\
@@ -187,6 +204,8 @@ CmdLineParser::OptArgDesc Analysis::ArgsHPCProf::optArgs[] = {
      NULL },
   { 'S', "structure",       CLP::ARG_REQ,  CLP::DUPOPT_CAT,  CLP_SEPARATOR,
      NULL },
+  {  0 , "struct-cache",    CLP::ARG_NONE, CLP::DUPOPT_CLOB, NULL,
+     NULL },
   { 'R', "replace-path",    CLP::ARG_REQ,  CLP::DUPOPT_CAT,  CLP_SEPARATOR,
      NULL},
 
@@ -218,6 +237,8 @@ CmdLineParser::OptArgDesc Analysis::ArgsHPCProf::optArgs[] = {
      NULL },
   { 0, "remove-redundancy", CLP::ARG_NONE, CLP::DUPOPT_CLOB, NULL,
      NULL },
+  { 'j', "jobs",            CLP::ARG_REQ,  CLP::DUPOPT_CLOB, NULL,
+     NULL },
   {  0 , "debug",           CLP::ARG_OPT,  CLP::DUPOPT_CLOB, NULL,  // hidden
      CLP::isOptArg_long },
   CmdLineParser_OptArgDesc_NULL_MACRO // SGI's compiler requires this version
@@ -329,6 +350,16 @@ ArgsHPCProf::parse(int argc, const char* const argv[])
       }
       Diagnostics_SetDiagnosticFilterLevel(verb);
     }
+    if (parser.isOpt("jobs")) {
+      const string& arg = parser.getOptArg("jobs");
+      jobs = (int)CmdLineParser::toLong(arg);
+      if (jobs < 1) {
+	ARG_ERROR("--jobs/-j option: expected a positive number of threads");
+      }
+#ifdef ENABLE_OPENMP
+      omp_set_num_threads(jobs);
+#endif
+    }
 
     // Check for agent options
     if (parser.isOpt("agent-cilk")) {
@@ -366,6 +397,9 @@ ArgsHPCProf::parse(int argc, const char* const argv[])
       string str = parser.getOptArg("structure");
       StrUtil::tokenize_str(str, CLP_SEPARATOR, structureFiles);
     }
+    if (parser.isOpt("struct-cache")) {
+      structureCache = true;
+    }
     if (parser.isOpt("normalize")) { 
       const string& arg = parser.getOptArg("normalize");
       doNormalizeTy = parseArg_norm(arg, "--normalize/-N option");
@@ -417,7 +451,14 @@ ArgsHPCProf::parse(int argc, const char* const argv[])
     }
     if (parser.isOpt("metric-db")) {
       const string& arg = parser.getOptArg("metric-db");
-      db_makeMetricDB = CmdLineParser::parseArg_bool(arg, "--metric-db option");
+      if (arg == "sparse") {
+	db_makeMetricDB = true;
+	db_sparseMetricDB = true;
+      }
+      else {
+	db_makeMetricDB = CmdLineParser::parseArg_bool(arg, "--metric-db option");
+	db_sparseMetricDB = false;
+      }
     }
     if (parser.isOpt("struct-id")) {
       db_addStructId = true;
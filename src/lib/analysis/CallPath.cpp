@@ -71,10 +71,20 @@ using std::string;
 #include <climits>
 #include <cstring>
 
+#include <vector>
+
 #include <typeinfo>
+#include <exception>
+#include <algorithm>
 
 #include <sys/stat.h>
 
+#include <include/hpctoolkit-config.h>
+
+#ifdef ENABLE_OPENMP
+#include <omp.h>
+#endif
+
 //*************************** User Include Files ****************************
 
 #include <include/uint.h>
@@ -137,40 +147,282 @@ namespace Analysis {
 
 namespace CallPath {
 
+static Prof::CallPath::Profile*
+readOne(const Util::StringVec& profileFiles, const Util::UIntVec* groupMap,
+	uint i, uint rFlags, bool isRecorded);
+
+static void
+recordFirst(Prof::CallPath::Profile* x, uint i,
+	    Prof::CCT::MergeRecordSink* mrgRecords);
+
+static void
+mergeOne(Prof::CallPath::Profile* x, Prof::CallPath::Profile* y,
+	 int mergeTy, uint mrgFlags, uint i = 0,
+	 Prof::CCT::MergeRecordSink* mrgRecords = NULL);
+
+static void
+clearMetricValues(Prof::CallPath::Profile* prof);
+
+#ifdef ENABLE_OPENMP
+static Prof::CallPath::Profile*
+readParallel(const Util::StringVec& profileFiles, const Util::UIntVec* groupMap,
+	     int mergeTy, uint rFlags, uint mrgFlags,
+	     Prof::CCT::MergeRecordSink* mrgRecords);
+#endif
+
 
 Prof::CallPath::Profile*
 read(const Util::StringVec& profileFiles, const Util::UIntVec* groupMap,
-     int mergeTy, uint rFlags, uint mrgFlags)
+     int mergeTy, uint rFlags, uint mrgFlags,
+     Prof::CCT::MergeRecordSink* mrgRecords)
 {
   // Special case
   if (profileFiles.empty()) {
     Prof::CallPath::Profile* prof = Prof::CallPath::Profile::make(rFlags);
     return prof;
   }
+
+  Prof::CallPath::Profile* prof = NULL;
+
+#ifdef ENABLE_OPENMP
+  if (profileFiles.size() > 1 && omp_get_max_threads() > 1) {
+    prof = readParallel(profileFiles, groupMap, mergeTy, rFlags, mrgFlags,
+			mrgRecords);
+  }
+#endif
   
   // General case
-  uint groupId = (groupMap) ? (*groupMap)[0] : 0;
-  Prof::CallPath::Profile* prof = read(profileFiles[0], groupId, rFlags);
+  if (!prof) {
+    prof = readOne(profileFiles, groupMap, 0, rFlags, mrgRecords != NULL);
+    if (mrgRecords) {
+      recordFirst(prof, 0, mrgRecords);
+    }
+
+    for (uint i = 1; i < profileFiles.size(); ++i) {
+      Prof::CallPath::Profile* p =
+	readOne(profileFiles, groupMap, i, rFlags, mrgRecords != NULL);
+      mergeOne(prof, p, mergeTy, mrgFlags, i, mrgRecords);
+    }
+    prof->metricMgr()->mergePerfEventStatistics_finalize(profileFiles.size());
+  }
+
+  if (mrgRecords && prof->isMetricMgrVirtual()) {
+    clearMetricValues(prof);
+  }
+  
+  return prof;
+}
+
+
+// readOne: read the i-th profile of 'profileFiles' and note its
+// directory.  If its merge is recorded, the profile keeps its metric
+// values even if its metrics are virtual.
+static Prof::CallPath::Profile*
+readOne(const Util::StringVec& profileFiles, const Util::UIntVec* groupMap,
+	uint i, uint rFlags, bool isRecorded)
+{
+  uint groupId = (groupMap) ? (*groupMap)[i] : 0;
+
+  uint rFlags1 = rFlags;
+  if (isRecorded) {
+    rFlags1 &= ~Prof::CallPath::Profile::RFlg_VirtualMetrics;
+  }
+  Prof::CallPath::Profile* prof = read(profileFiles[i], groupId, rFlags1);
+
+  if (rFlags & Prof::CallPath::Profile::RFlg_VirtualMetrics) {
+    prof->isMetricMgrVirtual(true);
+  }
 
   // add the directory into the set of directories
-  prof->addDirectory(profileFiles[0]);
+  prof->addDirectory(profileFiles[i]);
 
-  for (uint i = 1; i < profileFiles.size(); ++i) {
-    groupId = (groupMap) ? (*groupMap)[i] : 0;
-    Prof::CallPath::Profile* p = read(profileFiles[i], groupId, rFlags);
-    prof->merge(*p, mergeTy, mrgFlags);
+  return prof;
+}
+
+
+// recordFirst: pass 'mrgRecords' a record for the i-th profile 'x',
+// which the other profiles are merged into, as if it had been merged
+// into an empty profile
+static void
+recordFirst(Prof::CallPath::Profile* x, uint i,
+	    Prof::CCT::MergeRecordSink* mrgRecords)
+{
+  Prof::CCT::MergeRecord* mrgRecord = new Prof::CCT::MergeRecord;
+  mrgRecord->numMetrics(x->metricMgr()->size());
+  mrgRecord->traceFileName(x->traceFileName());
+  mrgRecord->noteInsert(*x->cct()->root());
 
-    prof->metricMgr()->mergePerfEventStatistics(p->metricMgr());
-    delete p;
+  mrgRecords->put(i, mrgRecord);
+}
 
-    // add the directory into the set of directories
-    prof->addDirectory(profileFiles[i]);
+
+// mergeOne: merge 'y', the i-th profile, into 'x' and delete 'y'; if
+// 'mrgRecords' is non-NULL, pass it a record of the merge
+static void
+mergeOne(Prof::CallPath::Profile* x, Prof::CallPath::Profile* y,
+	 int mergeTy, uint mrgFlags, uint i,
+	 Prof::CCT::MergeRecordSink* mrgRecords)
+{
+  Prof::CCT::MergeRecord* mrgRecord =
+    (mrgRecords) ? new Prof::CCT::MergeRecord : NULL;
+
+  x->merge(*y, mergeTy, mrgFlags, mrgRecord);
+
+  if (mrgRecord) {
+    mrgRecords->put(i, mrgRecord);
   }
-  prof->metricMgr()->mergePerfEventStatistics_finalize(profileFiles.size());
-  
+
+  x->metricMgr()->mergePerfEventStatistics(y->metricMgr());
+  x->copyDirectory(y->directorySet());
+  delete y;
+}
+
+
+// clearMetricValues: drop the metric values that recorded profiles
+// kept while being merged (cf. readOne())
+static void
+clearMetricValues(Prof::CallPath::Profile* prof)
+{
+  for (Prof::CCT::ANodeIterator it(prof->cct()->root());
+       it.Current(); ++it) {
+    it.current()->clearMetrics();
+  }
+}
+
+
+#ifdef ENABLE_OPENMP
+
+// readParallel: Read and merge 'profileFiles' with all OpenMP threads,
+// producing the same profile as the serial loop in read().
+//
+// Profiles are independent until merged, so parsing is always done
+// concurrently.  How they are merged depends on 'mrgFlags':
+//
+// - MrgFlg_NormalizeTraceFileY rewrites the trace file of the profile
+//   being merged, which only works when that profile came from one
+//   file.  Profiles are therefore merged one at a time, in order, while
+//   the other threads parse ahead.  The same holds when 'mrgRecords'
+//   asks for a record of each file's merge.
+//
+// - Otherwise merging is associative, so each thread merges a
+//   contiguous block of files and the per-block profiles are combined
+//   with a pairwise tree reduction that keeps the original order (and
+//   hence the order of metrics and load modules).
+//
+// An exception cannot leave an OpenMP region; the first one is kept
+// and rethrown once all threads are done.
+static Prof::CallPath::Profile*
+readParallel(const Util::StringVec& profileFiles, const Util::UIntVec* groupMap,
+	     int mergeTy, uint rFlags, uint mrgFlags,
+	     Prof::CCT::MergeRecordSink* mrgRecords)
+{
+  long numFiles = profileFiles.size();
+  std::exception_ptr error;
+  Prof::CallPath::Profile* prof = NULL;
+
+  if ((mrgFlags & Prof::CCT::MrgFlg_NormalizeTraceFileY) || mrgRecords) {
+    // -------------------------------------------------------
+    // parse in parallel; merge in order
+    // -------------------------------------------------------
+#pragma omp parallel for ordered schedule(dynamic, 1)
+    for (long i = 0; i < numFiles; ++i) {
+      Prof::CallPath::Profile* p = NULL;
+      try {
+	p = readOne(profileFiles, groupMap, i, rFlags, mrgRecords != NULL);
+      }
+      catch (...) {
+#pragma omp critical (readParallel_error)
+	{ if (!error) { error = std::current_exception(); } }
+      }
+
+#pragma omp ordered
+      {
+	try {
+	  if (!p) {
+	    // nothing to merge
+	  }
+	  else if (!prof) {
+	    prof = p;
+	    if (mrgRecords) {
+	      recordFirst(prof, i, mrgRecords);
+	    }
+	  }
+	  else {
+	    mergeOne(prof, p, mergeTy, mrgFlags, i, mrgRecords);
+	  }
+	}
+	catch (...) {
+#pragma omp critical (readParallel_error)
+	  { if (!error) { error = std::current_exception(); } }
+	}
+      }
+    }
+  }
+  else {
+    // -------------------------------------------------------
+    // merge contiguous blocks in parallel...
+    // -------------------------------------------------------
+    long numBlks = std::min(numFiles, (long)omp_get_max_threads());
+    std::vector<Prof::CallPath::Profile*> blkProf(numBlks, NULL);
+
+#pragma omp parallel for schedule(dynamic, 1)
+    for (long b = 0; b < numBlks; ++b) {
+      long beg = (numFiles * b) / numBlks;
+      long end = (numFiles * (b + 1)) / numBlks;
+      try {
+	for (long i = beg; i < end; ++i) {
+	  Prof::CallPath::Profile* p =
+	    readOne(profileFiles, groupMap, i, rFlags, false);
+	  if (!blkProf[b]) {
+	    blkProf[b] = p;
+	  }
+	  else {
+	    mergeOne(blkProf[b], p, mergeTy, mrgFlags);
+	  }
+	}
+      }
+      catch (...) {
+#pragma omp critical (readParallel_error)
+	{ if (!error) { error = std::current_exception(); } }
+      }
+    }
+
+    // -------------------------------------------------------
+    // ...then reduce the blocks pairwise: (0 1) (2 3) ... => (0 2) ...
+    // -------------------------------------------------------
+    for (long stride = 1; stride < numBlks && !error; stride *= 2) {
+#pragma omp parallel for schedule(dynamic, 1)
+      for (long b = 0; b < numBlks - stride; b += 2 * stride) {
+	try {
+	  mergeOne(blkProf[b], blkProf[b + stride], mergeTy, mrgFlags);
+	  blkProf[b + stride] = NULL;
+	}
+	catch (...) {
+#pragma omp critical (readParallel_error)
+	  { if (!error) { error = std::current_exception(); } }
+	}
+      }
+    }
+
+    prof = blkProf[0];
+    blkProf[0] = NULL;
+    for (long b = 1; b < numBlks; ++b) {
+      delete blkProf[b]; // only non-NULL after an error
+    }
+  }
+
+  if (error) {
+    delete prof;
+    std::rethrow_exception(error);
+  }
+
+  prof->metricMgr()->mergePerfEventStatistics_finalize(numFiles);
+
   return prof;
 }
 
+#endif // ENABLE_OPENMP
+
 
 Prof::CallPath::Profile*
 read(const char* prof_fnm, uint groupId, uint rFlags)
@@ -212,7 +464,8 @@ readStructure(Prof::Struct::Tree* structure, const Analysis::Args& args)
   DocHandlerArgs docargs(&RealPathMgr::singleton());
 
   Prof::Struct::readStructure(*structure, args.structureFiles,
-			      PGMDocHandler::Doc_STRUCT, docargs);
+			      PGMDocHandler::Doc_STRUCT, docargs,
+			      args.structureCache);
 
   // BAnal::Struct::makeStructure() creates a Struct::Tree that
   // distinguishes between non-call-site statements and call site
@@ -241,6 +494,15 @@ readStructure(Prof::Struct::Tree* structure, const Analysis::Args& args)
 }
 
 
+void
+makeStructureCache(const Analysis::Args& args)
+{
+  DocHandlerArgs docargs(&RealPathMgr::singleton());
+
+  Prof::Struct::makeBinaryCache(args.structureFiles, docargs);
+}
+
+
 } // namespace CallPath
 
 } // namespace Analysis
@@ -317,10 +579,58 @@ coalesceStmts(Prof::Struct::ANode* node)
 
 typedef std::map<Prof::Struct::ANode*, Prof::CCT::ANode*> StructToCCTMap;
 
+
+// LMOverlay: The per-load-module state needed to overlay static
+// structure.  A table of these, indexed by LoadMap::LMId_t, allows a
+// single CCT traversal to dispatch each ADynNode to its own load
+// module.  Entries with a NULL 'lmStrct' are skipped.
+class LMOverlay {
+public:
+  enum Source {
+    SrcNone,      // nothing to read (LoadMap::LMId_NULL)
+    SrcStruct,    // structure file
+    SrcVDSO,      // virtual load module: no binary to read
+    SrcBinary,    // line map from the binary
+    SrcBinaryErr  // binary could not be read
+  };
+
+  typedef std::map<VMA, Prof::Struct::ACodeNode*> VMAToStrctMap;
+
+  LMOverlay()
+    : loadmap_lm(NULL), lmStrct(NULL), lm(NULL), src(SrcNone)
+  { }
+
+  Prof::LoadMap::LM* loadmap_lm;
+  Prof::Struct::LM* lmStrct;
+
+  // For a load module without a structure file: the VMAs its CCT
+  // nodes sample, and (src == SrcBinary) the structure that the line
+  // map of its binary gives each of them.  The binary is freed as soon
+  // as this is filled in; see readLMOverlayBinary().
+  VMAToStrctMap vmaToStrct;
+
+  BinUtil::LM* lm; // only from the caller of overlayStaticStructure()
+  Source src;
+  std::string error;
+};
+
+typedef std::vector<LMOverlay> LMOverlayVec;
+
+
 static void
-overlayStaticStructure(Prof::CCT::ANode* node,
-		       Prof::LoadMap::LM* loadmap_lm,
-		       Prof::Struct::LM* lmStrct, BinUtil::LM* lm);
+noteLMOverlayVMAs(Prof::CCT::ANode* root, LMOverlayVec& lmVec);
+
+static void
+prepareLMOverlay(Prof::CallPath::Profile& prof, LMOverlay& lmOvly);
+
+static void
+readLMOverlayBinary(Prof::CallPath::Profile& prof, LMOverlay& lmOvly);
+
+static void
+reportLMOverlay(const LMOverlay& lmOvly, bool printProgress);
+
+static void
+overlayStaticStructure(Prof::CCT::ANode* node, const LMOverlayVec& lmVec);
 
 static Prof::CCT::ANode*
 demandScopeInFrame(Prof::CCT::ADynNode* node, Prof::Struct::ANode* strct,
@@ -354,9 +664,11 @@ overlayStaticStructureMain(Prof::CallPath::Profile& prof,
   std::string errors;
 
   // -------------------------------------------------------
-  // Overlay static structure. N.B. To process spurious samples,
-  // iteration includes LoadMap::LMId_NULL
+  // Demand structure for each used load module. N.B. To process
+  // spurious samples, iteration includes LoadMap::LMId_NULL
   // -------------------------------------------------------
+  LMOverlayVec lmVec(loadmap->size() + 1);
+
   for (Prof::LoadMap::LMId_t i = Prof::LoadMap::LMId_NULL;
       i <= loadmap->size(); ++i) {
     Prof::LoadMap::LM* lm = loadmap->lm(i);
@@ -364,9 +676,8 @@ overlayStaticStructureMain(Prof::CallPath::Profile& prof,
       try {
         const string& lm_nm = lm->name();
 
-        Prof::Struct::LM* lmStrct = Prof::Struct::LM::demand(rootStrct, lm_nm);
-        Analysis::CallPath::overlayStaticStructureMain(prof, lm, lmStrct,
-                                                       printProgress);
+        lmVec[i].loadmap_lm = lm;
+        lmVec[i].lmStrct = Prof::Struct::LM::demand(rootStrct, lm_nm);
       }
       catch (const Diagnostics::Exception& x) {
         errors += "  " + x.what() + "\n";
@@ -374,10 +685,52 @@ overlayStaticStructureMain(Prof::CallPath::Profile& prof,
     }
   }
 
+  // -------------------------------------------------------
+  // Build VMA maps for all load modules at once, and make structure
+  // from the binaries of those without a structure file.  Binaries
+  // are read one at a time, in load module order, so that only one is
+  // resident and structure ids are the same on every run (cf.
+  // hpcprof-mpi).
+  // -------------------------------------------------------
+  long numLM = lmVec.size();
+
+  noteLMOverlayVMAs(prof.cct()->root(), lmVec);
+
+#ifdef ENABLE_OPENMP
+#pragma omp parallel for schedule(dynamic, 1) ordered
+#endif
+  for (long i = 0; i < numLM; ++i) {
+    prepareLMOverlay(prof, lmVec[i]);
+#ifdef ENABLE_OPENMP
+#pragma omp ordered
+#endif
+    readLMOverlayBinary(prof, lmVec[i]);
+  }
+
+  for (long i = 0; i < numLM; ++i) {
+    reportLMOverlay(lmVec[i], printProgress);
+  }
+
   if (!errors.empty()) {
     DIAG_WMsgIf(1, "Cannot fully process samples because of errors reading load modules:\n" << errors);
   }
 
+  // -------------------------------------------------------
+  // Overlay static structure for every load module in one pass over
+  // the CCT
+  // -------------------------------------------------------
+  overlayStaticStructure(prof.cct()->root(), lmVec);
+
+  // account for new structure inserted by BAnal::Struct::makeStructureSimple()
+#ifdef ENABLE_OPENMP
+#pragma omp parallel for schedule(dynamic, 1)
+#endif
+  for (long i = 0; i < numLM; ++i) {
+    if (lmVec[i].lmStrct) {
+      lmVec[i].lmStrct->computeVMAMaps();
+    }
+  }
+
   // -------------------------------------------------------
   // Basic normalization
   // -------------------------------------------------------
@@ -396,42 +749,21 @@ overlayStaticStructureMain(Prof::CallPath::Profile& prof,
 			   Prof::Struct::LM* lmStrct,
                            bool printProgress)
 {
-  const string& lm_nm = loadmap_lm->name();
-  BinUtil::LM* lm = NULL;
+  LMOverlayVec lmVec(loadmap_lm->id() + 1);
 
-  bool useStruct = (lmStrct->childCount() > 0);
+  LMOverlay& lmOvly = lmVec[loadmap_lm->id()];
+  lmOvly.loadmap_lm = loadmap_lm;
+  lmOvly.lmStrct = lmStrct;
 
-  if (useStruct) {
-    DIAG_MsgIf(printProgress, "STRUCTURE: " << lm_nm);
-  } else if (loadmap_lm->id() == Prof::LoadMap::LMId_NULL) {
-    // no-op for this case
-  } else if (vdso_loadmodule(lm_nm.c_str()))  {
-    DIAG_WMsgIf(printProgress, "Cannot fully process samples for virtual load module " << lm_nm);
-  } else {
+  noteLMOverlayVMAs(prof.cct()->root(), lmVec);
+  prepareLMOverlay(prof, lmOvly);
+  readLMOverlayBinary(prof, lmOvly);
+  reportLMOverlay(lmOvly, printProgress);
 
-    try {
-      lm = new BinUtil::LM();
-      lm->open(lm_nm.c_str());
-      lm->read(prof.directorySet(), BinUtil::LM::ReadFlg_Proc);
-    }
-    catch (const Diagnostics::Exception& x) {
-      delete lm;
-      lm = NULL;
-      DIAG_WMsgIf(printProgress, "Cannot fully process samples for load module " << 
-                  lm_nm << ": " << x.what());
-    }
-    if (lm) DIAG_MsgIf(printProgress, "Line map : " << lm_nm);
-  }
-
-  if (lm) {
-    lmStrct->pretty_name(lm->name().c_str());
-  }
-  Analysis::CallPath::overlayStaticStructure(prof, loadmap_lm, lmStrct, lm);
+  overlayStaticStructure(prof.cct()->root(), lmVec);
   
   // account for new structure inserted by BAnal::Struct::makeStructureSimple()
   lmStrct->computeVMAMaps();
-
-  delete lm;
 }
 
 
@@ -443,7 +775,14 @@ overlayStaticStructure(Prof::CallPath::Profile& prof,
 		       Prof::LoadMap::LM* loadmap_lm,
 		       Prof::Struct::LM* lmStrct, BinUtil::LM* lm)
 {
-  overlayStaticStructure(prof.cct()->root(), loadmap_lm, lmStrct, lm);
+  LMOverlayVec lmVec(loadmap_lm->id() + 1);
+
+  LMOverlay& lmOvly = lmVec[loadmap_lm->id()];
+  lmOvly.loadmap_lm = loadmap_lm;
+  lmOvly.lmStrct = lmStrct;
+  lmOvly.lm = lm;
+
+  overlayStaticStructure(prof.cct()->root(), lmVec);
 }
 
 
@@ -485,19 +824,124 @@ noteStaticStructureOnLeaves(Prof::CallPath::Profile& prof)
 
 //****************************************************************************
 
+// noteLMOverlayVMAs: Note in 'lmVec' the VMAs sampled in each load
+// module that has no structure file and may be read from its binary.
 static void
-overlayStaticStructure(Prof::CCT::ANode* node,
-		       Prof::LoadMap::LM* loadmap_lm,
-		       Prof::Struct::LM* lmStrct, BinUtil::LM* lm)
+noteLMOverlayVMAs(Prof::CCT::ANode* root, LMOverlayVec& lmVec)
+{
+  for (Prof::CCT::ANodeIterator it(root); it.Current(); ++it) {
+    Prof::CCT::ADynNode* n_dyn =
+      dynamic_cast<Prof::CCT::ADynNode*>(it.current());
+    if (n_dyn && n_dyn->lmId() < lmVec.size()) {
+      LMOverlay& lmOvly = lmVec[n_dyn->lmId()];
+      if (lmOvly.lmStrct && lmOvly.lmStrct->childCount() == 0
+	  && n_dyn->lmId() != Prof::LoadMap::LMId_NULL) {
+	lmOvly.vmaToStrct[n_dyn->lmIP()] = NULL;
+      }
+    }
+  }
+}
+
+
+// prepareLMOverlay: Decide where the structure for 'lmOvly' comes
+// from and build its VMA maps so that the CCT traversal only performs
+// lookups.  Called concurrently for distinct load modules.
+static void
+prepareLMOverlay(Prof::CallPath::Profile& prof, LMOverlay& lmOvly)
+{
+  if (!lmOvly.lmStrct) { return; }
+
+  const string& lm_nm = lmOvly.loadmap_lm->name();
+
+  if (lmOvly.lmStrct->childCount() > 0) {
+    lmOvly.src = LMOverlay::SrcStruct;
+  } else if (lmOvly.loadmap_lm->id() == Prof::LoadMap::LMId_NULL) {
+    lmOvly.src = LMOverlay::SrcNone;
+  } else if (vdso_loadmodule(lm_nm.c_str()))  {
+    lmOvly.src = LMOverlay::SrcVDSO;
+  } else {
+    lmOvly.src = LMOverlay::SrcBinary; // see readLMOverlayBinary()
+  }
+
+  // VMA maps are otherwise built lazily by the first lookup
+  lmOvly.lmStrct->computeVMAMaps();
+}
+
+
+// readLMOverlayBinary: For a load module without a structure file,
+// read the line map of its binary, make structure for each sampled
+// VMA, and free the binary.  Structure ids are assigned here, so load
+// modules must be processed in a fixed order.
+static void
+readLMOverlayBinary(Prof::CallPath::Profile& prof, LMOverlay& lmOvly)
+{
+  if (lmOvly.src != LMOverlay::SrcBinary) { return; }
+
+  const string& lm_nm = lmOvly.loadmap_lm->name();
+
+  // N.B.: BFD keeps global state (e.g., its open-file cache), so
+  // binaries are read one at a time.
+#ifdef ENABLE_OPENMP
+#pragma omp critical (overlayStaticStructure_binutils)
+#endif
+  {
+    BinUtil::LM* lm = NULL;
+    try {
+      lm = new BinUtil::LM();
+      lm->open(lm_nm.c_str());
+      lm->read(prof.directorySet(), BinUtil::LM::ReadFlg_Proc);
+      lmOvly.lmStrct->pretty_name(lm->name().c_str());
+
+      for (LMOverlay::VMAToStrctMap::iterator it = lmOvly.vmaToStrct.begin();
+	   it != lmOvly.vmaToStrct.end(); ++it) {
+	it->second = Analysis::Util::demandStructure(it->first, lmOvly.lmStrct,
+						     lm, false/*useStruct*/);
+      }
+    }
+    catch (const Diagnostics::Exception& x) {
+      lmOvly.src = LMOverlay::SrcBinaryErr;
+      lmOvly.error = lm_nm + ": " + x.what();
+    }
+    delete lm;
+  }
+}
+
+
+static void
+reportLMOverlay(const LMOverlay& lmOvly, bool printProgress)
+{
+  if (!lmOvly.lmStrct) { return; }
+
+  const string& lm_nm = lmOvly.loadmap_lm->name();
+
+  switch (lmOvly.src) {
+    case LMOverlay::SrcStruct:
+      DIAG_MsgIf(printProgress, "STRUCTURE: " << lm_nm);
+      break;
+    case LMOverlay::SrcVDSO:
+      DIAG_WMsgIf(printProgress, "Cannot fully process samples for virtual load module " << lm_nm);
+      break;
+    case LMOverlay::SrcBinary:
+      DIAG_MsgIf(printProgress, "Line map : " << lm_nm);
+      break;
+    case LMOverlay::SrcBinaryErr:
+      DIAG_WMsgIf(printProgress, "Cannot fully process samples for load module " << lmOvly.error);
+      break;
+    default:
+      break;
+  }
+}
+
+
+static void
+overlayStaticStructure(Prof::CCT::ANode* node, const LMOverlayVec& lmVec)
 {
   // INVARIANT: The parent of 'node' has been fully processed
-  // w.r.t. the given load module and lives within a correctly located
-  // procedure frame.
+  // w.r.t. every load module in 'lmVec' and lives within a correctly
+  // located procedure frame.
   
   if (!node) { return; }
 
-  bool useStruct = (!lm);
-
   // N.B.: dynamically allocate to better handle the deep recursion
   // required for very deep CCTs.
   StructToCCTMap* strctToCCTMap = new StructToCCTMap;
@@ -525,13 +969,25 @@ overlayStaticStructure(Prof::CCT::ANode* node,
     // ---------------------------------------------------
     // process Prof::CCT::ADynNode nodes
     // 
-    // N.B.: Since we process w.r.t. one load module at a time, we may
-    //   see non-ADynNode nodes!
+    // N.B.: A node's load module may be absent from 'lmVec' (e.g.,
+    //   its structure could not be demanded); such nodes are left
+    //   as is.  Struct keys in 'strctToCCTMap' are distinct across
+    //   load modules, so one map serves them all.
     // ---------------------------------------------------
     Prof::CCT::ADynNode* n_dyn = dynamic_cast<Prof::CCT::ADynNode*>(n);
-    if (n_dyn && (n_dyn->lmId() == loadmap_lm->id())) {
+    const LMOverlay* lmOvly = NULL;
+    if (n_dyn && n_dyn->lmId() < lmVec.size()
+	&& lmVec[n_dyn->lmId()].lmStrct) {
+      lmOvly = &lmVec[n_dyn->lmId()];
+    }
+
+    if (lmOvly) {
       using namespace Prof;
 
+      Struct::LM* lmStrct = lmOvly->lmStrct;
+      BinUtil::LM* lm = lmOvly->lm;
+      bool useStruct = (!lm);
+
       const string* unkProcNm = NULL;
       if (n_dyn->isSecondarySynthRoot()) {
 	unkProcNm = &Struct::Tree::PartialUnwindProcNm;
@@ -539,9 +995,16 @@ overlayStaticStructure(Prof::CCT::ANode* node,
 
       // 1. Add symbolic information to 'n_dyn'
       VMA lm_ip = n_dyn->lmIP();
-      Struct::ACodeNode* strct =
-        Analysis::Util::demandStructure(lm_ip, lmStrct, lm, useStruct,
-				unkProcNm);
+      Struct::ACodeNode* strct = NULL;
+      LMOverlay::VMAToStrctMap::const_iterator it_strct =
+	lmOvly->vmaToStrct.find(lm_ip);
+      if (it_strct != lmOvly->vmaToStrct.end()) {
+	strct = it_strct->second;
+      }
+      if (!strct) {
+	strct = Analysis::Util::demandStructure(lm_ip, lmStrct, lm, useStruct,
+						unkProcNm);
+      }
       
       n->structure(strct);
 
@@ -570,7 +1033,7 @@ overlayStaticStructure(Prof::CCT::ANode* node,
     // recur
     // ---------------------------------------------------
     if (!n->isLeaf()) {
-      overlayStaticStructure(n, loadmap_lm, lmStrct, lm);
+      overlayStaticStructure(n, lmVec);
     }
   }
 
@@ -1095,8 +1558,17 @@ makeDatabase(Prof::CallPath::Profile& prof, const Analysis::Args& args)
   Analysis::Util::copySourceFiles(prof.structure()->root(),
 				  args.searchPathTpls, db_dir);
 
-  // 2. Copy trace files (if necessary)
-  Analysis::Util::copyTraceFiles(db_dir, prof.traceFileNameSet());
+  // 2. Write trace files (if necessary) as one merged trace file,
+  //    copying them individually if that fails
+  const std::set<string>& traceFiles = prof.traceFileNameSet();
+  string trace_fnm = db_dir + "/" + Analysis_OUT_DB_TRACE;
+  if (args.db_traceFilesWritten) {
+    // nothing to do
+  }
+  else if (!args.db_mergeTraceFiles || traceFiles.empty()
+	   || !Analysis::Util::mergeTraceFiles(trace_fnm, traceFiles)) {
+    Analysis::Util::copyTraceFiles(db_dir, traceFiles);
+  }
 
   // 3. Create 'experiment.xml' file
   string experiment_fnm = db_dir + "/" + args.out_db_experiment;
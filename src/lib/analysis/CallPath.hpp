@@ -94,9 +94,15 @@ extern std::ostream* dbgOs; // for parallel debugging
 //
 // ---------------------------------------------------------
 
+// read: Read and merge 'profileFiles' in order.  If 'mrgRecords' is
+//   non-NULL, it is passed a record of how each file's profile merged
+//   into the result (cf. Prof::CCT::MergeRecord), including the metric
+//   values of that profile; a result with virtual metrics then has no
+//   metric values.
 Prof::CallPath::Profile*
 read(const Util::StringVec& profileFiles, const Util::UIntVec* groupMap,
-     int mergeTy, uint rFlags = 0, uint mrgFlags = 0);
+     int mergeTy, uint rFlags = 0, uint mrgFlags = 0,
+     Prof::CCT::MergeRecordSink* mrgRecords = NULL);
 
 Prof::CallPath::Profile*
 read(const char* prof_fnm, uint groupId, uint rFlags = 0);
@@ -108,9 +114,16 @@ read(const string& prof_fnm, uint groupId, uint rFlags = 0)
 }
 
 
+// readStructure: read args.structureFiles into 'structure', through
+// their binary copies if args.structureCache is set
 void
 readStructure(Prof::Struct::Tree* structure, const Analysis::Args& args);
 
+// makeStructureCache: write binary copies of args.structureFiles that
+// are missing or out of date (cf. Prof::Struct::makeBinaryCache())
+void
+makeStructureCache(const Analysis::Args& args);
+
 
 // ---------------------------------------------------------
 // 
@@ -63,6 +63,11 @@
 #include <string>
 using std::string;
 
+#include <vector>
+using std::vector;
+
+#include <algorithm>
+
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
 
@@ -144,15 +149,44 @@ Analysis::Raw::writeAsText_callpathMetricDB(const char* filenm)
 
     hpcmetricDB_fmt_hdr_fprint(&hdr, stdout);
 
+    // a sparse database is expanded to the dense rows of the original
+    // format so that the text output does not depend on the layout
+    bool isSparse = hpcmetricDB_fmt_isSparse(&hdr);
+    vector<uint64_t> rowIdx;
+    vector<double> row(hdr.numMetrics);
+    if (isSparse) {
+      rowIdx.resize(hdr.numNodes + 1);
+      ret = hpcmetricDB_fmt_sparse_idx_fread(&rowIdx[0], &hdr, fs);
+      if (ret != HPCFMT_OK) {
+	DIAG_Throw("error reading metric-db file '" << filenm << "'");
+      }
+    }
+
     for (uint nodeId = 1; nodeId < hdr.numNodes + 1; ++nodeId) {
+      if (isSparse) {
+	std::fill(row.begin(), row.end(), 0.0);
+	for (uint64_t i = rowIdx[nodeId - 1]; i < rowIdx[nodeId]; ++i) {
+	  uint32_t mId = 0;
+	  double mval = 0;
+	  ret = hpcmetricDB_fmt_sparse_pair_fread(&mId, &mval, fs);
+	  if (ret != HPCFMT_OK || mId >= hdr.numMetrics) {
+	    DIAG_Throw("error reading metric-db file '" << filenm << "'");
+	  }
+	  row[mId] = mval;
+	}
+      }
+      else {
+	for (uint mId = 0; mId < hdr.numMetrics; ++mId) {
+	  ret = hpcfmt_real8_fread(&row[mId], fs);
+	  if (ret != HPCFMT_OK) {
+	    DIAG_Throw("error reading metric-db file '" << filenm << "'");
+	  }
+	}
+      }
+
       fprintf(stdout, "(%6u: ", nodeId);
       for (uint mId = 0; mId < hdr.numMetrics; ++mId) {
-	double mval = 0;
-	ret = hpcfmt_real8_fread(&mval, fs);
-	if (ret != HPCFMT_OK) {
-	  DIAG_Throw("error reading trace file '" << filenm << "'");
-	}
-	fprintf(stdout, "%12g ", mval);
+	fprintf(stdout, "%12g ", row[mId]);
       }
       fprintf(stdout, ")\n");
     }
@@ -186,10 +220,13 @@ Analysis::Raw::writeAsText_callpathTrace(const char* filenm)
 
     hpctrace_fmt_hdr_fprint(&hdr, stdout);
 
+    hpctrace_fmt_block_t blk;
+    hpctrace_fmt_block_init(&blk, NULL);
+
     // Read trace records and exit on EOF
     while ( !feof(fs) ) {
       hpctrace_fmt_datum_t datum;
-      ret = hpctrace_fmt_datum_fread(&datum, hdr.flags, fs);
+      ret = hpctrace_fmt_datum_fread(&datum, hdr.flags, &blk, fs);
       if (ret == HPCFMT_EOF) {
 	break;
       }
@@ -68,8 +68,14 @@ using std::string;
 #include <typeinfo>
 
 #include <cstring> // strlen()
+#include <cstdlib> // strtol()
+#include <cerrno>
 
 #include <dirent.h> // scandir()
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h> // pwrite()
 
 //*************************** User Include Files ****************************
 
@@ -88,6 +94,7 @@ using std::string;
 #include <lib/support/PathFindMgr.hpp>
 #include <lib/support/PathReplacementMgr.hpp>
 #include <lib/support/diagnostics.h>
+#include <lib/support/FileUtil.hpp>
 #include <lib/support/realpath.h>
 
 //*************************** Forward Declarations **************************
@@ -642,6 +649,349 @@ copyTraceFiles(const std::string& dstDir, const std::set<string>& srcFiles)
 }
 
 
+
+//***************************************************************************
+// merged trace file
+//***************************************************************************
+
+// layout of the merged file (big-endian), as read by hpcserver/hpcviewer:
+//   int type, int numFiles,
+//   numFiles * (int proc, int thread, long offset),
+//   the trace files in name order, long MergedTraceMarker
+static const uint64_t MergedTraceMarker = 0xFFFFFFFFDEADF00DULL;
+
+static const uint MergedTraceHdrSz = 2 * 4;
+static const uint MergedTraceIdxSz = 2 * 4 + 8;
+
+// type bits
+static const int MergedTrace_MultiProcess = 1;
+static const int MergedTrace_MultiThread  = 2;
+
+// positions, from the end, of the process and thread ids in the name
+// <exe>-<proc>-<thread>-<host>-<pid>-<gen>.hpctrace
+static const int MergedTrace_ProcPos   = 5;
+static const int MergedTrace_ThreadPos = 4;
+
+
+static void
+putBigEndian(char* buf, uint64_t val, int nbytes)
+{
+  for (int i = nbytes - 1; i >= 0; --i) {
+    buf[i] = (char)(val & 0xff);
+    val >>= 8;
+  }
+}
+
+
+static bool
+pwriteAll(int fd, const char* buf, size_t len, uint64_t off)
+{
+  while (len > 0) {
+    ssize_t n = pwrite(fd, buf, len, off);
+    if (n < 0) {
+      if (errno == EINTR) {
+	continue;
+      }
+      return false;
+    }
+    buf += n;
+    len -= n;
+    off += n;
+  }
+  return true;
+}
+
+
+static bool
+parseInt(const string& str, int& val)
+{
+  char* end = NULL;
+  val = (int)strtol(str.c_str(), &end, 10);
+  return (!str.empty() && *end == '\0');
+}
+
+
+// parseTraceFileName: the process and thread ids of a trace file, as
+// hpcserver's MergeDataFiles finds them (including its fallback for
+// names with one extra trailing component)
+static bool
+parseTraceFileName(const string& name, int& proc, int& thread)
+{
+  static const string sfx = string(".") + HPCRUN_TraceFnmSfx;
+
+  string base = name;
+  if (base.length() > sfx.length()
+      && base.compare(base.length() - sfx.length(), sfx.length(), sfx) == 0) {
+    base.erase(base.length() - sfx.length());
+  }
+
+  StringVec tokens;
+  size_t beg = 0;
+  while (true) {
+    size_t end = base.find('-', beg);
+    tokens.push_back(base.substr(beg, end - beg));
+    if (end == string::npos) {
+      break;
+    }
+    beg = end + 1;
+  }
+
+  int n = tokens.size();
+  if (n < MergedTrace_ProcPos) {
+    return false;
+  }
+
+  int shift = 0;
+  if (!parseInt(tokens[n - MergedTrace_ProcPos], proc)) {
+    if (n < MergedTrace_ProcPos + 1) {
+      return false;
+    }
+    shift = 1;
+    proc = atoi(tokens[n + shift - MergedTrace_ProcPos].c_str());
+  }
+  thread = atoi(tokens[n + shift - MergedTrace_ThreadPos].c_str());
+  return true;
+}
+
+
+static bool
+lt_MergedTraceFileName(const MergedTraceFile* x, const MergedTraceFile* y)
+{
+  return (x->name < y->name);
+}
+
+
+static bool
+lt_MergedTraceFileOffset(const MergedTraceFile* x, const MergedTraceFile* y)
+{
+  return (x->offset < y->offset);
+}
+
+
+void
+getMergedTraceFiles(const std::set<string>& srcFiles,
+		    MergedTraceFileVec& files)
+{
+  for (std::set<string>::const_iterator it = srcFiles.begin();
+       it != srcFiles.end(); ++it) {
+    const string& x = *it;
+
+    // as in copyTraceFiles(), prefer the rewritten trace.tmp file
+    MergedTraceFile f;
+    f.traceFnm = x;
+    f.srcFnm = x + "." + HPCPROF_TmpFnmSfx;
+    if (!FileUtil::isReadable(f.srcFnm)) {
+      f.srcFnm = x;
+    }
+    f.name = FileUtil::basename(x);
+
+    struct stat sbuf;
+    if (stat(f.srcFnm.c_str(), &sbuf) != 0) {
+      DIAG_EMsg("While merging trace files: cannot stat '" << f.srcFnm << "'");
+      continue;
+    }
+    f.size = sbuf.st_size;
+    files.push_back(f);
+  }
+}
+
+
+uint64_t
+layoutMergedTrace(MergedTraceFileVec& files)
+{
+  std::vector<MergedTraceFile*> order;
+  for (uint i = 0; i < files.size(); ++i) {
+    MergedTraceFile& f = files[i];
+    f.offset = 0;
+    if (parseTraceFileName(f.name, f.proc, f.thread)) {
+      order.push_back(&f);
+    }
+    else {
+      DIAG_WMsg(1, "Copying trace file with unexpected name instead of merging it: '" << f.name << "'");
+    }
+  }
+  std::sort(order.begin(), order.end(), lt_MergedTraceFileName);
+
+  uint64_t offset = MergedTraceHdrSz + (uint64_t)order.size() * MergedTraceIdxSz;
+  for (uint i = 0; i < order.size(); ++i) {
+    order[i]->offset = offset;
+    offset += order[i]->size;
+  }
+  return offset + sizeof(MergedTraceMarker);
+}
+
+
+bool
+writeMergedTraceHeader(int fd, const MergedTraceFileVec& files)
+{
+  std::vector<const MergedTraceFile*> order;
+  int type = 0;
+  for (uint i = 0; i < files.size(); ++i) {
+    const MergedTraceFile& f = files[i];
+    if (f.offset != 0) {
+      order.push_back(&f);
+      if (f.proc != 0) {
+	type |= MergedTrace_MultiProcess;
+      }
+      if (f.thread != 0) {
+	type |= MergedTrace_MultiThread;
+      }
+    }
+  }
+  std::sort(order.begin(), order.end(), lt_MergedTraceFileOffset);
+
+  std::vector<char> buf(MergedTraceHdrSz + order.size() * MergedTraceIdxSz);
+  char* p = &buf[0];
+  putBigEndian(p, type, 4);
+  putBigEndian(p + 4, order.size(), 4);
+  p += MergedTraceHdrSz;
+  for (uint i = 0; i < order.size(); ++i) {
+    putBigEndian(p, order[i]->proc, 4);
+    putBigEndian(p + 4, order[i]->thread, 4);
+    putBigEndian(p + 8, order[i]->offset, 8);
+    p += MergedTraceIdxSz;
+  }
+  return pwriteAll(fd, &buf[0], buf.size(), 0);
+}
+
+
+static bool
+writeMergedTraceFile(int fd, const MergedTraceFile& f, char* buf)
+{
+  int srcFd = open(f.srcFnm.c_str(), O_RDONLY);
+  if (srcFd < 0) {
+    return false;
+  }
+
+  uint64_t copied = 0;
+  bool ok = true;
+  while (ok) {
+    ssize_t n = read(srcFd, buf, HPCIO_RWBufferSz);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      ok = (n == 0);
+      break;
+    }
+    ok = (copied + n <= f.size
+	  && pwriteAll(fd, buf, n, f.offset + copied));
+    copied += n;
+  }
+  close(srcFd);
+
+  // the file must not change size after layoutMergedTrace()
+  return (ok && copied == f.size);
+}
+
+
+bool
+writeMergedTraceFiles(int fd, const MergedTraceFileVec& files)
+{
+  bool ok = true;
+
+#ifdef ENABLE_OPENMP
+#pragma omp parallel
+#endif
+  {
+    char* buf = new char[HPCIO_RWBufferSz];
+
+#ifdef ENABLE_OPENMP
+#pragma omp for schedule(dynamic, 1)
+#endif
+    for (int i = 0; i < (int)files.size(); ++i) {
+      const MergedTraceFile& f = files[i];
+      if (f.offset == 0) {
+	continue;
+      }
+      if (!writeMergedTraceFile(fd, f, buf)) {
+#ifdef ENABLE_OPENMP
+#pragma omp critical (writeMergedTraceFiles)
+#endif
+	{
+	  DIAG_EMsg("While merging trace file '" << f.srcFnm << "'");
+	  ok = false;
+	}
+      }
+    }
+
+    delete[] buf;
+  }
+
+  return ok;
+}
+
+
+bool
+writeMergedTraceMarker(int fd, uint64_t mergedSize)
+{
+  char buf[sizeof(MergedTraceMarker)];
+  putBigEndian(buf, MergedTraceMarker, sizeof(buf));
+  return pwriteAll(fd, buf, sizeof(buf), mergedSize - sizeof(buf));
+}
+
+
+void
+removeMergedTraceTmpFiles(const MergedTraceFileVec& files)
+{
+  static const string sfx = string(".") + HPCPROF_TmpFnmSfx;
+
+  for (uint i = 0; i < files.size(); ++i) {
+    const string& fnm = files[i].srcFnm;
+    if (files[i].offset != 0 && fnm.length() > sfx.length()
+	&& fnm.compare(fnm.length() - sfx.length(), sfx.length(), sfx) == 0) {
+      FileUtil::remove(fnm.c_str());
+    }
+  }
+}
+
+
+void
+copyUnmergedTraceFiles(const std::string& dstDir,
+		       const MergedTraceFileVec& files)
+{
+  std::set<string> unmerged;
+  for (uint i = 0; i < files.size(); ++i) {
+    if (files[i].offset == 0) {
+      unmerged.insert(files[i].traceFnm);
+    }
+  }
+  copyTraceFiles(dstDir, unmerged);
+}
+
+
+bool
+mergeTraceFiles(const std::string& dstFnm, const std::set<string>& srcFiles)
+{
+  MergedTraceFileVec files;
+  getMergedTraceFiles(srcFiles, files);
+  uint64_t mergedSize = layoutMergedTrace(files);
+
+  DIAG_Msg(1, "Merging " << files.size() << " trace files: " << dstFnm);
+
+  int fd = open(dstFnm.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  if (fd < 0) {
+    DIAG_EMsg("While merging trace files: cannot create '" << dstFnm << "'");
+    return false;
+  }
+
+  bool ok = (writeMergedTraceHeader(fd, files)
+	     && writeMergedTraceFiles(fd, files)
+	     && writeMergedTraceMarker(fd, mergedSize));
+  ok = (close(fd) == 0) && ok;
+
+  if (!ok) {
+    DIAG_EMsg("While merging trace files: could not write '" << dstFnm << "'; copying them instead");
+    FileUtil::remove(dstFnm.c_str());
+    return false;
+  }
+
+  removeMergedTraceTmpFiles(files);
+  copyUnmergedTraceFiles(FileUtil::dirname(dstFnm), files);
+  return true;
+}
+
+
 } // end of Util namespace
 } // end of Analysis namespace
 
@@ -71,6 +71,8 @@
 
 #include <include/uint.h>
 
+#include <stdint.h>
+
 #include "Args.hpp"
 
 #include <lib/prof/CallPath-Profile.hpp>
@@ -174,6 +176,77 @@ copyTraceFiles(const std::string& dstDir,
 	       const std::set<std::string>& srcFiles);
 
 
+// --------------------------------------------------------------------------
+// The merged trace file (experiment.mt): the database's trace files
+// concatenated behind a table of (process, thread, offset) entries, in
+// the format hpcserver and hpcviewer otherwise build on first open.
+// --------------------------------------------------------------------------
+
+class MergedTraceFile {
+public:
+  MergedTraceFile()
+    : size(0), proc(0), thread(0), offset(0)
+  { }
+
+  std::string traceFnm; // the trace file, as in the profile
+  std::string srcFnm; // file to copy (rewritten '.tmp' file, if any)
+  std::string name;   // name of the trace file within the database
+  uint64_t size;
+  int proc, thread;
+  uint64_t offset;    // offset in the merged file; 0 if 'name' is unusable
+};
+
+typedef std::vector<MergedTraceFile> MergedTraceFileVec;
+
+
+// getMergedTraceFiles: fills 'srcFnm', 'name' and 'size' of each trace
+// file in 'srcFiles'
+void
+getMergedTraceFiles(const std::set<std::string>& srcFiles,
+		    MergedTraceFileVec& files);
+
+// layoutMergedTrace: assigns 'proc', 'thread' and 'offset' of each file
+// (in name order, as the merged file is read) without reordering 'files'.
+// Returns the size of the merged file.
+uint64_t
+layoutMergedTrace(MergedTraceFileVec& files);
+
+// writeMergedTraceHeader, writeMergedTraceFiles, writeMergedTraceMarker:
+// write the pieces of a merged file laid out by layoutMergedTrace().
+// The pieces are written with positioned writes, so different processes
+// may write disjoint subsets of the files concurrently; the end marker,
+// which marks the file as complete, should be written last.  Each returns
+// false on error.
+bool
+writeMergedTraceHeader(int fd, const MergedTraceFileVec& files);
+
+bool
+writeMergedTraceFiles(int fd, const MergedTraceFileVec& files);
+
+bool
+writeMergedTraceMarker(int fd, uint64_t mergedSize);
+
+// removeMergedTraceTmpFiles: removes the '.tmp' trace files that have
+// been written to the merged file
+void
+removeMergedTraceTmpFiles(const MergedTraceFileVec& files);
+
+// copyUnmergedTraceFiles: copies the files that layoutMergedTrace() left
+// out of the merged file (unexpected names) into 'dstDir', so that they
+// are kept in the database
+void
+copyUnmergedTraceFiles(const std::string& dstDir,
+		       const MergedTraceFileVec& files);
+
+// mergeTraceFiles: writes 'srcFiles' into the merged trace file
+// 'dstFnm', copying the files it cannot hold next to it.  On failure,
+// removes 'dstFnm' and returns false, leaving the trace files for
+// copyTraceFiles().
+bool
+mergeTraceFiles(const std::string& dstFnm,
+		const std::set<std::string>& srcFiles);
+
+
 } // namespace Util
 
 } // namespace Analysis
@@ -257,6 +257,71 @@ hpcfmt_real8_fwrite(double val, FILE* outfs)
 }
 
 
+//***************************************************************************
+// Big-endian encoding into memory (for writers that buffer whole blocks
+// and emit them with a single fwrite)
+//***************************************************************************
+
+static inline void
+hpcfmt_int4_encode(uint32_t val, uint8_t* buf)
+{
+  for (int i = 3; i >= 0; --i) {
+    buf[i] = (uint8_t)(val & 0xff);
+    val >>= 8;
+  }
+}
+
+
+static inline void
+hpcfmt_int8_encode(uint64_t val, uint8_t* buf)
+{
+  for (int i = 7; i >= 0; --i) {
+    buf[i] = (uint8_t)(val & 0xff);
+    val >>= 8;
+  }
+}
+
+
+static inline void
+hpcfmt_real8_encode(double val, uint8_t* buf)
+{
+  hpcfmt_byte8_union_t v;
+  v.r8 = val;
+  hpcfmt_int8_encode(v.i8, buf);
+}
+
+
+static inline uint32_t
+hpcfmt_int4_decode(const uint8_t* buf)
+{
+  uint32_t val = 0;
+  for (int i = 0; i < 4; ++i) {
+    val = (val << 8) | buf[i];
+  }
+  return val;
+}
+
+
+static inline uint64_t
+hpcfmt_int8_decode(const uint8_t* buf)
+{
+  uint64_t val = 0;
+  for (int i = 0; i < 8; ++i) {
+    val = (val << 8) | buf[i];
+  }
+  return val;
+}
+
+
+static inline double
+hpcfmt_real8_decode(const uint8_t* buf)
+{
+  hpcfmt_byte8_union_t v;
+  v.i8 = hpcfmt_int8_decode(buf);
+  return v.r8;
+}
+
+
 //***************************************************************************
 // hpcfmt_str_t
 //***************************************************************************
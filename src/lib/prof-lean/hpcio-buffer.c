@@ -71,6 +71,14 @@
 //
 // Deserves further study: the best way to handle errors from write().
 //
+// Async mode: the client supplies a second (spare) buffer and a
+// handoff function.  When the buffer fills, it is swapped with the
+// spare and handed off, so that another thread can write() it while
+// the client keeps filling the other one.  If the spare is still being
+// written, the write waits only briefly and is then dropped whole (a
+// record is never split), so a slow file system cannot stall a
+// signal handler.
+//
 //***************************************************************************
 
 //************************* System Include Files ****************************
@@ -79,6 +87,7 @@
 #include <sys/stat.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <sched.h>
 #include <string.h>
 #include <unistd.h>
 
@@ -92,6 +101,10 @@
 
 #define HPCIO_OUTBUF_MAGIC  0x494F4246
 
+// times a write in async mode yields waiting for the spare buffer
+// before its data is dropped
+#define HPCIO_OUTBUF_STALL_YIELDS  16
+
 
 //*************************** Private Functions *****************************
 
@@ -137,6 +150,52 @@ outbuf_flush_buffer(hpcio_outbuf_t *outbuf)
 }
 
 
+// Wait, without bound, until the spare buffer has been written.
+//
+static void
+outbuf_drain_spare(hpcio_outbuf_t *outbuf)
+{
+  while (atomic_load_explicit(&outbuf->spare_busy, memory_order_acquire)) {
+    sched_yield();
+  }
+}
+
+
+// Swap the full buffer with the spare and hand it off to be written.
+//
+// Returns: HPCFMT_OK if the buffer is now empty, or HPCFMT_ERR if the
+// spare was still busy after a short wait.
+//
+static int
+outbuf_handoff(hpcio_outbuf_t *outbuf)
+{
+  int k;
+
+  for (k = 0; atomic_load_explicit(&outbuf->spare_busy, memory_order_acquire); k++) {
+    if (k == HPCIO_OUTBUF_STALL_YIELDS) {
+      return HPCFMT_ERR;
+    }
+    if (k == 0) {
+      outbuf->stalls++;
+    }
+    sched_yield();
+  }
+
+  void *full = outbuf->buf_start;
+  outbuf->buf_start = outbuf->spare_start;
+  outbuf->spare_start = full;
+  outbuf->spare_in_use = outbuf->in_use;
+  outbuf->in_use = 0;
+  outbuf->handoffs++;
+
+  atomic_store_explicit(&outbuf->spare_busy, 1, memory_order_release);
+  if (outbuf->handoff == NULL || outbuf->handoff(outbuf) != HPCFMT_OK) {
+    hpcio_outbuf_write_spare(outbuf);
+  }
+  return HPCFMT_OK;
+}
+
+
 //*************************** Interface Functions ***************************
 
 // Attach the file descriptor to the buffer, initialize and fill in
@@ -163,6 +222,39 @@ hpcio_outbuf_attach(hpcio_outbuf_t *outbuf /* out */, int fd,
   outbuf->use_lock = (flags & HPCIO_OUTBUF_LOCKED);
   spinlock_unlock(&outbuf->lock);
 
+  outbuf->spare_start = NULL;
+  outbuf->spare_in_use = 0;
+  atomic_store(&outbuf->spare_busy, 0);
+  outbuf->spare_err = 0;
+  outbuf->handoff = NULL;
+  outbuf->next = NULL;
+  outbuf->handoffs = 0;
+  outbuf->stalls = 0;
+  outbuf->drops = 0;
+
+  return HPCFMT_OK;
+}
+
+
+// Attach in async mode.  buf_start and spare_start are two buffers of
+// buf_size bytes each, and handoff is called with each full buffer.
+//
+// Returns: HPCFMT_OK on success, else HPCFMT_ERR.
+//
+int
+hpcio_outbuf_attach_async(hpcio_outbuf_t *outbuf /* out */, int fd,
+			  void *buf_start, void *spare_start, size_t buf_size,
+			  int flags, hpcio_outbuf_handoff_fn *handoff)
+{
+  if (spare_start == NULL
+      || hpcio_outbuf_attach(outbuf, fd, buf_start, buf_size,
+			     flags | HPCIO_OUTBUF_ASYNC) != HPCFMT_OK) {
+    return HPCFMT_ERR;
+  }
+
+  outbuf->spare_start = spare_start;
+  outbuf->handoff = handoff;
+
   return HPCFMT_OK;
 }
 
@@ -183,6 +275,26 @@ hpcio_outbuf_write(hpcio_outbuf_t *outbuf, const void *data, size_t size)
     spinlock_lock(&outbuf->lock);
   }
 
+  if (outbuf->flags & HPCIO_OUTBUF_ASYNC) {
+    if (size <= outbuf->buf_size) {
+      // the data goes in whole, or is dropped
+      if (size > outbuf->buf_size - outbuf->in_use
+	  && outbuf_handoff(outbuf) != HPCFMT_OK) {
+	outbuf->drops++;
+      }
+      else {
+	memcpy(outbuf->buf_start + outbuf->in_use, data, size);
+	outbuf->in_use += size;
+      }
+      if (outbuf->use_lock) {
+	spinlock_unlock(&outbuf->lock);
+      }
+      return size;
+    }
+    // larger than a buffer: keep the order and write it synchronously
+    outbuf_drain_spare(outbuf);
+  }
+
   amt_done = 0;
   while (amt_done < size) {
     // flush if needed
@@ -208,7 +320,42 @@ hpcio_outbuf_write(hpcio_outbuf_t *outbuf, const void *data, size_t size)
 }
 
 
-// Flush the outbuf to the kernel via write().
+// Write the spare buffer of an async outbuf and make it available
+// again.  Called by the thread that the buffer was handed off to.
+//
+// Returns: HPCFMT_OK on success, else HPCFMT_ERR (the data is lost,
+// and the error is also reported by flush and close).
+//
+int
+hpcio_outbuf_write_spare(hpcio_outbuf_t *outbuf)
+{
+  size_t amt_done = 0;
+  ssize_t ret;
+  int err = 0;
+
+  while (amt_done < outbuf->spare_in_use) {
+    errno = 0;
+    ret = write(outbuf->fd, outbuf->spare_start + amt_done,
+		outbuf->spare_in_use - amt_done);
+    if (ret > 0) {
+      amt_done += ret;
+    }
+    else if (! (ret < 0 && errno == EINTR)) {
+      err = 1;
+      outbuf->spare_err = 1;
+      break;
+    }
+  }
+
+  outbuf->spare_in_use = 0;
+  atomic_store_explicit(&outbuf->spare_busy, 0, memory_order_release);
+
+  return err ? HPCFMT_ERR : HPCFMT_OK;
+}
+
+
+// Flush the outbuf to the kernel via write().  In async mode, first
+// wait for the spare buffer to be written.
 //
 // Returns: HPCFMT_OK on success, else HPCFMT_ERR.
 //
@@ -222,7 +369,13 @@ hpcio_outbuf_flush(hpcio_outbuf_t *outbuf)
     spinlock_lock(&outbuf->lock);
   }
 
+  if (outbuf->flags & HPCIO_OUTBUF_ASYNC) {
+    outbuf_drain_spare(outbuf);
+  }
   int ret = outbuf_flush_buffer(outbuf);
+  if (outbuf->spare_err) {
+    ret = HPCFMT_ERR;
+  }
 
   if (outbuf->use_lock) {
     spinlock_unlock(&outbuf->lock);
@@ -249,7 +402,10 @@ hpcio_outbuf_close(hpcio_outbuf_t *outbuf)
     spinlock_lock(&outbuf->lock);
   }
 
-  if (outbuf_flush_buffer(outbuf) == HPCFMT_OK
+  if (outbuf->flags & HPCIO_OUTBUF_ASYNC) {
+    outbuf_drain_spare(outbuf);
+  }
+  if (outbuf_flush_buffer(outbuf) == HPCFMT_OK && ! outbuf->spare_err
       && close(outbuf->fd) == 0) {
     // flush and close both succeed
     outbuf->magic = 0;
@@ -53,7 +53,16 @@
 #include "spinlock.h"
 
 
-// Clients should treat the outbuf struct as opaque.
+// Clients should treat the outbuf struct as opaque, except for the
+// async counters and the next field, which is free for the client's
+// queue of handed off buffers.
+
+struct hpcio_outbuf_s;
+
+// Called in async mode with a full buffer in the spare, to have some
+// other thread write it with hpcio_outbuf_write_spare().  Returns
+// HPCFMT_OK if the spare will be written, else the caller writes it.
+typedef int hpcio_outbuf_handoff_fn(struct hpcio_outbuf_s *outbuf);
 
 typedef struct hpcio_outbuf_s {
   uint32_t magic;
@@ -64,6 +73,19 @@ typedef struct hpcio_outbuf_s {
   int  flags;
   char use_lock;
   spinlock_t lock;
+
+  // async mode: spare_in_use bytes of the spare buffer are waiting
+  // to be written while spare_busy is set
+  void  *spare_start;
+  size_t spare_in_use;
+  atomic_long spare_busy;
+  int    spare_err;
+  hpcio_outbuf_handoff_fn *handoff;
+  struct hpcio_outbuf_s *next;
+
+  long handoffs;  // full buffers handed off
+  long stalls;    // writes that had to wait for the spare
+  long drops;     // writes dropped because the spare stayed busy
 } hpcio_outbuf_t;
 
 
@@ -73,6 +95,7 @@ typedef struct hpcio_outbuf_s {
 
 #define HPCIO_OUTBUF_LOCKED    0x1
 #define HPCIO_OUTBUF_UNLOCKED  0x2
+#define HPCIO_OUTBUF_ASYNC     0x4
 
 #if defined(__cplusplus)
 extern "C" {
@@ -82,9 +105,17 @@ int
 hpcio_outbuf_attach(hpcio_outbuf_t *outbuf /* out */, int fd,
 		    void *buf_start, size_t buf_size, int flags);
 
+int
+hpcio_outbuf_attach_async(hpcio_outbuf_t *outbuf /* out */, int fd,
+			  void *buf_start, void *spare_start, size_t buf_size,
+			  int flags, hpcio_outbuf_handoff_fn *handoff);
+
 ssize_t
 hpcio_outbuf_write(hpcio_outbuf_t *outbuf, const void *data, size_t size);
 
+int
+hpcio_outbuf_write_spare(hpcio_outbuf_t *outbuf);
+
 int
 hpcio_outbuf_flush(hpcio_outbuf_t *outbuf);
 
@@ -766,6 +766,27 @@ const hpctrace_hdr_flags_t hpctrace_hdr_flags_NULL = {
   .bits = 0
 };
 
+const hpctrace_hdr_clock_t hpctrace_hdr_clock_NULL = {
+  .source    = HPCTRACE_CLOCK_WALL_US,
+  .clockBase = 0,
+  .wallBase  = 0
+};
+
+
+int
+hpctrace_fmt_hdr_len(double version)
+{
+  int len = HPCTRACE_FMT_MagicLen + HPCTRACE_FMT_VersionLen
+    + HPCTRACE_FMT_EndianLen;
+  if (version >= HPCTRACE_FMT_Version_101) {
+    len += HPCTRACE_FMT_FlagsLen;
+  }
+  if (version >= HPCTRACE_FMT_Version_102) {
+    len += HPCTRACE_FMT_ClockLen;
+  }
+  return len;
+}
+
 
 int
 hpctrace_fmt_hdr_fread(hpctrace_fmt_hdr_t* hdr, FILE* infs)
@@ -795,10 +816,17 @@ hpctrace_fmt_hdr_fread(hpctrace_fmt_hdr_t* hdr, FILE* infs)
   }
 
   hdr->flags = hpctrace_hdr_flags_NULL;
-  if (hdr->version > 1.0) {
+  if (hdr->version >= HPCTRACE_FMT_Version_101) {
     HPCFMT_ThrowIfError(hpcfmt_int8_fread(&(hdr->flags.bits), infs));
   }
 
+  hdr->clock = hpctrace_hdr_clock_NULL;
+  if (hdr->version >= HPCTRACE_FMT_Version_102) {
+    HPCFMT_ThrowIfError(hpcfmt_int8_fread(&(hdr->clock.source), infs));
+    HPCFMT_ThrowIfError(hpcfmt_int8_fread(&(hdr->clock.clockBase), infs));
+    HPCFMT_ThrowIfError(hpcfmt_int8_fread(&(hdr->clock.wallBase), infs));
+  }
+
   return HPCFMT_OK;
 }
 
@@ -806,18 +834,24 @@ hpctrace_fmt_hdr_fread(hpctrace_fmt_hdr_t* hdr, FILE* infs)
 // Writer based on outbuf.
 // Returns: HPCFMT_OK on success, else HPCFMT_ERR.
 int
-hpctrace_fmt_hdr_outbuf(hpctrace_hdr_flags_t flags, hpcio_outbuf_t* outbuf)
+hpctrace_fmt_hdr_outbuf(hpctrace_hdr_flags_t flags,
+			const hpctrace_hdr_clock_t* clock,
+			hpcio_outbuf_t* outbuf)
 {
   ssize_t ret;
 
-  const int bufSZ = sizeof(flags);
+  const int bufSZ = sizeof(flags) + sizeof(*clock);
   unsigned char buf[bufSZ];
 
-  uint64_t flag_bits = flags.bits;
+  uint64_t words[4] = {
+    flags.bits, clock->source, clock->clockBase, clock->wallBase
+  };
   int k = 0;
-  for (int shift = 56; shift >= 0; shift -= 8) {
-    buf[k] = (flag_bits >> shift) & 0xff;
-    k++;
+  for (int i = 0; i < 4; i++) {
+    for (int shift = 56; shift >= 0; shift -= 8) {
+      buf[k] = (words[i] >> shift) & 0xff;
+      k++;
+    }
   }
 
   hpcio_outbuf_write(outbuf, HPCTRACE_FMT_Magic, HPCTRACE_FMT_MagicLen);
@@ -835,7 +869,8 @@ hpctrace_fmt_hdr_outbuf(hpctrace_hdr_flags_t flags, hpcio_outbuf_t* outbuf)
 
 // N.B.: not async safe
 int
-hpctrace_fmt_hdr_fwrite(hpctrace_hdr_flags_t flags, FILE* fs)
+hpctrace_fmt_hdr_fwrite(hpctrace_hdr_flags_t flags,
+			const hpctrace_hdr_clock_t* clock, FILE* fs)
 {
   int nw;
 
@@ -850,6 +885,10 @@ hpctrace_fmt_hdr_fwrite(hpctrace_hdr_flags_t flags, FILE* fs)
 
   HPCFMT_ThrowIfError(hpcfmt_int8_fwrite(flags.bits, fs));
 
+  HPCFMT_ThrowIfError(hpcfmt_int8_fwrite(clock->source, fs));
+  HPCFMT_ThrowIfError(hpcfmt_int8_fwrite(clock->clockBase, fs));
+  HPCFMT_ThrowIfError(hpcfmt_int8_fwrite(clock->wallBase, fs));
+
   return HPCFMT_OK;
 }
 
@@ -863,6 +902,8 @@ hpctrace_fmt_hdr_fprint(hpctrace_fmt_hdr_t* hdr, FILE* fs)
   fprintf(fs, "  (version: %s)\n", hdr->versionStr);
   fprintf(fs, "  (endian: %c)\n", hdr->endian);
   fprintf(fs, "  (flags: 0x%"PRIx64")\n", hdr->flags.bits);
+  fprintf(fs, "  (clock: %"PRIu64", base: %"PRIu64", wall: %"PRIu64")\n",
+	  hdr->clock.source, hdr->clock.clockBase, hdr->clock.wallBase);
   fprintf(fs, "]\n");
 
   return HPCFMT_OK;
@@ -873,11 +914,94 @@ hpctrace_fmt_hdr_fprint(hpctrace_fmt_hdr_t* hdr, FILE* fs)
 // [hpctrace] datum (trace record)
 //***************************************************************************
 
+// zig-zag maps small negative deltas to small unsigned values
+static inline uint64_t
+hpctrace_fmt_zigzag_encode(int64_t v)
+{
+  return ((uint64_t) v << 1) ^ (uint64_t) (v >> 63);
+}
+
+
+static inline int64_t
+hpctrace_fmt_zigzag_decode(uint64_t v)
+{
+  return (int64_t) (v >> 1) ^ -(int64_t) (v & 1);
+}
+
+
+static int
+hpctrace_fmt_varint_fread(uint64_t* val, FILE* fs)
+{
+  uint64_t v = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    int c = getc(fs);
+    if (c == EOF) {
+      return HPCFMT_ERR;
+    }
+    v |= ((uint64_t) (c & 0x7f)) << shift;
+    if (! (c & 0x80)) {
+      *val = v;
+      return HPCFMT_OK;
+    }
+  }
+  return HPCFMT_ERR;
+}
+
+
+static int
+hpctrace_fmt_datum_fread_compact(hpctrace_fmt_datum_t* x,
+				 hpctrace_hdr_flags_t flags,
+				 hpctrace_fmt_block_t* blk, FILE* fs)
+{
+  uint64_t zz;
+
+  if (blk->nrecords == 0) {
+    uint32_t len, nrecords;
+    int ret = hpcfmt_int4_fread(&len, fs);
+    if (ret != HPCFMT_OK) {
+      return ret; // can be HPCFMT_EOF
+    }
+    HPCFMT_ThrowIfError(hpcfmt_int4_fread(&nrecords, fs));
+    HPCFMT_ThrowIfError(hpcfmt_int8_fread(&(blk->firstTime), fs));
+    if (nrecords == 0) {
+      // the block index follows the last block
+      return HPCFMT_EOF;
+    }
+    blk->nrecords = nrecords;
+    blk->time = blk->firstTime;
+    blk->cpId = 0;
+  }
+
+  HPCFMT_ThrowIfError(hpctrace_fmt_varint_fread(&zz, fs));
+  blk->time += (uint64_t) hpctrace_fmt_zigzag_decode(zz);
+  HPCFMT_ThrowIfError(hpctrace_fmt_varint_fread(&zz, fs));
+  blk->cpId += (uint32_t) hpctrace_fmt_zigzag_decode(zz);
+  x->time = blk->time;
+  x->cpId = blk->cpId;
+
+  if (flags.fields.isDataCentric) {
+    HPCFMT_ThrowIfError(hpctrace_fmt_varint_fread(&zz, fs));
+    x->metricId = (uint32_t) zz;
+  }
+  else {
+    x->metricId = HPCRUN_FMT_MetricId_NULL;
+  }
+
+  blk->nrecords--;
+  return HPCFMT_OK;
+}
+
+
 int
 hpctrace_fmt_datum_fread(hpctrace_fmt_datum_t* x, hpctrace_hdr_flags_t flags,
-			 FILE* fs)
+			 hpctrace_fmt_block_t* blk, FILE* fs)
 {
   int ret = HPCFMT_OK;
+
+  if (flags.fields.isCompact) {
+    return (blk) ? hpctrace_fmt_datum_fread_compact(x, flags, blk, fs)
+                 : HPCFMT_ERR;
+  }
   
   ret = hpcfmt_int8_fread(&(x->time), fs);
   if (ret != HPCFMT_OK) {
@@ -964,6 +1088,220 @@ hpctrace_fmt_datum_fprint(hpctrace_fmt_datum_t* x, hpctrace_hdr_flags_t flags,
 }
 
 
+//***************************************************************************
+// [hpctrace] compact blocks
+//***************************************************************************
+
+static inline unsigned char*
+hpctrace_fmt_varint_put(unsigned char* p, uint64_t v)
+{
+  while (v >= 0x80) {
+    *p++ = (v & 0x7f) | 0x80;
+    v >>= 7;
+  }
+  *p++ = v;
+  return p;
+}
+
+
+static inline const unsigned char*
+hpctrace_fmt_varint_get(const unsigned char* p, const unsigned char* end,
+			uint64_t* val)
+{
+  uint64_t v = 0;
+  for (int shift = 0; shift < 64 && p < end; shift += 7) {
+    unsigned char c = *p++;
+    v |= ((uint64_t) (c & 0x7f)) << shift;
+    if (! (c & 0x80)) {
+      *val = v;
+      return p;
+    }
+  }
+  return NULL;
+}
+
+
+static inline void
+hpctrace_fmt_be_put(unsigned char* p, uint64_t v, int len)
+{
+  for (int k = len - 1; k >= 0; k--) {
+    p[k] = v & 0xff;
+    v >>= 8;
+  }
+}
+
+
+static inline uint64_t
+hpctrace_fmt_be_get(const unsigned char* p, int len)
+{
+  uint64_t v = 0;
+  for (int k = 0; k < len; k++) {
+    v = (v << 8) | p[k];
+  }
+  return v;
+}
+
+
+void
+hpctrace_fmt_block_init(hpctrace_fmt_block_t* blk, unsigned char* buf)
+{
+  blk->nrecords = 0;
+  blk->len = 0;
+  blk->firstTime = 0;
+  blk->time = 0;
+  blk->cpId = 0;
+  blk->buf = buf;
+}
+
+
+bool
+hpctrace_fmt_block_append(hpctrace_fmt_block_t* blk, hpctrace_fmt_datum_t* x,
+			  hpctrace_hdr_flags_t flags)
+{
+  if (blk->nrecords == 0) {
+    blk->firstTime = blk->time = x->time;
+    blk->cpId = 0;
+    blk->len = 0;
+  }
+
+  unsigned char* p = blk->buf + HPCTRACE_FMT_BlockHdrLen + blk->len;
+  unsigned char* start = p;
+
+  p = hpctrace_fmt_varint_put(p, hpctrace_fmt_zigzag_encode((int64_t) (x->time - blk->time)));
+  p = hpctrace_fmt_varint_put(p, hpctrace_fmt_zigzag_encode((int64_t) x->cpId - (int64_t) blk->cpId));
+  if (flags.fields.isDataCentric) {
+    p = hpctrace_fmt_varint_put(p, x->metricId);
+  }
+
+  blk->len += p - start;
+  blk->time = x->time;
+  blk->cpId = x->cpId;
+  blk->nrecords++;
+
+  return blk->nrecords == HPCTRACE_FMT_BlockRecords;
+}
+
+
+// Fill in the block header and return the length of the whole block.
+static size_t
+hpctrace_fmt_block_finish(hpctrace_fmt_block_t* blk)
+{
+  hpctrace_fmt_be_put(blk->buf, blk->len, 4);
+  hpctrace_fmt_be_put(blk->buf + 4, blk->nrecords, 4);
+  hpctrace_fmt_be_put(blk->buf + 8, blk->firstTime, 8);
+  return HPCTRACE_FMT_BlockHdrLen + blk->len;
+}
+
+
+int
+hpctrace_fmt_block_outbuf(hpctrace_fmt_block_t* blk, hpcio_outbuf_t* outbuf)
+{
+  if (blk->nrecords == 0) {
+    return HPCFMT_OK;
+  }
+
+  ssize_t len = hpctrace_fmt_block_finish(blk);
+  blk->nrecords = 0;
+  blk->len = 0;
+
+  if (hpcio_outbuf_write(outbuf, blk->buf, len) != len) {
+    return HPCFMT_ERR;
+  }
+  return HPCFMT_OK;
+}
+
+
+// N.B.: not async safe
+int
+hpctrace_fmt_block_fwrite(hpctrace_fmt_block_t* blk, FILE* fs)
+{
+  if (blk->nrecords == 0) {
+    return HPCFMT_OK;
+  }
+
+  size_t len = hpctrace_fmt_block_finish(blk);
+  blk->nrecords = 0;
+  blk->len = 0;
+
+  if (fwrite(blk->buf, 1, len, fs) != len) {
+    return HPCFMT_ERR;
+  }
+  return HPCFMT_OK;
+}
+
+
+// N.B.: not async safe
+int
+hpctrace_fmt_index_fwrite(const hpctrace_fmt_index_entry_t* index,
+			  uint64_t nblocks, uint64_t nrecords, FILE* fs)
+{
+  HPCFMT_ThrowIfError(hpcfmt_int4_fwrite(nblocks * HPCTRACE_FMT_IndexEntryLen, fs));
+  HPCFMT_ThrowIfError(hpcfmt_int4_fwrite(0, fs));
+  HPCFMT_ThrowIfError(hpcfmt_int8_fwrite(0, fs));
+
+  for (uint64_t i = 0; i < nblocks; i++) {
+    HPCFMT_ThrowIfError(hpcfmt_int8_fwrite(index[i].offset, fs));
+    HPCFMT_ThrowIfError(hpcfmt_int8_fwrite(index[i].time, fs));
+  }
+
+  HPCFMT_ThrowIfError(hpcfmt_int8_fwrite(nblocks, fs));
+  HPCFMT_ThrowIfError(hpcfmt_int8_fwrite(nrecords, fs));
+  if (fwrite(HPCTRACE_FMT_IndexTag, 1, 8, fs) != 8) {
+    return HPCFMT_ERR;
+  }
+
+  return HPCFMT_OK;
+}
+
+
+int
+hpctrace_fmt_block_decode(const unsigned char* p, size_t avail,
+			  hpctrace_hdr_flags_t flags, hpctrace_fmt_datum_t* x,
+			  size_t* blockLen)
+{
+  if (avail < HPCTRACE_FMT_BlockHdrLen) {
+    return -1;
+  }
+
+  uint64_t len = hpctrace_fmt_be_get(p, 4);
+  uint32_t nrecords = hpctrace_fmt_be_get(p + 4, 4);
+  uint64_t time = hpctrace_fmt_be_get(p + 8, 8);
+  uint32_t cpId = 0;
+
+  *blockLen = HPCTRACE_FMT_BlockHdrLen + len;
+  if (*blockLen > avail || nrecords > HPCTRACE_FMT_BlockRecords) {
+    return -1;
+  }
+
+  const unsigned char* q = p + HPCTRACE_FMT_BlockHdrLen;
+  const unsigned char* end = q + len;
+  uint64_t zz;
+
+  for (uint32_t i = 0; i < nrecords; i++) {
+    if ((q = hpctrace_fmt_varint_get(q, end, &zz)) == NULL) {
+      return -1;
+    }
+    time += (uint64_t) hpctrace_fmt_zigzag_decode(zz);
+    if ((q = hpctrace_fmt_varint_get(q, end, &zz)) == NULL) {
+      return -1;
+    }
+    cpId += (uint32_t) hpctrace_fmt_zigzag_decode(zz);
+
+    x[i].time = time;
+    x[i].cpId = cpId;
+    x[i].metricId = HPCRUN_FMT_MetricId_NULL;
+    if (flags.fields.isDataCentric) {
+      if ((q = hpctrace_fmt_varint_get(q, end, &zz)) == NULL) {
+	return -1;
+      }
+      x[i].metricId = zz;
+    }
+  }
+
+  return nrecords;
+}
+
+
 //***************************************************************************
 // hpcprof-metricdb (located here for now)
 //***************************************************************************
@@ -994,16 +1332,23 @@ hpcmetricDB_fmt_hdr_fread(hpcmetricDB_fmt_hdr_t* hdr, FILE* infs)
   if (nr != HPCMETRICDB_FMT_VersionLen) {
     return HPCFMT_ERR;
   }
+  strcpy(hdr->versionStr, version);
   hdr->version = atof(hdr->versionStr);
 
   nr = fread(&endian, 1, HPCMETRICDB_FMT_EndianLen, infs);
   if (nr != HPCMETRICDB_FMT_EndianLen) {
     return HPCFMT_ERR;
   }
+  hdr->endian = endian[0];
 
   HPCFMT_ThrowIfError(hpcfmt_int4_fread(&(hdr->numNodes), infs));
   HPCFMT_ThrowIfError(hpcfmt_int4_fread(&(hdr->numMetrics), infs));
 
+  hdr->flags = 0;
+  if (hdr->version >= HPCMETRICDB_FMT_Version_020) {
+    HPCFMT_ThrowIfError(hpcfmt_int8_fread(&(hdr->flags), infs));
+  }
+
   return HPCFMT_OK;
 }
 
@@ -1013,10 +1358,13 @@ hpcmetricDB_fmt_hdr_fwrite(hpcmetricDB_fmt_hdr_t* hdr, FILE* outfs)
 {
   int nw;
 
+  const char* versionStr =
+    (hdr->flags) ? HPCMETRICDB_FMT_Version : HPCMETRICDB_FMT_VersionDense;
+
   nw = fwrite(HPCMETRICDB_FMT_Magic,   1, HPCMETRICDB_FMT_MagicLen, outfs);
   if (nw != HPCTRACE_FMT_MagicLen) return HPCFMT_ERR;
 
-  nw = fwrite(HPCMETRICDB_FMT_Version, 1, HPCMETRICDB_FMT_VersionLen, outfs);
+  nw = fwrite(versionStr, 1, HPCMETRICDB_FMT_VersionLen, outfs);
   if (nw != HPCMETRICDB_FMT_VersionLen) return HPCFMT_ERR;
 
   nw = fwrite(HPCMETRICDB_FMT_Endian,  1, HPCMETRICDB_FMT_EndianLen, outfs);
@@ -1025,6 +1373,10 @@ hpcmetricDB_fmt_hdr_fwrite(hpcmetricDB_fmt_hdr_t* hdr, FILE* outfs)
   HPCFMT_ThrowIfError(hpcfmt_int4_fwrite(hdr->numNodes, outfs));
   HPCFMT_ThrowIfError(hpcfmt_int4_fwrite(hdr->numMetrics, outfs));
 
+  if (hdr->flags) {
+    HPCFMT_ThrowIfError(hpcfmt_int8_fwrite(hdr->flags, outfs));
+  }
+
   return HPCFMT_OK;
 }
 
@@ -1037,7 +1389,32 @@ hpcmetricDB_fmt_hdr_fprint(hpcmetricDB_fmt_hdr_t* hdr, FILE* outfs)
 
   fprintf(outfs, "(num-nodes:   %u)\n", hdr->numNodes);
   fprintf(outfs, "(num-metrics: %u)\n", hdr->numMetrics);
+  fprintf(outfs, "(layout:      %s)\n",
+	  hpcmetricDB_fmt_isSparse(hdr) ? "sparse" : "dense");
+
+  return HPCFMT_OK;
+}
+
 
+int
+hpcmetricDB_fmt_sparse_idx_fread(uint64_t* rowIdx,
+				 const hpcmetricDB_fmt_hdr_t* hdr, FILE* infs)
+{
+  for (uint32_t i = 0; i <= hdr->numNodes; ++i) {
+    HPCFMT_ThrowIfError(hpcfmt_int8_fread(&rowIdx[i], infs));
+    if (i > 0 && rowIdx[i] < rowIdx[i - 1]) {
+      return HPCFMT_ERR;
+    }
+  }
+  return HPCFMT_OK;
+}
+
+
+int
+hpcmetricDB_fmt_sparse_pair_fread(uint32_t* mId, double* mval, FILE* infs)
+{
+  HPCFMT_ThrowIfError(hpcfmt_int4_fread(mId, infs));
+  HPCFMT_ThrowIfError(hpcfmt_real8_fread(mval, infs));
   return HPCFMT_OK;
 }
 
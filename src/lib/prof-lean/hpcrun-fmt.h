@@ -582,15 +582,23 @@ hpcrun_fmt_lip_fprint(lush_lip_t* x, FILE* fs, const char* pre);
 // Header sizes:
 // - version 1.00: 24 bytes
 // - version 1.01: 32 bytes: 24 + sizeof(hpctrace_hdr_flags_t)
+// - version 1.02: 56 bytes: 32 + sizeof(hpctrace_hdr_clock_t)
+// - version 1.03: 56 bytes, adds the isCompact flag (compact records)
 
 static const char HPCTRACE_FMT_Magic[]   = "HPCRUN-trace______"; // 18 bytes
-static const char HPCTRACE_FMT_Version[] = "01.01";              // 5 bytes
+static const char HPCTRACE_FMT_Version[] = "01.03";              // 5 bytes
 static const char HPCTRACE_FMT_Endian[]  = "b";                  // 1 byte
 
+// currently supported versions
+static const double HPCTRACE_FMT_Version_101 = 1.01;
+static const double HPCTRACE_FMT_Version_102 = 1.02;
+static const double HPCTRACE_FMT_Version_103 = 1.03;
+
 
 typedef struct hpctrace_hdr_flags_bitfield {
   bool isDataCentric : 1;
-  uint64_t unused    : 63;
+  bool isCompact     : 1; // records are in compact blocks (version 1.03)
+  uint64_t unused    : 62;
 } hpctrace_hdr_flags_bitfield;
 
 
@@ -602,17 +610,49 @@ typedef union hpctrace_hdr_flags_t {
 extern const hpctrace_hdr_flags_t hpctrace_hdr_flags_NULL;
 
 
+// Clock used to timestamp trace records.  Records written with
+// HPCTRACE_CLOCK_WALL_US (the only clock before version 1.02) hold
+// gettimeofday() microseconds.  All other clocks record nanoseconds in
+// the clock's own domain; the calibration pair (clockBase, wallBase)
+// taken at trace open maps them back to wall time.
+typedef enum hpctrace_clock_source_t {
+  HPCTRACE_CLOCK_WALL_US       = 0,
+  HPCTRACE_CLOCK_MONOTONIC_RAW = 1, // clock_gettime(CLOCK_MONOTONIC_RAW)
+  HPCTRACE_CLOCK_TSC           = 2, // calibrated rdtsc/rdtscp
+  HPCTRACE_CLOCK_PERF          = 3, // PERF_SAMPLE_TIME (CLOCK_MONOTONIC_RAW)
+} hpctrace_clock_source_t;
+
+
+typedef struct hpctrace_hdr_clock_t {
+  uint64_t source;    // hpctrace_clock_source_t
+  uint64_t clockBase; // trace clock reading (ns) at calibration
+  uint64_t wallBase;  // wall time (ns since the epoch) at calibration
+} hpctrace_hdr_clock_t;
+
+extern const hpctrace_hdr_clock_t hpctrace_hdr_clock_NULL;
+
+
 #define HPCTRACE_FMT_MagicLenX   (sizeof(HPCTRACE_FMT_Magic) - 1)
 #define HPCTRACE_FMT_VersionLenX (sizeof(HPCTRACE_FMT_Version) - 1)
 #define HPCTRACE_FMT_EndianLenX  (sizeof(HPCTRACE_FMT_Endian) - 1)
 #define HPCTRACE_FMT_FlagsLenX   (sizeof(hpctrace_hdr_flags_t))
+#define HPCTRACE_FMT_ClockLenX   (sizeof(hpctrace_hdr_clock_t))
 
 static const int HPCTRACE_FMT_MagicLen   = HPCTRACE_FMT_MagicLenX;
 static const int HPCTRACE_FMT_VersionLen = HPCTRACE_FMT_VersionLenX;
 static const int HPCTRACE_FMT_EndianLen  = HPCTRACE_FMT_EndianLenX;
 static const int HPCTRACE_FMT_FlagsLen   = HPCTRACE_FMT_FlagsLenX;
+static const int HPCTRACE_FMT_ClockLen   = HPCTRACE_FMT_ClockLenX;
 
 static const int HPCTRACE_FMT_HeaderLen =
+  HPCTRACE_FMT_MagicLenX +
+  HPCTRACE_FMT_VersionLenX +
+  HPCTRACE_FMT_EndianLenX +
+  HPCTRACE_FMT_FlagsLenX +
+  HPCTRACE_FMT_ClockLenX;
+
+// offset of the clock calibration within a version 1.02 header
+static const int HPCTRACE_FMT_ClockOffset =
   HPCTRACE_FMT_MagicLenX +
   HPCTRACE_FMT_VersionLenX +
   HPCTRACE_FMT_EndianLenX +
@@ -628,18 +668,27 @@ typedef struct hpctrace_fmt_hdr_t {
 
   hpctrace_hdr_flags_t flags;
 
+  hpctrace_hdr_clock_t clock;
+
 } hpctrace_fmt_hdr_t;
 
 
+// length of the header of a trace file with the given version
+int
+hpctrace_fmt_hdr_len(double version);
+
 int
 hpctrace_fmt_hdr_fread(hpctrace_fmt_hdr_t* hdr, FILE* infs);
 
 int
-hpctrace_fmt_hdr_outbuf(hpctrace_hdr_flags_t flags, hpcio_outbuf_t* outbuf);
+hpctrace_fmt_hdr_outbuf(hpctrace_hdr_flags_t flags,
+			const hpctrace_hdr_clock_t* clock,
+			hpcio_outbuf_t* outbuf);
 
 // N.B.: not async safe
 int
-hpctrace_fmt_hdr_fwrite(hpctrace_hdr_flags_t flags, FILE* fs);
+hpctrace_fmt_hdr_fwrite(hpctrace_hdr_flags_t flags,
+			const hpctrace_hdr_clock_t* clock, FILE* fs);
 
 int
 hpctrace_fmt_hdr_fprint(hpctrace_fmt_hdr_t* hdr, FILE* fs);
@@ -652,15 +701,111 @@ hpctrace_fmt_hdr_fprint(hpctrace_fmt_hdr_t* hdr, FILE* fs);
 #define HPCRUN_FMT_MetricId_NULL (INT_MAX) // for Java, no UINT32_MAX
 
 typedef struct hpctrace_fmt_datum_t {
-  uint64_t time; // microseconds
+  uint64_t time; // trace clock units; cf. hpctrace_hdr_clock_t
   uint32_t cpId; // call path id (CCT leaf id); cf. HPCRUN_FMT_CCTNodeId_NULL
   uint32_t metricId;
 } hpctrace_fmt_datum_t;
 
 
+//***************************************************************************
+// [hpctrace] compact trace records (version 1.03)
+//***************************************************************************
+
+// With the isCompact flag, the records after the header are grouped
+// into blocks.  A block starts with a 16 byte header
+//
+//   uint32 len       bytes of encoded records that follow
+//   uint32 nrecords  records in the block (0 for the block index)
+//   uint64 time      time of the first record
+//
+// followed by each record as zig-zag varint differences from the
+// previous record's time and cpId (the block's time and 0 for the
+// first record), plus a varint metricId in data-centric traces.  Every
+// block decodes on its own, and all but the last one hold exactly
+// HPCTRACE_FMT_BlockRecords records, so record i is in block
+// i / HPCTRACE_FMT_BlockRecords.
+//
+// Writers that can afford to remember every block (hpcprof, but not
+// hpcrun) end the file with a block index: a block with nrecords = 0
+// holding an hpctrace_fmt_index_entry_t for each block, followed by a
+// trailer of uint64 nblocks, uint64 nrecords and HPCTRACE_FMT_IndexTag.
+// Files without an index are read by walking the block headers.
+
+#define HPCTRACE_FMT_BlockRecords  1024
+#define HPCTRACE_FMT_BlockHdrLen   16
+
+// worst case: 10 byte time, 5 byte cpId and 5 byte metricId varints
+#define HPCTRACE_FMT_RecordMaxLen  20
+#define HPCTRACE_FMT_BlockMaxLen \
+  (HPCTRACE_FMT_BlockHdrLen \
+   + HPCTRACE_FMT_BlockRecords * HPCTRACE_FMT_RecordMaxLen)
+
+#define HPCTRACE_FMT_IndexEntryLen 16
+#define HPCTRACE_FMT_TrailerLen    24
+
+static const char HPCTRACE_FMT_IndexTag[] = "HPCTRIDX"; // 8 bytes
+
+
+typedef struct hpctrace_fmt_index_entry_t {
+  uint64_t offset; // of the block, from the end of the file header
+  uint64_t time;   // of the block's first record
+} hpctrace_fmt_index_entry_t;
+
+
+// Encoder or decoder state for one trace file.
+typedef struct hpctrace_fmt_block_t {
+  uint32_t nrecords;  // writing: records in buf; reading: records left
+  uint32_t len;       // writing: bytes of records in buf
+  uint64_t firstTime; // of the block's first record
+  uint64_t time;      // of the previous record
+  uint32_t cpId;      // of the previous record
+  unsigned char* buf; // writing: HPCTRACE_FMT_BlockMaxLen bytes
+} hpctrace_fmt_block_t;
+
+
+// buf may be NULL for reading.
+void
+hpctrace_fmt_block_init(hpctrace_fmt_block_t* blk, unsigned char* buf);
+
+// Encode x into the block.  Returns: true if the block is now full
+// and should be written out.
+bool
+hpctrace_fmt_block_append(hpctrace_fmt_block_t* blk, hpctrace_fmt_datum_t* x,
+			  hpctrace_hdr_flags_t flags);
+
+// Write the block, if it is not empty, with a single write to the
+// outbuf (so that a dropped write loses whole blocks), and empty it.
+int
+hpctrace_fmt_block_outbuf(hpctrace_fmt_block_t* blk, hpcio_outbuf_t* outbuf);
+
+// N.B.: not async safe
+int
+hpctrace_fmt_block_fwrite(hpctrace_fmt_block_t* blk, FILE* fs);
+
+// N.B.: not async safe
+int
+hpctrace_fmt_index_fwrite(const hpctrace_fmt_index_entry_t* index,
+			  uint64_t nblocks, uint64_t nrecords, FILE* fs);
+
+// Decode the block starting at p, of which avail bytes are present,
+// into x[0 .. HPCTRACE_FMT_BlockRecords).  Sets *blockLen to the
+// length of the whole block.
+//
+// Returns: the number of records (0 for the block index), or -1 if
+// the block is truncated or corrupt.
+int
+hpctrace_fmt_block_decode(const unsigned char* p, size_t avail,
+			  hpctrace_hdr_flags_t flags, hpctrace_fmt_datum_t* x,
+			  size_t* blockLen);
+
+
+//***************************************************************************
+
+// Read the next record.  blk holds the decoder state of compact files
+// (see hpctrace_fmt_block_init) and may be NULL for other files.
 int
 hpctrace_fmt_datum_fread(hpctrace_fmt_datum_t* x, hpctrace_hdr_flags_t flags,
-			 FILE* fs);
+			 hpctrace_fmt_block_t* blk, FILE* fs);
 
 int
 hpctrace_fmt_datum_outbuf(hpctrace_fmt_datum_t* x, hpctrace_hdr_flags_t flags,
@@ -676,6 +821,29 @@ hpctrace_fmt_datum_fprint(hpctrace_fmt_datum_t* x, hpctrace_hdr_flags_t flags,
 			  FILE* fs);
 
 
+// Convert a trace record timestamp to wall time.
+static inline uint64_t
+hpctrace_fmt_time_to_wall_ns(const hpctrace_hdr_clock_t* clock, uint64_t time)
+{
+  if (clock->source == HPCTRACE_CLOCK_WALL_US) {
+    return time * 1000;
+  }
+  // unsigned wrap-around yields the right answer for records taken
+  // before the calibration point
+  return time - clock->clockBase + clock->wallBase;
+}
+
+
+static inline uint64_t
+hpctrace_fmt_time_to_wall_us(const hpctrace_hdr_clock_t* clock, uint64_t time)
+{
+  if (clock->source == HPCTRACE_CLOCK_WALL_US) {
+    return time;
+  }
+  return hpctrace_fmt_time_to_wall_ns(clock, time) / 1000;
+}
+
+
 //***************************************************************************
 // hpcprof-metricdb (located here for now)
 //***************************************************************************
@@ -684,10 +852,30 @@ hpctrace_fmt_datum_fprint(hpctrace_fmt_datum_t* x, hpctrace_hdr_flags_t flags,
 // [hpcprof-metricdb] hdr
 //***************************************************************************
 
+// Versions:
+// - version 0.10: dense.  The header is followed by numNodes rows of
+//   numMetrics real8 values; the first row is node 1.
+// - version 0.20: adds a flags word to the header.  Without
+//   HPCMETRICDB_FMT_FLAG_Sparse the data is as in version 0.10.  With
+//   it, the header is followed by a row index of numNodes + 1 int8
+//   entries, where entry i is the number of (metric-id, value) pairs
+//   before those of node i + 1, and then by the pairs themselves
+//   (int4 metric id, real8 value), grouped by node and holding only
+//   non-zero values.
+//
+// Dense databases are still written as version 0.10 so that existing
+// readers keep working; only sparse databases need version 0.20.
+
 static const char HPCMETRICDB_FMT_Magic[]   = "HPCPROF-metricdb__"; // 18 bytes
-static const char HPCMETRICDB_FMT_Version[] = "00.10";              // 5 bytes
+static const char HPCMETRICDB_FMT_Version[] = "00.20";              // 5 bytes
 static const char HPCMETRICDB_FMT_Endian[]  = "b";                  // 1 byte
 
+static const char HPCMETRICDB_FMT_VersionDense[] = "00.10";
+
+// currently supported versions
+static const double HPCMETRICDB_FMT_Version_010 = 0.10;
+static const double HPCMETRICDB_FMT_Version_020 = 0.20;
+
 #define HPCMETRICDB_FMT_MagicLenX   (sizeof(HPCMETRICDB_FMT_Magic) - 1)
 #define HPCMETRICDB_FMT_VersionLenX (sizeof(HPCMETRICDB_FMT_Version) - 1)
 #define HPCMETRICDB_FMT_EndianLenX  (sizeof(HPCMETRICDB_FMT_Endian) - 1)
@@ -700,6 +888,12 @@ static const int HPCMETRICDB_FMT_HeaderLen =
   (HPCMETRICDB_FMT_MagicLenX + HPCMETRICDB_FMT_VersionLenX
    + HPCMETRICDB_FMT_EndianLenX);
 
+// header flags (version 0.20)
+#define HPCMETRICDB_FMT_FLAG_Sparse ((uint64_t)0x1)
+
+// sizes of the sparse row-index entries and (metric-id, value) pairs
+static const int HPCMETRICDB_FMT_SparseIdxLen  = 8;
+static const int HPCMETRICDB_FMT_SparsePairLen = 4 + 8;
 
 
 typedef struct hpcmetricDB_fmt_hdr_t {
@@ -711,18 +905,38 @@ typedef struct hpcmetricDB_fmt_hdr_t {
   uint32_t numNodes;
   uint32_t numMetrics;
 
+  uint64_t flags; // 0 for version 0.10
+
 } hpcmetricDB_fmt_hdr_t;
 
 
 int
 hpcmetricDB_fmt_hdr_fread(hpcmetricDB_fmt_hdr_t* hdr, FILE* infs);
 
+// writes version 0.20 if 'hdr->flags' is non-zero, otherwise 0.10
 int
 hpcmetricDB_fmt_hdr_fwrite(hpcmetricDB_fmt_hdr_t* hdr, FILE* outfs);
 
 int
 hpcmetricDB_fmt_hdr_fprint(hpcmetricDB_fmt_hdr_t* hdr, FILE* outfs);
 
+
+static inline bool
+hpcmetricDB_fmt_isSparse(const hpcmetricDB_fmt_hdr_t* hdr)
+{
+  return (hdr->flags & HPCMETRICDB_FMT_FLAG_Sparse);
+}
+
+
+// Reads the row index of a sparse database into 'rowIdx', which must
+// hold hdr->numNodes + 1 entries.
+int
+hpcmetricDB_fmt_sparse_idx_fread(uint64_t* rowIdx,
+				 const hpcmetricDB_fmt_hdr_t* hdr, FILE* infs);
+
+int
+hpcmetricDB_fmt_sparse_pair_fread(uint32_t* mId, double* mval, FILE* infs);
+
 // --------------------------------------------------------------------------
 // additional sampling info
 // --------------------------------------------------------------------------
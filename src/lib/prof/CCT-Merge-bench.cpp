@@ -0,0 +1,202 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// File:
+//   $HeadURL$
+//
+// Purpose:
+//   Benchmark Prof::CCT::ANode::mergeDeep() on wide trees.
+//
+// Description:
+//   A benchmark (built by 'make check' in <builddir>/src/lib/prof)
+//   that merges synthetic CCTs whose roots have a configurable fan-out,
+//   once with the hash index of x's children and once with the linear
+//   findDynChild() scan (MrgFlg_NoChildIndex), and reports the time of
+//   each.
+//
+//   Usage: CCT-Merge-bench [fan-out ...]
+//
+//   Each tree has 'fan-out' call sites below the root, each with a
+//   few statements; x and y share half of their call sites, so the
+//   merge exercises both the merge and the insert case.  The two
+//   variants must produce trees of the same size.
+//
+//***************************************************************************
+
+//************************* System Include Files ****************************
+
+#include <iostream>
+using std::cout;
+using std::endl;
+
+#include <cstdlib>
+#include <sys/time.h>
+
+//*************************** User Include Files ****************************
+
+#include <include/uint.h>
+
+#include "CCT-Tree.hpp"
+#include "CCT-Merge.hpp"
+
+//*************************** Forward Declarations ***************************
+
+using namespace Prof;
+
+static const uint StmtsPerCall = 4;
+
+//***************************************************************************
+
+static double
+now()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+
+// makeTree: call sites at ips [ipBeg, ipBeg + fanout) in a shuffled
+// order, each with StmtsPerCall statements
+static CCT::ANode*
+makeTree(uint fanout, VMA ipBeg, uint seed)
+{
+  Metric::IData metrics(1);
+  metrics.metric(0) = 1.0;
+
+  std::vector<VMA> ips(fanout);
+  for (uint i = 0; i < fanout; ++i) {
+    ips[i] = ipBeg + i;
+  }
+  srand(seed);
+  for (uint i = fanout - 1; i > 0; --i) {
+    uint j = rand() % (i + 1);
+    std::swap(ips[i], ips[j]);
+  }
+
+  CCT::ANode* root = new CCT::Root("bench");
+  for (uint i = 0; i < fanout; ++i) {
+    CCT::Call* call =
+      new CCT::Call(root, HPCRUN_FMT_CCTNodeId_NULL, lush_assoc_info_NULL,
+		    1, ips[i] * 16, 0, NULL, metrics);
+    for (uint k = 0; k < StmtsPerCall; ++k) {
+      new CCT::Stmt(call, HPCRUN_FMT_CCTNodeId_NULL, lush_assoc_info_NULL,
+		    1, ips[i] * 16 + k + 1, 0, NULL, metrics);
+    }
+  }
+  return root;
+}
+
+
+static uint
+countNodes(CCT::ANode* root)
+{
+  uint n = 0;
+  for (CCT::ANodeIterator it(root); it.Current(); ++it) {
+    n++;
+  }
+  return n;
+}
+
+
+// mergeOnce: returns the seconds spent in mergeDeep
+static double
+mergeOnce(uint fanout, uint mrgFlag, uint& nodes)
+{
+  CCT::ANode* x = makeTree(fanout, 0, 1);
+  CCT::ANode* y = makeTree(fanout, fanout / 2, 2);
+
+  CCT::Tree cct(NULL);
+  cct.root(x);
+  CCT::MergeContext mrgCtxt(&cct, false);
+  mrgCtxt.flags(mrgFlag);
+
+  double t0 = now();
+  CCT::MergeEffectList* effcts = x->mergeDeep(y, 0, mrgCtxt);
+  double t1 = now();
+
+  delete effcts;
+  delete y;
+  nodes = countNodes(x);
+  return t1 - t0;
+}
+
+
+int
+main(int argc, char* argv[])
+{
+  std::vector<uint> fanouts;
+  for (int i = 1; i < argc; ++i) {
+    fanouts.push_back((uint)atoi(argv[i]));
+  }
+  if (fanouts.empty()) {
+    for (uint f = 1000; f <= 16000; f *= 2) {
+      fanouts.push_back(f);
+    }
+  }
+
+  cout << "fan-out\tscan (s)\tindex (s)\tspeedup" << endl;
+  for (uint i = 0; i < fanouts.size(); ++i) {
+    uint f = fanouts[i];
+    if (f < 2) {
+      continue;
+    }
+    uint n_scan = 0, n_index = 0;
+    double t_scan = mergeOnce(f, CCT::MrgFlg_NoChildIndex, n_scan);
+    double t_index = mergeOnce(f, 0, n_index);
+    if (n_scan != n_index) {
+      std::cerr << "error: merged trees differ: " << n_scan << " vs. "
+		<< n_index << " nodes" << endl;
+      return 1;
+    }
+    cout << f << "\t" << t_scan << "\t" << t_index << "\t"
+	 << (t_index > 0 ? t_scan / t_index : 0) << endl;
+  }
+
+  return 0;
+}
@@ -91,7 +91,8 @@ namespace CCT {
 //***************************************************************************
 
 MergeContext::MergeContext(Tree* cct, bool doTrackCPIds)
-  : m_cct(cct), m_mrgFlag(0), m_isTrackingCPIds(doTrackCPIds)
+  : m_cct(cct), m_mrgFlag(0), m_recorder(NULL),
+    m_isTrackingCPIds(doTrackCPIds)
 {
   if (isTrackingCPIds()) {
     fillCPIdSet(cct);
@@ -113,6 +114,94 @@ MergeContext::fillCPIdSet(Tree* cct)
 }
 
 
+//***************************************************************************
+// MergeRecord
+//***************************************************************************
+
+void
+MergeRecord::note(const ADynNode& x, const ADynNode& y)
+{
+  for (uint i = 0; i < y.numMetrics(); ++i) {
+    if (y.hasMetric(i)) {
+      Metric m = { i, y.metric(i) };
+      m_metrics.push_back(m);
+    }
+  }
+
+  Entry e = { x.id(), y.cpId(), (uint)m_metrics.size() };
+  m_entries.push_back(e);
+}
+
+
+void
+MergeRecord::noteInsert(const ANode& y)
+{
+  for (ANodeIterator it(&y); it.Current(); ++it) {
+    ADynNode* n_dyn = dynamic_cast<ADynNode*>(it.current());
+    if (n_dyn) {
+      note(*n_dyn, *n_dyn);
+    }
+  }
+}
+
+
+void
+MergeRecord::remapX(const NodeIdMap& xIdMap)
+{
+  for (uint i = 0; i < m_entries.size(); ++i) {
+    NodeIdMap::const_iterator it = xIdMap.find(m_entries[i].x_id);
+    m_entries[i].x_id = (it != xIdMap.end()) ? it->second : XId_NULL;
+  }
+}
+
+
+void
+MergeRecord::clear()
+{
+  m_metricBegIdx = 0;
+  m_numMetrics = 0;
+  m_traceFileName.clear();
+  std::vector<Entry>().swap(m_entries);
+  std::vector<Metric>().swap(m_metrics);
+}
+
+
+int
+MergeRecord::fwrite(FILE* fs) const
+{
+  uint64_t hdr[5] = { m_metricBegIdx, m_numMetrics, m_traceFileName.size(),
+		      m_entries.size(), m_metrics.size() };
+
+  bool ok = (std::fwrite(hdr, sizeof(hdr), 1, fs) == 1
+	     && std::fwrite(m_traceFileName.data(), 1, hdr[2], fs) == hdr[2]
+	     && std::fwrite(m_entries.data(), sizeof(Entry), hdr[3], fs) == hdr[3]
+	     && std::fwrite(m_metrics.data(), sizeof(Metric), hdr[4], fs) == hdr[4]);
+  return (ok) ? 0 : -1;
+}
+
+
+int
+MergeRecord::fread(FILE* fs)
+{
+  uint64_t hdr[5];
+  if (std::fread(hdr, sizeof(hdr), 1, fs) != 1) {
+    return -1;
+  }
+
+  m_metricBegIdx = (uint)hdr[0];
+  m_numMetrics = (uint)hdr[1];
+  m_traceFileName.resize(hdr[2]);
+  m_entries.resize(hdr[3]);
+  m_metrics.resize(hdr[4]);
+
+  bool ok = ((hdr[2] == 0
+	      || std::fread(&m_traceFileName[0], 1, hdr[2], fs) == hdr[2])
+	     && std::fread(m_entries.data(), sizeof(Entry), hdr[3], fs) == hdr[3]
+	     && std::fread(m_metrics.data(), sizeof(Metric), hdr[4], fs) == hdr[4]);
+  return (ok) ? 0 : -1;
+}
+
+
 //***************************************************************************
 // MergeEffect
 //***************************************************************************
@@ -63,11 +63,14 @@
 //************************* System Include Files ****************************
 
 #include <iostream>
+#include <cstdio>
+#include <climits>
 
 #include <string>
 #include <vector>
 #include <list>
 #include <set>
+#include <unordered_map>
 
 //*************************** User Include Files ****************************
 
@@ -80,6 +83,19 @@
 
 //*************************** Forward Declarations ***************************
 
+namespace Prof {
+
+namespace CCT {
+
+class ANode;
+class ADynNode;
+
+// maps the node ids of one CCT to those of another
+typedef std::unordered_map<uint, uint> NodeIdMap;
+
+} // namespace CCT
+
+} // namespace Prof
 
 //***************************************************************************
 // MergeEffect, MergeEffectList
@@ -131,6 +147,141 @@ typedef std::list<MergeEffect> MergeEffectList;
 } // namespace Prof
 
 
+//***************************************************************************
+// MergeRecord
+//***************************************************************************
+
+namespace Prof {
+
+namespace CCT {
+
+// MergeRecord: While merging a tree y into a tree x, notes each merge
+// of a node y_n into a node x_n (case 2 of ANode::mergeDeep()) by
+// x_n's id, y_n's cp-id and y_n's non-zero metric values, in merge
+// order.  A node y_n that is inserted into x (case 1) keeps its id
+// and is noted as merged into itself.  This is all a later merge of y
+// into x needs, so Tree::replay() can repeat it without reading or
+// matching y again.  If x's nodes are later matched with those of
+// another tree z (cf. Tree::match()), remapX() turns the record into
+// one for merging y into z.
+class MergeRecord {
+public:
+  struct Entry {
+    uint x_id;
+    uint y_cpId;
+    uint metricEnd; // metrics [previous entry's metricEnd, metricEnd)
+  };
+
+  struct Metric {
+    uint mId; // within y
+    double value;
+  };
+
+public:
+  MergeRecord()
+    : m_metricBegIdx(0), m_numMetrics(0)
+  { }
+
+  void
+  note(const ADynNode& x, const ADynNode& y);
+
+  // noteInsert: note each ADynNode of subtree 'y', which is about to
+  // be inserted into x, as merged into itself
+  void
+  noteInsert(const ANode& y);
+
+  // remapX: replace each x id with its image under 'xIdMap'; entries
+  // without one are left out of replay() (cf. XId_NULL)
+  void
+  remapX(const NodeIdMap& xIdMap);
+
+  void
+  clear();
+
+  static const uint XId_NULL = UINT_MAX;
+
+  // -------------------------------------------------------
+  // y's metrics map to [metricBegIdx(), metricBegIdx() + numMetrics())
+  // in x; y's trace file, if any, is normalized by Profile::replay()
+  // -------------------------------------------------------
+  uint
+  metricBegIdx() const
+  { return m_metricBegIdx; }
+
+  void
+  metricBegIdx(uint x)
+  { m_metricBegIdx = x; }
+
+  uint
+  numMetrics() const
+  { return m_numMetrics; }
+
+  void
+  numMetrics(uint x)
+  { m_numMetrics = x; }
+
+  const std::string&
+  traceFileName() const
+  { return m_traceFileName; }
+
+  void
+  traceFileName(const std::string& x)
+  { m_traceFileName = x; }
+
+  const std::vector<Entry>&
+  entries() const
+  { return m_entries; }
+
+  const std::vector<Metric>&
+  metrics() const
+  { return m_metrics; }
+
+  // approximate size in memory
+  size_t
+  memSize() const
+  {
+    return (sizeof(*this) + m_traceFileName.size()
+	    + m_entries.size() * sizeof(Entry)
+	    + m_metrics.size() * sizeof(Metric));
+  }
+
+  // -------------------------------------------------------
+  // fwrite/fread: spill to and restore from a scratch file within
+  // the same process (the format is not portable); return 0 on
+  // success, else -1.  fread() replaces the current contents.
+  // -------------------------------------------------------
+  int
+  fwrite(FILE* fs) const;
+
+  int
+  fread(FILE* fs);
+
+private:
+  uint m_metricBegIdx;
+  uint m_numMetrics;
+  std::string m_traceFileName;
+
+  std::vector<Entry> m_entries;
+  std::vector<Metric> m_metrics;
+};
+
+
+// MergeRecordSink: receives merge records as they are completed
+class MergeRecordSink {
+public:
+  virtual ~MergeRecordSink()
+  { }
+
+  // put: take ownership of record 'i'
+  virtual void
+  put(uint i, MergeRecord* rec) = 0;
+};
+
+} // namespace CCT
+
+} // namespace Prof
+
+
 //***************************************************************************
 // MergeContext
 //***************************************************************************
@@ -158,7 +309,11 @@ enum {
   // -------------------------------------------------------
   // *Private* CCT Merge flags
   // -------------------------------------------------------
-  MrgFlg_PropagateEffects    = (1 << 3)
+  MrgFlg_PropagateEffects    = (1 << 3),
+
+  // Match children with a linear scan instead of a hash index (for
+  // debugging and benchmarking mergeDeep).
+  MrgFlg_NoChildIndex        = (1 << 4)
 };
 
 
@@ -185,6 +340,16 @@ public:
   { return (m_mrgFlag & MrgFlg_PropagateEffects); }
 
 
+  // if non-NULL, ANode::mergeDeep() notes each node merge here
+  MergeRecord*
+  recorder() const
+  { return m_recorder; }
+
+  void
+  recorder(MergeRecord* x)
+  { m_recorder = x; }
+
+
   // -------------------------------------------------------
   //
   // -------------------------------------------------------
@@ -262,6 +427,7 @@ private:
   const Tree* m_cct;
 
   uint m_mrgFlag;
+  MergeRecord* m_recorder;
 
   bool m_isTrackingCPIds;
   CPIdSet m_cpIdSet;
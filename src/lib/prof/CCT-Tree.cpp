@@ -74,6 +74,8 @@ using std::vector;
 #include <set>
 using std::set;
 
+#include <unordered_map>
+
 #include <typeinfo>
 
 //*************************** User Include Files ****************************
@@ -161,7 +163,8 @@ Tree::~Tree()
 
 
 MergeEffectList*
-Tree::merge(const Tree* y, uint x_newMetricBegIdx, uint mrgFlag, uint oFlag)
+Tree::merge(const Tree* y, uint x_newMetricBegIdx, uint mrgFlag, uint oFlag,
+	    MergeRecord* mrgRecord)
 {
   Tree* x = this;
   ANode* x_root = root();
@@ -203,10 +206,13 @@ Tree::merge(const Tree* y, uint x_newMetricBegIdx, uint mrgFlag, uint oFlag)
     m_mergeCtxt = new MergeContext(x, doTrackCPIds);
   }
   m_mergeCtxt->flags(mrgFlag);
+  m_mergeCtxt->recorder(mrgRecord);
   
   MergeEffectList* mrgEffects =
     x_root->mergeDeep(y_root, x_newMetricBegIdx, *m_mergeCtxt, oFlag);
 
+  m_mergeCtxt->recorder(NULL);
+
   DIAG_If(0 /*public diag level*/) {
     verifyUniqueCPIds();
   }
@@ -215,6 +221,56 @@ Tree::merge(const Tree* y, uint x_newMetricBegIdx, uint mrgFlag, uint oFlag)
 }
 
 
+MergeEffectList*
+Tree::replay(const MergeRecord& mrgRecord, const std::vector<ANode*>& nodes,
+	     uint mrgFlag)
+{
+  if (!m_mergeCtxt) {
+    bool doTrackCPIds = !metadata()->traceFileNameSet().empty();
+    m_mergeCtxt = new MergeContext(this, doTrackCPIds);
+  }
+  m_mergeCtxt->flags(mrgFlag);
+
+  MergeEffectList* effctLst = new MergeEffectList;
+
+  const std::vector<MergeRecord::Entry>& entries = mrgRecord.entries();
+  const std::vector<MergeRecord::Metric>& metrics = mrgRecord.metrics();
+  uint x_newMetricBegIdx = mrgRecord.metricBegIdx();
+  uint x_end = x_newMetricBegIdx + mrgRecord.numMetrics();
+
+  // cf. ANode::mergeDeep(), case 2, and ADynNode::mergeMe()
+  uint mBeg = 0;
+  for (uint i = 0; i < entries.size(); ++i) {
+    const MergeRecord::Entry& e = entries[i];
+    uint mEnd = e.metricEnd;
+
+    ANode* x = (e.x_id < nodes.size()) ? nodes[e.x_id] : NULL;
+    ADynNode* x_dyn = dynamic_cast<ADynNode*>(x);
+    if (x_dyn) {
+      x_dyn->ensureMetricsSize(x_end);
+      for (uint j = mBeg; j < mEnd; ++j) {
+	x_dyn->metric(x_newMetricBegIdx + metrics[j].mId) += metrics[j].value;
+      }
+
+      MergeEffect effct = x_dyn->mergeMeCPId(e.y_cpId, m_mergeCtxt);
+      if (m_mergeCtxt->doPropagateEffects() && !effct.isNoop()) {
+	effctLst->push_back(effct);
+      }
+    }
+    mBeg = mEnd;
+  }
+
+  return effctLst;
+}
+
+
+void
+Tree::match(const Tree* y, NodeIdMap& yIdToXId)
+{
+  m_root->matchDeep(y->root(), yIdToXId);
+}
+
+
 void
 Tree::pruneCCTByNodeId(const uint8_t* prunedNodes)
 {
@@ -810,6 +866,86 @@ ANode::deleteChaff(ANode* x, uint8_t* deletedNodes)
 // Merging
 //**********************************************************************
 
+// DynChildIndex: Let x be a node that is the target of mergeDeep().
+//   Indexes the direct ADynNode descendents of x (those findDynChild()
+//   would visit) by the fields that the standard condition of
+//   ADynNode::isMergable() compares for equality, so that matching
+//   each child of y costs a hash probe rather than a scan of x's
+//   children.  Candidates are kept in findDynChild() order, so both
+//   return the same node.
+//
+// The structure-based merge condition can match leaves whose IPs
+// differ; lookups that could rely on it fall back to findDynChild().
+class DynChildIndex {
+public:
+  DynChildIndex(ANode* x)
+    : m_x(x)
+  { collect(x); }
+
+  ADynNode*
+  find(const ADynNode& y_dyn) const
+  {
+    if (y_dyn.isLeaf() && y_dyn.structure()) {
+      return m_x->findDynChild(y_dyn);
+    }
+
+    Map::const_iterator it = m_map.find(key(y_dyn));
+    if (it != m_map.end()) {
+      const vector<ADynNode*>& cands = it->second;
+      for (uint i = 0; i < cands.size(); ++i) {
+	if (ADynNode::isMergable(*cands[i], y_dyn)) {
+	  return cands[i];
+	}
+      }
+    }
+    return NULL;
+  }
+
+  // insert: note that x_dyn has just been linked as the last child of x
+  void
+  insert(ADynNode* x_dyn)
+  { m_map[key(*x_dyn)].push_back(x_dyn); }
+
+  // the number of y children worth building an index for
+  static const uint MinLookups = 8;
+
+private:
+  typedef std::unordered_map<size_t, vector<ADynNode*> > Map;
+
+  static size_t
+  key(const ADynNode& n)
+  {
+    uint64_t h = (uint64_t)n.lmIP_real();
+    h = h * 0x9e3779b97f4a7c15ull + (uint64_t)n.lmId_real();
+    h = h * 0x9e3779b97f4a7c15ull + (uint64_t)n.isLeaf();
+    const lush_lip_t* lip = n.lip();
+    if (lip) {
+      h = h * 0x9e3779b97f4a7c15ull + lip->data8[0];
+      h = h * 0x9e3779b97f4a7c15ull + lip->data8[1];
+    }
+    return (size_t)(h ^ (h >> 29));
+  }
+
+  void
+  collect(ANode* x)
+  {
+    for (ANodeChildIterator it(x); it.Current(); ++it) {
+      ANode* x_child = it.current();
+      ADynNode* x_dyn = dynamic_cast<ADynNode*>(x_child);
+      if (x_dyn) {
+	insert(x_dyn);
+      }
+      else {
+	collect(x_child);
+      }
+    }
+  }
+
+  ANode* m_x;
+  Map m_map;
+};
+
+
 MergeEffectList*
 ANode::mergeDeep(ANode* y, uint x_newMetricBegIdx, MergeContext& mrgCtxt,
 		 uint oFlag)
@@ -832,6 +968,12 @@ ANode::mergeDeep(ANode* y, uint x_newMetricBegIdx, MergeContext& mrgCtxt,
   //    recur.
   // ------------------------------------------------------------
   MergeEffectList* effctLst = new MergeEffectList;
+
+  // index x's children on the first lookup when y has enough children
+  // to amortize it
+  bool useIndex = (y->childCount() >= DynChildIndex::MinLookups
+		   && !(mrgCtxt.flags() & MrgFlg_NoChildIndex));
+  DynChildIndex* x_index = NULL;
   
   for (ANodeChildIterator it(y); it.Current(); /* */) {
     ANode* y_child = it.current();
@@ -841,7 +983,16 @@ ANode::mergeDeep(ANode* y, uint x_newMetricBegIdx, MergeContext& mrgCtxt,
 
     MergeEffectList* effctLst1 = NULL;
 
-    ADynNode* x_child_dyn = x->findDynChild(*y_child_dyn);
+    ADynNode* x_child_dyn = NULL;
+    if (useIndex) {
+      if (!x_index) {
+	x_index = new DynChildIndex(x);
+      }
+      x_child_dyn = x_index->find(*y_child_dyn);
+    }
+    else {
+      x_child_dyn = x->findDynChild(*y_child_dyn);
+    }
 
 #define MERGE_ACTION 0
 #define MERGE_ERROR 0
@@ -858,11 +1009,17 @@ ANode::mergeDeep(ANode* y, uint x_newMetricBegIdx, MergeContext& mrgCtxt,
 	DIAG_MsgIf(MERGE_ACTION /*(oFlag & Tree::OFlg_Debug)*/,
 		   "CCT::ANode::mergeDeep: Adding:\n     "
 		   << y_child->toStringMe(Tree::OFlg_Debug));
+	if (mrgCtxt.recorder()) {
+	  mrgCtxt.recorder()->noteInsert(*y_child);
+	}
 	y_child->unlink();
   
 	effctLst1 = y_child->mergeDeep_fixInsert(x_newMetricBegIdx, mrgCtxt);
 
 	y_child->link(x);
+	if (x_index) {
+	  x_index->insert(y_child_dyn);
+	}
       }
     }
     else {
@@ -871,6 +1028,9 @@ ANode::mergeDeep(ANode* y, uint x_newMetricBegIdx, MergeContext& mrgCtxt,
 		 "CCT::ANode::mergeDeep: Merging x <= y:\n"
 		 << "  x: " << x_child_dyn->toStringMe(Tree::OFlg_Debug)
 		 << "\n  y: " << y_child_dyn->toStringMe(Tree::OFlg_Debug));
+      if (mrgCtxt.recorder()) {
+	mrgCtxt.recorder()->note(*x_child_dyn, *y_child_dyn);
+      }
       MergeEffect effct =
 	x_child_dyn->mergeMe(*y_child_dyn, &mrgCtxt, x_newMetricBegIdx);
       if (mrgCtxt.doPropagateEffects() && !effct.isNoop()) {
@@ -888,10 +1048,39 @@ ANode::mergeDeep(ANode* y, uint x_newMetricBegIdx, MergeContext& mrgCtxt,
     delete effctLst1;
   }
 
+  delete x_index;
   return effctLst;
 }
 
 
+void
+ANode::matchDeep(ANode* y, NodeIdMap& yIdToXId)
+{
+  ANode* x = this;
+
+  // cf. mergeDeep(), case 2
+  DynChildIndex* x_index = NULL;
+  if (y->childCount() >= DynChildIndex::MinLookups) {
+    x_index = new DynChildIndex(x);
+  }
+
+  for (ANodeChildIterator it(y); it.Current(); ++it) {
+    ANode* y_child = it.current();
+    ADynNode* y_child_dyn = dynamic_cast<ADynNode*>(y_child);
+    DIAG_Assert(y_child_dyn, "ANode::matchDeep");
+
+    ADynNode* x_child_dyn = ((x_index) ? x_index->find(*y_child_dyn)
+			     : x->findDynChild(*y_child_dyn));
+    if (x_child_dyn) {
+      yIdToXId[y_child->id()] = x_child_dyn->id();
+      x_child_dyn->matchDeep(y_child, yIdToXId);
+    }
+  }
+
+  delete x_index;
+}
+
+
 MergeEffect
 ANode::merge(ANode* y)
 {
@@ -939,21 +1128,29 @@ MergeEffect
 ADynNode::mergeMe(const ANode& y, MergeContext* mrgCtxt, uint metricBegIdx, bool mayConflict)
 {
   // N.B.: Assumes ADynNode::isMergable() holds
-  ADynNode* x = this;
-
   const ADynNode* y_dyn = dynamic_cast<const ADynNode*>(&y);
   DIAG_Assert(y_dyn, "ADynNode::mergeMe: " << DIAG_UnexpectedInput);
 
-  MergeEffect effct = ANode::mergeMe(y, mrgCtxt, metricBegIdx);
+  ANode::mergeMe(y, mrgCtxt, metricBegIdx);
+
+  return mergeMeCPId(y_dyn->cpId(), mrgCtxt, mayConflict);
+}
+
+
+MergeEffect
+ADynNode::mergeMeCPId(uint y_cpId, MergeContext* mrgCtxt, bool mayConflict)
+{
+  MergeEffect effct;
 
   // merge cp-ids
-  if (hasMergeEffects(*x, *y_dyn)) {
-    // 1. Conflicting ids:
-    //    => keep x's cpId; within y, translate [y_dyn->m_cpId ==> m_cpId]
-    effct.old_cpId = y_dyn->m_cpId;
+  if (m_cpId != y_cpId && m_cpId != HPCRUN_FMT_CCTNodeId_NULL
+      && y_cpId != HPCRUN_FMT_CCTNodeId_NULL) {
+    // 1. Conflicting ids (cf. hasMergeEffects()):
+    //    => keep x's cpId; within y, translate [y_cpId ==> m_cpId]
+    effct.old_cpId = y_cpId;
     effct.new_cpId = m_cpId;
   }
-  else if (y_dyn->cpId() == HPCRUN_FMT_CCTNodeId_NULL) {
+  else if (y_cpId == HPCRUN_FMT_CCTNodeId_NULL) {
     // 2. Trivial conflict: y's cpId is NULL; x's may or may not be NULL:
     //    => keep x's cpId.
   }
@@ -966,14 +1163,14 @@ ADynNode::mergeMe(const ANode& y, MergeContext* mrgCtxt, uint metricBegIdx, bool
     if (mayConflict) {
       // mayConflict is true, so we need to ensure uniqueness of cp-ids
       DIAG_Assert(mrgCtxt, "ADynNode::mergeMe: potentially introducing cp-id conflicts; cannot verify without MergeContext!");
-      MergeContext::pair ret = mrgCtxt->ensureUniqueCPId(y_dyn->cpId());
+      MergeContext::pair ret = mrgCtxt->ensureUniqueCPId(y_cpId);
       m_cpId = ret.cpId;
       DIAG_Assert(effct.isNoop(), DIAG_UnexpectedInput);
       effct = ret.effect;
     }
     else {
-      // Since mayConflict is false, we can set m_cpId to y_dyn->cpId()
-      m_cpId = y_dyn->cpId();
+      // Since mayConflict is false, we can set m_cpId to y_cpId
+      m_cpId = y_cpId;
     }
   }
   
@@ -176,7 +176,21 @@ public:
   // -------------------------------------------------------
   MergeEffectList*
   merge(const Tree* y, uint x_newMetricBegIdx,
-	uint mrgFlag = 0, uint oFlag = 0);
+	uint mrgFlag = 0, uint oFlag = 0, MergeRecord* mrgRecord = NULL);
+
+  // replay: Repeat the node merges noted in 'mrgRecord' into 'this'.
+  //   'nodes' maps each noted x id to its node in 'this', or to NULL
+  //   if the node has since been pruned.  Returns the same effects as
+  //   the corresponding merge().
+  MergeEffectList*
+  replay(const MergeRecord& mrgRecord, const std::vector<ANode*>& nodes,
+	 uint mrgFlag = 0);
+
+  // match: For each node of 'y' that merge() would merge into a node
+  //   of 'this' (cf. MrgFlg_AssertCCTMergeOnly), map y's id to that
+  //   node's id in 'yIdToXId'.  Neither tree is modified.
+  void
+  match(const Tree* y, NodeIdMap& yIdToXId);
 
   // -------------------------------------------------------
   // dense ids (only used when explicitly requested)
@@ -320,19 +334,15 @@ public:
   ANode(ANodeTy type, ANode* parent, Struct::ACodeNode* strct = NULL)
     : NonUniformDegreeTreeNode(parent),
       Metric::IData(),
-      m_type(type), m_id(s_nextUniqueId), m_strct(strct)
-  {
-    s_nextUniqueId += 2; // cf. HPCRUN_FMT_RetainIdFlag
-  }
+      m_type(type), m_id(nextUniqueId()), m_strct(strct)
+  { }
 
   ANode(ANodeTy type,
 	ANode* parent, Struct::ACodeNode* strct, const Metric::IData& metrics)
     : NonUniformDegreeTreeNode(parent),
       Metric::IData(metrics),
-      m_type(type), m_id(s_nextUniqueId), m_strct(strct)
-  {
-    s_nextUniqueId += 2; // cf. HPCRUN_FMT_RetainIdFlag
-  }
+      m_type(type), m_id(nextUniqueId()), m_strct(strct)
+  { }
 
   virtual ~ANode()
   { }
@@ -341,10 +351,9 @@ public:
   ANode(const ANode& x)
     : NonUniformDegreeTreeNode(NULL),
       Metric::IData(x),
-      m_type(x.m_type), m_id(s_nextUniqueId), m_strct(x.m_strct)
+      m_type(x.m_type), m_id(nextUniqueId()), m_strct(x.m_strct)
   {
     zeroLinks();
-    s_nextUniqueId += 2; // cf. HPCRUN_FMT_RetainIdFlag
   }
 
   // deep copy of internals (but without children)
@@ -355,8 +364,7 @@ public:
       //NonUniformDegreeTreeNode::operator=(x);
       Metric::IData::operator=(x);
       m_type = x.m_type;
-      m_id = s_nextUniqueId;
-      s_nextUniqueId += 2;
+      m_id = nextUniqueId();
       // m_id: skip
       m_strct = x.m_strct;
     }
@@ -586,6 +594,12 @@ public:
   std::list<MergeEffect>*
   mergeDeep(ANode* y, uint x_numMetrics, MergeContext& mrgCtxt, uint oFlag = 0);
 
+  // matchDeep: Let 'this' = x and y be as for mergeDeep().  Given y,
+  //   recursively map the ids of y's descendents to those of the
+  //   nodes of x that mergeDeep() would merge them into.
+  void
+  matchDeep(ANode* y, NodeIdMap& yIdToXId);
+
   
   // merge: Let 'this' = x and let y be a node corresponding to x.
   //   Merge y into x.
@@ -679,6 +693,14 @@ protected:
 
 
 private:
+  // N.B.: profiles may be read and merged by several threads at once
+  // (cf. Analysis::CallPath::read()), so ids are handed out atomically.
+  static uint
+  nextUniqueId()
+  {
+    return __sync_fetch_and_add(&s_nextUniqueId, 2); // cf. HPCRUN_FMT_RetainIdFlag
+  }
+
   static uint s_nextUniqueId;
   
 protected:
@@ -965,6 +987,10 @@ public:
 
   virtual MergeEffect
   mergeMe(const ANode& y, MergeContext* mrgCtxt = NULL, uint metricBegIdx = 0, bool mayConflict = true);
+
+  // mergeMeCPId: the cp-id part of mergeMe(), given y's cp-id
+  MergeEffect
+  mergeMeCPId(uint y_cpId, MergeContext* mrgCtxt, bool mayConflict = true);
   
 
   // -------------------------------------------------------
@@ -0,0 +1,282 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// File:
+//   $HeadURL$
+//
+// Purpose:
+//   [The purpose of this file]
+//
+// Description:
+//   [The set of functions, macros, etc. defined in the file]
+//
+//***************************************************************************
+
+//************************* System Include Files ****************************
+
+#include <cstring>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+//*************************** User Include Files ****************************
+
+#include "CallPath-CCTReader.hpp"
+
+#include <lib/support/diagnostics.h>
+
+//*************************** Forward Declarations **************************
+
+//***************************************************************************
+
+// N.B.: hpcrun-fmt is big-endian; records are not aligned.
+
+static inline uint16_t
+ld_be2(const char* p)
+{
+  uint16_t x;
+  memcpy(&x, p, sizeof(x));
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  x = __builtin_bswap16(x);
+#endif
+  return x;
+}
+
+
+static inline uint32_t
+ld_be4(const char* p)
+{
+  uint32_t x;
+  memcpy(&x, p, sizeof(x));
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  x = __builtin_bswap32(x);
+#endif
+  return x;
+}
+
+
+static inline uint64_t
+ld_be8(const char* p)
+{
+  uint64_t x;
+  memcpy(&x, p, sizeof(x));
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  x = __builtin_bswap64(x);
+#endif
+  return x;
+}
+
+
+//***************************************************************************
+
+namespace Prof {
+
+namespace CallPath {
+
+CCTNodeReader::CCTNodeReader(FILE* fs, epoch_flags_t flags, uint numMetrics,
+			     uint64_t numNodes)
+  : m_fs(fs), m_flags(flags), m_numMetrics(numMetrics),
+    m_numNodes(numNodes), m_recSz(recordSize(flags, numMetrics)),
+    m_map(NULL), m_mapSz(0), m_beg(NULL), m_endOff(0),
+    m_next(0), m_blkSz(0), m_blkPos(0)
+{
+  if (numNodes == 0) {
+    return;
+  }
+
+  // -------------------------------------------------------
+  // Find the records in the file (cf. hpcio_fopen_r)
+  // -------------------------------------------------------
+  int fd = fileno(fs);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+    return;
+  }
+
+  off_t begOff = ftello(fs); // accounts for the stream's buffer
+  if (begOff < 0 || (uint64_t)(st.st_size - begOff) / m_recSz < numNodes) {
+    return; // let the stdio reader report the short file
+  }
+
+  void* map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (map == MAP_FAILED) {
+    return;
+  }
+  madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+  m_map = map;
+  m_mapSz = st.st_size;
+  m_beg = (const char*)map + begOff;
+  m_endOff = begOff + (off_t)(numNodes * m_recSz);
+
+  uint blkSz = (numNodes < BlockSz) ? (uint)numNodes : BlockSz;
+  m_id.resize(blkSz);
+  m_idParent.resize(blkSz);
+  m_asInfo.resize(blkSz);
+  m_lmId.resize(blkSz);
+  m_lmIP.resize(blkSz);
+  if (m_flags.fields.isLogicalUnwind) {
+    m_lip.resize(blkSz);
+  }
+  m_metrics.resize((size_t)blkSz * m_numMetrics);
+}
+
+
+CCTNodeReader::~CCTNodeReader()
+{
+  if (m_map) {
+    munmap(m_map, m_mapSz);
+
+    // leave 'm_fs' where the stdio reader would have
+    int ret = fseeko(m_fs, m_endOff, SEEK_SET);
+    DIAG_AssertWarn(ret == 0, "CCTNodeReader: fseeko!");
+  }
+}
+
+
+size_t
+CCTNodeReader::recordSize(epoch_flags_t flags, uint numMetrics)
+{
+  // cf. hpcrun_fmt_cct_node_fread()
+  size_t sz = sizeof(uint32_t) + sizeof(uint32_t); // id, id_parent
+  if (flags.fields.isLogicalUnwind) {
+    sz += sizeof(uint32_t);                        // as_info
+  }
+  sz += sizeof(uint16_t) + sizeof(uint64_t);       // lm_id, lm_ip
+  if (flags.fields.isLogicalUnwind) {
+    sz += LUSH_LIP_DATA8_SZ * sizeof(uint64_t);    // lip
+  }
+  sz += numMetrics * sizeof(uint64_t);             // metrics
+  return sz;
+}
+
+
+int
+CCTNodeReader::read(hpcrun_fmt_cct_node_t& x)
+{
+  DIAG_Assert(isMapped(), "CCTNodeReader::read: file is not mapped!");
+
+  if (m_blkPos == m_blkSz) {
+    if (m_next == m_numNodes) {
+      return HPCFMT_EOF;
+    }
+    decodeBlock();
+  }
+
+  uint i = m_blkPos++;
+  x.id = m_id[i];
+  x.id_parent = m_idParent[i];
+  x.as_info.bits = m_asInfo[i];
+  x.lm_id = m_lmId[i];
+  x.lm_ip = m_lmIP[i];
+  if (m_flags.fields.isLogicalUnwind) {
+    x.lip = m_lip[i];
+  }
+  else {
+    lush_lip_init(&x.lip);
+  }
+  x.num_metrics = m_numMetrics;
+  x.metrics = (m_numMetrics > 0) ? &m_metrics[(size_t)i * m_numMetrics] : NULL;
+
+  return HPCFMT_OK;
+}
+
+
+// decodeBlock: Decode the next block of records field by field.  The
+// metric values of a record are contiguous, so they are swapped with
+// one loop over the whole block.
+void
+CCTNodeReader::decodeBlock()
+{
+  uint64_t nLeft = m_numNodes - m_next;
+  uint n = (nLeft < m_id.size()) ? (uint)nLeft : (uint)m_id.size();
+
+  const char* blk = m_beg + m_next * m_recSz;
+  bool isLU = m_flags.fields.isLogicalUnwind;
+
+  const char* p = blk;
+  for (uint i = 0; i < n; ++i, p += m_recSz) {
+    const char* q = p;
+    m_id[i]       = ld_be4(q); q += sizeof(uint32_t);
+    m_idParent[i] = ld_be4(q); q += sizeof(uint32_t);
+    m_asInfo[i]   = (isLU) ? ld_be4(q) : lush_assoc_info_NULL.bits;
+    if (isLU) { q += sizeof(uint32_t); }
+    m_lmId[i]     = ld_be2(q); q += sizeof(uint16_t);
+    m_lmIP[i]     = ld_be8(q); q += sizeof(uint64_t);
+    if (isLU) {
+      for (int k = 0; k < LUSH_LIP_DATA8_SZ; ++k) {
+	m_lip[i].data8[k] = ld_be8(q); q += sizeof(uint64_t);
+      }
+    }
+  }
+
+  if (m_numMetrics > 0) {
+    size_t mOff = m_recSz - m_numMetrics * sizeof(uint64_t);
+    uint64_t* mval = &m_metrics[0].bits;
+    p = blk + mOff;
+    for (uint i = 0; i < n; ++i, p += m_recSz) {
+      uint64_t* v = mval + (size_t)i * m_numMetrics;
+      memcpy(v, p, m_numMetrics * sizeof(uint64_t));
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+      for (uint k = 0; k < m_numMetrics; ++k) {
+	v[k] = __builtin_bswap64(v[k]);
+      }
+#endif
+    }
+  }
+
+  m_next += n;
+  m_blkSz = n;
+  m_blkPos = 0;
+}
+
+} // namespace CallPath
+
+} // namespace Prof
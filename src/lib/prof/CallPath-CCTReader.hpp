@@ -0,0 +1,160 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// File:
+//   $HeadURL$
+//
+// Purpose:
+//   Decode the CCT node records of an hpcrun-fmt profile from a
+//   read-only mapping of the file.
+//
+// Description:
+//   hpcrun_fmt_cct_node_fread() reads each field of a node record with
+//   a byte-at-a-time big-endian stdio read.  All records of an epoch
+//   have the same size, so when the profile is a regular file,
+//   CCTNodeReader maps it and decodes a block of records at a time into
+//   one array per field, which Profile::fmt_cct_fread() then consumes
+//   record by record.  The stream is left positioned after the last
+//   record, exactly as the stdio reader would leave it.
+//
+//***************************************************************************
+
+#ifndef prof_Prof_CallPath_CCTReader_hpp
+#define prof_Prof_CallPath_CCTReader_hpp
+
+//************************* System Include Files ****************************
+
+#include <cstdio>
+#include <vector>
+
+#include <sys/types.h>
+
+//*************************** User Include Files ****************************
+
+#include <include/uint.h>
+
+#include <lib/prof-lean/hpcrun-fmt.h>
+
+#include <lib/support/Unique.hpp>
+
+//*************************** Forward Declarations **************************
+
+//***************************************************************************
+
+namespace Prof {
+
+namespace CallPath {
+
+class CCTNodeReader
+  : public Unique // prevent copying
+{
+public:
+  static const uint BlockSz = 4096; // records decoded at a time
+
+  // Map the file behind 'fs' if possible.  The first of 'numNodes'
+  // records (each with 'numMetrics' metric values) starts at the
+  // current position of 'fs'.
+  CCTNodeReader(FILE* fs, epoch_flags_t flags, uint numMetrics,
+		uint64_t numNodes);
+
+  ~CCTNodeReader();
+
+  // isMapped: false if the records must be read with stdio (e.g., 'fs'
+  //   is a pipe or the file is too short)
+  bool
+  isMapped() const
+  { return (m_beg != NULL); }
+
+  // read: like hpcrun_fmt_cct_node_fread(), fill 'x' with the next
+  //   record.  x.metrics points into the reader and stays valid until
+  //   the next call.  Returns HPCFMT_EOF after the last record.
+  int
+  read(hpcrun_fmt_cct_node_t& x);
+
+  // recordSize: the size of one node record in the file
+  static size_t
+  recordSize(epoch_flags_t flags, uint numMetrics);
+
+private:
+  void
+  decodeBlock();
+
+private:
+  FILE* m_fs;
+  epoch_flags_t m_flags;
+  uint m_numMetrics;
+  uint64_t m_numNodes;
+
+  size_t m_recSz;
+  void* m_map;       // the mapping (page-aligned)
+  size_t m_mapSz;
+  const char* m_beg; // first record; NULL if not mapped
+  off_t m_endOff;    // file offset just past the last record
+
+  uint64_t m_next;   // next record to decode
+  uint m_blkSz;      // records in the current block
+  uint m_blkPos;     // next record in the current block
+
+  // the current block, one array per field
+  std::vector<uint32_t> m_id;
+  std::vector<uint32_t> m_idParent;
+  std::vector<uint32_t> m_asInfo;
+  std::vector<uint16_t> m_lmId;
+  std::vector<uint64_t> m_lmIP;
+  std::vector<lush_lip_t> m_lip;
+  std::vector<hpcrun_metricVal_t> m_metrics; // BlockSz x m_numMetrics
+};
+
+} // namespace CallPath
+
+} // namespace Prof
+
+
+//***************************************************************************
+
+#endif // prof_Prof_CallPath_CCTReader_hpp
@@ -0,0 +1,249 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// File:
+//   $HeadURL$
+//
+// Purpose:
+//   Benchmark reading the CCT of an hpcrun-fmt profile.
+//
+// Description:
+//   A benchmark (built by 'make check' in <builddir>/src/lib/prof)
+//   that writes a synthetic profile and reads it with
+//   Prof::CallPath::Profile::make(), once with the stdio reader
+//   (RFlg_NoMmap) and once with the mapped reader (CCTNodeReader), and
+//   reports the time of each.
+//
+//   Usage: CallPath-Profile-bench [num-nodes [num-metrics [file]]]
+//
+//   The CCT is a tree of call sites with fan-out 8 whose leaves are
+//   statements with metric values; the defaults are 2M nodes and 4
+//   metrics.  Both readers must produce the same tree.
+//
+//***************************************************************************
+
+//************************* System Include Files ****************************
+
+#include <iostream>
+using std::cout;
+using std::endl;
+
+#include <string>
+#include <vector>
+
+#include <cstdio>
+#include <cstdlib>
+#include <sys/time.h>
+#include <unistd.h>
+
+//*************************** User Include Files ****************************
+
+#include <include/uint.h>
+
+#include "CallPath-Profile.hpp"
+#include "CCT-Tree.hpp"
+
+#include <lib/prof-lean/hpcio.h>
+#include <lib/prof-lean/hpcfmt.h>
+#include <lib/prof-lean/hpcrun-fmt.h>
+
+//*************************** Forward Declarations ***************************
+
+using namespace Prof;
+
+static const uint FanOut = 8;
+
+//***************************************************************************
+
+void
+prof_abort(int error_code)
+{
+  exit(error_code);
+}
+
+
+static double
+now()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+
+// writeProfile: write a profile with 'numNodes' CCT nodes in
+// breadth-first order: node k (k > 0) is a child of node (k - 1) / FanOut
+static bool
+writeProfile(const char* fnm, uint numNodes, uint numMetrics)
+{
+  FILE* fs = hpcio_fopen_w(fnm, 1);
+  if (!fs) {
+    return false;
+  }
+
+  hpcrun_fmt_hdr_fwrite(fs, HPCRUN_FMT_NV_prog, "bench", NULL);
+
+  epoch_flags_t flags;
+  flags.bits = 0;
+  hpcrun_fmt_epochHdr_fwrite(fs, flags, 1, "bench-name", "bench-value", NULL);
+
+  hpcfmt_int4_fwrite(numMetrics, fs);
+  std::vector<std::string> names(numMetrics);
+  for (uint i = 0; i < numMetrics; ++i) {
+    names[i] = "EVENT" + std::to_string(i);
+
+    metric_desc_t mdesc = metricDesc_NULL;
+    mdesc.flags = hpcrun_metricFlags_NULL;
+    mdesc.name = const_cast<char*>(names[i].c_str());
+    mdesc.description = const_cast<char*>(names[i].c_str());
+    mdesc.flags.fields.ty = MetricFlags_Ty_Raw;
+    mdesc.flags.fields.valFmt = MetricFlags_ValFmt_Int;
+    mdesc.period = 1;
+
+    metric_aux_info_t aux_info;
+    aux_info.is_multiplexed = 0;
+    aux_info.num_samples = 0;
+    aux_info.threshold_mean = 0;
+    hpcrun_fmt_metricDesc_fwrite(&mdesc, &aux_info, fs);
+  }
+
+  hpcfmt_int4_fwrite(1, fs);
+  loadmap_entry_t lm_entry;
+  lm_entry.id = 1;
+  lm_entry.name = const_cast<char*>("/bench/libbench.so");
+  lm_entry.flags = 0;
+  hpcrun_fmt_loadmapEntry_fwrite(&lm_entry, fs);
+
+  hpcfmt_int8_fwrite(numNodes, fs);
+
+  std::vector<hpcrun_metricVal_t> metrics(numMetrics);
+  hpcrun_fmt_cct_node_t nodeFmt;
+  nodeFmt.as_info = lush_assoc_info_NULL;
+  lush_lip_init(&nodeFmt.lip);
+  nodeFmt.num_metrics = numMetrics;
+  nodeFmt.metrics = (numMetrics > 0) ? &metrics[0] : NULL;
+
+  uint numInterior = (numNodes + FanOut - 2) / FanOut; // nodes with children
+  for (uint k = 0; k < numNodes; ++k) {
+    bool isLeaf = (k >= numInterior);
+    int id = 2 * (k + 1);
+    nodeFmt.id = (isLeaf) ? -id : id;
+    nodeFmt.id_parent = (k == 0) ? HPCRUN_FMT_CCTNodeId_NULL
+                                 : 2 * ((k - 1) / FanOut + 1);
+    nodeFmt.lm_id = (k == 0) ? HPCRUN_FMT_LMId_NULL : 1;
+    nodeFmt.lm_ip = (k == 0) ? 0 : 0x1000 + 16 * (k % 4096);
+    for (uint i = 0; i < numMetrics; ++i) {
+      metrics[i].i = (isLeaf) ? (k % 7) + i : 0;
+    }
+    hpcrun_fmt_cct_node_fwrite(&nodeFmt, flags, fs);
+  }
+
+  hpcio_fclose(fs);
+  return true;
+}
+
+
+// readProfile: returns the seconds spent in Profile::make()
+static double
+readProfile(const char* fnm, uint rFlags, uint& nodes, double& sum)
+{
+  double t0 = now();
+  CallPath::Profile* prof = CallPath::Profile::make(fnm, rFlags, NULL);
+  double t1 = now();
+
+  nodes = 0;
+  sum = 0;
+  uint numMetrics = prof->metricMgr()->size();
+  for (CCT::ANodeIterator it(prof->cct()->root()); it.Current(); ++it) {
+    CCT::ANode* n = it.current();
+    nodes++;
+    for (uint i = 0; i < numMetrics && i < n->numMetrics(); ++i) {
+      sum += n->metric(i);
+    }
+  }
+
+  delete prof;
+  return t1 - t0;
+}
+
+
+int
+main(int argc, char* argv[])
+{
+  uint numNodes = (argc > 1) ? (uint)atoi(argv[1]) : (2u << 20);
+  uint numMetrics = (argc > 2) ? (uint)atoi(argv[2]) : 4;
+  std::string fnm = (argc > 3) ? argv[3]
+    : "/tmp/CallPath-Profile-bench." + std::to_string(getpid()) + ".hpcrun";
+
+  if (numNodes < 1 || !writeProfile(fnm.c_str(), numNodes, numMetrics)) {
+    std::cerr << "error: cannot write '" << fnm << "'" << endl;
+    return 1;
+  }
+
+  uint n_stdio = 0, n_mmap = 0;
+  double sum_stdio = 0, sum_mmap = 0;
+  double t_stdio = readProfile(fnm.c_str(), CallPath::Profile::RFlg_NoMmap,
+			       n_stdio, sum_stdio);
+  double t_mmap = readProfile(fnm.c_str(), 0, n_mmap, sum_mmap);
+
+  if (argc <= 3) {
+    unlink(fnm.c_str());
+  }
+
+  if (n_stdio != n_mmap || sum_stdio != sum_mmap) {
+    std::cerr << "error: profiles differ: " << n_stdio << " vs. " << n_mmap
+	      << " nodes" << endl;
+    return 1;
+  }
+
+  cout << "nodes\tmetrics\tstdio (s)\tmmap (s)\tspeedup" << endl;
+  cout << numNodes << "\t" << numMetrics << "\t" << t_stdio << "\t" << t_mmap
+       << "\t" << (t_mmap > 0 ? t_stdio / t_mmap : 0) << endl;
+
+  return 0;
+}
@@ -71,6 +71,8 @@ using std::dec;
 using std::string;
 
 #include <map>
+#include <unordered_map>
+#include <vector>
 #include <algorithm>
 #include <sstream>
 
@@ -95,6 +97,7 @@ using std::string;
 #include <include/uint.h>
 
 #include "CallPath-Profile.hpp"
+#include "CallPath-CCTReader.hpp"
 #include "FileError.hpp"
 #include "NameMappings.hpp"
 #include "Struct-Tree.hpp"
@@ -171,6 +174,7 @@ Profile::Profile(const std::string name)
 
   m_mMgr = new Metric::Mgr;
   m_isMetricMgrVirtual = false;
+  m_isMetricDBSparse = false;
 
   m_loadmap = new LoadMap;
 
@@ -192,7 +196,8 @@ Profile::~Profile()
 
 
 uint
-Profile::merge(Profile& y, int mergeTy, uint mrgFlag)
+Profile::merge(Profile& y, int mergeTy, uint mrgFlag,
+	       CCT::MergeRecord* mrgRecord)
 {
   Profile& x = (*this);
 
@@ -266,8 +271,15 @@ Profile::merge(Profile& y, int mergeTy, uint mrgFlag)
     mrgFlag |= CCT::MrgFlg_PropagateEffects;
   }
 
+  if (mrgRecord) {
+    mrgRecord->clear();
+    mrgRecord->metricBegIdx(firstMergedMetric);
+    mrgRecord->numMetrics(y.metricMgr()->size());
+    mrgRecord->traceFileName(y.m_traceFileName);
+  }
+
   CCT::MergeEffectList* mrgEffects2 =
-    x.cct()->merge(y.cct(), x_newMetricBegIdx, mrgFlag);
+    x.cct()->merge(y.cct(), x_newMetricBegIdx, mrgFlag, 0, mrgRecord);
 
   DIAG_Assert(Logic::implies(mrgEffects2 && !mrgEffects2->empty(),
 			     mrgFlag & CCT::MrgFlg_NormalizeTraceFileY),
@@ -381,13 +393,44 @@ Profile::merge_fixCCT(const std::vector<LoadMap::MergeEffect>* mrgEffects)
 }
 
 
+uint
+Profile::replay(const CCT::MergeRecord& mrgRecord,
+		const std::vector<CCT::ANode*>& nodes, uint mrgFlag)
+{
+  if (mrgFlag & CCT::MrgFlg_NormalizeTraceFileY) {
+    mrgFlag |= CCT::MrgFlg_PropagateEffects;
+  }
+
+  CCT::MergeEffectList* mrgEffects = cct()->replay(mrgRecord, nodes, mrgFlag);
+
+  merge_fixTrace(mrgRecord.traceFileName(), mrgEffects);
+  delete mrgEffects;
+
+  return mrgRecord.metricBegIdx();
+}
+
+
 void
-Profile::merge_fixTrace(const CCT::MergeEffectList* mrgEffects)
+Profile::match(Profile& y, CCT::NodeIdMap& yIdToXId)
+{
+  // Post-INVARIANT: y's cct refers to x's LoadMap (cf. merge())
+  std::vector<LoadMap::MergeEffect>* mrgEffects =
+    m_loadmap->merge(*y.loadmap());
+  y.merge_fixCCT(mrgEffects);
+  delete mrgEffects;
+
+  cct()->match(y.cct(), yIdToXId);
+}
+
+
+void
+Profile::merge_fixTrace(const std::string& traceFileName,
+			const CCT::MergeEffectList* mrgEffects)
 {
   typedef std::map<uint, uint> UIntToUIntMap;
 
   // early exit for trivial case
-  if (m_traceFileName.empty()) {
+  if (traceFileName.empty()) {
     return;
   }
   else if (!mrgEffects || mrgEffects->empty()) {
@@ -410,14 +453,14 @@ Profile::merge_fixTrace(const CCT::MergeEffectList* mrgEffects)
   // ------------------------------------------------------------
   int ret;
 
-  DIAG_MsgIf(0, "Profile::merge_fixTrace: " << m_traceFileName);
+  DIAG_MsgIf(0, "Profile::merge_fixTrace: " << traceFileName);
 
-  string traceFileNameTmp = m_traceFileName + "." + HPCPROF_TmpFnmSfx;
+  string traceFileNameTmp = traceFileName + "." + HPCPROF_TmpFnmSfx;
 
   char* infsBuf = new char[HPCIO_RWBufferSz];
   char* outfsBuf = new char[HPCIO_RWBufferSz];
 
-  const string& inFnm = m_traceFileName;
+  const string& inFnm = traceFileName;
   FILE* infs = hpcio_fopen_r(inFnm.c_str());
   if (!infs) {
     std::string errorString;
@@ -460,13 +503,21 @@ Profile::merge_fixTrace(const CCT::MergeEffectList* mrgEffects)
   ret = setvbuf(outfs, outfsBuf, _IOFBF, HPCIO_RWBufferSz);
   DIAG_AssertWarn(ret == 0, outFnm << ": Profile::merge_fixTrace: setvbuf!");
 
-  ret = hpctrace_fmt_hdr_fwrite(hdr.flags, outfs);
+  // compact files are rewritten in compact blocks, with a block index
+  hpctrace_fmt_block_t inBlk, outBlk;
+  std::vector<unsigned char> outBlkBuf(HPCTRACE_FMT_BlockMaxLen);
+  std::vector<hpctrace_fmt_index_entry_t> blkIndex;
+  uint64_t blkOffset = 0, numRecords = 0;
+  hpctrace_fmt_block_init(&inBlk, NULL);
+  hpctrace_fmt_block_init(&outBlk, &outBlkBuf[0]);
+
+  ret = hpctrace_fmt_hdr_fwrite(hdr.flags, &hdr.clock, outfs);
   if (ret == HPCFMT_ERR) goto badwrite;
 
   while ( !feof(infs) ) {
     // 1. Read trace record (exit on EOF)
     hpctrace_fmt_datum_t datum;
-    ret = hpctrace_fmt_datum_fread(&datum, hdr.flags, infs);
+    ret = hpctrace_fmt_datum_fread(&datum, hdr.flags, &inBlk, infs);
     if (ret == HPCFMT_EOF) {
       break;
     } else if (ret == HPCFMT_ERR) {
@@ -488,7 +539,28 @@ Profile::merge_fixTrace(const CCT::MergeEffectList* mrgEffects)
     datum.cpId = cctId_new;
 
     // 3. Write new trace record
-    ret = hpctrace_fmt_datum_fwrite(&datum, hdr.flags, outfs);
+    if (hdr.flags.fields.isCompact) {
+      if (outBlk.nrecords == 0) {
+	hpctrace_fmt_index_entry_t entry = { blkOffset, datum.time };
+	blkIndex.push_back(entry);
+      }
+      numRecords++;
+      if (hpctrace_fmt_block_append(&outBlk, &datum, hdr.flags)) {
+	blkOffset += HPCTRACE_FMT_BlockHdrLen + outBlk.len;
+	ret = hpctrace_fmt_block_fwrite(&outBlk, outfs);
+      }
+    }
+    else {
+      ret = hpctrace_fmt_datum_fwrite(&datum, hdr.flags, outfs);
+    }
+    if (ret == HPCFMT_ERR) goto badwrite;
+  }
+
+  if (hdr.flags.fields.isCompact) {
+    ret = hpctrace_fmt_block_fwrite(&outBlk, outfs);
+    if (ret == HPCFMT_ERR) goto badwrite;
+    ret = hpctrace_fmt_index_fwrite(blkIndex.empty() ? NULL : &blkIndex[0],
+				    blkIndex.size(), numRecords, outfs);
     if (ret == HPCFMT_ERR) goto badwrite;
   }
 
@@ -835,8 +907,11 @@ Profile::writeXML_hdr(std::ostream& os, uint metricBeg, uint metricEnd,
       os << " db-glob=\"" << m->dbFileGlob() << "\""
 	 << " db-id=\"" << m->dbId() << "\""
 	 << " db-num-metrics=\"" << m->dbNumMetrics() << "\""
-	 << " db-header-sz=\"" << HPCMETRICDB_FMT_HeaderLen << "\""
-	 << "/>\n";
+	 << " db-header-sz=\"" << HPCMETRICDB_FMT_HeaderLen << "\"";
+      if (m_isMetricDBSparse) {
+	os << " db-layout=\"sparse\"";
+      }
+      os << "/>\n";
     }
   }
   os << "  </MetricDBTable>\n";
@@ -1426,7 +1501,7 @@ Profile::fmt_cct_fread(Profile& prof, FILE* infs, uint rFlags,
 		       const metric_tbl_t& metricTbl,
 		       std::string ctxtStr, FILE* outfs)
 {
-  typedef std::map<int, CCT::ANode*> CCTIdToCCTNodeMap;
+  typedef std::unordered_map<int, CCT::ANode*> CCTIdToCCTNodeMap;
 
   DIAG_Assert(infs, "Bad file descriptor!");
   
@@ -1468,13 +1543,35 @@ Profile::fmt_cct_fread(Profile& prof, FILE* infs, uint rFlags,
     (hpcrun_metricVal_t*)alloca(numMetricsSrc * sizeof(hpcrun_metricVal_t))
     : NULL;
 
+  // N.B.: If possible, decode the records from a mapping of the file
+  // rather than with stdio; 'nodeRdr' leaves 'infs' after the last one.
+  CallPath::CCTNodeReader nodeRdr(infs, prof.m_flags, numMetricsSrc,
+				  (rFlags & RFlg_NoMmap) ? 0 : numNodes);
+
+  cctNodeMap.reserve(numNodes);
+
   ExprEval eval;
 
+  // metrics whose values are computed by a formula
+  metric_desc_t* m_lst = metricTbl.lst;
+  std::vector<uint> formulaMetrics;
+  for (uint i = 0; i < numMetricsSrc; i++) {
+    char *expr = (char*) m_lst[i].formula;
+    if (expr != NULL && strlen(expr) > 0) {
+      formulaMetrics.push_back(i);
+    }
+  }
+
   for (uint i = 0; i < numNodes; ++i) {
     // ----------------------------------------------------------
     // Read the node
     // ----------------------------------------------------------
-    ret = hpcrun_fmt_cct_node_fread(&nodeFmt, prof.m_flags, infs);
+    if (nodeRdr.isMapped()) {
+      ret = nodeRdr.read(nodeFmt);
+    }
+    else {
+      ret = hpcrun_fmt_cct_node_fread(&nodeFmt, prof.m_flags, infs);
+    }
     if (ret != HPCFMT_OK) {
       DIAG_Throw("Error reading CCT node " << nodeFmt.id);
     }
@@ -1489,17 +1586,18 @@ Profile::fmt_cct_fread(Profile& prof, FILE* infs, uint rFlags,
     // FIXME: we don't check the validity of the formula (yet).
     //        If hpcrun has incorrect formula, the result can be anything
     // ------------------------------------------
-    metric_desc_t* m_lst = metricTbl.lst;
-    VarMap var_map(nodeFmt.metrics, m_lst, numMetricsSrc);
+    if (!formulaMetrics.empty()) {
+      VarMap var_map(nodeFmt.metrics, m_lst, numMetricsSrc);
 
-    for (uint i = 0; i < numMetricsSrc; i++) {
-      char *expr = (char*) m_lst[i].formula;
-      if (expr == NULL || strlen(expr)==0) continue;
+      for (uint k = 0; k < formulaMetrics.size(); k++) {
+	uint i = formulaMetrics[k];
+	char *expr = (char*) m_lst[i].formula;
 
-      double res = eval.Eval(expr, &var_map);
-      if (eval.GetErr() == EEE_NO_ERROR) {
-        // the formula syntax looks "correct". Update the the metric value
-      	hpcrun_fmt_metric_set_value(m_lst[i], &nodeFmt.metrics[i], res);
+	double res = eval.Eval(expr, &var_map);
+	if (eval.GetErr() == EEE_NO_ERROR) {
+	  // the formula syntax looks "correct". Update the the metric value
+	  hpcrun_fmt_metric_set_value(m_lst[i], &nodeFmt.metrics[i], res);
+	}
       }
     }
 
@@ -1572,7 +1670,8 @@ Profile::fmt_cct_fread(Profile& prof, FILE* infs, uint rFlags,
 //***************************************************************************
 
 int
-Profile::fmt_fwrite(const Profile& prof, FILE* fs, uint wFlags)
+Profile::fmt_fwrite(const Profile& prof, FILE* fs, uint wFlags,
+		    const CCT::ANodeFilter* filter)
 {
   int ret;
 
@@ -1584,7 +1683,7 @@ Profile::fmt_fwrite(const Profile& prof, FILE* fs, uint wFlags)
   string traceMaxTimeStr = StrUtil::toStr(prof.m_traceMaxTime);
 
   ret = hpcrun_fmt_hdr_fwrite(fs,
-			"TODO:hdr-name","TODO:hdr-value",
+			HPCRUN_FMT_NV_prog, prof.name().c_str(),
 			HPCRUN_FMT_NV_traceMinTime, traceMinTimeStr.c_str(),
 			HPCRUN_FMT_NV_traceMaxTime, traceMaxTimeStr.c_str(),
 			NULL);
@@ -1593,7 +1692,7 @@ Profile::fmt_fwrite(const Profile& prof, FILE* fs, uint wFlags)
   // ------------------------------------------------------------
   // epoch
   // ------------------------------------------------------------
-  ret = fmt_epoch_fwrite(prof, fs, wFlags);
+  ret = fmt_epoch_fwrite(prof, fs, wFlags, filter);
   if (ret == HPCFMT_ERR) return HPCFMT_ERR;
 
   return HPCFMT_OK;
@@ -1601,7 +1700,8 @@ Profile::fmt_fwrite(const Profile& prof, FILE* fs, uint wFlags)
 
 
 int
-Profile::fmt_epoch_fwrite(const Profile& prof, FILE* fs, uint wFlags)
+Profile::fmt_epoch_fwrite(const Profile& prof, FILE* fs, uint wFlags,
+			  const CCT::ANodeFilter* filter)
 {
   int ret;
 
@@ -1682,7 +1782,7 @@ Profile::fmt_epoch_fwrite(const Profile& prof, FILE* fs, uint wFlags)
   // ------------------------------------------------------------
   // cct
   // ------------------------------------------------------------
-  ret = fmt_cct_fwrite(prof, fs, wFlags);
+  ret = fmt_cct_fwrite(prof, fs, wFlags, filter);
   if (ret == HPCFMT_ERR) return HPCFMT_ERR;
 
   return HPCFMT_OK;
@@ -1690,7 +1790,8 @@ Profile::fmt_epoch_fwrite(const Profile& prof, FILE* fs, uint wFlags)
 
 
 int
-Profile::fmt_cct_fwrite(const Profile& prof, FILE* fs, uint wFlags)
+Profile::fmt_cct_fwrite(const Profile& prof, FILE* fs, uint wFlags,
+			const CCT::ANodeFilter* filter)
 {
   int ret;
 
@@ -1698,12 +1799,33 @@ Profile::fmt_cct_fwrite(const Profile& prof, FILE* fs, uint wFlags)
   // Ensure CCT node ids follow conventions
   // ------------------------------------------------------------
 
+  // Collect the nodes to write in preorder so that each parent
+  // precedes its children.  A node rejected by 'filter' prunes its
+  // whole subtree.
+  std::vector<CCT::ANode*> nodes;
+  if (!filter) {
+    for (CCT::ANodeIterator it(prof.cct()->root()); it.Current(); ++it) {
+      nodes.push_back(it.current());
+    }
+  }
+  else if (prof.cct()->root()) {
+    std::vector<CCT::ANode*> stack(1, prof.cct()->root());
+    while (!stack.empty()) {
+      CCT::ANode* n = stack.back();
+      stack.pop_back();
+      nodes.push_back(n);
+      for (CCT::ANodeChildIterator it(n, filter); it.Current(); ++it) {
+	stack.push_back(it.current());
+      }
+    }
+  }
+
   // N.B.: This may not generate preorder ids because it is necessary
   // to retain certain trace ids.
   uint64_t numNodes = 0;
   uint nodeId_next = 2; // cf. s_nextUniqueId
-  for (CCT::ANodeIterator it(prof.cct()->root()); it.Current(); ++it) {
-    CCT::ANode* n = it.current();
+  for (uint i = 0; i < nodes.size(); ++i) {
+    CCT::ANode* n = nodes[i];
     Prof::CCT::ADynNode* n_dyn = dynamic_cast<Prof::CCT::ADynNode*>(n);
 
     if (n_dyn && hpcrun_fmt_doRetainId(n_dyn->cpId())) {
@@ -1737,8 +1859,8 @@ Profile::fmt_cct_fwrite(const Profile& prof, FILE* fs, uint wFlags)
   nodeFmt.metrics =
     (hpcrun_metricVal_t*) alloca(numMetrics * sizeof(hpcrun_metricVal_t));
 
-  for (CCT::ANodeIterator it(prof.cct()->root()); it.Current(); ++it) {
-    CCT::ANode* n = it.current();
+  for (uint i = 0; i < nodes.size(); ++i) {
+    CCT::ANode* n = nodes[i];
     fmt_cct_makeNode(nodeFmt, *n, prof.m_flags);
 
     ret = hpcrun_fmt_cct_node_fwrite(&nodeFmt, prof.m_flags, fs);
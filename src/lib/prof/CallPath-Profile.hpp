@@ -122,6 +122,11 @@ public:
   { return m_fmtVersion; }
 
 
+  const std::string&
+  traceFileName() const
+  { return m_traceFileName; }
+
+
   const StringSet&
   traceFileNameSet() const
   { return m_traceFileNameSet; }
@@ -138,6 +143,16 @@ public:
     m_remove_redundancy = flag;
   }
 
+  // whether the metric databases are written in the sparse layout
+  // (metric-db version 0.20), which experiment.xml must announce
+  bool
+  isMetricDBSparse() const
+  { return m_isMetricDBSparse; }
+
+  void
+  isMetricDBSparse(bool flag)
+  { m_isMetricDBSparse = flag; }
+
   void
   addDirectory(std::string filename) {
     std::string directory = FileUtil::dirname(filename);
@@ -244,8 +259,28 @@ public:
   //   the index of the first merged metric in x.
   // ASSUMES: both x and y are in canonical form (canonicalize())
   // WARNING: the merge may change/destroy y
+  //
+  // If 'mrgRecord' is non-NULL, the node merges are noted there so
+  // that replay() can repeat them later (cf. CCT::MergeRecord).
+  uint
+  merge(Profile& y, int mergeTy, uint mrgFlag = 0,
+	CCT::MergeRecord* mrgRecord = NULL);
+
+  // replay: Repeat the CCT merge noted by merge() in 'mrgRecord',
+  //   including normalizing y's trace file if 'mrgFlag' asks for it,
+  //   without y itself.  'nodes' maps the x ids noted in 'mrgRecord'
+  //   to the current nodes of x's CCT (cf. CCT::Tree::replay()).
+  //   Returns the index of the first merged metric in x.
   uint
-  merge(Profile& y, int mergeTy, uint mrgFlag = 0);
+  replay(const CCT::MergeRecord& mrgRecord,
+	 const std::vector<CCT::ANode*>& nodes, uint mrgFlag = 0);
+
+  // match: Map the ids of y's CCT nodes to those of the nodes of x =
+  //   'this' that merge() would merge them into (cf.
+  //   CCT::Tree::match()).  Only x's LoadMap and y's load module ids
+  //   are changed, as by merge().
+  void
+  match(Profile& y, CCT::NodeIdMap& yIdToXId);
 
   // -------------------------------------------------------
   //
@@ -271,6 +306,10 @@ public:
     // affects the normalizations applied to obtain a canonical CCT.
     RFlg_HpcrunData = (1 << 4),
 
+    // read CCT nodes with stdio even if the profile file can be
+    // mapped (cf. CCTNodeReader)
+    RFlg_NoMmap = (1 << 5),
+
     // only write metric descriptors, even if CCT nodes have metrics
     WFlg_VirtualMetrics = (1 << 15)
   };
@@ -314,15 +353,22 @@ public:
   //
   // N.B.: hpcrun-fmt cannot represent static structure.  Therefore,
   // fmt_cct_fwrite() only writes out nodes of type CCT::ADynNode.
+  //
+  // If 'filter' is non-NULL, only the part of the CCT that it selects
+  // is written: the root is always written; any other node that does
+  // not pass 'filter' is omitted along with its subtree.
 
   static int
-  fmt_fwrite(const Profile& prof, FILE* outfs, uint wFlags);
+  fmt_fwrite(const Profile& prof, FILE* outfs, uint wFlags,
+	     const CCT::ANodeFilter* filter = NULL);
 
   static int
-  fmt_epoch_fwrite(const Profile& prof, FILE* outfs, uint wFlags);
+  fmt_epoch_fwrite(const Profile& prof, FILE* outfs, uint wFlags,
+		   const CCT::ANodeFilter* filter = NULL);
 
   static int
-  fmt_cct_fwrite(const Profile& prof, FILE* fs, uint wFlags);
+  fmt_cct_fwrite(const Profile& prof, FILE* fs, uint wFlags,
+		 const CCT::ANodeFilter* filter = NULL);
 
   // -------------------------------------------------------
   // Output
@@ -360,7 +406,12 @@ private:
   merge_fixCCT(const std::vector<LoadMap::MergeEffect>* mrgEffects);
 
   void
-  merge_fixTrace(const CCT::MergeEffectList* mrgEffects);
+  merge_fixTrace(const CCT::MergeEffectList* mrgEffects)
+  { merge_fixTrace(m_traceFileName, mrgEffects); }
+
+  static void
+  merge_fixTrace(const std::string& traceFileName,
+		 const CCT::MergeEffectList* mrgEffects);
 
 
 private:
@@ -381,6 +432,7 @@ private:
 
   Metric::Mgr* m_mMgr;
   bool m_isMetricMgrVirtual;
+  bool m_isMetricDBSparse;
 
   LoadMap* m_loadmap;
 
@@ -118,8 +118,9 @@ LoadMap::lm_insert(LoadMap::LM* x)
 LoadMap::LMSet_nm::iterator
 LoadMap::lm_find(const std::string& nm) const
 {
-  static LoadMap::LM key;
-  key.name(nm);
+  // N.B.: not static: load maps of different profiles may be merged
+  // concurrently
+  LoadMap::LM key(nm);
 
   LMSet_nm::iterator fnd = m_lm_byName.find(&key);
   return fnd;
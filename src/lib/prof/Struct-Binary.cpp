@@ -0,0 +1,673 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+
+//***************************************************************************
+//
+// File:
+//   $HeadURL$
+//
+// Purpose:
+//   [The purpose of this file]
+//
+// Description:
+//   [The set of functions, macros, etc. defined in the file]
+//
+//***************************************************************************
+
+//************************* System Include Files ****************************
+
+#include <string>
+using std::string;
+
+#include <vector>
+#include <map>
+
+#include <cstdio>
+#include <cstring>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+//*************************** User Include Files ****************************
+
+#include <include/uint.h>
+
+#include "Struct-Binary.hpp"
+
+#include <lib/support/diagnostics.h>
+#include <lib/support/FileUtil.hpp>
+#include <lib/support/PathReplacementMgr.hpp>
+#include <lib/support/RealPathMgr.hpp>
+
+//*************************** Forward Declarations **************************
+
+//***************************************************************************
+// File format
+//***************************************************************************
+
+//   header
+//   LM records    [numLMs]
+//   node records  [numNodes]  (preorder within each load module)
+//   VMA records   [numVMAs]
+//   string table  [strSz]     (NUL-terminated strings; offset 0 is "")
+//
+// Each section begins at an 8-byte aligned offset.
+
+static const char BinMagic[16] = "HPCStructBinary";
+static const uint32_t BinVersion = 2;
+static const uint32_t BinByteOrder = 0x01020304;
+
+struct BinHdr {
+  char magic[16];
+  uint32_t version;
+  uint32_t byteOrder;  // BinByteOrder, as written
+
+  uint64_t srcSize;    // source structure file (0 if none)
+  int64_t srcMtime_s;
+  int64_t srcMtime_ns;
+  uint64_t pathCfgHash; // cf. pathSettingsHash()
+
+  uint64_t numLMs;
+  uint64_t lmOff;
+  uint64_t numNodes;
+  uint64_t nodeOff;
+  uint64_t numVMAs;
+  uint64_t vmaOff;
+  uint64_t strSz;
+  uint64_t strOff;
+};
+
+struct BinLM {
+  uint64_t name;      // string offset
+  uint64_t nodeBeg;   // node records [nodeBeg, nodeEnd)
+  uint64_t nodeEnd;
+};
+
+// Strings by node type:
+//   File:  str[0] = name
+//   Proc:  str[0] = name,     str[1] = link name
+//   Alien: str[0] = file,     str[1] = name,  str[2] = display name
+//   Loop:  str[0] = file
+//   Stmt:  str[0] = device
+struct BinNode {
+  uint8_t type;       // Prof::Struct::ANode::ANodeTy
+  uint8_t flags;      // BinNodeFlg_*
+  uint16_t depth;     // 1 for children of the load module
+  uint32_t origId;
+  uint32_t begLn;
+  uint32_t endLn;
+  uint64_t str[3];
+  uint64_t target;    // Stmt: call target
+  uint64_t vmaBeg;    // VMA records [vmaBeg, vmaBeg + numVMAs)
+  uint32_t numVMAs;
+  uint32_t pad;
+};
+
+enum {
+  BinNodeFlg_HasSym = (1 << 0), // Proc: hasSymbolic()
+  BinNodeFlg_Call   = (1 << 1)  // Stmt: STMT_CALL
+};
+
+struct BinVMA {
+  uint64_t beg;
+  uint64_t end;
+};
+
+
+static uint64_t
+alignUp(uint64_t x)
+{
+  return (x + 7) & ~((uint64_t)7);
+}
+
+
+// pathSettingsHash: a hash of the settings under which RealPathMgr
+// rewrites file names (the -R replacement paths and the search paths).
+// Node names are stored as rewritten, so a copy made under other
+// settings is stale.
+static uint64_t
+pathSettingsHash()
+{
+  string cfg = RealPathMgr::singleton().searchPaths();
+  cfg += '\0';
+
+  const std::vector<PathReplacementMgr::StringPair>& pairs =
+    PathReplacementMgr::singleton().pairs();
+  for (uint i = 0; i < pairs.size(); ++i) {
+    cfg += pairs[i].first;
+    cfg += '\0';
+    cfg += pairs[i].second;
+    cfg += '\0';
+  }
+
+  // FNV-1a
+  uint64_t hash = 14695981039346656037ULL;
+  for (uint i = 0; i < cfg.size(); ++i) {
+    hash ^= (unsigned char)cfg[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+
+// readHdr: read the header of 'fnm' into 'hdr'; returns false if 'fnm'
+// cannot be read or is not a binary structure file of this machine
+static bool
+readHdr(const char* fnm, BinHdr& hdr)
+{
+  int fd = open(fnm, O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  ssize_t ret = read(fd, &hdr, sizeof(hdr));
+  close(fd);
+
+  return (ret == (ssize_t)sizeof(hdr)
+	  && memcmp(hdr.magic, BinMagic, sizeof(BinMagic)) == 0
+	  && hdr.version == BinVersion
+	  && hdr.byteOrder == BinByteOrder);
+}
+
+
+//***************************************************************************
+
+namespace Prof {
+
+namespace Struct {
+
+//***************************************************************************
+// writeBinary
+//***************************************************************************
+
+namespace {
+
+class BinWriter {
+public:
+  BinWriter()
+  {
+    m_strs.push_back('\0'); // ""
+  }
+
+  void
+  addLM(const LM* lm)
+  {
+    BinLM x;
+    x.name = str(lm->name());
+    x.nodeBeg = m_nodes.size();
+    for (ANode* n = lm->firstChild(); n; n = n->nextSibling()) {
+      addNode(n, 1);
+    }
+    x.nodeEnd = m_nodes.size();
+    m_lms.push_back(x);
+  }
+
+  void
+  write(const char* fnm, const char* srcFnm);
+
+private:
+  uint64_t
+  str(const string& x)
+  {
+    if (x.empty()) {
+      return 0;
+    }
+    std::map<string, uint64_t>::iterator it = m_strMap.find(x);
+    if (it != m_strMap.end()) {
+      return it->second;
+    }
+    uint64_t off = m_strs.size();
+    m_strs.insert(m_strs.end(), x.c_str(), x.c_str() + x.size() + 1);
+    m_strMap.insert(std::make_pair(x, off));
+    return off;
+  }
+
+  void
+  addNode(ANode* n, uint depth);
+
+private:
+  std::vector<BinLM> m_lms;
+  std::vector<BinNode> m_nodes;
+  std::vector<BinVMA> m_vmas;
+  std::vector<char> m_strs;
+  std::map<string, uint64_t> m_strMap;
+};
+
+
+void
+BinWriter::addNode(ANode* n, uint depth)
+{
+  ACodeNode* cn = dynamic_cast<ACodeNode*>(n);
+  DIAG_Assert(cn, "");
+
+  if (depth > UINT16_MAX) {
+    DIAG_Throw("structure tree too deep for a binary structure file");
+  }
+
+  BinNode x;
+  memset(&x, 0, sizeof(x));
+  x.type = n->type();
+  x.depth = depth;
+  x.origId = n->m_origId;
+  x.begLn = cn->begLine();
+  x.endLn = cn->endLine();
+
+  switch (n->type()) {
+    case ANode::TyFile: {
+      File* f = static_cast<File*>(n);
+      x.str[0] = str(f->name());
+      break;
+    }
+    case ANode::TyProc: {
+      Proc* p = static_cast<Proc*>(n);
+      x.str[0] = str(p->name());
+      x.str[1] = str(p->linkName());
+      x.flags |= (p->hasSymbolic()) ? BinNodeFlg_HasSym : 0;
+      break;
+    }
+    case ANode::TyAlien: {
+      Alien* a = static_cast<Alien*>(n);
+      x.str[0] = str(a->fileName());
+      x.str[1] = str(a->name());
+      x.str[2] = str(a->displayName());
+      break;
+    }
+    case ANode::TyLoop: {
+      Loop* l = static_cast<Loop*>(n);
+      x.str[0] = str(l->fileName());
+      break;
+    }
+    case ANode::TyStmt: {
+      Stmt* s = static_cast<Stmt*>(n);
+      x.str[0] = str(s->device());
+      if (s->stmtType() == Stmt::STMT_CALL) {
+	x.flags |= BinNodeFlg_Call;
+	x.target = s->target();
+      }
+      break;
+    }
+    default:
+      DIAG_Throw("cannot write " << n->toStringMe()
+		 << " to a binary structure file");
+  }
+
+  const VMAIntervalSet& vmaset = cn->vmaSet();
+  x.vmaBeg = m_vmas.size();
+  x.numVMAs = vmaset.size();
+  for (VMAIntervalSet::const_iterator it = vmaset.begin();
+       it != vmaset.end(); ++it) {
+    BinVMA v;
+    v.beg = it->beg();
+    v.end = it->end();
+    m_vmas.push_back(v);
+  }
+
+  m_nodes.push_back(x);
+
+  for (ANode* c = n->firstChild(); c; c = c->nextSibling()) {
+    addNode(c, depth + 1);
+  }
+}
+
+
+void
+BinWriter::write(const char* fnm, const char* srcFnm)
+{
+  BinHdr hdr;
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(hdr.magic, BinMagic, sizeof(BinMagic));
+  hdr.version = BinVersion;
+  hdr.byteOrder = BinByteOrder;
+
+  if (srcFnm) {
+    struct stat st;
+    if (stat(srcFnm, &st) != 0) {
+      DIAG_Throw("cannot stat '" << srcFnm << "'");
+    }
+    hdr.srcSize = st.st_size;
+    hdr.srcMtime_s = st.st_mtim.tv_sec;
+    hdr.srcMtime_ns = st.st_mtim.tv_nsec;
+  }
+  hdr.pathCfgHash = pathSettingsHash();
+
+  hdr.numLMs = m_lms.size();
+  hdr.lmOff = alignUp(sizeof(hdr));
+  hdr.numNodes = m_nodes.size();
+  hdr.nodeOff = alignUp(hdr.lmOff + hdr.numLMs * sizeof(BinLM));
+  hdr.numVMAs = m_vmas.size();
+  hdr.vmaOff = alignUp(hdr.nodeOff + hdr.numNodes * sizeof(BinNode));
+  hdr.strSz = m_strs.size();
+  hdr.strOff = alignUp(hdr.vmaOff + hdr.numVMAs * sizeof(BinVMA));
+
+  // Write under a temporary name and rename so that a concurrent reader
+  // sees either no file or a complete one.  N.B.: The temporary name
+  // does not include 'fnm' lest hpcprof take it for a structure file
+  // when scanning a measurement directory.
+  string tmpFnm = (FileUtil::dirname(fnm) + "/.struct-binary.tmp."
+		   + std::to_string(getpid()));
+
+  FILE* fs = fopen(tmpFnm.c_str(), "w");
+  if (!fs) {
+    DIAG_Throw("cannot open '" << tmpFnm << "' for writing");
+  }
+
+  static const char zeros[8] = { 0 };
+  bool ok = (fwrite(&hdr, sizeof(hdr), 1, fs) == 1);
+
+  struct { uint64_t off; const void* data; size_t sz; } sections[] = {
+    { hdr.lmOff,   m_lms.data(),   m_lms.size() * sizeof(BinLM) },
+    { hdr.nodeOff, m_nodes.data(), m_nodes.size() * sizeof(BinNode) },
+    { hdr.vmaOff,  m_vmas.data(),  m_vmas.size() * sizeof(BinVMA) },
+    { hdr.strOff,  m_strs.data(),  m_strs.size() }
+  };
+  uint64_t pos = sizeof(hdr);
+  for (uint i = 0; ok && i < sizeof(sections) / sizeof(sections[0]); ++i) {
+    size_t padSz = sections[i].off - pos;
+    ok = (padSz == 0 || fwrite(zeros, 1, padSz, fs) == padSz);
+    ok = ok && (sections[i].sz == 0
+		|| fwrite(sections[i].data, sections[i].sz, 1, fs) == 1);
+    pos = sections[i].off + sections[i].sz;
+  }
+
+  ok = (fclose(fs) == 0) && ok;
+  ok = ok && (rename(tmpFnm.c_str(), fnm) == 0);
+  if (!ok) {
+    unlink(tmpFnm.c_str());
+    DIAG_Throw("error writing binary structure file '" << fnm << "'");
+  }
+}
+
+} // namespace
+
+
+void
+writeBinary(const Tree& structure, const char* fnm, const char* srcFnm)
+{
+  BinWriter writer;
+
+  Root* root = structure.root();
+  if (root) {
+    for (ANode* n = root->firstChild(); n; n = n->nextSibling()) {
+      if (n->type() != ANode::TyLM) {
+	DIAG_Throw("cannot write " << n->toStringMe()
+		   << " to a binary structure file");
+      }
+      writer.addLM(static_cast<LM*>(n));
+    }
+  }
+
+  writer.write(fnm, srcFnm);
+}
+
+
+//***************************************************************************
+// BinaryReader
+//***************************************************************************
+
+BinaryReader::BinaryReader(const char* fnm)
+  : m_fnm(fnm), m_map(NULL), m_mapSz(0)
+{
+  int fd = open(fnm, O_RDONLY);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0) {
+    if (fd >= 0) {
+      close(fd);
+    }
+    DIAG_Throw("cannot open binary structure file '" << fnm << "'");
+  }
+
+  if ((size_t)st.st_size >= sizeof(BinHdr)) {
+    m_map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (m_map == MAP_FAILED) {
+      m_map = NULL;
+    }
+    m_mapSz = st.st_size;
+  }
+  close(fd);
+
+  // -------------------------------------------------------
+  // Check the header and the extent of each section
+  // -------------------------------------------------------
+  const BinHdr* hdr = static_cast<const BinHdr*>(m_map);
+  const char* base = static_cast<const char*>(m_map);
+
+  bool ok = (hdr
+	     && memcmp(hdr->magic, BinMagic, sizeof(BinMagic)) == 0
+	     && hdr->version == BinVersion
+	     && hdr->byteOrder == BinByteOrder);
+  ok = ok && (hdr->lmOff + hdr->numLMs * sizeof(BinLM) <= m_mapSz
+	      && hdr->nodeOff + hdr->numNodes * sizeof(BinNode) <= m_mapSz
+	      && hdr->vmaOff + hdr->numVMAs * sizeof(BinVMA) <= m_mapSz
+	      && hdr->strOff + hdr->strSz <= m_mapSz
+	      && hdr->strSz > 0 && base[hdr->strOff + hdr->strSz - 1] == '\0');
+  if (!ok) {
+    if (m_map) {
+      munmap(m_map, m_mapSz);
+    }
+    DIAG_Throw("'" << fnm << "' is not a valid binary structure file");
+  }
+
+  // -------------------------------------------------------
+  // Index the load modules (cf. Root::insertLMMap())
+  // -------------------------------------------------------
+  const BinLM* lms = reinterpret_cast<const BinLM*>(base + hdr->lmOff);
+  const char* strs = base + hdr->strOff;
+
+  for (uint i = 0; i < hdr->numLMs; ++i) {
+    string nm = strs + lms[i].name;
+    m_lmMap_realpath.insert(std::make_pair(nm, (int)i));
+
+    string nm_base = FileUtil::basename(nm);
+    std::pair<std::map<string, int>::iterator, bool> ret =
+      m_lmMap_basename.insert(std::make_pair(nm_base, (int)i));
+    if (!ret.second) {
+      ret.first->second = -1;
+    }
+  }
+
+  m_isRead.resize(hdr->numLMs, false);
+
+  madvise(m_map, m_mapSz, MADV_RANDOM);
+}
+
+
+BinaryReader::~BinaryReader()
+{
+  if (m_map) {
+    munmap(m_map, m_mapSz);
+  }
+}
+
+
+uint
+BinaryReader::numLMs() const
+{
+  return static_cast<const BinHdr*>(m_map)->numLMs;
+}
+
+
+LM*
+BinaryReader::readLM(Root* root, const std::string& nm)
+{
+  // -------------------------------------------------------
+  // Find the load module (cf. Root::findLM())
+  // -------------------------------------------------------
+  string nm_real = nm;
+  RealPathMgr::singleton().realpath(nm_real);
+
+  int lmIdx = -1;
+  std::map<string, int>::iterator it1 = m_lmMap_realpath.find(nm_real);
+  if (it1 != m_lmMap_realpath.end()) {
+    lmIdx = it1->second;
+  }
+  else if (nm_real == FileUtil::basename(nm_real)) {
+    std::map<string, int>::iterator it2 = m_lmMap_basename.find(nm_real);
+    if (it2 != m_lmMap_basename.end()) {
+      lmIdx = it2->second;
+    }
+  }
+
+  if (lmIdx < 0 || m_isRead[lmIdx]) {
+    return NULL;
+  }
+  m_isRead[lmIdx] = true;
+
+  // -------------------------------------------------------
+  // Create the load module and its subtree, making the same calls as
+  // PGMDocHandler (but with final line ranges)
+  // -------------------------------------------------------
+  const BinHdr* hdr = static_cast<const BinHdr*>(m_map);
+  const char* base = static_cast<const char*>(m_map);
+  const BinLM& blm = reinterpret_cast<const BinLM*>(base + hdr->lmOff)[lmIdx];
+  const BinNode* nodes = reinterpret_cast<const BinNode*>(base + hdr->nodeOff);
+  const BinVMA* vmas = reinterpret_cast<const BinVMA*>(base + hdr->vmaOff);
+  const char* strs = base + hdr->strOff;
+
+  if (blm.nodeBeg > blm.nodeEnd || blm.nodeEnd > hdr->numNodes) {
+    DIAG_Throw("'" << m_fnm << "': invalid load module record " << lmIdx);
+  }
+
+  LM* lm = new LM(strs + blm.name, root);
+
+  std::vector<ACodeNode*> scopeStack; // scopeStack[d]: current node at depth d
+  scopeStack.push_back(lm);
+
+  for (uint64_t i = blm.nodeBeg; i < blm.nodeEnd; ++i) {
+    const BinNode& x = nodes[i];
+
+    if (x.depth < 1 || x.depth > scopeStack.size()
+	|| x.str[0] >= hdr->strSz || x.str[1] >= hdr->strSz
+	|| x.str[2] >= hdr->strSz || x.vmaBeg + x.numVMAs > hdr->numVMAs) {
+      DIAG_Throw("'" << m_fnm << "': invalid node record " << i);
+    }
+
+    ACodeNode* parent = scopeStack[x.depth - 1];
+    ACodeNode* n = NULL;
+
+    switch (x.type) {
+      case ANode::TyFile:
+	DIAG_Assert(parent == lm, "");
+	n = File::demand(lm, strs + x.str[0]);
+	break;
+      case ANode::TyProc:
+	n = new Proc(strs + x.str[0], parent, strs + x.str[1],
+		     (x.flags & BinNodeFlg_HasSym), x.begLn, x.endLn);
+	break;
+      case ANode::TyAlien:
+	n = new Alien(parent, strs + x.str[0], strs + x.str[1],
+		      strs + x.str[2], x.begLn, x.endLn);
+	break;
+      case ANode::TyLoop: {
+	string fnm = strs + x.str[0];
+	n = new Loop(parent, fnm, x.begLn, x.endLn);
+	break;
+      }
+      case ANode::TyStmt: {
+	Stmt::StmtType ty =
+	  (x.flags & BinNodeFlg_Call) ? Stmt::STMT_CALL : Stmt::STMT_STMT;
+	Stmt* s = new Stmt(parent, x.begLn, x.endLn, 0, 0, ty);
+	if (x.target) {
+	  s->target(x.target);
+	}
+	if (x.str[0]) {
+	  s->device(strs + x.str[0]);
+	}
+	n = s;
+	break;
+      }
+      default:
+	DIAG_Throw("'" << m_fnm << "': invalid node type in record " << i);
+    }
+
+    for (uint j = 0; j < x.numVMAs; ++j) {
+      const BinVMA& v = vmas[x.vmaBeg + j];
+      n->vmaSet().insert(v.beg, v.end);
+    }
+    n->m_origId = x.origId;
+
+    scopeStack.resize(x.depth);
+    scopeStack.push_back(n);
+  }
+
+  return lm;
+}
+
+
+bool
+BinaryReader::isBinaryFile(const char* fnm)
+{
+  char magic[sizeof(BinMagic)];
+
+  int fd = open(fnm, O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  ssize_t ret = read(fd, magic, sizeof(magic));
+  close(fd);
+
+  return (ret == (ssize_t)sizeof(magic)
+	  && memcmp(magic, BinMagic, sizeof(BinMagic)) == 0);
+}
+
+
+bool
+BinaryReader::isCopyOf(const char* fnm, const char* srcFnm)
+{
+  BinHdr hdr;
+  struct stat st;
+  return (readHdr(fnm, hdr)
+	  && stat(srcFnm, &st) == 0
+	  && hdr.srcSize == (uint64_t)st.st_size
+	  && hdr.srcMtime_s == (int64_t)st.st_mtim.tv_sec
+	  && hdr.srcMtime_ns == (int64_t)st.st_mtim.tv_nsec
+	  && hdr.pathCfgHash == pathSettingsHash());
+}
+
+
+} // namespace Struct
+
+} // namespace Prof
@@ -0,0 +1,162 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+
+//***************************************************************************
+//
+// File:
+//   $HeadURL$
+//
+// Purpose:
+//   A binary form of a structure file whose load modules are read
+//   lazily.
+//
+// Description:
+//   Parsing a large XML structure file dominates the start-up of
+//   hpcprof even though a profile typically samples only a few of its
+//   load modules.  A binary structure file holds the load modules of a
+//   Struct::Tree as flat arrays of fixed-size records (one per node, in
+//   preorder, with each node's depth) plus one table of shared strings.
+//   BinaryReader maps the file and creates a load module and its
+//   subtree only when LM::demand() asks for it (cf.
+//   Root::addBinarySource()).
+//
+//   The file records the size and modification time of the structure
+//   file it was made from, and the path settings that rewrote its file
+//   names, so that a binary copy can serve as a cache of an XML
+//   structure file (cf. BinaryReader::isCopyOf()).  Records are
+//   in native byte order; a file from a machine of another byte order
+//   is rejected.
+//
+//***************************************************************************
+
+#ifndef prof_Prof_Struct_Binary_hpp
+#define prof_Prof_Struct_Binary_hpp
+
+//************************* System Include Files ****************************
+
+#include <string>
+#include <map>
+#include <vector>
+
+#include <stdint.h>
+
+//*************************** User Include Files ****************************
+
+#include <include/uint.h>
+
+#include "Struct-Tree.hpp"
+
+#include <lib/support/Unique.hpp>
+
+//*************************** Forward Declarations **************************
+
+//***************************************************************************
+
+namespace Prof {
+
+namespace Struct {
+
+// writeBinary: Write the load modules of 'structure' to the binary
+// structure file 'fnm'.  'srcFnm', if non-NULL, names the structure
+// file that 'structure' was read from.  The file is written under a
+// temporary name and then renamed so that readers never see a partial
+// file.  Throws if 'structure' has Group or Ref nodes or if 'fnm'
+// cannot be written.
+void
+writeBinary(const Tree& structure, const char* fnm,
+	    const char* srcFnm = NULL);
+
+
+class BinaryReader
+  : public Unique // prevent copying
+{
+public:
+  // Map the binary structure file 'fnm'.  Throws if it cannot be
+  // mapped or is not a binary structure file.
+  BinaryReader(const char* fnm);
+
+  ~BinaryReader();
+
+  const std::string&
+  fileName() const
+  { return m_fnm; }
+
+  uint
+  numLMs() const;
+
+  // readLM: If this file has a load module 'nm' (matched as by
+  //   Root::findLM()) that has not yet been read, create it and its
+  //   subtree in 'root' and return it; otherwise return NULL.
+  LM*
+  readLM(Root* root, const std::string& nm);
+
+  // isBinaryFile: whether 'fnm' begins like a binary structure file
+  static bool
+  isBinaryFile(const char* fnm);
+
+  // isCopyOf: whether 'fnm' is a binary structure file made from the
+  //   current contents of 'srcFnm' (by size and modification time)
+  //   under the current path replacement and search path settings
+  static bool
+  isCopyOf(const char* fnm, const char* srcFnm);
+
+private:
+  std::string m_fnm;
+  void* m_map;
+  size_t m_mapSz;
+
+  std::map<std::string, int> m_lmMap_realpath; // name -> index
+  std::map<std::string, int> m_lmMap_basename; // -1 if not unique
+  std::vector<bool> m_isRead;
+};
+
+} // namespace Struct
+
+} // namespace Prof
+
+
+//***************************************************************************
+
+#endif // prof_Prof_Struct_Binary_hpp
@@ -81,6 +81,7 @@ using std::string;
 #include <include/uint.h>
 
 #include "Struct-Tree.hpp"
+#include "Struct-Binary.hpp"
 
 #include <lib/xml/xml.hpp>
 
@@ -246,6 +247,7 @@ Root::Ctor(const char* nm)
   groupMap = new GroupMap();
   lmMap_realpath = new LMMap();
   lmMap_basename = new LMMap();
+  m_binarySources = NULL;
 }
 
 
@@ -258,6 +260,7 @@ Root::operator=(const Root& x)
     groupMap = NULL;
     lmMap_realpath = NULL;
     lmMap_basename = NULL;
+    m_binarySources = NULL;
   }
   return *this;
 }
@@ -292,6 +295,46 @@ Root::findLM(const char* nm) const
 }
 
 
+void
+Root::addBinarySource(BinaryReader* x)
+{
+  if (!m_binarySources) {
+    m_binarySources = new std::vector<BinaryReader*>;
+  }
+  m_binarySources->push_back(x);
+}
+
+
+LM*
+Root::readLM(const std::string& nm)
+{
+  if (!m_binarySources) {
+    return NULL;
+  }
+
+  for (uint i = 0; i < m_binarySources->size(); ++i) {
+    LM* lm = (*m_binarySources)[i]->readLM(this, nm);
+    if (lm) {
+      return lm;
+    }
+  }
+  return NULL;
+}
+
+
+void
+Root::deleteBinarySources()
+{
+  if (m_binarySources) {
+    for (uint i = 0; i < m_binarySources->size(); ++i) {
+      delete (*m_binarySources)[i];
+    }
+    delete m_binarySources;
+    m_binarySources = NULL;
+  }
+}
+
+
 void
 Group::Ctor(const char* nm, ANode* parent)
 {
@@ -359,6 +402,9 @@ LM*
 LM::demand(Root* pgm, const string& lm_nm)
 {
   LM* lm = pgm->findLM(lm_nm);
+  if (!lm) {
+    lm = pgm->readLM(lm_nm);
+  }
   if (!lm) {
     lm = new LM(lm_nm, pgm);
   }
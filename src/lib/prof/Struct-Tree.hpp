@@ -68,6 +68,7 @@
 #include <list>
 #include <set>
 #include <map>
+#include <vector>
 
 #include <typeinfo>
 
@@ -245,6 +246,8 @@ class Loop;
 class Stmt;
 class Ref;
 
+class BinaryReader; // cf. Struct-Binary.hpp
+
 // ---------------------------------------------------------
 // ANode: The base node for a program scope tree
 // ---------------------------------------------------------
@@ -889,6 +892,7 @@ public:
     delete groupMap;
     delete lmMap_realpath;
     delete lmMap_basename;
+    deleteBinarySources();
   }
 
   virtual const std::string&
@@ -929,6 +933,12 @@ public:
   findGroup(const std::string& nm) const
   { return findGroup(nm.c_str()); }
 
+  // addBinarySource: Make the load modules in binary structure file
+  // 'x' available to LM::demand(), which creates a load module from
+  // 'x' the first time it is demanded.  Assumes ownership of 'x'.
+  void
+  addBinarySource(BinaryReader* x);
+
   virtual ANode*
   clone()
   { return new Root(*this); }
@@ -967,6 +977,14 @@ private:
   void
   insertLMMap(LM* lm);
 
+  // readLM: create load module 'nm' from the first binary source that
+  // contains it; returns NULL if there is none
+  LM*
+  readLM(const std::string& nm);
+
+  void
+  deleteBinarySources();
+
   friend class Group;
   friend class LM;
 
@@ -978,6 +996,8 @@ private:
   LMMap* lmMap_realpath; // mapped by 'realpath'
   LMMap* lmMap_basename;
 
+  std::vector<BinaryReader*>* m_binarySources; // NULL if there are none
+
 #if 0
   static RealPathMgr& s_realpathMgr;
 #endif
@@ -1082,6 +1102,9 @@ public:
   clone()
   { return new LM(*this); }
 
+  // demand: find load module 'lm_fnm' in 'pgm'; otherwise read it
+  // from a binary source of 'pgm' (cf. Root::addBinarySource()) or, if
+  // there is none, create an empty one
   static LM*
   demand(Root* pgm, const std::string& lm_fnm);
 
@@ -73,11 +73,15 @@ using std::endl;
 #include <string>
 using std::string;
 
+#include <set>
+
 //************************* User Include Files *******************************
 
 #include "PGMReader.hpp"
 #include "XercesUtil.hpp"
 
+#include <lib/prof/Struct-Binary.hpp>
+
 //*********************** Xerces Include Files *******************************
 
 #include <xercesc/util/XMLString.hpp>
@@ -133,14 +137,36 @@ void
 readStructure(Struct::Tree& structure, 
 	      const std::vector<string>& structureFiles,
 	      PGMDocHandler::Doc_t docty, 
-	      DocHandlerArgs& docargs)
+	      DocHandlerArgs& docargs,
+	      bool useCache)
 {
   if (structureFiles.empty()) { return; }
 
+  std::set<string> cacheFiles;
+  for (uint i = 0; i < structureFiles.size(); ++i) {
+    cacheFiles.insert(binaryCacheName(structureFiles[i]));
+  }
+
   InitXerces();
 
   for (uint i = 0; i < structureFiles.size(); ++i) {
     const string& fnm = structureFiles[i];
+
+    if (BinaryReader::isBinaryFile(fnm.c_str())) {
+      // skip the binary copy of a structure file that is also listed
+      if (cacheFiles.find(fnm) == cacheFiles.end()) {
+	structure.root()->addBinarySource(new BinaryReader(fnm.c_str()));
+      }
+      continue;
+    }
+
+    string cacheFnm = binaryCacheName(fnm);
+    if (useCache && docty == PGMDocHandler::Doc_STRUCT
+	&& BinaryReader::isCopyOf(cacheFnm.c_str(), fnm.c_str())) {
+      structure.root()->addBinarySource(new BinaryReader(cacheFnm.c_str()));
+      continue;
+    }
+
     read_PGM(structure, fnm.c_str(), docty, docargs);
   }
 
@@ -148,6 +174,43 @@ readStructure(Struct::Tree& structure,
 }
 
 
+string
+binaryCacheName(const string& fnm)
+{
+  return fnm + ".bin";
+}
+
+
+void
+makeBinaryCache(const std::vector<string>& structureFiles,
+		DocHandlerArgs& docargs)
+{
+  InitXerces();
+
+  for (uint i = 0; i < structureFiles.size(); ++i) {
+    const string& fnm = structureFiles[i];
+    string cacheFnm = binaryCacheName(fnm);
+
+    if (BinaryReader::isBinaryFile(fnm.c_str())
+	|| BinaryReader::isCopyOf(cacheFnm.c_str(), fnm.c_str())) {
+      continue;
+    }
+
+    Struct::Tree structure("");
+    read_PGM(structure, fnm.c_str(), PGMDocHandler::Doc_STRUCT, docargs);
+
+    try {
+      writeBinary(structure, cacheFnm.c_str(), fnm.c_str());
+    }
+    catch (const Diagnostics::Exception& x) {
+      DIAG_WMsgIf(1, "cannot cache '" << fnm << "': " << x.what());
+    }
+  }
+
+  FiniXerces();
+}
+
+
 void
 read_PGM(Struct::Tree& structure,
 	 const char* filenm,
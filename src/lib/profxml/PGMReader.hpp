@@ -62,6 +62,7 @@
 
 //************************ System Include Files ******************************
 
+#include <string>
 #include <vector>
 
 //************************* User Include Files *******************************
@@ -77,11 +78,28 @@ namespace Prof {
 
 namespace Struct {
 
+// readStructure: Read 'structureFiles' into 'structure'.  The load
+// modules of a binary structure file (cf. Struct-Binary.hpp) are read
+// on demand.  If 'useCache' is true, an XML structure file with an
+// up-to-date binary copy (cf. makeBinaryCache()) is read through the
+// copy.
 void
 readStructure(Tree& structure, 
 	      const std::vector<string>& structureFiles,
 	      PGMDocHandler::Doc_t docty, 
-	      DocHandlerArgs& docargs);
+	      DocHandlerArgs& docargs,
+	      bool useCache = false);
+
+// binaryCacheName: the name of the binary copy of structure file 'fnm'
+std::string
+binaryCacheName(const std::string& fnm);
+
+// makeBinaryCache: Write a binary copy of each XML structure file in
+// 'structureFiles' that does not have an up-to-date one.  A copy that
+// cannot be written is reported with a warning.
+void
+makeBinaryCache(const std::vector<string>& structureFiles,
+		DocHandlerArgs& docargs);
 
 void
 read_PGM(Tree& structure,
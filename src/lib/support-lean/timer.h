@@ -190,6 +190,26 @@ time_getTSC()
 }
 
 
+// time_getTSCP: like time_getTSC(), but uses rdtscp where available,
+// which waits for preceding instructions to complete before reading
+// the counter.  Callers must check for rdtscp support (cpuid) first.
+inline static uint64_t
+time_getTSCP()
+{
+#if defined(__x86_64__)
+
+  uint32_t hi, lo, aux;
+  asm volatile ("rdtscp" : "=a" (lo), "=d" (hi), "=c" (aux));
+  return (((uint64_t)hi) << 32) | ((uint64_t)lo);
+
+#else
+
+  return time_getTSC();
+
+#endif
+}
+
+
 // **************************************************************************
 
 #if defined(__cplusplus)
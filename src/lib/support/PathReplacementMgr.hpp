@@ -108,6 +108,11 @@ public:
 public:
   typedef std::pair<std:: string, std::string> StringPair;
 
+  // pairs: the replacement-path pairs, in the order they are tried
+  const std::vector<StringPair>&
+  pairs() const
+  { return m_pathReplacement; }
+
 private:
   std::vector<StringPair> m_pathReplacement;
 };
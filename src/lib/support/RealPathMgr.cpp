@@ -93,6 +93,7 @@ RealPathMgr::RealPathMgr()
 {
   m_pathFindMgr = NULL;
   m_pathReplaceMgr = NULL;
+  pthread_mutex_init(&m_cacheLock, NULL);
 }
 
 
@@ -102,6 +103,7 @@ RealPathMgr::RealPathMgr(PathFindMgr * findMgr, PathReplacementMgr * replaceMgr)
 {
   m_pathFindMgr = findMgr;
   m_pathReplaceMgr = replaceMgr;
+  pthread_mutex_init(&m_cacheLock, NULL);
 }
 
 
@@ -114,6 +116,7 @@ RealPathMgr::~RealPathMgr()
   if (m_pathReplaceMgr != NULL) {
     delete m_pathReplaceMgr;
   }
+  pthread_mutex_destroy(&m_cacheLock);
 }
 
 
@@ -132,6 +135,10 @@ RealPathMgr::realpath(string& pathNm) const
   
   // INVARIANT: 'pathNm' is not empty
 
+  // N.B.: the path-replacement and path-find managers keep caches of
+  // their own, so hold the lock across the whole lookup.
+  pthread_mutex_lock(&m_cacheLock);
+
   // INVARIANT: all entries in the map are non-empty
   MyMap::iterator it = m_cache.find(pathNm);
 
@@ -199,6 +206,9 @@ RealPathMgr::realpath(string& pathNm) const
       m_cache.insert(make_pair(pathNm_orig, pathNm_real));
     }
   }
+
+  pthread_mutex_unlock(&m_cacheLock);
+
   return (pathNm[0] == '/'); // fully resolved
 }
 
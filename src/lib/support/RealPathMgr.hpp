@@ -68,6 +68,8 @@
 
 #include <cctype>
 
+#include <pthread.h>
+
 //*************************** User Include Files ****************************
 
 #include <include/uint.h>
@@ -103,6 +105,8 @@ public:
   // and return true.  Return true if 'fnm' is as fully resolved as it
   // can be (which does not necessarily mean it exists); otherwise
   // return false.
+  //
+  // N.B.: safe to call from several threads at once.
   bool
   realpath(std::string& pathNm) const;
   
@@ -147,6 +151,7 @@ private:
 
   std::string m_searchPaths;
   mutable MyMap m_cache;
+  mutable pthread_mutex_t m_cacheLock; // protects m_cache and path managers
 };
 
 
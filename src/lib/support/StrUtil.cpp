@@ -237,7 +237,9 @@ toDbl(const char* str, unsigned* endidx)
 //
 // --------------------------------------------------------------------------
 
-static char buf[32];
+// Each conversion uses its own buffer: profiles are parsed by several
+// threads at once (cf. Analysis::CallPath::read()).
+static const int BufSz = 32;
 
 string
 toStr(const int x, int base)
@@ -253,7 +255,8 @@ toStr(const int x, int base)
     DIAG_Die(DIAG_Unimplemented);
   }
   
-  sprintf(buf, format, x);
+  char buf[BufSz];
+  snprintf(buf, BufSz, format, x);
   return string(buf);
 }
 
@@ -280,7 +283,8 @@ toStr(const unsigned x, int base)
     DIAG_Die(DIAG_Unimplemented);
   }
   
-  sprintf(buf, format, x);
+  char buf[BufSz];
+  snprintf(buf, BufSz, format, x);
   return string(buf);
 }
 
@@ -303,7 +307,8 @@ toStr(const int64_t x, int base)
     DIAG_Die(DIAG_Unimplemented);
   }
   
-  sprintf(buf, format, x);
+  char buf[BufSz];
+  snprintf(buf, BufSz, format, x);
   return string(buf);
 }
 
@@ -326,7 +331,8 @@ toStr(const uint64_t x, int base)
     DIAG_Die(DIAG_Unimplemented);
   }
   
-  sprintf(buf, format, x);
+  char buf[BufSz];
+  snprintf(buf, BufSz, format, x);
   return string(buf);
 }
 
@@ -334,7 +340,8 @@ toStr(const uint64_t x, int base)
 string
 toStr(const void* x, int GCC_ATTR_UNUSED base)
 {
-  sprintf(buf, "%p", x);
+  char buf[BufSz];
+  snprintf(buf, BufSz, "%p", x);
   return string(buf);
 }
 
@@ -342,9 +349,17 @@ toStr(const void* x, int GCC_ATTR_UNUSED base)
 string
 toStr(const double x, const char* format)
 {
-  //static char buf[19]; // 0xhhhhhhhhhhhhhhhh format
-  sprintf(buf, format, x);
-  return string(buf);
+  char buf[BufSz];
+  int len = snprintf(buf, BufSz, format, x);
+  if (len < BufSz) {
+    return string(buf);
+  }
+
+  // e.g., "%f" of a large value
+  string str(len + 1, '\0');
+  snprintf(&str[0], len + 1, format, x);
+  str.resize(len);
+  return str;
 }
 
 
@@ -0,0 +1,228 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// File:
+//   $HeadURL$
+//
+// Purpose:
+//   Keeps one CCT::MergeRecord per profile file between the summary
+//   and thread-level metric passes; see MergeRecordStore.hpp.
+//
+//***************************************************************************
+
+//************************* System Include Files ****************************
+
+#include <cstdio>
+#include <cstdlib>
+
+#include <string>
+using std::string;
+
+#include <vector>
+
+#include <unistd.h>
+
+//*************************** User Include Files ****************************
+
+#include <include/uint.h>
+
+#include "MergeRecordStore.hpp"
+
+#include <lib/support/diagnostics.h>
+#include <lib/support/StrUtil.hpp>
+
+//*************************** Forward Declarations **************************
+
+//***************************************************************************
+// MergeRecordStore
+//***************************************************************************
+
+MergeRecordStore::MergeRecordStore(uint numRecords, size_t memLimit,
+				   const string& scratchDir, int myRank)
+  : m_records(numRecords, NULL), m_spillOffset(numRecords, -1),
+    m_memLimit(memLimit), m_memUsed(0),
+    m_scratchDir(scratchDir), m_myRank(myRank),
+    m_spillFs(NULL), m_spillFailed(false), m_numSpilled(0)
+{
+}
+
+
+MergeRecordStore::~MergeRecordStore()
+{
+  for (uint i = 0; i < m_records.size(); ++i) {
+    delete m_records[i];
+  }
+  if (m_spillFs) {
+    fclose(m_spillFs);
+  }
+}
+
+
+void
+MergeRecordStore::put(uint i, Prof::CCT::MergeRecord* rec)
+{
+  DIAG_Assert(i < m_records.size() && !m_records[i] && m_spillOffset[i] < 0,
+	      "MergeRecordStore::put: bad record " << i);
+
+  size_t sz = rec->memSize();
+  if (m_memUsed + sz > m_memLimit && openSpillFile()) {
+    off_t offset = -1;
+    if (fseeko(m_spillFs, 0, SEEK_END) == 0) {
+      offset = ftello(m_spillFs);
+    }
+    if (offset >= 0 && rec->fwrite(m_spillFs) == 0
+	&& fflush(m_spillFs) == 0) {
+      m_spillOffset[i] = offset;
+      m_numSpilled++;
+      delete rec;
+      return;
+    }
+
+    // e.g., the scratch file system is full: keep the rest in memory
+    DIAG_WMsgIf(1, "[" << m_myRank << "] unable to spill merge records to "
+		<< m_scratchDir << "; keeping them in memory");
+    m_spillFailed = true;
+    reopenSpillFile();
+  }
+
+  m_records[i] = rec;
+  m_memUsed += sz;
+}
+
+
+Prof::CCT::MergeRecord*
+MergeRecordStore::take(uint i)
+{
+  Prof::CCT::MergeRecord* rec = m_records[i];
+  if (rec) {
+    m_records[i] = NULL;
+    m_memUsed -= rec->memSize();
+    return rec;
+  }
+
+  if (m_spillOffset[i] >= 0) {
+    rec = new Prof::CCT::MergeRecord;
+    if (fseeko(m_spillFs, m_spillOffset[i], SEEK_SET) != 0
+	|| rec->fread(m_spillFs) != 0) {
+      delete rec;
+      DIAG_Throw("[" << m_myRank << "] unable to read back merge record "
+		 << i << " from " << m_scratchDir);
+    }
+    m_spillOffset[i] = -1;
+  }
+  return rec;
+}
+
+
+// openSpillFile: The spill file is unlinked as soon as it is created so
+// that it disappears with the process, however the process exits.
+bool
+MergeRecordStore::openSpillFile()
+{
+  if (m_spillFailed) {
+    return false;
+  }
+  if (m_spillFs) {
+    return true;
+  }
+
+  string fnm = m_scratchDir + "/hpcprof-records-"
+    + StrUtil::toStr(m_myRank) + "-XXXXXX";
+  std::vector<char> fnmBuf(fnm.begin(), fnm.end());
+  fnmBuf.push_back('\0');
+
+  int fd = mkstemp(&fnmBuf[0]);
+  if (fd >= 0) {
+    unlink(&fnmBuf[0]);
+    m_spillFs = fdopen(fd, "w+");
+    if (!m_spillFs) {
+      close(fd);
+    }
+  }
+
+  if (!m_spillFs) {
+    DIAG_WMsgIf(1, "[" << m_myRank << "] unable to create a scratch file in "
+		<< m_scratchDir << "; keeping merge records in memory");
+    m_spillFailed = true;
+    return false;
+  }
+  return true;
+}
+
+
+// reopenSpillFile: After a failed write, the stream may still buffer
+// part of a record that it cannot write out.  Records spilled so far
+// were flushed, so reopen the file read-only (dropping that buffer) to
+// keep reading them back; the file stays alive through the new
+// descriptor.
+void
+MergeRecordStore::reopenSpillFile()
+{
+  int fd = dup(fileno(m_spillFs));
+  fclose(m_spillFs);
+  m_spillFs = NULL;
+
+  if (m_numSpilled == 0) {
+    if (fd >= 0) {
+      close(fd);
+    }
+    return;
+  }
+
+  if (fd >= 0) {
+    m_spillFs = fdopen(fd, "r");
+    if (!m_spillFs) {
+      close(fd);
+    }
+  }
+  if (!m_spillFs) {
+    DIAG_Throw("[" << m_myRank << "] unable to reopen the scratch file in "
+	       << m_scratchDir << " holding " << m_numSpilled
+	       << " spilled merge records");
+  }
+}
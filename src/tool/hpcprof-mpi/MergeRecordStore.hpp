@@ -0,0 +1,140 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// File:
+//   $HeadURL$
+//
+// Purpose:
+//   Keeps one CCT::MergeRecord per profile file from the initial read
+//   through the summary and thread-level metric passes of hpcprof-mpi.
+//
+// Description:
+//   The initial read parses each profile once and notes how it merged
+//   into the local CCT in a MergeRecord.  Once the records refer to the
+//   canonical CCT, the summary and thread-level passes replay them
+//   instead of reading the profiles again.
+//   Records are kept in memory up to a budget; beyond it, they are
+//   spilled to an (unlinked) scratch file that is read back on demand.
+//
+//***************************************************************************
+
+#ifndef MergeRecordStore_hpp
+#define MergeRecordStore_hpp
+
+//************************* System Include Files ****************************
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <sys/types.h>
+
+//*************************** User Include Files ****************************
+
+#include <include/uint.h>
+
+#include <lib/prof/CCT-Merge.hpp>
+
+#include <lib/support/Unique.hpp>
+
+//*************************** Forward Declarations **************************
+
+//***************************************************************************
+// MergeRecordStore
+//***************************************************************************
+
+class MergeRecordStore
+  : public Prof::CCT::MergeRecordSink,
+    public Unique // prevent copying
+{
+public:
+  // 'memLimit' is in bytes; spill files are created in 'scratchDir'
+  MergeRecordStore(uint numRecords, size_t memLimit,
+		   const std::string& scratchDir, int myRank);
+
+  ~MergeRecordStore();
+
+  // put: take ownership of record 'i'
+  virtual void
+  put(uint i, Prof::CCT::MergeRecord* rec);
+
+  // take: return record 'i' (or NULL if there is none) and pass
+  //   ownership to the caller
+  Prof::CCT::MergeRecord*
+  take(uint i);
+
+  uint
+  numSpilled() const
+  { return m_numSpilled; }
+
+private:
+  bool
+  openSpillFile();
+
+  void
+  reopenSpillFile();
+
+private:
+  std::vector<Prof::CCT::MergeRecord*> m_records;
+  std::vector<off_t> m_spillOffset; // -1 if not spilled
+
+  size_t m_memLimit;
+  size_t m_memUsed;
+
+  std::string m_scratchDir;
+  int m_myRank;
+
+  FILE* m_spillFs;
+  bool m_spillFailed;
+  uint m_numSpilled;
+};
+
+
+//***************************************************************************
+
+#endif // MergeRecordStore_hpp
@@ -69,7 +69,10 @@
 using std::string;
 
 #include <algorithm>
+#include <unordered_map>
+#include <vector>
 
+#include <climits>
 #include <stdint.h>
 
 //*************************** User Include Files ****************************
@@ -105,6 +108,10 @@ packStringSet(const StringSet& profile,
 static StringSet*
 unpackStringSet(uint8_t* buffer, size_t bufferSz);
 
+static Prof::CallPath::Profile*
+mergeProfiles(uint8_t* buffer, const int* bufferSz, const int* bufferOff,
+	      int numProfiles, bool doMergeStats);
+
 //***************************************************************************
 // private functions
 //***************************************************************************
@@ -123,10 +130,336 @@ broadcast_sizet
 
 
 
+//***************************************************************************
+// sharded reduction
+//***************************************************************************
+
+// aim for about this many shards per rank when choosing the shard
+// depth: enough to spread the merge work without tiny messages
+static const uint ShardsPerRank = 4;
+
+// ShardOwnerMap: for each shard root, its owner; for each proper
+// ancestor of a shard root, the (sorted) owners of the shard roots
+// beneath it.  Nodes below shard roots are not mapped.
+typedef std::unordered_map<const Prof::CCT::ANode*, std::vector<int> >
+  ShardOwnerMap;
+
+struct ShardFilterArg {
+  const ShardOwnerMap* owners;
+  int shard;
+};
+
+
+// isInShard: CCT::ANodeFilter function selecting the nodes of one
+// shard.  N.B.: Profile::fmt_cct_fwrite() only asks about children of
+// selected nodes, so an unmapped node lies below a selected shard root.
+static bool
+isInShard(const Prof::CCT::ANode& n, long arg)
+{
+  const ShardFilterArg* shardArg = (const ShardFilterArg*)arg;
+  ShardOwnerMap::const_iterator it = shardArg->owners->find(&n);
+  if (it == shardArg->owners->end()) {
+    return true;
+  }
+  return std::binary_search(it->second.begin(), it->second.end(),
+			    shardArg->shard);
+}
+
+
+static uint64_t
+hashBytes(uint64_t hash, const void* data, size_t dataSz)
+{
+  // FNV-1a
+  const unsigned char* p = (const unsigned char*)data;
+  for (size_t i = 0; i < dataSz; ++i) {
+    hash ^= p[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+
+// hashCallPath: extends the hash of a call path with node 'n'.
+// N.B.: Nodes that CCT::ADynNode::isMergable() would merge must hash
+// alike on every rank, so use the load module's name rather than its
+// rank-local id.
+static uint64_t
+hashCallPath(uint64_t hash, const Prof::CCT::ANode* n,
+	     const Prof::LoadMap& loadmap)
+{
+  const Prof::CCT::ADynNode* n_dyn =
+    dynamic_cast<const Prof::CCT::ADynNode*>(n);
+  if (!n_dyn) {
+    return hash;
+  }
+
+  const std::string& lmName = loadmap.lm(n_dyn->lmId_real())->name();
+  VMA ip = n_dyn->lmIP_real();
+  char isLeaf = n_dyn->isLeaf();
+
+  hash = hashBytes(hash, lmName.c_str(), lmName.size() + 1);
+  hash = hashBytes(hash, &ip, sizeof(ip));
+  hash = hashBytes(hash, &isLeaf, sizeof(isLeaf));
+  return hash;
+}
+
+
+// chooseShardDepth: shards are rooted at the shallowest depth at which
+// some rank has ShardsPerRank nodes per rank (or at its deepest level)
+static int
+chooseShardDepth(const Prof::CallPath::Profile& profile, int numRanks,
+		 MPI_Comm comm)
+{
+  size_t numShards = (size_t)ShardsPerRank * numRanks;
+
+  int depth = 0;
+  std::vector<Prof::CCT::ANode*> level, nextLevel;
+  level.push_back(profile.cct()->root());
+
+  while (level.size() < numShards) {
+    nextLevel.clear();
+    for (uint i = 0; i < level.size(); ++i) {
+      for (Prof::CCT::ANodeChildIterator it(level[i]); it.Current(); ++it) {
+	nextLevel.push_back(it.current());
+      }
+    }
+    if (nextLevel.empty()) {
+      break;
+    }
+    level.swap(nextLevel);
+    depth++;
+  }
+
+  int shardDepth = 0;
+  MPI_Allreduce(&depth, &shardDepth, 1, MPI_INT, MPI_MAX, comm);
+  return shardDepth;
+}
+
+
+// makeShardOwners: shard roots are the nodes at 'shardDepth' and the
+// leaves above it.  Each is owned by the rank its call path hashes to.
+static void
+makeShardOwners(const Prof::CallPath::Profile& profile, int shardDepth,
+		int numRanks, ShardOwnerMap& owners)
+{
+  struct Frame {
+    Prof::CCT::ANode* node;
+    uint64_t hash;
+    int depth;
+  };
+
+  std::vector<Frame> stack;
+  Frame root = { profile.cct()->root(), 14695981039346656037ULL, 0 };
+  stack.push_back(root);
+
+  while (!stack.empty()) {
+    Frame f = stack.back();
+    stack.pop_back();
+
+    if (f.depth < shardDepth && !f.node->isLeaf()) {
+      for (Prof::CCT::ANodeChildIterator it(f.node); it.Current(); ++it) {
+	Prof::CCT::ANode* x = it.current();
+	Frame g = { x, hashCallPath(f.hash, x, *profile.loadmap()),
+		    f.depth + 1 };
+	stack.push_back(g);
+      }
+      continue;
+    }
+
+    int owner = (int)(f.hash % numRanks);
+    owners[f.node].push_back(owner);
+
+    // note the owner on the path to the root, stopping at the first
+    // ancestor that already has it
+    for (Prof::CCT::ANode* x = f.node->parent(); x; x = x->parent()) {
+      std::vector<int>& xOwners = owners[x];
+      std::vector<int>::iterator pos =
+	std::lower_bound(xOwners.begin(), xOwners.end(), owner);
+      if (pos != xOwners.end() && *pos == owner) {
+	break;
+      }
+      xOwners.insert(pos, owner);
+    }
+  }
+}
+
+
+// packShards: packs one shard per rank into 'buffer', shard i at
+// [bufferOff[i], bufferOff[i] + bufferSz[i])
+static void
+packShards(const Prof::CallPath::Profile& profile, int numRanks,
+	   const ShardOwnerMap& owners,
+	   uint8_t** buffer, size_t* bufferSz,
+	   std::vector<int>& shardSz, std::vector<int>& shardOff)
+{
+  // open_memstream: mallocs buffer and sets bufferSz
+  FILE* fs = open_memstream((char**)buffer, bufferSz);
+
+  uint wFlags = Prof::CallPath::Profile::WFlg_VirtualMetrics;
+  long prevOff = 0;
+
+  for (int shard = 0; shard < numRanks; ++shard) {
+    ShardFilterArg arg = { &owners, shard };
+    Prof::CCT::ANodeFilter filter(isInShard, "isInShard", (long)&arg);
+    Prof::CallPath::Profile::fmt_fwrite(profile, fs, wFlags, &filter);
+
+    long off = ftell(fs);
+    shardOff[shard] = (int)prevOff;
+    shardSz[shard] = (int)(off - prevOff);
+    prevOff = off;
+  }
+
+  fclose(fs);
+}
+
+
+// mergeProfiles: unpacks and merges, in order, the 'numProfiles'
+// profiles packed in 'buffer'.  If 'doMergeStats', perf event
+// statistics are summed over all profiles.
+static Prof::CallPath::Profile*
+mergeProfiles(uint8_t* buffer, const int* bufferSz, const int* bufferOff,
+	      int numProfiles, bool doMergeStats)
+{
+  int mergeTy = Prof::CallPath::Profile::Merge_MergeMetricByName;
+
+  Prof::CallPath::Profile* profile = NULL;
+  for (int i = 0; i < numProfiles; ++i) {
+    Prof::CallPath::Profile* y =
+      unpackProfile(buffer + bufferOff[i], (size_t)bufferSz[i]);
+    if (!profile) {
+      profile = y;
+      continue;
+    }
+
+    profile->merge(*y, mergeTy);
+    if (doMergeStats) {
+      profile->metricMgr()->mergePerfEventStatistics(y->metricMgr());
+    }
+    delete y;
+  }
+  return profile;
+}
+
+
 //***************************************************************************
 // interface functions
 //***************************************************************************
 
+Prof::CallPath::Profile*
+reduceSharded
+(
+  Prof::CallPath::Profile& profile,
+  int myRank,
+  int numRanks,
+  MPI_Comm comm
+)
+{
+  // -------------------------------------------------------
+  // 1. Split the local profile into one shard per owner.  Every shard
+  //    carries the full loadmap and metric table and the call paths
+  //    leading to its subtrees.
+  // -------------------------------------------------------
+  int shardDepth = chooseShardDepth(profile, numRanks, comm);
+
+  std::vector<int> sendSz(numRanks), sendOff(numRanks);
+  uint8_t* sendBuf = NULL;
+  size_t sendBufSz = 0;
+  {
+    ShardOwnerMap owners;
+    makeShardOwners(profile, shardDepth, numRanks, owners);
+    packShards(profile, numRanks, owners, &sendBuf, &sendBufSz,
+	       sendSz, sendOff);
+  }
+
+  // -------------------------------------------------------
+  // 2. Send each owner its shards and merge them in rank order.  Perf
+  //    event statistics are summed over all ranks, so every merged
+  //    shard carries the totals.
+  //    N.B.: MPI counts and offsets are ints, so no buffer may exceed
+  //    INT_MAX bytes; if one would at any rank, all ranks give up.
+  // -------------------------------------------------------
+  int isOk = (sendBufSz <= (size_t)INT_MAX);
+  if (!isOk) {
+    std::fill(sendSz.begin(), sendSz.end(), 0);
+  }
+
+  std::vector<int> recvSz(numRanks), recvOff(numRanks);
+  MPI_Alltoall(&sendSz[0], 1, MPI_INT, &recvSz[0], 1, MPI_INT, comm);
+
+  size_t recvBufSz = 0;
+  for (int i = 0; i < numRanks; ++i) {
+    recvOff[i] = (int)recvBufSz;
+    recvBufSz += recvSz[i];
+  }
+  isOk = isOk && (recvBufSz <= (size_t)INT_MAX);
+
+  int isOkAll = 0;
+  MPI_Allreduce(&isOk, &isOkAll, 1, MPI_INT, MPI_LAND, comm);
+  if (!isOkAll) {
+    free(sendBuf);
+    return NULL;
+  }
+
+  uint8_t* recvBuf = new uint8_t[recvBufSz];
+
+  MPI_Alltoallv(sendBuf, &sendSz[0], &sendOff[0], MPI_BYTE,
+		recvBuf, &recvSz[0], &recvOff[0], MPI_BYTE, comm);
+  free(sendBuf);
+
+  Prof::CallPath::Profile* shard =
+    mergeProfiles(recvBuf, &recvSz[0], &recvOff[0], numRanks, true);
+  delete[] recvBuf;
+
+  // -------------------------------------------------------
+  // 3. Gather all merged shards at every rank and merge them in owner
+  //    order; since every rank merges the same data in the same order,
+  //    all ranks obtain identical canonical profiles.
+  // -------------------------------------------------------
+  uint8_t* shardBuf = NULL;
+  size_t shardBufSz = 0;
+  packProfile(*shard, &shardBuf, &shardBufSz);
+  delete shard;
+
+  // N.B.: every rank sees all sizes (-1 if too large) and so makes the
+  // same decision
+  int shardSz = (shardBufSz <= (size_t)INT_MAX) ? (int)shardBufSz : -1;
+  std::vector<int> gatherSz(numRanks), gatherOff(numRanks);
+  MPI_Allgather(&shardSz, 1, MPI_INT, &gatherSz[0], 1, MPI_INT, comm);
+
+  size_t gatherBufSz = 0;
+  for (int i = 0; i < numRanks; ++i) {
+    if (gatherSz[i] < 0) {
+      gatherBufSz = (size_t)INT_MAX + 1;
+      break;
+    }
+    gatherOff[i] = (int)gatherBufSz;
+    gatherBufSz += gatherSz[i];
+  }
+  if (gatherBufSz > (size_t)INT_MAX) {
+    free(shardBuf);
+    return NULL;
+  }
+
+  uint8_t* gatherBuf = new uint8_t[gatherBufSz];
+
+  MPI_Allgatherv(shardBuf, shardSz, MPI_BYTE,
+		 gatherBuf, &gatherSz[0], &gatherOff[0], MPI_BYTE, comm);
+  free(shardBuf);
+
+  // N.B.: each merged shard already has the totals
+  Prof::CallPath::Profile* profGbl =
+    mergeProfiles(gatherBuf, &gatherSz[0], &gatherOff[0], numRanks, false);
+  delete[] gatherBuf;
+
+  if (DBG_CCT_MERGE) {
+    string pfx = "[" + StrUtil::toStr(myRank) + "]";
+    DIAG_DevMsgIf(1, profGbl->metricMgr()->toString(pfx.c_str()));
+  }
+
+  return profGbl;
+}
+
+
 void
 broadcast
 (
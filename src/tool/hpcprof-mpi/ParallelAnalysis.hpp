@@ -254,6 +254,26 @@ reduce(T object, int myRank, int numRanks, MPI_Comm comm = MPI_COMM_WORLD)
 }
 
 
+// ------------------------------------------------------------------------
+// reduceSharded: Reduces the profile at every rank into a canonical
+// profile that is returned at every rank, without funneling whole
+// profiles through rank 0 (an alternative to reduce() + broadcast()).
+//
+// CCT subtrees are assigned to owner ranks by hashing their call path.
+// Each rank sends each owner only that owner's shard of its profile;
+// each owner merges the shards it receives in rank order; and every
+// rank then assembles the canonical profile from all merged shards.
+// Metrics are merged in rank order; perf event statistics are merged
+// as for reduce().  Assumes 0-based ranks.
+//
+// Returns NULL at every rank, leaving 'profile' unchanged, if a
+// message would exceed the INT_MAX bytes that MPI counts can address.
+// ------------------------------------------------------------------------
+Prof::CallPath::Profile*
+reduceSharded(Prof::CallPath::Profile& profile, int myRank, int numRanks,
+	      MPI_Comm comm = MPI_COMM_WORLD);
+
+
 // ------------------------------------------------------------------------
 // broadcast: Broadcast the profile at the tree's root (rank 0) to every
 // other rank.  Assumes 0-based ranks.
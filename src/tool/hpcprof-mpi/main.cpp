@@ -68,6 +68,7 @@
 #include <typeinfo>
 #include <signal.h>
 #include <unistd.h>
+#include <fcntl.h> // open()
 
 #include <string>
 using std::string;
@@ -86,6 +87,7 @@ using std::vector;
 #include <include/uint.h>
 
 #include "Args.hpp"
+#include "MergeRecordStore.hpp"
 #include "ParallelAnalysis.hpp"
 
 #include <lib/analysis/CallPath.hpp>
@@ -119,15 +121,31 @@ makeSummaryMetrics(Prof::CallPath::Profile& profGbl,
 		   const Analysis::Args& args,
 		   const Analysis::Util::NormalizeProfileArgs_t& nArgs,
 		   const vector<uint>& groupIdToGroupSizeMap,
+		   MergeRecordStore& mrgRecords,
 		   int myRank, int numRanks);
 
 static void
 makeThreadMetrics(Prof::CallPath::Profile& profGbl,
 		  const Analysis::Args& args,
 		  const Analysis::Util::NormalizeProfileArgs_t& nArgs,
-		  const vector<uint>& groupIdToGroupSizeMap,
+		  MergeRecordStore& mrgRecords,
+		  const vector<Prof::CCT::ANode*>& summaryIdToNode,
 		  int myRank, int numRanks);
 
+static bool
+useShardedReduce();
+
+static MergeRecordStore*
+makeMergeRecordStore(uint numRecords, int myRank);
+
+static Prof::CallPath::Profile*
+copyProfile(const Prof::CallPath::Profile& prof);
+
+static void
+remapMergeRecords(Prof::CallPath::Profile& profGbl,
+		  Prof::CallPath::Profile& profLcl,
+		  MergeRecordStore& mrgRecords, uint numRecords);
+
 static uint
 makeDerivedMetricDescs(Prof::CallPath::Profile& profGbl,
 		       const Analysis::Args& args,
@@ -137,17 +155,24 @@ makeDerivedMetricDescs(Prof::CallPath::Profile& profGbl,
 		       const vector<uint>& groupIdToGroupSizeMap,
 		       int myRank);
 
+static bool
+writeMergedTrace(Prof::CallPath::Profile& profGbl, const Analysis::Args& args,
+		 int myRank, int numRanks);
+
 static void
 makeSummaryMetrics_Lcl(Prof::CallPath::Profile& profGbl,
-		       const string& profileFile,
-		       const Analysis::Args& args, uint groupId, uint groupMax,
+		       const Prof::CCT::MergeRecord& mrgRecord,
+		       const vector<Prof::CCT::ANode*>& idToNode,
+		       uint groupId,
 		       vector<VMAIntervalSet*>& groupIdToGroupMetricsMap,
 		       int myRank);
 
 static void
 makeThreadMetrics_Lcl(Prof::CallPath::Profile& profGbl,
+		      const Prof::CCT::MergeRecord& mrgRecord,
+		      const vector<Prof::CCT::ANode*>& summaryIdToNode,
 		      const string& profileFile,
-		      const Analysis::Args& args, uint groupId, uint groupMax,
+		      const Analysis::Args& args, uint groupId,
 		      int myRank);
 
 static string
@@ -155,7 +180,7 @@ makeDBFileName(const string& dbDir, uint groupId, const string& profileFile);
 
 static void
 writeMetricsDB(Prof::CallPath::Profile& profGbl, uint mBegId, uint mEndId,
-	       const string& metricDBFnm);
+	       const string& metricDBFnm, bool isSparse);
 
 
 static void
@@ -308,26 +333,60 @@ realmain(int argc, char* const* argv)
   Analysis::Util::UIntVec* groupMap =
     (nArgs.groupMax > 1) ? nArgs.groupMap : NULL;
 
-  profLcl = Analysis::CallPath::read(*nArgs.paths, groupMap, mergeTy, rFlags);
+  // N.B.: Each profile file is only read here; 'mrgRecords' notes how
+  // each merged into 'profLcl', including its metric values.
+  MergeRecordStore* mrgRecords =
+    makeMergeRecordStore(nArgs.paths->size(), myRank);
+
+  profLcl = Analysis::CallPath::read(*nArgs.paths, groupMap, mergeTy, rFlags,
+				     0, mrgRecords);
 
   // -------------------------------------------------------
   // 1b. Create canonical CCT (metrics merged by <group>.<name>.*)
   // -------------------------------------------------------
   Prof::CallPath::Profile* profGbl = NULL;
 
-  // Post-INVARIANT: rank 0's 'profLcl' is the canonical CCT.  Metrics
-  // are merged (and sorted by always merging left-child before right)
-  ParallelAnalysis::reduce(profLcl, myRank, numRanks);
+  if (useShardedReduce()) {
+    // Post-INVARIANT: 'profGbl' is the canonical CCT.  Metrics are
+    // merged (and sorted by merging in rank order)
+    profGbl = ParallelAnalysis::reduceSharded(*profLcl, myRank, numRanks);
 
-  ParallelAnalysis::reduce(&profLcl->directorySet(), myRank, numRanks);
+    if (profGbl) {
+      ParallelAnalysis::reduce(&profLcl->directorySet(), myRank, numRanks);
 
-  if (myRank == 0) {
-    profGbl = profLcl;
-    profLcl = NULL;
+      if (myRank == 0) {
+	profGbl->copyDirectory(profLcl->directorySet());
+      }
+    }
+    else if (myRank == 0) {
+      DIAG_WMsgIf(1, "HPCPROF_REDUCE=shard: shards exceed the 2 GB MPI "
+		  "message limit; reducing through rank 0 instead");
+    }
   }
 
-  // Post-INVARIANT: 'profGbl' is the canonical CCT
-  ParallelAnalysis::broadcast(profGbl, myRank);
+  if (!profGbl) {
+    // N.B.: Other ranks only add nodes to 'profLcl' while reducing.
+    // Rank 0 reduces into a copy so that 'profLcl' keeps the nodes that
+    // 'mrgRecords' refers to.
+    Prof::CallPath::Profile* profRdc = profLcl;
+    if (myRank == 0) {
+      profRdc = copyProfile(*profLcl);
+    }
+
+    // Post-INVARIANT: rank 0's 'profRdc' is the canonical CCT.  Metrics
+    // are merged (and sorted by always merging left-child before right)
+    ParallelAnalysis::reduce(profRdc, myRank, numRanks);
+
+    ParallelAnalysis::reduce(&profLcl->directorySet(), myRank, numRanks);
+
+    if (myRank == 0) {
+      profGbl = profRdc;
+      profGbl->copyDirectory(profLcl->directorySet());
+    }
+
+    // Post-INVARIANT: 'profGbl' is the canonical CCT
+    ParallelAnalysis::broadcast(profGbl, myRank);
+  }
 
   if (myRank == 0) {
     profGbl->metricMgr()->mergePerfEventStatistics_finalize(numRanks - 1);
@@ -335,8 +394,6 @@ realmain(int argc, char* const* argv)
 
   ParallelAnalysis::broadcast(profGbl->directorySet(), myRank);
 
-  delete profLcl;
-
   // -------------------------------------------------------
   // 1c. Add static structure to canonical CCT; form dense node ids
   //
@@ -344,6 +401,18 @@ realmain(int argc, char* const* argv)
   // ids; corresponding nodes have idential ids.
   // -------------------------------------------------------
 
+  // N.B.: Rank 0 writes missing binary copies of structure files before
+  // any rank reads structure so that every rank reads the same files.
+  // Making a copy creates (and deletes) structure nodes on rank 0 only;
+  // this shifts the ids of later nodes uniformly, which preserves their
+  // order.
+  if (args.structureCache && !args.structureFiles.empty()) {
+    if (myRank == 0) {
+      Analysis::CallPath::makeStructureCache(args);
+    }
+    MPI_Barrier(MPI_COMM_WORLD);
+  }
+
   Prof::Struct::Tree* structure = new Prof::Struct::Tree("");
   if (!args.structureFiles.empty()) {
     Analysis::CallPath::readStructure(structure, args);
@@ -361,13 +430,23 @@ realmain(int argc, char* const* argv)
   // N.B.: Dense ids are assigned w.r.t. Prof::CCT::...::cmpByStructureInfo()
   profGbl->cct()->makeDensePreorderIds();
 
+  // -------------------------------------------------------
+  // 1d. Refer merge records to canonical CCT
+  //
+  // Post-INVARIANT: 'mrgRecords' notes how each local profile merges
+  // into 'profGbl'
+  // -------------------------------------------------------
+  remapMergeRecords(*profGbl, *profLcl, *mrgRecords, nArgs.paths->size());
+
+  delete profLcl;
+
   // -------------------------------------------------------
   // 2a. Create summary metrics for canonical CCT
   //
   // Post-INVARIANT: rank 0's 'profGbl' contains summary metrics
   // -------------------------------------------------------
   makeSummaryMetrics(*profGbl, args, nArgs, groupIdToGroupSizeMap,
-		     myRank, numRanks);
+		     *mrgRecords, myRank, numRanks);
 
   // -------------------------------------------------------
   // 2b. Prune and normalize canonical CCT
@@ -379,8 +458,9 @@ realmain(int argc, char* const* argv)
 
   if (myRank == 0) {
     // Disable pruning when making a metric database because it causes
-    // makeThreadMetrics_Lcl(), which uses CCT::MrgFlg_CCTMergeOnly,
-    // to under-compute values for thread-level metrics.
+    // makeThreadMetrics_Lcl(), which skips pruned nodes (cf.
+    // CCT::MrgFlg_CCTMergeOnly), to under-compute values for
+    // thread-level metrics.
     if (!args.db_makeMetricDB) {
       Analysis::CallPath::pruneBySummaryMetrics(*profGbl, prunedNodes);
     }
@@ -400,14 +480,27 @@ realmain(int argc, char* const* argv)
     Analysis::CallPath::applySummaryMetricAgents(*profGbl, args.agent);
   }
 
+  // Before renumbering, note the surviving nodes by the ids that
+  // 'mrgRecords' refers to.
+  vector<Prof::CCT::ANode*> summaryIdToNode(prunedNodesSz, NULL);
+  for (Prof::CCT::ANodeIterator it(profGbl->cct()->root());
+       it.Current(); ++it) {
+    Prof::CCT::ANode* n = it.current();
+    if (n->id() < prunedNodesSz) {
+      summaryIdToNode[n->id()] = n;
+    }
+  }
+
   // N.B.: Dense ids are assigned w.r.t. Prof::CCT::...::cmpByStructureInfo()
   profGbl->cct()->makeDensePreorderIds();
 
   // -------------------------------------------------------
   // 2c. Create thread-level metric DB // Normalize trace files
   // -------------------------------------------------------
-  makeThreadMetrics(*profGbl, args, nArgs, groupIdToGroupSizeMap,
+  makeThreadMetrics(*profGbl, args, nArgs, *mrgRecords, summaryIdToNode,
 		    myRank, numRanks);
+
+  delete mrgRecords;
   
   // ------------------------------------------------------------
   // 3. Generate Experiment database
@@ -416,6 +509,14 @@ realmain(int argc, char* const* argv)
 
   Analysis::CallPath::pruneStructTree(*profGbl);
 
+  // All ranks write their trace files into experiment.mt together; if
+  // that fails, each rank copies its own trace files instead.  Rank 0
+  // keeps its trace file names either way: experiment.xml lists the
+  // trace database only if there are some.
+  args.db_traceFilesWritten =
+    writeMergedTrace(*profGbl, args, myRank, numRanks);
+  args.db_mergeTraceFiles = false;
+
   if (myRank == 0) {
     if (args.title.empty()) {
       args.title = profGbl->name();
@@ -424,10 +525,11 @@ realmain(int argc, char* const* argv)
     if (!args.db_makeMetricDB) {
       profGbl->metricMgr()->zeroDBInfo();
     }
+    profGbl->isMetricDBSparse(args.db_sparseMetricDB);
 
     Analysis::CallPath::makeDatabase(*profGbl, args);
   }
-  else {
+  else if (!args.db_traceFilesWritten) {
     Analysis::Util::copyTraceFiles(args.db_dir, profGbl->traceFileNameSet());
   }
 
@@ -571,6 +673,7 @@ makeSummaryMetrics(Prof::CallPath::Profile& profGbl,
 		   const Analysis::Args& args,
 		   const Analysis::Util::NormalizeProfileArgs_t& nArgs,
 		   const vector<uint>& groupIdToGroupSizeMap,
+		   MergeRecordStore& mrgRecords,
 		   int myRank, int numRanks)
 {
   uint mDrvdBeg = 0, mDrvdEnd = 0;   // [ )
@@ -586,6 +689,13 @@ makeSummaryMetrics(Prof::CallPath::Profile& profGbl,
   Prof::Metric::Mgr& mMgrGbl = *profGbl.metricMgr();
   Prof::CCT::ANode* cctRoot = profGbl.cct()->root();
 
+  // the nodes of 'profGbl' by the (dense) ids that 'mrgRecords' refers to
+  vector<Prof::CCT::ANode*> idToNode(profGbl.cct()->maxDenseId() + 1, NULL);
+  for (Prof::CCT::ANodeIterator it(cctRoot); it.Current(); ++it) {
+    Prof::CCT::ANode* n = it.current();
+    idToNode[n->id()] = n;
+  }
+
   // -------------------------------------------------------
   // compute local contribution summary metrics (accumulate function)
   // -------------------------------------------------------
@@ -593,10 +703,11 @@ makeSummaryMetrics(Prof::CallPath::Profile& profGbl,
 			      Prof::Metric::AExprIncr::FnInit);
 
   for (uint i = 0; i < nArgs.paths->size(); ++i) {
-    const string& fnm = (*nArgs.paths)[i];
     uint groupId = (*nArgs.groupMap)[i];
-    makeSummaryMetrics_Lcl(profGbl, fnm, args, groupId, nArgs.groupMax,
+    Prof::CCT::MergeRecord* mrgRecord = mrgRecords.take(i);
+    makeSummaryMetrics_Lcl(profGbl, *mrgRecord, idToNode, groupId,
 			   groupIdToGroupMetricsMap, myRank);
+    mrgRecords.put(i, mrgRecord);
   }
 
   // -------------------------------------------------------
@@ -660,17 +771,283 @@ static void
 makeThreadMetrics(Prof::CallPath::Profile& profGbl,
 		  const Analysis::Args& args,
 		  const Analysis::Util::NormalizeProfileArgs_t& nArgs,
-		  const vector<uint>& groupIdToGroupSizeMap,
+		  MergeRecordStore& mrgRecords,
+		  const vector<Prof::CCT::ANode*>& summaryIdToNode,
 		  int myRank, int numRanks)
 {
   for (uint i = 0; i < nArgs.paths->size(); ++i) {
     string& fnm = (*nArgs.paths)[i];
     uint groupId = (*nArgs.groupMap)[i];
-    makeThreadMetrics_Lcl(profGbl, fnm, args, groupId, nArgs.groupMax, myRank);
+    Prof::CCT::MergeRecord* mrgRecord = mrgRecords.take(i);
+    makeThreadMetrics_Lcl(profGbl, *mrgRecord, summaryIdToNode, fnm, args,
+			  groupId, myRank);
+    delete mrgRecord;
+  }
+}
+
+
+// useShardedReduce: The canonical CCT is formed with
+// ParallelAnalysis::reduceSharded() if HPCPROF_REDUCE is 'shard' and
+// otherwise with the reduction through rank 0.
+static bool
+useShardedReduce()
+{
+  const char* str = getenv("HPCPROF_REDUCE");
+  return (str && strcmp(str, "shard") == 0);
+}
+
+
+// makeMergeRecordStore: Merge records are kept in memory up to
+// HPCPROF_RECORD_MEM megabytes per rank (default 1024) and spilled
+// beyond that to HPCPROF_SCRATCH, TMPDIR or /tmp, in that order.
+static MergeRecordStore*
+makeMergeRecordStore(uint numRecords, int myRank)
+{
+  size_t memLimitMB = 1024;
+  const char* str = getenv("HPCPROF_RECORD_MEM");
+  if (str && strlen(str) > 0) {
+    memLimitMB = strtoul(str, NULL, 10);
+  }
+
+  const char* scratchDir = getenv("HPCPROF_SCRATCH");
+  if (!scratchDir || strlen(scratchDir) == 0) {
+    scratchDir = getenv("TMPDIR");
+  }
+  if (!scratchDir || strlen(scratchDir) == 0) {
+    scratchDir = "/tmp";
+  }
+
+  return new MergeRecordStore(numRecords, memLimitMB << 20, scratchDir,
+			      myRank);
+}
+
+
+// copyProfile: returns a copy of 'prof' with virtual metrics and
+// without directories (cf. ParallelAnalysis::packProfile())
+static Prof::CallPath::Profile*
+copyProfile(const Prof::CallPath::Profile& prof)
+{
+  uint8_t* buf = NULL;
+  size_t bufSz = 0;
+  ParallelAnalysis::packProfile(prof, &buf, &bufSz);
+
+  Prof::CallPath::Profile* copy = ParallelAnalysis::unpackProfile(buf, bufSz);
+  free(buf);
+
+  return copy;
+}
+
+
+// remapMergeRecords: 'mrgRecords' notes how each local profile merged
+// into the local CCT 'profLcl'.  Matches 'profLcl' with the canonical
+// CCT 'profGbl' (with structure and with dense ids) and makes each
+// record refer to the nodes and metrics of 'profGbl' instead, so that
+// the profiles need not be read again.
+// N.B.: changes the leaves and load module ids of 'profLcl'
+static void
+remapMergeRecords(Prof::CallPath::Profile& profGbl,
+		  Prof::CallPath::Profile& profLcl,
+		  MergeRecordStore& mrgRecords, uint numRecords)
+{
+  // Add *some* structure information to the leaves of 'profLcl' so that
+  // it will be matched successfully with the structured canonical CCT
+  // 'profGbl'.
+  //
+  // Background: When CCT::Stmts are merged in
+  // Analysis::CallPath::coalesceStmts(CallPath::Profile), IP/LIP
+  // information is not retained.  This means that when matching
+  // 'profLcl' with 'profGbl', many leaves in 'profLcl' will not find
+  // their corresponding node in 'profGbl' unless corrective measures
+  // are taken.
+  profLcl.structure(profGbl.structure());
+  Analysis::CallPath::noteStaticStructureOnLeaves(profLcl);
+  profLcl.structure(NULL);
+
+  Prof::CCT::NodeIdMap lclIdToGblId;
+  profGbl.match(profLcl, lclIdToGblId);
+
+  const Prof::Metric::Mgr* mMgrLcl = profLcl.metricMgr();
+  const Prof::Metric::Mgr* mMgrGbl = profGbl.metricMgr();
+
+  for (uint i = 0; i < numRecords; ++i) {
+    Prof::CCT::MergeRecord* mrgRecord = mrgRecords.take(i);
+    if (!mrgRecord) {
+      continue;
+    }
+
+    // nodes of 'profLcl' that have no counterpart are skipped, as by
+    // CCT::MrgFlg_AssertCCTMergeOnly
+    mrgRecord->remapX(lclIdToGblId);
+
+    // find the profile's metrics in 'profGbl' (cf. Profile::merge())
+    Prof::Metric::Mgr mMgr;
+    for (uint mId = 0; mId < mrgRecord->numMetrics(); ++mId) {
+      uint mIdLcl = mrgRecord->metricBegIdx() + mId;
+      mMgr.insert(mMgrLcl->metric(mIdLcl)->clone());
+    }
+
+    uint mBeg = (mMgr.size() > 0) ? mMgrGbl->findGroup(mMgr) : 0;
+    DIAG_Assert(mBeg != Prof::Metric::Mgr::npos,
+		"remapMergeRecords: profile metrics not in canonical profile");
+    mrgRecord->metricBegIdx(mBeg);
+
+    mrgRecords.put(i, mrgRecord);
   }
 }
 
 
+// writeMergedTrace: writes the trace files of all ranks into the
+// database's merged trace file.  The root lays the file out from every
+// rank's trace file names and sizes and writes its header; each rank then
+// writes its own trace files at their offsets.  Returns true on all ranks
+// if the merged file is complete; otherwise no merged file is left.
+static bool
+writeMergedTrace(Prof::CallPath::Profile& profGbl, const Analysis::Args& args,
+		 int myRank, int numRanks)
+{
+  using Analysis::Util::MergedTraceFileVec;
+
+  const string traceFnm = args.db_dir + "/" + Analysis_OUT_DB_TRACE;
+
+  MergedTraceFileVec files;
+  Analysis::Util::getMergedTraceFiles(profGbl.traceFileNameSet(), files);
+
+  // -------------------------------------------------------
+  // gather trace file names and sizes at the root
+  // -------------------------------------------------------
+
+  string namesBuf;
+  uint64_t* sizesBuf = new uint64_t[files.size()];
+  for (uint i = 0; i < files.size(); ++i) {
+    namesBuf += files[i].name;
+    namesBuf += '\0';
+    sizesBuf[i] = files[i].size;
+  }
+
+  int myCounts[2] = { (int)files.size(), (int)namesBuf.size() };
+  int* counts = new int[2 * numRanks];
+  MPI_Gather((void*)myCounts, 2, MPI_INT, (void*)counts, 2, MPI_INT,
+	     0, MPI_COMM_WORLD);
+
+  int* fileCounts = new int[numRanks];
+  int* fileDispls = new int[numRanks];
+  int* namesCounts = new int[numRanks];
+  int* namesDispls = new int[numRanks];
+  int numFiles = 0, namesSz = 0;
+  if (myRank == 0) {
+    for (int r = 0; r < numRanks; ++r) {
+      fileCounts[r] = counts[2 * r];
+      fileDispls[r] = numFiles;
+      numFiles += fileCounts[r];
+      namesCounts[r] = counts[2 * r + 1];
+      namesDispls[r] = namesSz;
+      namesSz += namesCounts[r];
+    }
+  }
+
+  char* allNames = new char[namesSz];
+  uint64_t* allSizes = new uint64_t[numFiles];
+  MPI_Gatherv((void*)namesBuf.data(), myCounts[1], MPI_CHAR,
+	      (void*)allNames, namesCounts, namesDispls, MPI_CHAR,
+	      0, MPI_COMM_WORLD);
+  MPI_Gatherv((void*)sizesBuf, myCounts[0], MPI_UNSIGNED_LONG_LONG,
+	      (void*)allSizes, fileCounts, fileDispls, MPI_UNSIGNED_LONG_LONG,
+	      0, MPI_COMM_WORLD);
+
+  // -------------------------------------------------------
+  // root lays out the merged file and writes its header
+  // -------------------------------------------------------
+
+  MergedTraceFileVec allFiles;
+  uint64_t mergedSize = 0;
+  uint64_t* allOffsets = new uint64_t[numFiles];
+  int ok = 0;
+  if (myRank == 0 && numFiles > 0) {
+    allFiles.resize(numFiles);
+    for (int i = 0, j = 0; i < numFiles; ++i) {
+      allFiles[i].name = &allNames[j];
+      allFiles[i].size = allSizes[i];
+      j += allFiles[i].name.length() + 1;
+    }
+    mergedSize = Analysis::Util::layoutMergedTrace(allFiles);
+    for (int i = 0; i < numFiles; ++i) {
+      allOffsets[i] = allFiles[i].offset;
+    }
+
+    DIAG_Msg(1, "Merging " << numFiles << " trace files: " << traceFnm);
+
+    int fd = open(traceFnm.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd >= 0) {
+      ok = Analysis::Util::writeMergedTraceHeader(fd, allFiles);
+      ok = (close(fd) == 0) && ok;
+    }
+    if (!ok) {
+      DIAG_EMsg("While merging trace files: could not create '" << traceFnm << "'");
+    }
+  }
+
+  MPI_Bcast((void*)&ok, 1, MPI_INT, 0, MPI_COMM_WORLD);
+
+  // -------------------------------------------------------
+  // each rank writes its own trace files
+  // -------------------------------------------------------
+
+  if (ok) {
+    uint64_t* offsetsBuf = new uint64_t[files.size()];
+    MPI_Scatterv((void*)allOffsets, fileCounts, fileDispls,
+		 MPI_UNSIGNED_LONG_LONG,
+		 (void*)offsetsBuf, myCounts[0], MPI_UNSIGNED_LONG_LONG,
+		 0, MPI_COMM_WORLD);
+    for (uint i = 0; i < files.size(); ++i) {
+      files[i].offset = offsetsBuf[i];
+    }
+    delete[] offsetsBuf;
+
+    int myOk = 0;
+    int fd = open(traceFnm.c_str(), O_WRONLY);
+    if (fd >= 0) {
+      myOk = Analysis::Util::writeMergedTraceFiles(fd, files);
+      myOk = (close(fd) == 0) && myOk;
+    }
+
+    MPI_Allreduce((void*)&myOk, (void*)&ok, 1, MPI_INT, MPI_LAND,
+		  MPI_COMM_WORLD);
+
+    // the end marker goes last: it marks the merged file as complete
+    if (myRank == 0) {
+      if (ok) {
+	int fd = open(traceFnm.c_str(), O_WRONLY);
+	ok = (fd >= 0
+	      && Analysis::Util::writeMergedTraceMarker(fd, mergedSize));
+	ok = (fd >= 0 && close(fd) == 0) && ok;
+      }
+      if (!ok) {
+	DIAG_EMsg("While merging trace files: could not write '" << traceFnm << "'; copying them instead");
+	FileUtil::remove(traceFnm.c_str());
+      }
+    }
+    MPI_Bcast((void*)&ok, 1, MPI_INT, 0, MPI_COMM_WORLD);
+
+    if (ok) {
+      Analysis::Util::removeMergedTraceTmpFiles(files);
+      Analysis::Util::copyUnmergedTraceFiles(args.db_dir, files);
+    }
+  }
+
+  delete[] sizesBuf;
+  delete[] counts;
+  delete[] fileCounts;
+  delete[] fileDispls;
+  delete[] namesCounts;
+  delete[] namesDispls;
+  delete[] allNames;
+  delete[] allSizes;
+  delete[] allOffsets;
+
+  return ok;
+}
+
+
 static uint
 makeDerivedMetricDescs(Prof::CallPath::Profile& profGbl,
 		       const Analysis::Args& args,
@@ -769,13 +1146,15 @@ makeDerivedMetricDescs(Prof::CallPath::Profile& profGbl,
 // - each thread-level CCT is always a subset of 'profGbl' (the
 //   canonical CCT); in other words, 'profGbl' should not be pruned
 //   in any way!
-// - 'args' contains the correct final experiment database.
+// - 'mrgRecord' notes how one profile file merges into 'profGbl'
+//   (cf. remapMergeRecords()); 'idToNode' maps canonical ids to nodes.
 //
 // FIXME: abstract between makeSummaryMetrics_Lcl() & makeThreadMetrics_Lcl()
 static void
 makeSummaryMetrics_Lcl(Prof::CallPath::Profile& profGbl,
-		       const string& profileFile,
-		       const Analysis::Args& args, uint groupId, uint groupMax,
+		       const Prof::CCT::MergeRecord& mrgRecord,
+		       const vector<Prof::CCT::ANode*>& idToNode,
+		       uint groupId,
 		       vector<VMAIntervalSet*>& groupIdToGroupMetricsMap,
 		       int myRank)
 {
@@ -783,38 +1162,13 @@ makeSummaryMetrics_Lcl(Prof::CallPath::Profile& profGbl,
   Prof::CCT::Tree* cctGbl = profGbl.cct();
   Prof::CCT::ANode* cctRootGbl = cctGbl->root();
 
-  // -------------------------------------------------------
-  // read profile file
-  // -------------------------------------------------------
-  uint rFlags = (Prof::CallPath::Profile::RFlg_NoMetricSfx
-		 | Prof::CallPath::Profile::RFlg_MakeInclExcl);
-  uint rGroupId = (groupMax > 1) ? groupId : 0;
-
-  Prof::CallPath::Profile* prof =
-    Analysis::CallPath::read(profileFile, rGroupId, rFlags);
-
   // -------------------------------------------------------
   // merge into canonical CCT
   // -------------------------------------------------------
-  int mergeTy  = Prof::CallPath::Profile::Merge_MergeMetricByName;
   int mergeFlg = (Prof::CCT::MrgFlg_AssertCCTMergeOnly);
 
-  // Add *some* structure information to the leaves of 'prof' so that
-  // it will be merged successfully with the structured canonical CCT
-  // 'profGbl'.
-  //
-  // Background: When CCT::Stmts are merged in
-  // Analysis::CallPath::coalesceStmts(CallPath::Profile), IP/LIP
-  // information is not retained.  This means that when merging 'prof'
-  // into 'profGbl' (using CallPath::Profile::merge()), many leaves in
-  // 'prof' will not find their corresponding node in 'profGbl' unless
-  // corrective measures are taken.
-  prof->structure(profGbl.structure());
-  Analysis::CallPath::noteStaticStructureOnLeaves(*prof);
-  prof->structure(NULL);
-
-  uint mBeg = profGbl.merge(*prof, mergeTy, mergeFlg); // [closed begin
-  uint mEnd = mBeg + prof->metricMgr()->size();        //  open end)
+  uint mBeg = profGbl.replay(mrgRecord, idToNode, mergeFlg); // [closed begin
+  uint mEnd = mBeg + mrgRecord.numMetrics();                  //  open end)
 
   // -------------------------------------------------------
   // compute local incl/excl sampled metrics and update local derived metrics
@@ -855,28 +1209,27 @@ makeSummaryMetrics_Lcl(Prof::CallPath::Profile& profGbl,
   // reinitialize metric values for next time
   // -------------------------------------------------------
 
-  // TODO: This really should (a) come immediately after the MetricMgr
-  // merge above and (b) use FnInitSrc (not 0).  However, to do this
-  // we would need to (a) split the MetricMgr merge and CCT merge into
-  // two; and (b) use a CCT init (which whould initialize using
-  // assignment) instead of CCT::merge() (which initializes based on
+  // TODO: This really should use FnInitSrc (not 0).  However, to do
+  // this we would need a CCT init (which whould initialize using
+  // assignment) instead of CCT::replay() (which initializes based on
   // addition against 0).
   cctRootGbl->zeroMetricsDeep(mBeg, mEnd); // cf. FnInitSrc
-  
-  delete prof;
 }
 
 
 // makeThreadMetrics_Lcl: Make thread-level metric database.
 //
 // Makes same assumptions as makeSummaryMetrics_Lcl but with one key
-// exception: Each thread-level CCT does not have to be a subset of
-// 'profGbl' (the canonical CCT); in other words, 'profGbl' may be
-// pruned.
+// exception: 'profGbl' (the canonical CCT) may have been pruned and
+// normalized since.  Replays the merge of 'profileFile' noted in
+// 'mrgRecord', where 'summaryIdToNode' maps the node ids that
+// makeSummaryMetrics_Lcl() used to the surviving nodes of 'profGbl'.
 static void
 makeThreadMetrics_Lcl(Prof::CallPath::Profile& profGbl,
+		      const Prof::CCT::MergeRecord& mrgRecord,
+		      const vector<Prof::CCT::ANode*>& summaryIdToNode,
 		      const string& profileFile,
-		      const Analysis::Args& args, uint groupId, uint groupMax,
+		      const Analysis::Args& args, uint groupId,
 		      int myRank)
 {
   Prof::Metric::Mgr* mMgrGbl = profGbl.metricMgr();
@@ -884,40 +1237,15 @@ makeThreadMetrics_Lcl(Prof::CallPath::Profile& profGbl,
   Prof::CCT::ANode* cctRootGbl = cctGbl->root();
 
   // -------------------------------------------------------
-  // read profile file
+  // merge into canonical CCT (and normalize the trace file)
   // -------------------------------------------------------
-  uint rFlags = (Prof::CallPath::Profile::RFlg_NoMetricSfx
-		 | Prof::CallPath::Profile::RFlg_MakeInclExcl);
-  uint rGroupId = (groupMax > 1) ? groupId : 0;
-
-  Prof::CallPath::Profile* prof =
-    Analysis::CallPath::read(profileFile, rGroupId, rFlags);
-
-  // -------------------------------------------------------
-  // merge into canonical CCT
-  // -------------------------------------------------------
-  int mergeTy  = Prof::CallPath::Profile::Merge_MergeMetricByName;
   int mergeFlg = (Prof::CCT::MrgFlg_NormalizeTraceFileY
 		  | Prof::CCT::MrgFlg_CCTMergeOnly);
 
-  // Add *some* structure information to the leaves of 'prof' so that
-  // it will be merged successfully with the structured canonical CCT
-  // 'profGbl'.
-  //
-  // Background: When CCT::Stmts are merged in
-  // Analysis::CallPath::coalesceStmts(CallPath::Profile), IP/LIP
-  // information is not retained.  This means that when merging 'prof'
-  // into 'profGbl' (using CallPath::Profile::merge()), many leaves in
-  // 'prof' will not find their corresponding node in 'profGbl' unless
-  // corrective measures are taken.
-  prof->structure(profGbl.structure());
-  Analysis::CallPath::noteStaticStructureOnLeaves(*prof);
-  prof->structure(NULL);
-
-  uint mBeg = profGbl.merge(*prof, mergeTy, mergeFlg); // [closed begin
+  uint mBeg = profGbl.replay(mrgRecord, summaryIdToNode, mergeFlg); // [closed begin
 
   if (args.db_makeMetricDB) {
-    uint mEnd = mBeg + prof->metricMgr()->size(); // open end)
+    uint mEnd = mBeg + mrgRecord.numMetrics(); // open end)
 
     // -------------------------------------------------------
     // compute local incl/excl sampled metrics
@@ -944,7 +1272,7 @@ makeThreadMetrics_Lcl(Prof::CallPath::Profile& profGbl,
     // -------------------------------------------------------
 
     string dbFnm = makeDBFileName(args.db_dir, groupId, profileFile);
-    writeMetricsDB(profGbl, mBeg, mEnd, dbFnm);
+    writeMetricsDB(profGbl, mBeg, mEnd, dbFnm, args.db_sparseMetricDB);
 
     // -------------------------------------------------------
     // reinitialize metric values for next time
@@ -953,8 +1281,6 @@ makeThreadMetrics_Lcl(Prof::CallPath::Profile& profGbl,
     // TODO: see corresponding comments in makeSummaryMetrics_Lcl()
     cctRootGbl->zeroMetricsDeep(mBeg, mEnd); // cf. FnInitSrc
   }
-
-  delete prof;
 }
 
 
@@ -972,10 +1298,49 @@ makeDBFileName(const string& dbDir, uint groupId, const string& profileFile)
 }
 
 
+// MetricDBBuffer: accumulates encoded metric-db data so that it
+// reaches the file in large blocks rather than one value at a time.
+class MetricDBBuffer {
+public:
+  MetricDBBuffer(FILE* fs)
+    : m_fs(fs), m_len(0)
+  { }
+
+  // returns a pointer to 'n' bytes to be filled in, or NULL on a
+  // write error
+  uint8_t*
+  reserve(size_t n)
+  {
+    if (m_len + n > BufSz && !flush()) {
+      return NULL;
+    }
+    uint8_t* p = m_buf + m_len;
+    m_len += n;
+    return p;
+  }
+
+  bool
+  flush()
+  {
+    size_t nw = fwrite(m_buf, 1, m_len, m_fs);
+    bool ok = (nw == m_len);
+    m_len = 0;
+    return ok;
+  }
+
+private:
+  static const size_t BufSz = 1 << 20;
+
+  FILE* m_fs;
+  size_t m_len;
+  uint8_t m_buf[BufSz];
+};
+
+
 // [mBegId, mEndId)
 static void
 writeMetricsDB(Prof::CallPath::Profile& profGbl, uint mBegId, uint mEndId,
-	       const string& metricDBFnm)
+	       const string& metricDBFnm, bool isSparse)
 {
   const Prof::CCT::Tree& cct = *(profGbl.cct());
 
@@ -1006,11 +1371,16 @@ writeMetricsDB(Prof::CallPath::Profile& profGbl, uint mBegId, uint mEndId,
   DIAG_MsgIf(0, "writeMetricsDB: " << metricDBFnm);
 
   uint numNodes = packedMetrics.numNodes() - 1;
+  uint numMetrics = mEndId - mBegId; // [mBegId mEndId)
+
+  MetricDBBuffer* buf = new MetricDBBuffer(fs);
+  uint8_t* p;
 
   // 1. header
   hpcmetricDB_fmt_hdr_t hdr;
   hdr.numNodes = numNodes;
-  hdr.numMetrics = mEndId - mBegId; // [mBegId mEndId)
+  hdr.numMetrics = numMetrics;
+  hdr.flags = (isSparse) ? HPCMETRICDB_FMT_FLAG_Sparse : 0;
 
   int ret;
   ret = hpcmetricDB_fmt_hdr_fwrite(&hdr, fs);
@@ -1021,15 +1391,45 @@ writeMetricsDB(Prof::CallPath::Profile& profGbl, uint mBegId, uint mEndId,
   //    - first column corresponds to first sampled metric.
   // cf. ParallelAnalysis::unpackMetrics: 
 
-  for (uint nodeId = 1; nodeId < numNodes + 1; ++nodeId) {
-    for (uint mId1 = 0, mId2 = mBegId; mId2 < mEndId; ++mId1, ++mId2) {
-      double mval = packedMetrics.idx(nodeId, mId1);
-      DIAG_MsgIf(0,  "  " << nodeId << " -> " << mval);
-      ret = hpcfmt_real8_fwrite(mval, fs);
-      if (ret == HPCFMT_ERR) goto badwrite;
+  if (!isSparse) {
+    for (uint nodeId = 1; nodeId < numNodes + 1; ++nodeId) {
+      for (uint mId1 = 0; mId1 < numMetrics; ++mId1) {
+	double mval = packedMetrics.idx(nodeId, mId1);
+	DIAG_MsgIf(0,  "  " << nodeId << " -> " << mval);
+	if (!(p = buf->reserve(sizeof(double)))) goto badwrite;
+	hpcfmt_real8_encode(mval, p);
+      }
+    }
+  }
+  else {
+    // row index: number of non-zero values before each node's ...
+    uint64_t nnz = 0;
+    if (!(p = buf->reserve(HPCMETRICDB_FMT_SparseIdxLen))) goto badwrite;
+    hpcfmt_int8_encode(nnz, p);
+    for (uint nodeId = 1; nodeId < numNodes + 1; ++nodeId) {
+      for (uint mId1 = 0; mId1 < numMetrics; ++mId1) {
+	nnz += (packedMetrics.idx(nodeId, mId1) != 0.0);
+      }
+      if (!(p = buf->reserve(HPCMETRICDB_FMT_SparseIdxLen))) goto badwrite;
+      hpcfmt_int8_encode(nnz, p);
+    }
+
+    // ... followed by the non-zero values themselves
+    for (uint nodeId = 1; nodeId < numNodes + 1; ++nodeId) {
+      for (uint mId1 = 0; mId1 < numMetrics; ++mId1) {
+	double mval = packedMetrics.idx(nodeId, mId1);
+	if (mval != 0.0) {
+	  if (!(p = buf->reserve(HPCMETRICDB_FMT_SparsePairLen))) goto badwrite;
+	  hpcfmt_int4_encode(mId1, p);
+	  hpcfmt_real8_encode(mval, p + 4);
+	}
+      }
     }
   }
 
+  if (!buf->flush()) goto badwrite;
+  delete buf;
+
   hpcio_fclose(fs);
   return;
 
@@ -196,6 +196,9 @@ realmain(int argc, char* const* argv)
 
   Prof::Struct::Tree* structure = new Prof::Struct::Tree("");
   if (!args.structureFiles.empty()) {
+    if (args.structureCache) {
+      Analysis::CallPath::makeStructureCache(args);
+    }
     Analysis::CallPath::readStructure(structure, args);
   }
   prof->structure(structure);
@@ -0,0 +1,399 @@
+// -*-Mode: C++;-*- // technically C99
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+
+//
+// cct-bench: replay backtraces into the hpcrun cct
+//
+// A harness for comparing the two child indexes of cct.c, built by
+// 'make check' in <builddir>/src/tool/hpcrun once per variant:
+// cct-bench uses the sibling splay tree and cct-bench-hash is compiled
+// with -DHPCRUN_CCT_HASH_CHILDREN for the hash-indexed variant.
+//
+// Usage: cct-bench [-r repeat] [file]
+//
+// Each line of 'file' is one backtrace, outermost frame first, as
+// whitespace separated 'lm_id:lm_ip' pairs in hex (an 'lm_id:' prefix
+// may be omitted).  Such a file is easily made from hpcrun debug
+// output or from a profile.  Without a file, a synthetic workload is
+// replayed: a main loop that calls many kernels (wide fan-out) each
+// with a few levels of deep, narrow call chains below.
+//
+// Both variants must report the same node count and path checksum.
+//
+
+//************************* System Include Files ****************************
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+//*************************** User Include Files ****************************
+
+#include <include/hpctoolkit-config.h>
+
+#include <memory/hpcrun-malloc.h>
+#include <messages/messages.h>
+#include <hpcrun/metrics.h>
+#include <hpcrun/cct2metrics.h>
+#include <utilities/ip-normalized.h>
+#include <lib/prof-lean/hpcio.h>
+#include <lib/prof-lean/hpcrun-fmt.h>
+#include <lib/prof-lean/lush/lush-support.h>
+
+#include "cct.h"
+
+//*************************** Forward Declarations **************************
+
+typedef struct {
+  size_t len;
+  cct_addr_t* frames;
+} replay_bt_t;
+
+typedef struct {
+  size_t n;
+  size_t cap;
+  replay_bt_t* bt;
+} bt_set_t;
+
+//***************************************************************************
+// stubs for the parts of hpcrun that cct.c uses
+//***************************************************************************
+
+lush_lip_t lush_lip_NULL;
+
+void*
+hpcrun_malloc(size_t size)
+{
+  return malloc(size);
+}
+
+#ifndef hpcrun_malloc_freeable
+void*
+hpcrun_malloc_freeable(size_t size)
+{
+  return malloc(size);
+}
+#endif
+
+int
+debug_flag_get(dbg_category flag)
+{
+  return 0;
+}
+
+void
+hpcrun_emsg(const char *fmt,...)
+{
+  va_list ap;
+  va_start(ap, fmt);
+  vfprintf(stderr, fmt, ap);
+  va_end(ap);
+  fputc('\n', stderr);
+}
+
+void
+hpcrun_pmsg(const char* tag, const char *fmt,...)
+{
+}
+
+ip_normalized_t
+hpcrun_normalize_ip(void* unnormalized_ip, load_module_t* lm)
+{
+  ip_normalized_t ip = ip_normalized_NULL;
+  return ip;
+}
+
+int
+hpcrun_get_num_kind_metrics(void)
+{
+  return 0;
+}
+
+metric_data_list_t*
+hpcrun_get_metric_data_list(cct_node_id_t cct_id)
+{
+  return NULL;
+}
+
+metric_data_list_t*
+hpcrun_move_metric_data_list(cct_node_id_t dest_id, cct_node_id_t source_id)
+{
+  return NULL;
+}
+
+metric_data_list_t*
+hpcrun_merge_cct_metrics(metric_data_list_t *dest, metric_data_list_t *source)
+{
+  return dest;
+}
+
+void
+hpcrun_metric_set_dense_copy(cct_metric_data_t* dest,
+			     metric_data_list_t* list, int num_metrics)
+{
+}
+
+size_t
+hpcio_be8_fwrite(uint64_t* val, FILE* fs)
+{
+  return sizeof(uint64_t);
+}
+
+int
+hpcrun_fmt_cct_node_fwrite(hpcrun_fmt_cct_node_t* x,
+			   epoch_flags_t flags, FILE* fs)
+{
+  return HPCFMT_OK;
+}
+
+//***************************************************************************
+// backtrace input
+//***************************************************************************
+
+static void
+bt_add(bt_set_t* set, cct_addr_t* frames, size_t len)
+{
+  if (set->n == set->cap) {
+    set->cap = set->cap ? 2 * set->cap : 1024;
+    set->bt = realloc(set->bt, set->cap * sizeof(replay_bt_t));
+  }
+  replay_bt_t* bt = &set->bt[set->n++];
+  bt->len = len;
+  bt->frames = malloc(len * sizeof(cct_addr_t));
+  memcpy(bt->frames, frames, len * sizeof(cct_addr_t));
+}
+
+static int
+bt_read(bt_set_t* set, const char* fnm)
+{
+  FILE* fs = fopen(fnm, "r");
+  if (! fs) {
+    perror(fnm);
+    return -1;
+  }
+
+  char line[65536];
+  cct_addr_t frames[1024];
+
+  while (fgets(line, sizeof(line), fs)) {
+    size_t len = 0;
+    for (char* tok = strtok(line, " \t\n"); tok && len < 1024;
+	 tok = strtok(NULL, " \t\n")) {
+      unsigned long lm_id = 0;
+      char* ip = strchr(tok, ':');
+      if (ip) {
+	lm_id = strtoul(tok, NULL, 16);
+	ip++;
+      }
+      else {
+	ip = tok;
+      }
+      cct_addr_t a = NON_LUSH_ADDR_INI(lm_id, strtoull(ip, NULL, 16));
+      frames[len++] = a;
+    }
+    if (len > 0) {
+      bt_add(set, frames, len);
+    }
+  }
+  fclose(fs);
+  return 0;
+}
+
+// main -> loop -> kernel k (of 512) -> helpers of depth 1..6
+static void
+bt_synthesize(bt_set_t* set, size_t samples)
+{
+  cct_addr_t frames[16];
+  uint64_t x = 0x9e3779b97f4a7c15ULL;
+
+  for (size_t s = 0; s < samples; s++) {
+    // xorshift
+    x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+
+    size_t len = 0;
+    cct_addr_t start = NON_LUSH_ADDR_INI(1, 0x400100);
+    cct_addr_t loop  = NON_LUSH_ADDR_INI(1, 0x400200);
+    frames[len++] = start;
+    frames[len++] = loop;
+
+    uint64_t kernel = x % 512;
+    cct_addr_t k = NON_LUSH_ADDR_INI(2, 0x10000 + 0x40 * kernel);
+    frames[len++] = k;
+
+    size_t depth = 1 + (x >> 20) % 6;
+    for (size_t d = 0; d < depth; d++) {
+      uint64_t callsite = (x >> (24 + 3 * d)) % 4;
+      cct_addr_t h = NON_LUSH_ADDR_INI(3, 0x20000 + 0x1000 * d + 0x10 * callsite);
+      frames[len++] = h;
+    }
+    bt_add(set, frames, len);
+  }
+}
+
+//***************************************************************************
+// replay
+//***************************************************************************
+
+static double
+now_sec(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+static cct_node_t*
+replay_insert(cct_node_t* root, replay_bt_t* bt)
+{
+  cct_node_t* node = root;
+  for (size_t i = 0; i < bt->len; i++) {
+    node = hpcrun_cct_insert_addr(node, &bt->frames[i]);
+  }
+  return node;
+}
+
+static cct_node_t*
+replay_find(cct_node_t* root, replay_bt_t* bt)
+{
+  cct_node_t* node = root;
+  for (size_t i = 0; node && i < bt->len; i++) {
+    node = hpcrun_cct_find_addr(node, &bt->frames[i]);
+  }
+  return node;
+}
+
+// an order independent digest of the set of root-to-node paths
+static void
+path_digest(cct_node_t* node, cct_op_arg_t arg, size_t level)
+{
+  uint64_t h = 0;
+  for (cct_node_t* n = node; n; n = hpcrun_cct_parent(n)) {
+    cct_addr_t* a = hpcrun_cct_addr(n);
+    h = (h ^ (a->ip_norm.lm_ip + ((uint64_t) a->ip_norm.lm_id << 48)))
+      * 0x100000001b3ULL;
+  }
+  *(uint64_t*) arg += h;
+}
+
+int
+main(int argc, char* argv[])
+{
+  bt_set_t set = { 0, 0, NULL };
+  int repeat = 10;
+  int c;
+
+  while ((c = getopt(argc, argv, "r:")) != -1) {
+    switch (c) {
+    case 'r': repeat = atoi(optarg); break;
+    default:
+      fprintf(stderr, "usage: %s [-r repeat] [file]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  if (optind < argc) {
+    if (bt_read(&set, argv[optind]) != 0) {
+      return 1;
+    }
+  }
+  else {
+    bt_synthesize(&set, 1 << 20);
+  }
+
+  size_t frames = 0;
+  for (size_t i = 0; i < set.n; i++) {
+    frames += set.bt[i].len;
+  }
+
+#ifdef HPCRUN_CCT_HASH_CHILDREN
+  const char* variant = "hash";
+#else
+  const char* variant = "splay";
+#endif
+
+  cct_node_t* root = hpcrun_cct_new();
+
+  // first pass builds the tree; later passes only look up
+  double t0 = now_sec();
+  for (size_t i = 0; i < set.n; i++) {
+    replay_insert(root, &set.bt[i]);
+  }
+  double t1 = now_sec();
+  for (int r = 1; r < repeat; r++) {
+    for (size_t i = 0; i < set.n; i++) {
+      replay_insert(root, &set.bt[i]);
+    }
+  }
+  double t2 = now_sec();
+  for (size_t i = 0; i < set.n; i++) {
+    if (replay_find(root, &set.bt[i]) == NULL) {
+      fprintf(stderr, "backtrace %zu not found after insertion\n", i);
+      return 1;
+    }
+  }
+  double t3 = now_sec();
+
+  uint64_t digest = 0;
+  hpcrun_cct_walk_node_1st(root, path_digest, &digest);
+
+  printf("variant:      %s\n", variant);
+  printf("backtraces:   %zu (%zu frames)\n", set.n, frames);
+  printf("cct nodes:    %zu\n", hpcrun_cct_num_nodes(root, true));
+  printf("path digest:  %016llx\n", (unsigned long long) digest);
+  printf("build:        %.2f ns/frame\n", 1e9 * (t1 - t0) / frames);
+  if (repeat > 1) {
+    printf("re-insert:    %.2f ns/frame\n",
+	   1e9 * (t2 - t1) / (frames * (double) (repeat - 1)));
+  }
+  printf("find:         %.2f ns/frame\n", 1e9 * (t3 - t2) / frames);
+
+  return 0;
+}
@@ -75,10 +75,13 @@
 
 //*************************** User Include Files ****************************
 
+#include <include/hpctoolkit-config.h>
+
 #include <memory/hpcrun-malloc.h>
 #include <hpcrun/metrics.h>
 #include <messages/messages.h>
 #include <lib/prof-lean/splay-macros.h>
+#include <lib/prof-lean/stdatomic.h>
 #include <lib/prof-lean/hpcrun-fmt.h>
 #include <lib/prof-lean/hpcrun-fmt.h>
 #include <hpcrun/hpcrun_return_codes.h>
@@ -89,6 +92,37 @@
 
 #define HPCRUN_CCT_KEEP_DUMMY 0
 
+//
+// The children of a node are indexed in one of two ways, chosen at
+// configure time:
+//
+//  - (default) a splay tree of siblings rooted at node->children and
+//    linked through their left/right pointers.
+//
+//  - (--enable-cct-child-hash) an inline array holding the first
+//    CCT_INLINE_CHILDREN children, which spills into an open-addressed
+//    (linear probing) hash table keyed on the child's cct_addr_t.
+//    Unlike a splay, a lookup does not write to the tree, and the cost
+//    of a lookup does not grow with the fan-out of the node.
+//
+#ifdef HPCRUN_CCT_HASH_CHILDREN
+
+#define CCT_INLINE_CHILDREN     3
+#define CCT_CHILD_TABLE_INIT    8
+
+// deleted table slots hold a tombstone so that walks over the table
+// remain valid while a walker deletes the node it visits
+static char cct_child_deleted;
+#define CCT_CHILD_TOMBSTONE  ((struct cct_node_t*) &cct_child_deleted)
+
+typedef struct cct_child_table_t {
+  uint32_t size;   // number of slots, a power of 2
+  uint32_t used;   // live plus deleted slots
+  struct cct_node_t* slots[];
+} cct_child_table_t;
+
+#endif
+
 //***************************** concrete data structure definition **********
 
 struct cct_node_t {
@@ -106,18 +140,35 @@ struct cct_node_t {
   cct_addr_t addr;
 
   bool is_leaf;
+
+#ifdef HPCRUN_CCT_METRIC_SLOT
+  // metrics attributed to this node (see cct2metrics.c)
+  metric_data_list_t* metrics;
+#endif
   
   // ---------------------------------------------------------
   // tree structure
   // ---------------------------------------------------------
 
-  // parent node and the beginning of the child list
+  // parent node
   struct cct_node_t* parent;
+
+#ifdef HPCRUN_CCT_HASH_CHILDREN
+  // child index: inline array, or hash table once it has spilled
+  bool has_child_table;
+  uint32_t num_children;
+  union {
+    struct cct_node_t* inline_children[CCT_INLINE_CHILDREN];
+    cct_child_table_t* table;
+  } child;
+#else
+  // the beginning of the child list
   struct cct_node_t* children;
 
   // left and right pointers for splay tree of siblings
   struct cct_node_t* left;
   struct cct_node_t* right;
+#endif
 };
 
 #if 0
@@ -131,9 +182,21 @@ static struct {
 } splay_cache;
 #endif
 
+//
+// count of structural changes other than insertions (see
+// hpcrun_cct_generation)
+//
+static atomic_long cct_generation = ATOMIC_VAR_INIT(0);
+
 //
 // ******************* Local Routines ********************
 //
+static inline void
+cct_generation_advance(void)
+{
+  atomic_fetch_add_explicit(&cct_generation, 1L, memory_order_relaxed);
+}
+
 static uint32_t 
 new_persistent_id()
 {
@@ -170,15 +233,234 @@ cct_node_create(cct_addr_t* addr, cct_node_t* parent)
   node->persistent_id = new_persistent_id();
 
   node->parent = parent;
-  node->children = NULL;
-  node->left = NULL;
-  node->right = NULL;
+
+  // memset leaves the child index empty
 
   node->is_leaf = false;
 
   return node;
 }
 
+#ifdef HPCRUN_CCT_HASH_CHILDREN
+
+//
+// ******* CHILD HASH TABLE section ********
+//
+
+// only the normalized ip is hashed: cct_addr_eq() compares lush
+// association classes rather than exact bits, and children that share
+// an ip but differ in their lush components are rare.
+static inline uint32_t
+cct_addr_hash(cct_addr_t* addr)
+{
+  uint64_t h = (((uint64_t) addr->ip_norm.lm_id) << 48)
+    ^ (uint64_t) addr->ip_norm.lm_ip;
+
+  // 64-bit finalizer from MurmurHash3
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return (uint32_t) h;
+}
+
+static cct_child_table_t*
+cct_child_table_new(uint32_t size)
+{
+  size_t sz = sizeof(cct_child_table_t) + size * sizeof(cct_node_t*);
+  cct_child_table_t* table;
+
+  if (ENABLED(FREEABLE)) {
+    table = hpcrun_malloc_freeable(sz);
+  }
+  else {
+    table = hpcrun_malloc(sz);
+  }
+  memset(table, 0, sz);
+  table->size = size;
+
+  return table;
+}
+
+static void
+cct_child_table_put(cct_child_table_t* table, cct_node_t* child)
+{
+  uint32_t mask = table->size - 1;
+  uint32_t i = cct_addr_hash(&child->addr) & mask;
+
+  while (table->slots[i] != NULL && table->slots[i] != CCT_CHILD_TOMBSTONE) {
+    i = (i + 1) & mask;
+  }
+  if (table->slots[i] == NULL) {
+    table->used++;
+  }
+  table->slots[i] = child;
+}
+
+// return the slot holding addr, or -1
+static int64_t
+cct_child_table_slot(cct_child_table_t* table, cct_addr_t* addr)
+{
+  uint32_t mask = table->size - 1;
+  uint32_t i = cct_addr_hash(addr) & mask;
+
+  for (cct_node_t* c; (c = table->slots[i]) != NULL; i = (i + 1) & mask) {
+    if (c != CCT_CHILD_TOMBSTONE && cct_addr_eq(addr, &(c->addr))) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+// Rebuild the table of a node so that it has room for one more child:
+// a table at most half full (counting deleted slots) keeps probe
+// sequences short.  The old table is simply abandoned, as hpcrun
+// memory is not reclaimed piecemeal; doubling bounds the waste to the
+// size of the final table.
+static void
+cct_child_table_reserve(cct_node_t* node)
+{
+  cct_child_table_t* old = node->child.table;
+  if (2 * (old->used + 1) <= old->size) {
+    return;
+  }
+
+  uint32_t size = old->size;
+  while (4 * (node->num_children + 1) > size) {
+    size *= 2;
+  }
+
+  cct_child_table_t* table = cct_child_table_new(size);
+  for (uint32_t i = 0; i < old->size; i++) {
+    cct_node_t* c = old->slots[i];
+    if (c != NULL && c != CCT_CHILD_TOMBSTONE) {
+      cct_child_table_put(table, c);
+    }
+  }
+  node->child.table = table;
+}
+
+static inline bool
+cct_children_empty(cct_node_t* node)
+{
+  return node->num_children == 0;
+}
+
+static cct_node_t*
+cct_child_find(cct_node_t* node, cct_addr_t* addr)
+{
+  if (! node->has_child_table) {
+    for (uint32_t i = 0; i < node->num_children; i++) {
+      cct_node_t* c = node->child.inline_children[i];
+      if (cct_addr_eq(addr, &(c->addr))) {
+        return c;
+      }
+    }
+    return NULL;
+  }
+
+  cct_child_table_t* table = node->child.table;
+  int64_t i = cct_child_table_slot(table, addr);
+  return (i < 0) ? NULL : table->slots[i];
+}
+
+// add child to the children of node.  child's addr must not already
+// be present.
+static void
+cct_child_link(cct_node_t* node, cct_node_t* child)
+{
+  if (! node->has_child_table) {
+    if (node->num_children < CCT_INLINE_CHILDREN) {
+      node->child.inline_children[node->num_children++] = child;
+      return;
+    }
+
+    // spill the inline children into a table
+    cct_child_table_t* table = cct_child_table_new(CCT_CHILD_TABLE_INIT);
+    for (uint32_t i = 0; i < node->num_children; i++) {
+      cct_child_table_put(table, node->child.inline_children[i]);
+    }
+    node->child.table = table;
+    node->has_child_table = true;
+  }
+
+  cct_child_table_reserve(node);
+  cct_child_table_put(node->child.table, child);
+  node->num_children++;
+}
+
+static cct_node_t*
+cct_child_unlink(cct_node_t* node, cct_addr_t* addr)
+{
+  if (! node->has_child_table) {
+    for (uint32_t i = 0; i < node->num_children; i++) {
+      cct_node_t* c = node->child.inline_children[i];
+      if (cct_addr_eq(addr, &(c->addr))) {
+        // shift down to keep the order seen by walk_children
+        node->num_children--;
+        for (uint32_t j = i; j < node->num_children; j++) {
+          node->child.inline_children[j] = node->child.inline_children[j + 1];
+        }
+        return c;
+      }
+    }
+    return NULL;
+  }
+
+  cct_child_table_t* table = node->child.table;
+  int64_t i = cct_child_table_slot(table, addr);
+  if (i < 0) {
+    return NULL;
+  }
+  cct_node_t* c = table->slots[i];
+  table->slots[i] = CCT_CHILD_TOMBSTONE;
+  node->num_children--;
+  return c;
+}
+
+// give the (empty) child index of 'to' all of the children of 'from'
+static void
+cct_children_move(cct_node_t* to, cct_node_t* from)
+{
+  to->has_child_table = from->has_child_table;
+  to->num_children = from->num_children;
+  to->child = from->child;
+
+  from->has_child_table = false;
+  from->num_children = 0;
+}
+
+//
+// helper for walking functions
+//
+// N.B.: the walk tolerates the visited node deleting itself: inline
+// children are visited from last to first, and deletion from the
+// table leaves a tombstone rather than moving entries.
+//
+static void
+walk_children(cct_node_t* cct,
+              cct_op_t op, cct_op_arg_t arg, size_t level,
+              void (*wf)(cct_node_t* n, cct_op_t o, cct_op_arg_t a, size_t l))
+{
+  if (! cct->has_child_table) {
+    for (uint32_t i = cct->num_children; i-- > 0; ) {
+      wf(cct->child.inline_children[i], op, arg, level);
+    }
+    return;
+  }
+
+  cct_child_table_t* table = cct->child.table;
+  for (uint32_t i = 0; i < table->size; i++) {
+    cct_node_t* c = table->slots[i];
+    if (c != NULL && c != CCT_CHILD_TOMBSTONE) {
+      wf(c, op, arg, level);
+    }
+  }
+}
+
+#else // ! HPCRUN_CCT_HASH_CHILDREN
+
 //
 // ******* SPLAY TREE section ********
 // [ Thanks to Mark Krentel ]
@@ -205,6 +487,82 @@ splay(cct_node_t* cct, cct_addr_t* addr)
 #undef l_lt
 #undef l_gt
 
+static inline bool
+cct_children_empty(cct_node_t* node)
+{
+  return ! node->children;
+}
+
+static cct_node_t*
+cct_child_find(cct_node_t* node, cct_addr_t* addr)
+{
+  cct_node_t* found    = splay(node->children, addr);
+    //
+    // !! SPECIAL CASE for cct splay !!
+    // !! The splay tree (represented by the root) is the data structure for the set
+    // !! of children of the parent. Consequently, when the splay operation changes the root,
+    // !! the parent's children pointer must point to the NEW root node
+    // !! NOT the old (pre-splay) root node
+    //
+
+  node->children = found;
+ 
+  if (found && cct_addr_eq(addr, &(found->addr))){
+    return found;
+  }
+  return NULL;
+}
+
+// add child to the children of node.  child's addr must not already
+// be present.
+static void
+cct_child_link(cct_node_t* node, cct_node_t* child)
+{
+  cct_node_t* found = splay(node->children, &(child->addr));
+  node->children = child;
+  if (! found) {
+    return;
+  }
+
+  if (cct_addr_lt(&(child->addr), &(found->addr))){
+    child->left = found->left;
+    child->right = found;
+    found->left = NULL;
+  }
+  else { // addr > addr of found
+    child->left = found;
+    child->right = found->right;
+    found->right = NULL;
+  }
+}
+
+static cct_node_t*
+cct_child_unlink(cct_node_t* node, cct_addr_t* frm)
+{
+  cct_node_t* found = splay(node->children, frm);
+
+  node->children = found;
+
+  if(!found || !cct_addr_eq(frm, &(found->addr))) 
+    return NULL;
+
+  if(node->children->left == NULL) {
+    node->children = node->children->right;
+    return found;
+  }
+  node->children->left = splay(node->children->left, frm);
+  node->children->left->right = node->children->right;
+  node->children = node->children->left;
+  return found;
+}
+
+// give the (empty) child index of 'to' all of the children of 'from'
+static void
+cct_children_move(cct_node_t* to, cct_node_t* from)
+{
+  to->children = from->children;
+}
+
 //
 // helper for walking functions
 // 
@@ -224,12 +582,19 @@ walk_child_lrs(cct_node_t* cct,
   wf(cct, op, arg, level);
 }
 
+static void
+walk_children(cct_node_t* cct,
+              cct_op_t op, cct_op_arg_t arg, size_t level,
+              void (*wf)(cct_node_t* n, cct_op_t o, cct_op_arg_t a, size_t l))
+{
+  walk_child_lrs(cct->children, op, arg, level, wf);
+}
+
+#endif // HPCRUN_CCT_HASH_CHILDREN
+
 static void
 walkset_l(cct_node_t* cct, cct_op_t fn, cct_op_arg_t arg, size_t level)
 {
-  if (! cct) return;
-  walkset_l(cct->left, fn, arg, level);
-  walkset_l(cct->right, fn, arg, level);
   fn(cct, arg, level);
 }
 
@@ -423,6 +788,14 @@ hpcrun_cct_persistent_id(cct_node_t* x)
   return x ? x->persistent_id : -1;
 }
 
+#ifdef HPCRUN_CCT_METRIC_SLOT
+metric_data_list_t**
+hpcrun_cct_metric_slot(cct_node_t* x)
+{
+  return &(x->metrics);
+}
+#endif
+
 cct_addr_t*
 hpcrun_cct_addr(cct_node_t* node)
 {
@@ -432,7 +805,7 @@ hpcrun_cct_addr(cct_node_t* node)
 bool
 hpcrun_cct_is_leaf(cct_node_t* node)
 {
-  return node ? (node->is_leaf) || (!(node->children)) : false;
+  return node ? (node->is_leaf) || cct_children_empty(node) : false;
 }
 
 //
@@ -443,7 +816,7 @@ hpcrun_cct_is_leaf(cct_node_t* node)
 bool
 hpcrun_cct_no_children(cct_node_t* node)
 {
-  return node ? ! node->children : false;
+  return node ? cct_children_empty(node) : false;
 }
 
 bool
@@ -479,37 +852,14 @@ hpcrun_cct_insert_addr(cct_node_t* node, cct_addr_t* frm)
   if ( ! node)
     return NULL;
 
-  cct_node_t* found    = splay(node->children, frm);
-    //
-    // !! SPECIAL CASE for cct splay !!
-    // !! The splay tree (represented by the root) is the data structure for the set
-    // !! of children of the parent. Consequently, when the splay operation changes the root,
-    // !! the parent's children pointer must point to the NEW root node
-    // !! NOT the old (pre-splay) root node
-    //
-
-  node->children = found;
- 
-  if (found && cct_addr_eq(frm, &(found->addr))){
+  cct_node_t* found = cct_child_find(node, frm);
+  if (found) {
     return found;
   }
   //  cct_node_t* new = cct_node_create(frm->as_info, frm->ip_norm, frm->lip, node);
   cct_node_t* new = cct_node_create(frm, node);
 
-  node->children = new;
-  if (! found){
-    return new;
-  }
-  if (cct_addr_lt(frm, &(found->addr))){
-    new->left = found->left;
-    new->right = found;
-    found->left = NULL;
-  }
-  else { // addr > addr of found
-    new->left = found;
-    new->right = found->right;
-    found->right = NULL;
-  }
+  cct_child_link(node, new);
   return new;
 }
 
@@ -522,26 +872,19 @@ hpcrun_cct_insert_dummy(cct_node_t* node, uint16_t lm_ip)
   return dummy;
 }
 
+long
+hpcrun_cct_generation(void)
+{
+  return atomic_load_explicit(&cct_generation, memory_order_relaxed);
+}
+
 cct_node_t*
 hpcrun_cct_delete_addr(cct_node_t* node, cct_addr_t* frm)
 {
   if(!node) return NULL;
 
-  cct_node_t* found = splay(node->children, frm);
-
-  node->children = found;
-
-  if(!found || !cct_addr_eq(frm, &(found->addr))) 
-    return NULL;
-
-  if(node->children->left == NULL) {
-    node->children = node->children->right;
-    return found;
-  }
-  node->children->left = splay(node->children->left, frm);
-  node->children->left->right = node->children->right;
-  node->children = node->children->left;
-  return found;
+  cct_generation_advance();
+  return cct_child_unlink(node, frm);
 }
 
 // insert a path to the root and return the path in the root
@@ -586,26 +929,11 @@ hpcrun_cct_terminate_path(cct_node_t* node)
 cct_node_t*
 hpcrun_cct_insert_node(cct_node_t* target, cct_node_t* src)
 {
+  cct_generation_advance();
   src->parent = target;
 
-  cct_node_t* found = splay(target->children, &(src->addr));
-  target->children = src;
-  if (! found) {
-    return src;
-  }
-  
   // NOTE: Assume equality cannot happen
-
-  if (cct_addr_lt(&(src->addr), &(found->addr))){
-    src->left = found->left;
-    src->right = found;
-    found->left = NULL;
-  }
-  else { // addr > addr of found
-    src->left = found;
-    src->right = found->right;
-    found->right = NULL;
-  }
+  cct_child_link(target, src);
   return src;
 }
 
@@ -649,8 +977,8 @@ void
 hpcrun_cct_walk_child_1st_w_level(cct_node_t* cct, cct_op_t op, cct_op_arg_t arg, size_t level)
 {
   if (!cct) return;
-  walk_child_lrs(cct->children, op, arg, level+1,
-		 hpcrun_cct_walk_child_1st_w_level);
+  walk_children(cct, op, arg, level+1,
+		hpcrun_cct_walk_child_1st_w_level);
   op(cct, arg, level);
 }
 
@@ -662,8 +990,8 @@ hpcrun_cct_walk_node_1st_w_level(cct_node_t* cct, cct_op_t op, cct_op_arg_t arg,
 {
   if (!cct) return;
   op(cct, arg, level);
-  walk_child_lrs(cct->children, op, arg, level+1,
-		 hpcrun_cct_walk_node_1st_w_level);
+  walk_children(cct, op, arg, level+1,
+		hpcrun_cct_walk_node_1st_w_level);
 }
 
 //
@@ -672,8 +1000,8 @@ hpcrun_cct_walk_node_1st_w_level(cct_node_t* cct, cct_op_t op, cct_op_arg_t arg,
 void
 hpcrun_cct_walkset(cct_node_t* cct, cct_op_t fn, cct_op_arg_t arg)
 {
-  if(!cct->children) return;
-  walkset_l(cct->children, fn, arg, 0);
+  if(cct_children_empty(cct)) return;
+  walk_children(cct, fn, arg, 0, walkset_l);
 }
 
 //
@@ -785,21 +1113,7 @@ hpcrun_cct_find_addr(cct_node_t* cct, cct_addr_t* addr)
   if ( ! cct)
     return NULL;
 
-  cct_node_t* found    = splay(cct->children, addr);
-    //
-    // !! SPECIAL CASE for cct splay !!
-    // !! The splay tree (represented by the root) is the data structure for the set
-    // !! of children of the parent. Consequently, when the splay operation changes the root,
-    // !! the parent's children pointer must point to the NEW root node
-    // !! NOT the old (pre-splay) root node
-    //
-
-  cct->children = found;
- 
-  if (found && cct_addr_eq(addr, &(found->addr))){
-    return found;
-  }
-  return NULL;
+  return cct_child_find(cct, addr);
 }
 
 //
@@ -843,9 +1157,10 @@ hpcrun_cct_merge(cct_node_t* cct_a, cct_node_t* cct_b,
   if (hpcrun_cct_is_leaf (cct_a) && hpcrun_cct_is_leaf(cct_b)) {
     merge(cct_a, cct_b, arg);
   }
-  if (! cct_a->children){
-    cct_a->children = cct_b->children;
+  cct_generation_advance();
+  if (cct_children_empty(cct_a)){
     hpcrun_cct_walkset(cct_b, attach_to_a, (cct_op_arg_t) cct_a);
+    cct_children_move(cct_a, cct_b);
   }
   else {
     mjarg_t local = (mjarg_t) {.targ = cct_a, .fn = merge, .arg = arg};
@@ -890,32 +1205,7 @@ cct_disjoint_union_cached(cct_node_t* target, cct_node_t* src)
     if ( src) EMSG("WARNING: cct disjoin union called w null target!!");
     return;
   }
-    
-  cct_addr_t* addr = hpcrun_cct_addr(src);
-  cct_node_t* found    = splay(target->children, addr);
-    //
-    // !! SPECIAL CASE for cct splay !!
-    // !! The splay tree (represented by the root) is the data structure for the set
-    // !! of children of the parent. Consequently, when the splay operation changes the root,
-    // !! the parent's children pointer must point to the NEW root node
-    // !! NOT the old (pre-splay) root node
-    //
-  if (!found) {
-    target->children = src;
-    src->parent = target;
-    return;
-  }
 
-  if (cct_addr_lt(addr, &(found->addr))){
-    src->left = found->left;
-    src->right = found;
-    found->left = NULL;
-  }
-  else { // addr > addr of found
-    src->left = found;
-    src->right = found->right;
-    found->right = NULL;
-  }
-  target->children = src;
+  cct_child_link(target, src);
   src->parent = target;
 }
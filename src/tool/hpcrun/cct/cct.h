@@ -137,6 +137,11 @@ extern cct_node_t* hpcrun_cct_top_new(uint16_t lmid, uintptr_t lmip);
 extern cct_node_t* hpcrun_cct_parent(cct_node_t* node);
 extern int32_t hpcrun_cct_persistent_id(cct_node_t* node);
 extern cct_addr_t* hpcrun_cct_addr(cct_node_t* node);
+//
+// with --enable-cct-metric-slot, the location in the node of its
+// metric data list (used by cct2metrics in place of its splay map)
+//
+extern metric_data_list_t** hpcrun_cct_metric_slot(cct_node_t* node);
 extern bool hpcrun_cct_is_leaf(cct_node_t* node);
 extern cct_node_t* hpcrun_cct_insert_path_return_leaf(cct_node_t *root, cct_node_t *path);
 extern void hpcrun_cct_delete_self(cct_node_t *node);
@@ -183,6 +188,14 @@ extern void hpcrun_cct_terminate_path(cct_node_t* node);
 //
 extern cct_node_t* hpcrun_cct_insert_node(cct_node_t* target, cct_node_t* src);
 
+//
+// A count of the operations (over all ccts) that unlink nodes or move
+// them between trees.  Plain insertions do not change it, so code that
+// caches cct_node_t pointers across samples may keep them for as long
+// as the generation is unchanged.
+//
+extern long hpcrun_cct_generation(void);
+
 extern void hpcrun_cct_insert_path(cct_node_t ** root, cct_node_t* path);
 
 // mark a node for retention as the leaf of a traced call path.
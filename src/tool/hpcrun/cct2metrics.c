@@ -5,6 +5,8 @@
 #include <string.h>
 #include <stdlib.h>
 
+#include <include/hpctoolkit-config.h>
+
 #include <messages/messages.h>
 #include <memory/hpcrun-malloc.h>
 #include <hpcrun/metrics.h>
@@ -17,6 +19,75 @@
 //
 // ***** The splay tree node *****
 //
+#ifdef HPCRUN_CCT_METRIC_SLOT
+
+//
+// Each cct node carries its metric data list directly, so attribution
+// costs no search.  The cct2metrics map degenerates to a placeholder:
+// metrics follow the node rather than the thread that attributed
+// them, and the map argument of hpcrun_cct_fwrite is not needed to
+// find them.
+//
+
+void
+hpcrun_cct2metrics_init(cct2metrics_t** map)
+{
+  TMSG(CCT2METRICS, "Init, map = %p", *map);
+  *map = NULL;
+}
+
+metric_data_list_t*
+hpcrun_reify_metric_set(cct_node_id_t cct_id, int metric_id)
+{
+  TMSG(CCT2METRICS, "REIFY: %p", cct_id);
+  metric_data_list_t** slot = hpcrun_cct_metric_slot(cct_id);
+  if (*slot == NULL) {
+    TMSG(CCT2METRICS, " -- Metric kind was null, allocating new metric kind");
+    *slot = hpcrun_new_metric_data_list(metric_id);
+  }
+  return *slot;
+}
+
+metric_data_list_t *
+hpcrun_get_metric_data_list(cct_node_id_t cct_id)
+{
+  if (! cct_id) return NULL;
+
+  return *hpcrun_cct_metric_slot(cct_id);
+}
+
+metric_data_list_t *
+hpcrun_move_metric_data_list(cct_node_id_t dest, cct_node_id_t source)
+{
+  if (dest == NULL || source == NULL) {
+    return NULL;
+  }
+
+  metric_data_list_t** slot = hpcrun_cct_metric_slot(source);
+  metric_data_list_t* metric_data_list = *slot;
+  if (metric_data_list == NULL) {
+    TMSG(CCT2METRICS, " -- no metrics for %p. Return NULL", source);
+    return NULL;
+  }
+  *slot = NULL;
+  cct2metrics_assoc(dest, metric_data_list);
+  return metric_data_list;
+}
+
+void
+cct2metrics_assoc(cct_node_id_t node, metric_data_list_t* kind_metrics)
+{
+  TMSG(CCT2METRICS, "CCT2METRICS_ASSOC for %p", node);
+  metric_data_list_t** slot = hpcrun_cct_metric_slot(node);
+  if (*slot != NULL) {
+    EMSG("CCT2METRICS map assoc invariant violated");
+    return;
+  }
+  *slot = kind_metrics;
+}
+
+#else // ! HPCRUN_CCT_METRIC_SLOT
+
 struct cct2metrics_t {
   cct_node_id_t node;
   metric_data_list_t* kind_metrics;
@@ -213,4 +284,4 @@ cct2metrics_assoc(cct_node_id_t node, metric_data_list_t* kind_metrics)
   if (ENABLED(CCT2METRICS)) splay_tree_dump(THREAD_LOCAL_MAP());
 }
 
-
+#endif // HPCRUN_CCT_METRIC_SLOT
@@ -90,6 +90,61 @@ hpcrun_kernel_callpath_register(hpcrun_kernel_callpath_t kcp)
 	hpcrun_kernel_callpath = kcp;
 }
 
+//
+// path memo: consecutive samples of a thread usually share all but
+// the innermost few frames.  The memo records, for each frame of the
+// previously inserted backtrace, the insertion cursor after that
+// frame.  The cursor after frame i depends on frames 0..i+1 (the
+// recursion compression test looks one frame ahead), so if the first
+// m frames match the memo, insertion may resume after frame m-2.
+//
+
+static inline bool
+path_memo_frame_eq(cct_path_memo_entry_t* e, frame_t* frame)
+{
+  // lush frames carry a logical ip; these are not memoized
+  return (frame->lip == NULL) &&
+    ip_normalized_eq(&(e->ip_norm), &(frame->ip_norm)) &&
+    e->as_info.bits == frame->as_info.bits;
+}
+
+// returns the number of leading frames that may be skipped, and
+// updates *cct to the cursor to resume from
+static uint32_t
+path_memo_lookup(cct_path_memo_t* memo, cct_node_t** cct,
+		 frame_t* path_beg, frame_t* path_end)
+{
+  if (memo->root != *cct ||
+      memo->generation != hpcrun_cct_generation() ||
+      memo->retain_recursion != retain_recursion) {
+    return 0;
+  }
+
+  uint32_t m = 0;
+  for (frame_t* frame = path_beg;
+       frame >= path_end && m < memo->len &&
+	 path_memo_frame_eq(&(memo->entry[m]), frame);
+       frame--) {
+    m++;
+  }
+  if (m < 2) {
+    return 0;
+  }
+
+  *cct = memo->entry[m - 2].node;
+  return m - 1;
+}
+
+void
+hpcrun_cct_path_memo_reset(void)
+{
+  thread_data_t* td = hpcrun_safe_get_td();
+  if (td) {
+    td->path_memo.root = NULL;
+    td->path_memo.len = 0;
+  }
+}
+
 static cct_node_t*
 cct_insert_raw_backtrace(cct_node_t* cct,
                             frame_t* path_beg, frame_t* path_end)
@@ -103,8 +158,28 @@ cct_insert_raw_backtrace(cct_node_t* cct,
   }
 #endif
 
+  thread_data_t* td = hpcrun_safe_get_td();
+  cct_path_memo_t* memo = td ? &(td->path_memo) : NULL;
+  cct_node_t* root = cct;
+  uint32_t i = 0;
+
   ip_normalized_t parent_routine = ip_normalized_NULL;
-  for(; path_beg >= path_end; path_beg--){
+
+  if (memo) {
+    uint32_t skip = path_memo_lookup(memo, &cct, path_beg, path_end);
+    if (skip > 0) {
+      TMSG(BT_INSERT, "path memo: resume below %d frames", skip);
+      hpcrun_stats_bt_memo_hit_inc(skip);
+      path_beg -= skip;
+      i = skip;
+      parent_routine = (path_beg + 1)->the_function;
+    }
+    else {
+      hpcrun_stats_bt_memo_miss_inc();
+    }
+  }
+
+  for(; path_beg >= path_end; path_beg--, i++){
     if ( (! retain_recursion) &&
 	 (path_beg >= path_end + 1) && 
          ip_normalized_eq(&(path_beg->the_function), &(parent_routine)) &&
@@ -120,8 +195,22 @@ cct_insert_raw_backtrace(cct_node_t* cct,
       cct = hpcrun_cct_insert_addr(cct, &tmp);
     }
     parent_routine = path_beg->the_function;
+
+    if (memo && i < CCT_PATH_MEMO_SZ) {
+      memo->entry[i] = (cct_path_memo_entry_t) {
+	.ip_norm = path_beg->ip_norm,
+	.as_info = path_beg->as_info,
+	.node = cct };
+    }
   }
   hpcrun_cct_terminate_path(cct);
+
+  if (memo) {
+    memo->root = root;
+    memo->generation = hpcrun_cct_generation();
+    memo->retain_recursion = retain_recursion;
+    memo->len = (i < CCT_PATH_MEMO_SZ) ? i : CCT_PATH_MEMO_SZ;
+  }
   return cct;
 }
 
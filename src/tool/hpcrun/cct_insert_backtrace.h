@@ -103,6 +103,13 @@ extern cct_node_t* hpcrun_backtrace2cct(cct_bundle_t* cct, ucontext_t* context,
 
 extern void hpcrun_kernel_callpath_register(hpcrun_kernel_callpath_t kcp);
 
+//
+// Forget the thread's last inserted path (see cct_insert_backtrace.c).
+// Must be called whenever the thread's CCT is replaced, since a new
+// root may be allocated where the old one was.
+//
+extern void hpcrun_cct_path_memo_reset(void);
+
 //
 // debug version of hpcrun_backtrace2cct:
 //   simulates errors to test partial unwind capability
@@ -5,6 +5,7 @@
 #include <stdio.h>
 #include <lib/prof-lean/hpcio-buffer.h>
 #include <lib/prof-lean/hpcfmt.h> // for metric_aux_info_t
+#include <lib/prof-lean/hpcrun-fmt.h> // for hpctrace_fmt_block_t
 
 #include "epoch.h"
 #include "cct2metrics.h"
@@ -28,8 +29,8 @@ typedef struct core_profile_trace_data_t {
   // ----------------------------------------
   // tracing
   // ----------------------------------------
-  uint64_t trace_min_time_us;
-  uint64_t trace_max_time_us;
+  uint64_t trace_min_time; // trace clock units; cf. trace_clock.h
+  uint64_t trace_max_time;
 
   // ----------------------------------------
   // IO support
@@ -37,6 +38,7 @@ typedef struct core_profile_trace_data_t {
   FILE* hpcrun_file;
   void* trace_buffer;
   hpcio_outbuf_t trace_outbuf;
+  hpctrace_fmt_block_t trace_block; // compact records not yet written
 
   // ----------------------------------------
   // Perf support
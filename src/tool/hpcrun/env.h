@@ -84,6 +84,12 @@ extern const char* HPCRUN_OPT_LUSH_AGENTS;
 extern const char* HPCRUN_OUT_PATH;
 
 extern const char* HPCRUN_TRACE;
+extern const char* HPCRUN_TRACE_CLOCK;
+extern const char* HPCRUN_TRACE_FORMAT;
+extern const char* HPCRUN_TRACE_ASYNC;
+extern const char* HPCRUN_TRACE_ASYNC_BUDGET;
+
+extern const char* HPCRUN_FNBOUNDS_CACHE;
 
 extern const char* HPCRUN_EVENT_LIST;
 extern const char* HPCRUN_MEMSIZE;
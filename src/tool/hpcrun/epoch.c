@@ -60,6 +60,7 @@
 #include <trampoline/common/trampoline.h>
 #include <messages/messages.h>
 #include <cct/cct_bundle.h>
+#include "cct_insert_backtrace.h"
 
 void
 hpcrun_reset_epoch(epoch_t* epoch)
@@ -118,6 +119,7 @@ hpcrun_check_for_new_loadmap(epoch_t* epoch)
 
     memcpy(newepoch, epoch, sizeof(epoch_t));
     hpcrun_cct_bundle_init(&(epoch->csdata), (epoch->csdata).ctxt);
+    hpcrun_cct_path_memo_reset();
 
     hpcrun_trampoline_remove();
 
@@ -154,6 +156,7 @@ hpcrun_epoch_reset(void)
   memcpy(newepoch, epoch, sizeof(epoch_t));
   TMSG(EPOCH_RESET, "check new loadmap = old loadmap = %d", newepoch->loadmap == epoch->loadmap);
   hpcrun_cct_bundle_init(&(newepoch->csdata), newepoch->csdata_ctxt); // reset cct
+  hpcrun_cct_path_memo_reset();
   hpcrun_reset_epoch(newepoch);
   TMSG(EPOCH_RESET," ==> no new epoch for next sample = %d", newepoch->loadmap == hpcrun_getLoadmap());
 }
@@ -0,0 +1,481 @@
+// -*-Mode: C++;-*- // technically C99
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+// The fnbounds cache, see fnbounds_cache.h.
+//
+// Each entry is one file: a small header followed by the array of
+// addresses at a page-aligned offset, so that a hit is a single
+// read-only mmap of the file.  Nothing in hpcrun writes to the table,
+// and the mapping is never unmapped, same as the anonymous region
+// from the server.
+//
+// Entries are written to a temp file with a name unique to the host
+// and process and then renamed into place.  Rename is atomic, so
+// concurrent processes, even on different nodes of a shared file
+// system, see either no entry or a complete one.  If two processes
+// miss on the same file, both compute and store it and the last
+// rename wins, which is harmless since the tables are identical.
+//
+// Notes:
+// 1. Calls to the cache already hold the FNBOUNDS_LOCK, the same as
+// hpcrun_syserv_query().
+//
+// 2. The cache is purely an optimization.  Any problem with an entry
+// (bad magic, wrong size, short file) is treated as a miss, and a
+// good entry from the server replaces it.
+
+//***************************************************************************
+
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <elf.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <link.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "env.h"
+#include "fnbounds_cache.h"
+#include "fnbounds_file_header.h"
+#include "hpcrun_stats.h"
+#include "messages.h"
+
+#define FNBOUNDS_CACHE_MAGIC  "HPCFNB01"
+#define BUILD_ID_MAX   64
+#define NOTE_BUF_SIZE  1024
+#define HOST_NAME_LEN  64
+
+// room for the entry and temp file names after the directory
+#define CACHE_NAME_ROOM  (2 * BUILD_ID_MAX + 3 * 20 + HOST_NAME_LEN + 40)
+
+#define SUCCESS   0
+#define FAILURE  -1
+
+enum {
+  CACHE_UNINIT = 0,
+  CACHE_ACTIVE,
+  CACHE_INACTIVE
+};
+
+// The cache file header.  Like fnbounds_file_header, this is not
+// platform-independent; entries are only useful to processes of the
+// same architecture, and ptr_size catches the obvious mismatch.
+struct fnbounds_cache_header {
+  char      magic[8];
+  uint64_t  size;
+  int64_t   mtime_sec;
+  int64_t   mtime_nsec;
+  uint64_t  num_entries;
+  uint64_t  reference_offset;
+  uint64_t  table_offset;
+  int32_t   is_relocatable;
+  int32_t   ptr_size;
+};
+
+static int cache_status = CACHE_UNINIT;
+static char cache_dir[PATH_MAX];
+
+
+//*****************************************************************
+// I/O helper functions
+//*****************************************************************
+
+// Automatically restart short reads.
+// Returns: SUCCESS or FAILURE (including end of file).
+//
+static int
+pread_all(int fd, void *buf, size_t count, off_t offset)
+{
+  ssize_t ret;
+  size_t len;
+
+  len = 0;
+  while (len < count) {
+    ret = pread(fd, ((char *) buf) + len, count - len, offset + len);
+    if (ret < 0 && errno != EINTR) {
+      return FAILURE;
+    }
+    if (ret == 0) {
+      return FAILURE;
+    }
+    if (ret > 0) {
+      len += ret;
+    }
+  }
+
+  return SUCCESS;
+}
+
+
+// Automatically restart short writes.
+// Returns: SUCCESS or FAILURE.
+//
+static int
+pwrite_all(int fd, const void *buf, size_t count, off_t offset)
+{
+  ssize_t ret;
+  size_t len;
+
+  len = 0;
+  while (len < count) {
+    ret = pwrite(fd, ((const char *) buf) + len, count - len, offset + len);
+    if (ret < 0 && errno != EINTR) {
+      return FAILURE;
+    }
+    if (ret > 0) {
+      len += ret;
+    }
+  }
+
+  return SUCCESS;
+}
+
+
+static size_t
+page_size(void)
+{
+  static size_t pagesize = 0;
+
+  if (pagesize == 0) {
+#if defined(_SC_PAGESIZE)
+    long ans = sysconf(_SC_PAGESIZE);
+    if (ans > 0) {
+      pagesize = ans;
+    }
+#endif
+    if (pagesize == 0) {
+      pagesize = 4096;
+    }
+  }
+
+  return pagesize;
+}
+
+
+// Returns: 'size' rounded up to a multiple of the mmap page size.
+static size_t
+page_align(size_t size)
+{
+  size_t pagesize = page_size();
+
+  return ((size + pagesize - 1)/pagesize) * pagesize;
+}
+
+
+//*****************************************************************
+// Cache keys
+//*****************************************************************
+
+// Returns: 1 if the cache is enabled, creating the directory on
+// first use.
+//
+static int
+cache_init(void)
+{
+  if (cache_status != CACHE_UNINIT) {
+    return cache_status == CACHE_ACTIVE;
+  }
+  cache_status = CACHE_INACTIVE;
+
+  char *dir = getenv(HPCRUN_FNBOUNDS_CACHE);
+  if (dir == NULL || dir[0] == 0) {
+    return 0;
+  }
+  if (strlen(dir) + CACHE_NAME_ROOM >= PATH_MAX) {
+    EMSG("fnbounds cache: directory name too long: %s", dir);
+    return 0;
+  }
+  if (mkdir(dir, 0755) != 0 && errno != EEXIST) {
+    EMSG("fnbounds cache: unable to create directory: %s", dir);
+    return 0;
+  }
+
+  strcpy(cache_dir, dir);
+  cache_status = CACHE_ACTIVE;
+  TMSG(FNBOUNDS_CACHE, "directory: %s", cache_dir);
+
+  return 1;
+}
+
+
+// Read the GNU build-id note from the program headers of an ELF file
+// of our own class.
+// Returns: length of the build-id, or else 0 if there is none.
+//
+static size_t
+read_build_id(int fd, unsigned char *id)
+{
+  ElfW(Ehdr) ehdr;
+  ElfW(Phdr) phdr;
+  char buf[NOTE_BUF_SIZE];
+  int n;
+
+  if (pread_all(fd, &ehdr, sizeof(ehdr), 0) != SUCCESS
+      || memcmp(ehdr.e_ident, ELFMAG, SELFMAG) != 0
+      || ehdr.e_ident[EI_CLASS] != (sizeof(void *) == 8 ? ELFCLASS64 : ELFCLASS32)
+      || ehdr.e_phentsize != sizeof(phdr))
+  {
+    return 0;
+  }
+
+  for (n = 0; n < ehdr.e_phnum; n++) {
+    off_t off = ehdr.e_phoff + n * sizeof(phdr);
+    if (pread_all(fd, &phdr, sizeof(phdr), off) != SUCCESS) {
+      return 0;
+    }
+    if (phdr.p_type != PT_NOTE) {
+      continue;
+    }
+
+    size_t len = phdr.p_filesz < NOTE_BUF_SIZE ? phdr.p_filesz : NOTE_BUF_SIZE;
+    if (pread_all(fd, buf, len, phdr.p_offset) != SUCCESS) {
+      continue;
+    }
+
+    // notes are 4-byte aligned name and desc after the header
+    size_t pos = 0;
+    while (pos + sizeof(ElfW(Nhdr)) <= len) {
+      ElfW(Nhdr) *note = (ElfW(Nhdr) *) (buf + pos);
+      size_t name_pos = pos + sizeof(ElfW(Nhdr));
+      size_t desc_pos = name_pos + ((note->n_namesz + 3) & ~3);
+      size_t next_pos = desc_pos + ((note->n_descsz + 3) & ~3);
+
+      if (next_pos > len) {
+	break;
+      }
+      if (note->n_type == NT_GNU_BUILD_ID && note->n_namesz == 4
+	  && memcmp(buf + name_pos, "GNU", 4) == 0
+	  && note->n_descsz > 0 && note->n_descsz <= BUILD_ID_MAX)
+      {
+	memcpy(id, buf + desc_pos, note->n_descsz);
+	return note->n_descsz;
+      }
+      pos = next_pos;
+    }
+  }
+
+  return 0;
+}
+
+
+// Fill in the key for 'fname' from its build-id (or path), size and
+// mtime.
+// Returns: SUCCESS or FAILURE.
+//
+static int
+make_key(const char *fname, struct fnbounds_cache_key *key)
+{
+  unsigned char id[BUILD_ID_MAX];
+  char id_str[2 * BUILD_ID_MAX + 1];
+  struct stat sb;
+  size_t k, id_len;
+
+  int fd = open(fname, O_RDONLY);
+  if (fd < 0) {
+    return FAILURE;
+  }
+  if (fstat(fd, &sb) != 0) {
+    close(fd);
+    return FAILURE;
+  }
+  id_len = read_build_id(fd, id);
+  close(fd);
+
+  if (id_len > 0) {
+    for (k = 0; k < id_len; k++) {
+      sprintf(&id_str[2 * k], "%02x", id[k]);
+    }
+  }
+  else {
+    // no build-id: FNV-1a hash of the path
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (k = 0; fname[k] != 0; k++) {
+      hash = (hash ^ (unsigned char) fname[k]) * 0x100000001b3ULL;
+    }
+    sprintf(id_str, "p%016llx", (unsigned long long) hash);
+  }
+
+  key->size = sb.st_size;
+  key->mtime_sec = sb.st_mtim.tv_sec;
+  key->mtime_nsec = sb.st_mtim.tv_nsec;
+  int len = snprintf(key->path, PATH_MAX, "%s/%s-%llx-%llx.%09lld.fnb",
+		     cache_dir, id_str, (unsigned long long) key->size,
+		     (long long) key->mtime_sec, (long long) key->mtime_nsec);
+
+  return (len < PATH_MAX) ? SUCCESS : FAILURE;
+}
+
+
+//*****************************************************************
+// Interface functions
+//*****************************************************************
+
+void *
+hpcrun_fnbounds_cache_lookup(const char *fname,
+			     struct fnbounds_file_header *fh,
+			     struct fnbounds_cache_key *key,
+			     int *key_valid)
+{
+  struct fnbounds_cache_header hdr;
+  struct stat sb;
+  void *addr;
+
+  *key_valid = 0;
+  if (fname == NULL || fh == NULL || ! cache_init()) {
+    return NULL;
+  }
+  if (make_key(fname, key) != SUCCESS) {
+    return NULL;
+  }
+  *key_valid = 1;
+
+  int fd = open(key->path, O_RDONLY);
+  if (fd < 0) {
+    TMSG(FNBOUNDS_CACHE, "miss: %s", fname);
+    hpcrun_stats_fnbounds_cache_miss_inc();
+    return NULL;
+  }
+
+  size_t num_bytes = 0;
+  int ok = pread_all(fd, &hdr, sizeof(hdr), 0) == SUCCESS
+    && fstat(fd, &sb) == 0
+    && memcmp(hdr.magic, FNBOUNDS_CACHE_MAGIC, sizeof(hdr.magic)) == 0
+    && hdr.ptr_size == sizeof(void *)
+    && hdr.size == key->size
+    && hdr.mtime_sec == key->mtime_sec
+    && hdr.mtime_nsec == key->mtime_nsec
+    && hdr.num_entries > 0
+    && hdr.table_offset % page_size() == 0;
+  if (ok) {
+    num_bytes = hdr.num_entries * sizeof(void *);
+    ok = (uint64_t) sb.st_size >= hdr.table_offset + num_bytes;
+  }
+  if (! ok) {
+    close(fd);
+    TMSG(FNBOUNDS_CACHE, "bad entry: %s", key->path);
+    hpcrun_stats_fnbounds_cache_miss_inc();
+    return NULL;
+  }
+
+  size_t mmap_size = page_align(num_bytes);
+  addr = mmap(NULL, mmap_size, PROT_READ, MAP_PRIVATE, fd, hdr.table_offset);
+  close(fd);
+  if (addr == MAP_FAILED) {
+    TMSG(FNBOUNDS_CACHE, "mmap failed: %s", key->path);
+    hpcrun_stats_fnbounds_cache_miss_inc();
+    return NULL;
+  }
+
+  fh->num_entries = hdr.num_entries;
+  fh->reference_offset = hdr.reference_offset;
+  fh->is_relocatable = hdr.is_relocatable;
+  fh->mmap_size = mmap_size;
+
+  TMSG(FNBOUNDS_CACHE, "hit: %s, symbols: %ld", fname, (long) fh->num_entries);
+  hpcrun_stats_fnbounds_cache_hit_inc();
+
+  return addr;
+}
+
+
+void
+hpcrun_fnbounds_cache_store(const struct fnbounds_cache_key *key,
+			    void *table,
+			    const struct fnbounds_file_header *fh)
+{
+  struct fnbounds_cache_header hdr;
+  char tmp_path[PATH_MAX];
+  char host[HOST_NAME_LEN];
+
+  if (cache_status != CACHE_ACTIVE || key == NULL || table == NULL
+      || fh == NULL || fh->num_entries < 1) {
+    return;
+  }
+
+  if (gethostname(host, sizeof(host)) != 0) {
+    strcpy(host, "localhost");
+  }
+  host[sizeof(host) - 1] = 0;
+  if (snprintf(tmp_path, PATH_MAX, "%s.%s.%d.tmp", key->path, host,
+	       (int) getpid()) >= PATH_MAX) {
+    return;
+  }
+
+  int fd = open(tmp_path, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    TMSG(FNBOUNDS_CACHE, "unable to create: %s", tmp_path);
+    return;
+  }
+
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(hdr.magic, FNBOUNDS_CACHE_MAGIC, sizeof(hdr.magic));
+  hdr.size = key->size;
+  hdr.mtime_sec = key->mtime_sec;
+  hdr.mtime_nsec = key->mtime_nsec;
+  hdr.num_entries = fh->num_entries;
+  hdr.reference_offset = fh->reference_offset;
+  hdr.table_offset = page_align(sizeof(hdr));
+  hdr.is_relocatable = fh->is_relocatable;
+  hdr.ptr_size = sizeof(void *);
+
+  int ok = pwrite_all(fd, &hdr, sizeof(hdr), 0) == SUCCESS
+    && pwrite_all(fd, table, fh->num_entries * sizeof(void *),
+		  hdr.table_offset) == SUCCESS;
+  ok = (close(fd) == 0) && ok;
+
+  if (! ok || rename(tmp_path, key->path) != 0) {
+    TMSG(FNBOUNDS_CACHE, "unable to store: %s", key->path);
+    unlink(tmp_path);
+    return;
+  }
+
+  TMSG(FNBOUNDS_CACHE, "stored: %s", key->path);
+}
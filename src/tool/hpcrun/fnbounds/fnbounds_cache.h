@@ -0,0 +1,90 @@
+// -*-Mode: C++;-*- // technically C99
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+// An on-disk cache of fnbounds tables shared between processes.
+//
+// With HPCRUN_FNBOUNDS_CACHE set to a directory, each table computed
+// by the fnbounds server is also written to that directory, and later
+// queries for the same file, from this or any other process, mmap the
+// table directly instead of asking the server.  A node-local
+// directory, eg, under /dev/shm, works best for large parallel jobs.
+//
+// Entries are keyed by the ELF build-id of the file (or a hash of its
+// path if it has none) plus its size and mtime, so a rebuilt file
+// never matches a stale entry.
+
+#ifndef _FNBOUNDS_CACHE_H_
+#define _FNBOUNDS_CACHE_H_
+
+#include <stdint.h>
+#include <sys/param.h>
+
+#include "fnbounds_file_header.h"
+
+struct fnbounds_cache_key {
+  char      path[PATH_MAX];
+  uint64_t  size;
+  int64_t   mtime_sec;
+  int64_t   mtime_nsec;
+};
+
+// Returns: the mmap'd table for 'fname' and fills in the file header,
+// or else NULL on a miss.  On a miss, 'key' is filled in for a later
+// call to store, if the cache is enabled.
+//
+void *hpcrun_fnbounds_cache_lookup(const char *fname,
+				   struct fnbounds_file_header *fh,
+				   struct fnbounds_cache_key *key,
+				   int *key_valid);
+
+// Atomically add a table from the fnbounds server to the cache.
+// Failures are silent, the cache is only an optimization.
+//
+void hpcrun_fnbounds_cache_store(const struct fnbounds_cache_key *key,
+				 void *table,
+				 const struct fnbounds_file_header *fh);
+
+#endif  // _FNBOUNDS_CACHE_H_
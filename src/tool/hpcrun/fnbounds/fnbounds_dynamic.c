@@ -94,6 +94,7 @@
 #include "fnbounds_file_header.h"
 #include "client.h"
 #include "dylib.h"
+#include "fnbounds_cache.h"
 
 #include <hpcrun/main.h>
 #include <hpcrun_dlfns.h>
@@ -154,6 +155,9 @@ fnbounds_compute(const char *filename, void *start, void *end);
 static void
 fnbounds_map_executable();
 
+static void **
+fnbounds_query(const char *filename, struct fnbounds_file_header *fh);
+
 
 //*********************************************************************
 // interface operations
@@ -288,7 +292,7 @@ fnbounds_dso_exec(void)
 
   TMSG(MAP_EXEC, "Entry");
   realpath("/proc/self/exe", filename);
-  void** nm_table = (void**) hpcrun_syserv_query(filename, &fh);
+  void** nm_table = fnbounds_query(filename, &fh);
   if (! nm_table) {
     EMSG("No nm_table for executable %s", filename);
     return hpcrun_dso_make(filename, NULL, NULL, NULL, NULL, 0);
@@ -425,6 +429,27 @@ fnbounds_fetch_executable_table(void)
 // is already locked (mostly).
 //*********************************************************************
 
+// Returns: the fnbounds table for 'filename', mapped from the cache
+// if possible, else computed by the server (and added to the cache).
+static void**
+fnbounds_query(const char* filename, struct fnbounds_file_header* fh)
+{
+  struct fnbounds_cache_key key;
+  int key_valid;
+
+  void** nm_table = (void**)
+    hpcrun_fnbounds_cache_lookup(filename, fh, &key, &key_valid);
+  if (nm_table == NULL) {
+    nm_table = (void**) hpcrun_syserv_query(filename, fh);
+    if (nm_table != NULL && key_valid) {
+      hpcrun_fnbounds_cache_store(&key, nm_table, fh);
+    }
+  }
+
+  return nm_table;
+}
+
+
 static dso_info_t* 
 fnbounds_compute(const char* incoming_filename, void* start, void* end)
 {
@@ -446,7 +471,7 @@ fnbounds_compute(const char* incoming_filename, void* start, void* end)
 
   realpath(incoming_filename, filename);
 
-  nm_table = (void**) hpcrun_syserv_query(filename, &fh);
+  nm_table = fnbounds_query(filename, &fh);
   if (nm_table == NULL) {
     return hpcrun_dso_make(filename, NULL, NULL, start, end, 0);
   }
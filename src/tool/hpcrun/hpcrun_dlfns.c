@@ -98,6 +98,7 @@ static atomic_long dlopen_num_readers = ATOMIC_VAR_INIT(0);
 static volatile long dlopen_num_writers = 0;
 static int  dlopen_writer_tid = -1;
 static atomic_long num_dlopen_pending = ATOMIC_VAR_INIT(0);
+static atomic_long num_dlclose = ATOMIC_VAR_INIT(0);
 
 
 // We use this only in the DLOPEN_RISKY case.
@@ -108,6 +109,13 @@ hpcrun_dlopen_pending(void)
 }
 
 
+long
+hpcrun_dlclose_generation(void)
+{
+  return atomic_load_explicit(&num_dlclose, memory_order_relaxed);
+}
+
+
 // Writers always wait until they acquire the lock.  Now allow writers
 // to lock against themselves, but only in the same thread.
 static void
@@ -228,6 +236,7 @@ hpcrun_post_dlclose(void *handle, int ret)
 
   TMSG(LOADMAP, "dlclose: handle = %p", handle);
   fnbounds_unmap_closed_dsos();
+  atomic_fetch_add_explicit(&num_dlclose, 1L, memory_order_relaxed);
   if (outermost) {
     TD_GET(inside_dlfcn) = false;
   }
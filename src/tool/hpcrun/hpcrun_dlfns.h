@@ -57,4 +57,7 @@ void hpcrun_post_dlclose(void *handle, int ret);
 
 long hpcrun_dlopen_pending(void);
 
+// number of dlclose()s so far, for caches of unwind results
+long hpcrun_dlclose_generation(void);
+
 #endif
@@ -79,6 +79,25 @@ static atomic_long trolled = ATOMIC_VAR_INIT(0);
 static atomic_long frames_total = ATOMIC_VAR_INIT(0);
 static atomic_long trolled_frames = ATOMIC_VAR_INIT(0);
 
+static atomic_long bt_memo_hit = ATOMIC_VAR_INIT(0);
+static atomic_long bt_memo_miss = ATOMIC_VAR_INIT(0);
+static atomic_long bt_memo_frames_skipped = ATOMIC_VAR_INIT(0);
+
+static atomic_long unw_cache_hit = ATOMIC_VAR_INIT(0);
+static atomic_long unw_cache_frames_saved = ATOMIC_VAR_INIT(0);
+
+static atomic_long perf_signals = ATOMIC_VAR_INIT(0);
+static atomic_long perf_ioctls = ATOMIC_VAR_INIT(0);
+static atomic_long perf_records = ATOMIC_VAR_INIT(0);
+static atomic_long perf_records_lost = ATOMIC_VAR_INIT(0);
+static atomic_long blame_dropped = ATOMIC_VAR_INIT(0);
+static atomic_long blame_dropped_value = ATOMIC_VAR_INIT(0);
+static atomic_long trace_handoffs = ATOMIC_VAR_INIT(0);
+static atomic_long trace_stalls = ATOMIC_VAR_INIT(0);
+static atomic_long trace_drops = ATOMIC_VAR_INIT(0);
+static atomic_long fnbounds_cache_hits = ATOMIC_VAR_INIT(0);
+static atomic_long fnbounds_cache_misses = ATOMIC_VAR_INIT(0);
+
 static atomic_long acc_trace_records = ATOMIC_VAR_INIT(0);
 static atomic_long acc_trace_records_dropped = ATOMIC_VAR_INIT(0);
 static atomic_long acc_samples = ATOMIC_VAR_INIT(0);
@@ -104,6 +123,25 @@ hpcrun_stats_reinit(void)
   atomic_store_explicit(&frames_total, 0, memory_order_relaxed);
   atomic_store_explicit(&trolled_frames, 0, memory_order_relaxed);
 
+  atomic_store_explicit(&bt_memo_hit, 0, memory_order_relaxed);
+  atomic_store_explicit(&bt_memo_miss, 0, memory_order_relaxed);
+  atomic_store_explicit(&bt_memo_frames_skipped, 0, memory_order_relaxed);
+
+  atomic_store_explicit(&unw_cache_hit, 0, memory_order_relaxed);
+  atomic_store_explicit(&unw_cache_frames_saved, 0, memory_order_relaxed);
+
+  atomic_store_explicit(&perf_signals, 0, memory_order_relaxed);
+  atomic_store_explicit(&perf_ioctls, 0, memory_order_relaxed);
+  atomic_store_explicit(&perf_records, 0, memory_order_relaxed);
+  atomic_store_explicit(&perf_records_lost, 0, memory_order_relaxed);
+  atomic_store_explicit(&blame_dropped, 0, memory_order_relaxed);
+  atomic_store_explicit(&blame_dropped_value, 0, memory_order_relaxed);
+  atomic_store_explicit(&trace_handoffs, 0, memory_order_relaxed);
+  atomic_store_explicit(&trace_stalls, 0, memory_order_relaxed);
+  atomic_store_explicit(&trace_drops, 0, memory_order_relaxed);
+  atomic_store_explicit(&fnbounds_cache_hits, 0, memory_order_relaxed);
+  atomic_store_explicit(&fnbounds_cache_misses, 0, memory_order_relaxed);
+
   atomic_store_explicit(&acc_trace_records, 0, memory_order_relaxed);
   atomic_store_explicit(&acc_trace_records_dropped, 0, memory_order_relaxed);
 
@@ -401,6 +439,189 @@ hpcrun_stats_trolled_frames(void)
   return atomic_load_explicit(&trolled_frames, memory_order_relaxed);
 }
 
+//---------------------------------------------------------------------
+// backtrace insertions resumed below a memoized path prefix
+//---------------------------------------------------------------------
+
+void
+hpcrun_stats_bt_memo_hit_inc(long frames_skipped)
+{
+  atomic_fetch_add_explicit(&bt_memo_hit, 1L, memory_order_relaxed);
+  atomic_fetch_add_explicit(&bt_memo_frames_skipped, frames_skipped,
+			    memory_order_relaxed);
+}
+
+long
+hpcrun_stats_bt_memo_hit(void)
+{
+  return atomic_load_explicit(&bt_memo_hit, memory_order_relaxed);
+}
+
+long
+hpcrun_stats_bt_memo_frames_skipped(void)
+{
+  return atomic_load_explicit(&bt_memo_frames_skipped, memory_order_relaxed);
+}
+
+void
+hpcrun_stats_bt_memo_miss_inc(void)
+{
+  atomic_fetch_add_explicit(&bt_memo_miss, 1L, memory_order_relaxed);
+}
+
+long
+hpcrun_stats_bt_memo_miss(void)
+{
+  return atomic_load_explicit(&bt_memo_miss, memory_order_relaxed);
+}
+
+//---------------------------------------------------------------------
+// unwinds completed from the unwind cache
+//---------------------------------------------------------------------
+
+void
+hpcrun_stats_unw_cache_hit_inc(long frames_saved)
+{
+  atomic_fetch_add_explicit(&unw_cache_hit, 1L, memory_order_relaxed);
+  atomic_fetch_add_explicit(&unw_cache_frames_saved, frames_saved,
+			    memory_order_relaxed);
+}
+
+long
+hpcrun_stats_unw_cache_hit(void)
+{
+  return atomic_load_explicit(&unw_cache_hit, memory_order_relaxed);
+}
+
+long
+hpcrun_stats_unw_cache_frames_saved(void)
+{
+  return atomic_load_explicit(&unw_cache_frames_saved, memory_order_relaxed);
+}
+
+//---------------------------------------------------------------------
+// linux perf signals, and the ioctls issued while handling them
+//---------------------------------------------------------------------
+
+void
+hpcrun_stats_perf_signal_inc(long ioctls)
+{
+  atomic_fetch_add_explicit(&perf_signals, 1L, memory_order_relaxed);
+  atomic_fetch_add_explicit(&perf_ioctls, ioctls, memory_order_relaxed);
+}
+
+long
+hpcrun_stats_perf_signals(void)
+{
+  return atomic_load_explicit(&perf_signals, memory_order_relaxed);
+}
+
+long
+hpcrun_stats_perf_ioctls(void)
+{
+  return atomic_load_explicit(&perf_ioctls, memory_order_relaxed);
+}
+
+void
+hpcrun_stats_perf_records_inc(long records, long lost)
+{
+  atomic_fetch_add_explicit(&perf_records, records, memory_order_relaxed);
+  atomic_fetch_add_explicit(&perf_records_lost, lost, memory_order_relaxed);
+}
+
+long
+hpcrun_stats_perf_records(void)
+{
+  return atomic_load_explicit(&perf_records, memory_order_relaxed);
+}
+
+long
+hpcrun_stats_perf_records_lost(void)
+{
+  return atomic_load_explicit(&perf_records_lost, memory_order_relaxed);
+}
+
+//---------------------------------------------------------------------
+// directed blame that found no room in a blame map
+//---------------------------------------------------------------------
+
+void
+hpcrun_stats_blame_dropped_inc(long value)
+{
+  atomic_fetch_add_explicit(&blame_dropped, 1L, memory_order_relaxed);
+  atomic_fetch_add_explicit(&blame_dropped_value, value, memory_order_relaxed);
+}
+
+long
+hpcrun_stats_blame_dropped(void)
+{
+  return atomic_load_explicit(&blame_dropped, memory_order_relaxed);
+}
+
+long
+hpcrun_stats_blame_dropped_value(void)
+{
+  return atomic_load_explicit(&blame_dropped_value, memory_order_relaxed);
+}
+
+//---------------------------------------------------------------------
+// async trace output
+//---------------------------------------------------------------------
+
+void
+hpcrun_stats_trace_async_inc(long handoffs, long stalls, long drops)
+{
+  atomic_fetch_add_explicit(&trace_handoffs, handoffs, memory_order_relaxed);
+  atomic_fetch_add_explicit(&trace_stalls, stalls, memory_order_relaxed);
+  atomic_fetch_add_explicit(&trace_drops, drops, memory_order_relaxed);
+}
+
+long
+hpcrun_stats_trace_handoffs(void)
+{
+  return atomic_load_explicit(&trace_handoffs, memory_order_relaxed);
+}
+
+long
+hpcrun_stats_trace_stalls(void)
+{
+  return atomic_load_explicit(&trace_stalls, memory_order_relaxed);
+}
+
+long
+hpcrun_stats_trace_drops(void)
+{
+  return atomic_load_explicit(&trace_drops, memory_order_relaxed);
+}
+
+//---------------------------------------------------------------------
+// fnbounds cache
+//---------------------------------------------------------------------
+
+void
+hpcrun_stats_fnbounds_cache_hit_inc(void)
+{
+  atomic_fetch_add_explicit(&fnbounds_cache_hits, 1L, memory_order_relaxed);
+}
+
+void
+hpcrun_stats_fnbounds_cache_miss_inc(void)
+{
+  atomic_fetch_add_explicit(&fnbounds_cache_misses, 1L, memory_order_relaxed);
+}
+
+long
+hpcrun_stats_fnbounds_cache_hits(void)
+{
+  return atomic_load_explicit(&fnbounds_cache_hits, memory_order_relaxed);
+}
+
+long
+hpcrun_stats_fnbounds_cache_misses(void)
+{
+  return atomic_load_explicit(&fnbounds_cache_misses, memory_order_relaxed);
+}
+
 //----------------------------
 // samples yielded due to deadlock prevention
 //----------------------------
@@ -439,6 +660,25 @@ hpcrun_stats_print_summary(void)
   long cpu_frames = atomic_load_explicit(&frames_total, memory_order_relaxed);
   long cpu_frames_trolled = atomic_load_explicit(&trolled_frames, memory_order_relaxed);
 
+  long cpu_memo_hit = atomic_load_explicit(&bt_memo_hit, memory_order_relaxed);
+  long cpu_memo_miss = atomic_load_explicit(&bt_memo_miss, memory_order_relaxed);
+  long cpu_memo_skipped = atomic_load_explicit(&bt_memo_frames_skipped, memory_order_relaxed);
+
+  long cpu_unw_cache_hit = atomic_load_explicit(&unw_cache_hit, memory_order_relaxed);
+  long cpu_unw_cache_saved = atomic_load_explicit(&unw_cache_frames_saved, memory_order_relaxed);
+
+  long cpu_perf_signals = atomic_load_explicit(&perf_signals, memory_order_relaxed);
+  long cpu_perf_ioctls = atomic_load_explicit(&perf_ioctls, memory_order_relaxed);
+  long cpu_perf_records = atomic_load_explicit(&perf_records, memory_order_relaxed);
+  long cpu_perf_lost = atomic_load_explicit(&perf_records_lost, memory_order_relaxed);
+  long cpu_blame_dropped = atomic_load_explicit(&blame_dropped, memory_order_relaxed);
+  long cpu_blame_dropped_value = atomic_load_explicit(&blame_dropped_value, memory_order_relaxed);
+  long cpu_trace_handoffs = atomic_load_explicit(&trace_handoffs, memory_order_relaxed);
+  long cpu_trace_stalls = atomic_load_explicit(&trace_stalls, memory_order_relaxed);
+  long cpu_trace_drops = atomic_load_explicit(&trace_drops, memory_order_relaxed);
+  long cpu_fnb_hits = atomic_load_explicit(&fnbounds_cache_hits, memory_order_relaxed);
+  long cpu_fnb_misses = atomic_load_explicit(&fnbounds_cache_misses, memory_order_relaxed);
+
   long cpu_intervals_total = atomic_load_explicit(&num_unwind_intervals_total, memory_order_relaxed);
   long cpu_intervals_susp = atomic_load_explicit(&num_unwind_intervals_suspicious, memory_order_relaxed);
 
@@ -457,11 +697,28 @@ hpcrun_stats_print_summary(void)
 
   AMSG("SUMMARY: cpu samples: %ld (recorded: %ld, blocked: %ld, errant: %ld, trolled: %ld, yielded: %ld),\n"
        "         frames: %ld (trolled: %ld)\n"
+       "         path memo: %ld (hits: %ld, misses: %ld, frames skipped: %ld)\n"
+       "         unwind cache hits: %ld (frames saved: %ld)\n"
+       "         perf signals: %ld (ioctls: %ld, per signal: %.2f)\n"
+       "         perf samples drained: %ld (per signal: %.2f, lost: %ld)\n"
+       "         blame dropped: %ld (value: %ld)\n"
+       "         trace buffer handoffs: %ld (stalls: %ld, records dropped: %ld)\n"
+       "         fnbounds cache lookups: %ld (hits: %ld, misses: %ld)\n"
        "         intervals: %ld (suspicious: %ld)\n"
        "         accelerator trace records: %ld (processed: %ld, dropped: %ld)\n"
        "         accelerator samples: %ld (recorded: %ld, dropped: %ld)",
        cpu_total, cpu_valid, cpu_blocked, cpu_dropped, cpu_trolled, cpu_yielded,
        cpu_frames, cpu_frames_trolled,
+       cpu_memo_hit + cpu_memo_miss, cpu_memo_hit, cpu_memo_miss, cpu_memo_skipped,
+       cpu_unw_cache_hit, cpu_unw_cache_saved,
+       cpu_perf_signals, cpu_perf_ioctls,
+       (cpu_perf_signals > 0) ? (double) cpu_perf_ioctls / cpu_perf_signals : 0.0,
+       cpu_perf_records,
+       (cpu_perf_signals > 0) ? (double) cpu_perf_records / cpu_perf_signals : 0.0,
+       cpu_perf_lost,
+       cpu_blame_dropped, cpu_blame_dropped_value,
+       cpu_trace_handoffs, cpu_trace_stalls, cpu_trace_drops,
+       cpu_fnb_hits + cpu_fnb_misses, cpu_fnb_hits, cpu_fnb_misses,
        cpu_intervals_total, cpu_intervals_susp,
        acc_trace + acc_trace_dropped, acc_trace, acc_trace_dropped,
        acc_samp + acc_samp_dropped, acc_samp, acc_samp_dropped
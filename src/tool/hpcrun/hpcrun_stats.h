@@ -188,6 +188,74 @@ long hpcrun_stats_frames_total(void);
 void hpcrun_stats_trolled_frames_inc(long amt);
 long hpcrun_stats_trolled_frames(void);
 
+//---------------------------------------------------------------------
+// backtrace insertions that resumed below a memoized path prefix
+// (hits) or started at the root (misses), and the frames so skipped
+//---------------------------------------------------------------------
+
+void hpcrun_stats_bt_memo_hit_inc(long frames_skipped);
+long hpcrun_stats_bt_memo_hit(void);
+long hpcrun_stats_bt_memo_frames_skipped(void);
+
+void hpcrun_stats_bt_memo_miss_inc(void);
+long hpcrun_stats_bt_memo_miss(void);
+
+//---------------------------------------------------------------------
+// unwinds completed from the unwind cache, and the frames not stepped
+//---------------------------------------------------------------------
+
+void hpcrun_stats_unw_cache_hit_inc(long frames_saved);
+long hpcrun_stats_unw_cache_hit(void);
+long hpcrun_stats_unw_cache_frames_saved(void);
+
+//---------------------------------------------------------------------
+// linux perf overflow signals handled, and the ioctls issued to stop
+// and restart the counters around them
+//---------------------------------------------------------------------
+
+void hpcrun_stats_perf_signal_inc(long ioctls);
+long hpcrun_stats_perf_signals(void);
+long hpcrun_stats_perf_ioctls(void);
+
+//---------------------------------------------------------------------
+// linux perf samples drained from the ring buffers, and the records
+// the kernel reports lost because a buffer was full
+//---------------------------------------------------------------------
+
+void hpcrun_stats_perf_records_inc(long records, long lost);
+long hpcrun_stats_perf_records(void);
+long hpcrun_stats_perf_records_lost(void);
+
+//---------------------------------------------------------------------
+// directed blame dropped because its blame map had no room for the
+// object: the number of times and the blame lost
+//---------------------------------------------------------------------
+
+void hpcrun_stats_blame_dropped_inc(long value);
+long hpcrun_stats_blame_dropped(void);
+long hpcrun_stats_blame_dropped_value(void);
+
+//---------------------------------------------------------------------
+// async trace output: full buffers handed to the writer thread, trace
+// appends that waited for it, and trace records dropped because it
+// fell behind
+//---------------------------------------------------------------------
+
+void hpcrun_stats_trace_async_inc(long handoffs, long stalls, long drops);
+long hpcrun_stats_trace_handoffs(void);
+long hpcrun_stats_trace_stalls(void);
+long hpcrun_stats_trace_drops(void);
+
+//---------------------------------------------------------------------
+// fnbounds cache: tables mapped from the cache and tables that had to
+// be computed by the fnbounds server
+//---------------------------------------------------------------------
+
+void hpcrun_stats_fnbounds_cache_hit_inc(void);
+void hpcrun_stats_fnbounds_cache_miss_inc(void);
+long hpcrun_stats_fnbounds_cache_hits(void);
+long hpcrun_stats_fnbounds_cache_misses(void);
+
 //-----------------------------
 // print summary
 //-----------------------------
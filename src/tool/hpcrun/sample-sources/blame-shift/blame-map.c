@@ -53,6 +53,7 @@
  *****************************************************************************/
 
 #include <assert.h>
+#include <stdbool.h>
 
 
 
@@ -62,6 +63,7 @@
 
 #include "blame-map.h"
 
+#include <hpcrun/hpcrun_stats.h>
 #include <hpcrun/messages/messages.h>
 #include <lib/prof-lean/stdatomic.h>
 #include <memory/hpcrun-malloc.h>
@@ -70,29 +72,21 @@
  * macros
  *****************************************************************************/
 
-#define N (128*1024)
+#define BLAME_MAP_BITS 17
+#define N (1 << BLAME_MAP_BITS)
 #define INDEX_MASK ((N)-1)
 
-#define LOSSLESS_BLAME
+// slots searched for an object before its blame is dropped
+#define PROBE_LIMIT 16
 
-#ifdef BLAME_MAP_LOCKING
+// obj: a slot that has never been used, or that was released
+#define OBJ_EMPTY     0
+#define OBJ_TOMBSTONE 1
 
-#define do_lock() \
-{ \
-  for(;;) { \
-    if (fetch_and_store_i64(&thelock, 1) == 0) break; \
-    while (thelock == 1); \
-  } \
-}
-
-#define do_unlock() thelock = 0
-
-#else
-
-#define do_lock() 
-#define do_unlock()
-
-#endif
+// state: a flag that closes the slot to adds, and the number of adds
+// in progress
+#define STATE_CLOSED      (1ULL << 63)
+#define STATE_WRITERS(s)  ((s) & ~STATE_CLOSED)
 
 
 
@@ -100,52 +94,40 @@
  * data type
  *****************************************************************************/
 
-typedef struct {
-  uint32_t obj_id;
-  uint32_t blame;
-} blame_parts_t;
-
-
-union blame_entry_t {
-  atomic_uint_least64_t  all;
-  blame_parts_t parts; 
+// An open-addressed table keyed by the full address of the object.
+//  - An object claims a free slot with a compare-and-swap on its key,
+//    sets its counter and then opens the slot.
+//  - An add pins an open slot by counting itself in the slot's state,
+//    checks that the slot is still the object's (a pinned slot cannot
+//    be released), adds to the 64-bit counter and unpins the slot.
+//  - Fetching the blame closes every slot of the object in reach,
+//    waits for the adds in progress on it, drains it and releases it
+//    as a tombstone, so that objects that come and go (e.g., locks in
+//    heap memory) do not fill the table.
+// Adds never wait, so they are safe in a signal handler; a fetch waits
+// only for adds that other threads have already begun.  An object may
+// briefly hold two slots, if it adds blame while one of its slots is
+// being claimed or released; fetching sums them.  Blame for an object
+// that finds no slot in PROBE_LIMIT probes is dropped and counted in
+// the hpcrun stats.
+
+struct blame_entry_t {
+  atomic_uint_least64_t obj;    // object, OBJ_EMPTY or OBJ_TOMBSTONE
+  atomic_uint_least64_t state;  // STATE_CLOSED unless owned
+  atomic_uint_least64_t blame;
 };
 
 
 
-/***************************************************************************
- * private data  
- ***************************************************************************/
-
-static uint64_t volatile thelock;
-
-
-
 /***************************************************************************
  * private operations
  ***************************************************************************/
 
-uint32_t 
-blame_map_obj_id(uint64_t obj)
-{
-  return ((uint32_t) ((uint64_t)obj) >> 2);
-}
-
-
-uint32_t 
+static inline uint32_t
 blame_map_hash(uint64_t obj) 
 {
-  return ((uint32_t)((blame_map_obj_id(obj)) & INDEX_MASK));
-}
-
-
-uint64_t 
-blame_map_entry(uint64_t obj, uint32_t metric_value)
-{
-  blame_entry_t be;
-  be.parts.obj_id = blame_map_obj_id(obj);
-  be.parts.blame = metric_value;
-  return atomic_load_explicit(&be.all, memory_order_relaxed);
+  // fibonacci hashing; objects such as locks are at least 8-byte aligned
+  return (uint32_t) (((obj >> 3) * 0x9E3779B97F4A7C15ULL) >> (64 - BLAME_MAP_BITS));
 }
 
 
@@ -167,96 +149,106 @@ blame_map_init(blame_entry_t table[])
 {
   int i;
   for(i = 0; i < N; i++) {
-    table[i].parts.obj_id = 0;
-    table[i].parts.blame = 0;
+    atomic_init(&table[i].obj, OBJ_EMPTY);
+    atomic_init(&table[i].state, STATE_CLOSED);
+    atomic_init(&table[i].blame, 0);
   }
 }
 
 
 void
 blame_map_add_blame(blame_entry_t table[],
-		    uint64_t obj, uint32_t metric_value)
+		    uint64_t obj, uint64_t metric_value)
 {
-  uint32_t obj_id = blame_map_obj_id(obj);
   uint32_t index = blame_map_hash(obj);
-
-  assert(index >= 0 && index < N);
-
-  do_lock();
-  for(;;) {
-    blame_entry_t oldval = table[index];
-
-    if(oldval.parts.obj_id == obj_id) {
-#ifdef LOSSLESS_BLAME
-      blame_entry_t newval = oldval;
-      newval.parts.blame += metric_value;
-      uint64_t oldall = atomic_load_explicit(&oldval.all, memory_order_relaxed);
-      uint64_t testoldall = oldall;
-      uint64_t newall = atomic_load_explicit(&oldval.all, memory_order_relaxed);
-      if (atomic_compare_exchange_strong_explicit(&table[index].all, &oldall, newall,
-						  memory_order_relaxed, memory_order_relaxed) 
-	    == testoldall) break;
-#else
-      oldval.parts.blame += metric_value;
-      table[index].all = oldval.all;
-      break;
-#endif
-    } else {
-      if(oldval.parts.obj_id == 0) {
-	uint64_t newval = blame_map_entry(obj, metric_value);
-#ifdef LOSSLESS_BLAME
-	uint64_t oldall = atomic_load_explicit(&oldval.all, memory_order_relaxed);
-	uint64_t testoldall = oldall;
-	if ((atomic_compare_exchange_strong_explicit(&table[index].all, &oldall, newval,
-						     memory_order_relaxed, memory_order_relaxed)) 
-	    == testoldall) break;
-	// otherwise, try again
-#else
-	table[index].all = newval;
-	break;
-#endif
+  int n;
+
+  for(n = 0; n < PROBE_LIMIT; n++, index = (index + 1) & INDEX_MASK) {
+    blame_entry_t* e = &table[index];
+    uint64_t key = atomic_load(&e->obj);
+
+    if (key == OBJ_EMPTY || key == OBJ_TOMBSTONE) {
+      if (atomic_compare_exchange_strong(&e->obj, &key, obj)) {
+	// the slot stays closed, so nothing else touches the counter
+	atomic_store(&e->blame, metric_value);
+	atomic_store(&e->state, 0);
+	return;
       }
-      else {
-	EMSG("leaked blame %d\n", metric_value);
-	// entry in use for another object's blame
-	// in this case, since it isn't easy to shift 
-	// our blame efficiently, we simply drop it.
+      // another thread got there first; key is now its value
+    }
+
+    if (key != obj) {
+      continue;
+    }
+
+    // pin the slot unless it is closed (being claimed or released)
+    uint64_t state = atomic_load(&e->state);
+    while (!(state & STATE_CLOSED)) {
+      if (atomic_compare_exchange_weak(&e->state, &state, state + 1)) {
 	break;
       }
     }
+    if (state & STATE_CLOSED) {
+      continue;
+    }
+
+    bool is_ours = (atomic_load(&e->obj) == obj);
+    if (is_ours) {
+      atomic_fetch_add(&e->blame, metric_value);
+    }
+    atomic_fetch_sub(&e->state, 1);
+    if (is_ours) {
+      return;
+    }
   }
-  do_unlock();
+
+  // every slot in reach belongs to another object
+  TMSG(LOCKWAIT, "dropped blame %ld for object %p", metric_value, (void *) obj);
+  hpcrun_stats_blame_dropped_inc(metric_value);
 }
 
 
 uint64_t 
 blame_map_get_blame(blame_entry_t table[], uint64_t obj)
 {
-  static uint64_t zero = 0;
-  uint64_t val = 0;
-  uint32_t obj_id = blame_map_obj_id(obj);
   uint32_t index = blame_map_hash(obj);
+  uint64_t total = 0;
+  int n;
 
-  assert(index >= 0 && index < N);
-
-  do_lock();
-  for(;;) {
-    blame_entry_t oldval = table[index];
-    if(oldval.parts.obj_id == obj_id) {
-#ifdef LOSSLESS_BLAME
-      uint64_t oldall = atomic_load_explicit(&oldval.all, memory_order_relaxed);
-      uint64_t testoldall = oldall;
-      if (atomic_compare_exchange_strong_explicit(&table[index].all, &oldall, zero,
-						  memory_order_relaxed, memory_order_relaxed)
-	  != testoldall) continue; // try again on failure
-#else
-      table[index].all = 0;
-#endif
-      val = (uint64_t)oldval.parts.blame;
+  for(n = 0; n < PROBE_LIMIT; n++, index = (index + 1) & INDEX_MASK) {
+    blame_entry_t* e = &table[index];
+    uint64_t key = atomic_load(&e->obj);
+
+    if (key == OBJ_EMPTY) {
+      break; // slots never return to empty, so obj has none further on
+    }
+    if (key != obj) {
+      continue;
     }
-    break;
-  }
-  do_unlock();
 
-  return val;
+    // close the slot; an open slot has an owner that cannot change
+    // until it is released, so check that it is still obj's
+    uint64_t state = atomic_load(&e->state);
+    while (!(state & STATE_CLOSED)) {
+      if (atomic_compare_exchange_weak(&e->state, &state,
+				       state | STATE_CLOSED)) {
+	break;
+      }
+    }
+    if (state & STATE_CLOSED) {
+      continue; // being claimed or released by another thread
+    }
+    if (atomic_load(&e->obj) != obj) {
+      atomic_fetch_and(&e->state, ~STATE_CLOSED);
+      continue;
+    }
+
+    // wait for the adds already in progress, drain and release
+    while (STATE_WRITERS(atomic_load(&e->state)) != 0) {
+      ;
+    }
+    total += atomic_exchange(&e->blame, 0);
+    atomic_store(&e->obj, OBJ_TOMBSTONE);
+  }
+  return total;
 }
@@ -108,7 +108,7 @@ directed_blame_sample(void *arg, int metric_id, cct_node_t *node,
 
   uint64_t obj_to_blame = bi->get_blame_target();
   if (obj_to_blame) {
-    uint32_t metric_value = (uint32_t) (metric_period * metric_incr);
+    uint64_t metric_value = (uint64_t) metric_period * metric_incr;
     blame_map_add_blame(bi->blame_table, obj_to_blame, metric_value); 
     if (bi->wait_metric_id) {
       cct_metric_data_increment(bi->wait_metric_id, node, 
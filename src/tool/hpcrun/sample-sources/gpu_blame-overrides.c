@@ -747,8 +747,8 @@ static inline core_profile_trace_data_t *hpcrun_stream_data_alloc_init(int id) {
     hpcrun_cct2metrics_init(&(st->cct2metrics_map)); //this just does st->map = NULL;
     
     
-    st->trace_min_time_us = 0;
-    st->trace_max_time_us = 0;
+    st->trace_min_time = 0;
+    st->trace_max_time = 0;
     st->hpcrun_file  = NULL;
     
     return st;
@@ -1286,7 +1286,7 @@ static void create_stream0_if_needed(cudaStream_t stream) {
             // store the persistent id one time
             g_stream_array[new_streamId].idle_node_id = hpcrun_cct_persistent_id(idl);
             
-            hpcrun_trace_append(g_stream_array[new_streamId].st, g_stream_array[new_streamId].idle_node_id, HPCRUN_FMT_MetricId_NULL /* null metric id */);
+            hpcrun_trace_append(g_stream_array[new_streamId].st, g_stream_array[new_streamId].idle_node_id, HPCRUN_FMT_MetricId_NULL /* null metric id */, 0);
             
         }
 
@@ -1449,7 +1449,7 @@ static void StreamCreateBookKeeper(cudaStream_t * stream){
         hpcrun_cct_persistent_id_trace_mutate(idl);
         // store the persistent id one time.
         g_stream_array[new_streamId].idle_node_id = hpcrun_cct_persistent_id(idl);
-        hpcrun_trace_append(g_stream_array[new_streamId].st, g_stream_array[new_streamId].idle_node_id, HPCRUN_FMT_MetricId_NULL /* null metric id */);
+        hpcrun_trace_append(g_stream_array[new_streamId].st, g_stream_array[new_streamId].idle_node_id, HPCRUN_FMT_MetricId_NULL /* null metric id */, 0);
         
     }
     
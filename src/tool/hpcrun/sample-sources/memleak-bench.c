@@ -0,0 +1,210 @@
+// -*-Mode: C++;-*- // technically C99
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+
+
+
+//
+// memleak-bench: multi-threaded malloc/free stress test for MEMLEAK
+//
+// A program (built by 'make check' in <builddir>/src/tool/hpcrun) to
+// measure the cost of the memleak overrides when many threads allocate
+// and free concurrently.  Each thread keeps a window of live blocks of
+// random sizes and replaces them at random; a fraction of the blocks
+// are handed to another thread to free, as producer/consumer codes do.
+// Compare the rate with and without hpcrun:
+//
+//   ./memleak-bench -t 8
+//   hpcrun -e MEMLEAK ./memleak-bench -t 8
+//   HPCRUN_MEMLEAK_PROB=0.1 hpcrun -e MEMLEAK ./memleak-bench -t 8
+//
+// Usage: memleak-bench [-t threads] [-n ops] [-l live] [-s max size] [-x percent]
+//
+//   -t  number of threads (default 4)
+//   -n  malloc/free pairs per thread, in thousands (default 2000)
+//   -l  live blocks per thread (default 1024)
+//   -s  largest block, in bytes (default 4096)
+//   -x  percent of blocks freed by another thread (default 25)
+//
+
+//************************* System Include Files ****************************
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+//*************************** Forward Declarations **************************
+
+#define MAX_THREADS  256
+
+typedef struct {
+  pthread_t thread;
+  void** live;            // blocks this thread will free
+  void* volatile* inbox;  // blocks handed over by other threads
+  uint64_t seed;
+  long remote;            // blocks freed for another thread
+} bench_thread_t;
+
+static bench_thread_t threads[MAX_THREADS];
+static int nthreads = 4;
+static long nops = 2000;
+static long nlive = 1024;
+static size_t max_size = 4096;
+static int cross = 25;
+
+//***************************************************************************
+// workload
+//***************************************************************************
+
+static uint64_t
+next_rand(uint64_t* x)
+{
+  *x ^= *x << 13;
+  *x ^= *x >> 7;
+  *x ^= *x << 17;
+  return *x;
+}
+
+
+static double
+now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+static void*
+worker(void* arg)
+{
+  bench_thread_t* self = (bench_thread_t*) arg;
+
+  for (long i = 0; i < nops; i++) {
+    long k = next_rand(&self->seed) % nlive;
+    size_t bytes = 1 + next_rand(&self->seed) % max_size;
+
+    char* p = malloc(bytes);
+    p[0] = p[bytes - 1] = (char) i;
+
+    if ((long) (next_rand(&self->seed) % 100) < cross) {
+      // swap the block into another thread's inbox, and free
+      // whatever block was there
+      bench_thread_t* other = &threads[next_rand(&self->seed) % nthreads];
+      void* old = __sync_lock_test_and_set(&other->inbox[k], p);
+      free(old);
+      self->remote++;
+    }
+    else {
+      free(self->live[k]);
+      self->live[k] = p;
+    }
+  }
+  return NULL;
+}
+
+//***************************************************************************
+
+int
+main(int argc, char* argv[])
+{
+  int c;
+  while ((c = getopt(argc, argv, "t:n:l:s:x:")) != -1) {
+    switch (c) {
+    case 't': nthreads = atoi(optarg); break;
+    case 'n': nops = atol(optarg); break;
+    case 'l': nlive = atol(optarg); break;
+    case 's': max_size = atol(optarg); break;
+    case 'x': cross = atoi(optarg); break;
+    default:
+      fprintf(stderr, "usage: %s [-t threads] [-n Kops] [-l live] [-s max size] "
+	      "[-x percent]\n", argv[0]);
+      return 1;
+    }
+  }
+  if (nthreads < 1 || nthreads > MAX_THREADS || nlive < 1 || max_size < 1) {
+    fprintf(stderr, "bad arguments\n");
+    return 1;
+  }
+  nops *= 1000;
+
+  for (int i = 0; i < nthreads; i++) {
+    threads[i].live = calloc(nlive, sizeof(void*));
+    threads[i].inbox = calloc(nlive, sizeof(void*));
+    threads[i].seed = 88172645463325252ULL + i;
+  }
+
+  double t0 = now();
+  for (int i = 0; i < nthreads; i++) {
+    pthread_create(&threads[i].thread, NULL, worker, &threads[i]);
+  }
+  long remote = 0;
+  for (int i = 0; i < nthreads; i++) {
+    pthread_join(threads[i].thread, NULL);
+    remote += threads[i].remote;
+  }
+  double t = now() - t0;
+
+  for (int i = 0; i < nthreads; i++) {
+    for (long k = 0; k < nlive; k++) {
+      free(threads[i].live[k]);
+      free((void*) threads[i].inbox[k]);
+    }
+    free(threads[i].live);
+    free((void*) threads[i].inbox);
+  }
+
+  long total = nthreads * nops;
+  printf("threads: %d  malloc/free pairs: %ld (%.0f%% cross-thread)  time: %.3f s\n",
+	 nthreads, total, 100.0 * remote / total, t);
+  printf("rate: %.2f M pairs/s  (%.1f ns per pair per thread)\n",
+	 total / t * 1e-6, t * 1e9 * nthreads / total);
+  return 0;
+}
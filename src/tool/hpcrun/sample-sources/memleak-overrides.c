@@ -95,6 +95,7 @@
 #include <monitor-exts/monitor_ext.h>
 #include <lib/prof-lean/spinlock.h>
 #include <lib/prof-lean/splay-macros.h>
+#include <lib/prof-lean/stdatomic.h>
 
 // FIXME: the inline getcontext macro is broken on 32-bit x86, so
 // revert to the getcontext syscall for now.
@@ -123,6 +124,13 @@ typedef struct leakinfo_s {
 
 leakinfo_t leakinfo_NULL = { .magic = 0, .context = NULL, .bytes = 0 };
 
+// a slot of the footer table: the application pointer of a malloc
+// with a footer and its leakinfo struct
+typedef struct memleak_slot_s {
+  atomic_uintptr_t memblock;
+  atomic_uintptr_t info;
+} memleak_slot_t;
+
 typedef void *memalign_fcn(size_t, size_t);
 typedef void *valloc_fcn(size_t);
 typedef void *malloc_fcn(size_t);
@@ -143,6 +151,18 @@ typedef void *realloc_fcn(void *, size_t);
 #define HPCRUN_MEMLEAK_PROB  "HPCRUN_MEMLEAK_PROB"
 #define DEFAULT_PROB  0.1
 
+// The footer table has MEMLEAK_TABLE_SLOTS slots when every malloc is
+// tracked, scaled down by HPCRUN_MEMLEAK_PROB (but not below
+// MEMLEAK_TABLE_MIN_SLOTS).  A malloc whose MEMLEAK_TABLE_PROBE slots
+// are all taken goes in the splay tree instead.
+#define MEMLEAK_TABLE_BITS       20
+#define MEMLEAK_TABLE_SLOTS      (1 << MEMLEAK_TABLE_BITS)
+#define MEMLEAK_TABLE_MIN_SLOTS  (1 << 12)
+#define MEMLEAK_TABLE_PROBE      32
+
+#define MEMLEAK_SLOT_EMPTY  ((uintptr_t) 0)
+#define MEMLEAK_SLOT_FREED  ((uintptr_t) 1)
+
 #ifdef HPCRUN_STATIC_LINK
 #define real_memalign   __real_memalign
 #define real_valloc   __real_valloc
@@ -174,8 +194,13 @@ static int leak_detection_init = 0;    // default is uninitialized
 static int use_memleak_prob = 0;
 static float memleak_prob = 0.0;
 
+static _Atomic(memleak_slot_t *) memleak_table = ATOMIC_VAR_INIT(NULL);
+static size_t memleak_table_size = 0;
+static int memleak_table_shift = 0;
+
 static struct leakinfo_s *memleak_tree_root = NULL;
 static spinlock_t memtree_lock = SPINLOCK_UNLOCKED;
+static atomic_long memleak_tree_count = ATOMIC_VAR_INIT(0);
 
 static int leakinfo_size = sizeof(struct leakinfo_s);
 static long memleak_pagesize = MEMLEAK_DEFAULT_PAGESIZE;
@@ -231,6 +256,7 @@ splay_insert(struct leakinfo_s *node)
     }
   }
   memleak_tree_root = node;
+  atomic_fetch_add_explicit(&memleak_tree_count, 1, memory_order_relaxed);
   spinlock_unlock(&memtree_lock);  
 }
 
@@ -256,6 +282,7 @@ splay_delete(void *memblock)
   }
 
   result = memleak_tree_root;
+  atomic_fetch_sub_explicit(&memleak_tree_count, 1, memory_order_relaxed);
 
   if (memleak_tree_root->left == NULL) {
     memleak_tree_root = memleak_tree_root->right;
@@ -272,6 +299,159 @@ splay_delete(void *memblock)
 
 
 
+/******************************************************************************
+ * footer table operations
+ *
+ * An open-addressing hash table keyed by the application pointer,
+ * shared by all threads (a block may be freed by another thread than
+ * the one that allocated it).  Insert and delete claim a slot with a
+ * compare-and-swap on its key and take no lock.  A key appears at most
+ * once: the address cannot be malloc'd again until it has been freed,
+ * and free removes it before the real free.  Deleted slots are marked
+ * FREED rather than EMPTY (so lookups can still stop at the first
+ * EMPTY slot) and are reused by later inserts.
+ *****************************************************************************/
+
+static void
+memleak_table_init(void)
+{
+  size_t slots = MEMLEAK_TABLE_SLOTS;
+  int shift = 64 - MEMLEAK_TABLE_BITS;
+
+  if (atomic_load_explicit(&memleak_table, memory_order_acquire) != NULL) {
+    return;
+  }
+
+  // scale the table to the expected number of tracked mallocs
+  if (use_memleak_prob) {
+    while (slots > MEMLEAK_TABLE_MIN_SLOTS && slots / 2 >= MEMLEAK_TABLE_SLOTS * memleak_prob) {
+      slots /= 2;
+      shift++;
+    }
+  }
+
+  // the table is untouched until used, so most of it is never resident
+  void *table = mmap(NULL, slots * sizeof(memleak_slot_t), PROT_READ | PROT_WRITE,
+		     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (table == MAP_FAILED) {
+    TMSG(MEMLEAK, "unable to mmap footer table, using the splay tree");
+    return;
+  }
+
+  // threads may race to initialize: the first table installed wins
+  memleak_slot_t *expected = NULL;
+  memleak_table_size = slots;
+  memleak_table_shift = shift;
+  if (! atomic_compare_exchange_strong_explicit(&memleak_table, &expected, table,
+						memory_order_acq_rel,
+						memory_order_acquire)) {
+    munmap(table, slots * sizeof(memleak_slot_t));
+    return;
+  }
+
+  TMSG(MEMLEAK, "footer table: %ld slots", slots);
+}
+
+
+static inline size_t
+memleak_table_hash(uintptr_t key)
+{
+  // fibonacci hashing; the low bits of malloc'd addresses are zero
+  return (size_t) (((uint64_t) (key >> 4) * 0x9E3779B97F4A7C15ULL) >> memleak_table_shift);
+}
+
+
+// Returns: 1 if the node was added to the table, 0 if its probe
+// window was full (or there is no table).
+//
+static int
+memleak_table_insert(struct leakinfo_s *node)
+{
+  memleak_slot_t *table = atomic_load_explicit(&memleak_table, memory_order_acquire);
+  if (table == NULL) {
+    return 0;
+  }
+
+  uintptr_t key = (uintptr_t) node->memblock;
+  size_t mask = memleak_table_size - 1;
+  size_t i = memleak_table_hash(key);
+
+  for (int n = 0; n < MEMLEAK_TABLE_PROBE; n++, i = (i + 1) & mask) {
+    memleak_slot_t *slot = &table[i];
+    uintptr_t old = atomic_load_explicit(&slot->memblock, memory_order_relaxed);
+
+    if ((old == MEMLEAK_SLOT_EMPTY || old == MEMLEAK_SLOT_FREED)
+	&& atomic_compare_exchange_strong_explicit(&slot->memblock, &old, key,
+						   memory_order_acq_rel,
+						   memory_order_relaxed)) {
+      atomic_store_explicit(&slot->info, (uintptr_t) node, memory_order_release);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+
+static struct leakinfo_s *
+memleak_table_delete(void *memblock)
+{
+  memleak_slot_t *table = atomic_load_explicit(&memleak_table, memory_order_acquire);
+  if (table == NULL) {
+    return NULL;
+  }
+
+  uintptr_t key = (uintptr_t) memblock;
+  size_t mask = memleak_table_size - 1;
+  size_t i = memleak_table_hash(key);
+
+  for (int n = 0; n < MEMLEAK_TABLE_PROBE; n++, i = (i + 1) & mask) {
+    memleak_slot_t *slot = &table[i];
+    uintptr_t old = atomic_load_explicit(&slot->memblock, memory_order_acquire);
+
+    if (old == key) {
+      // only the thread freeing memblock can remove it
+      struct leakinfo_s *node =
+	(struct leakinfo_s *) atomic_load_explicit(&slot->info, memory_order_acquire);
+      atomic_store_explicit(&slot->memblock, MEMLEAK_SLOT_FREED, memory_order_release);
+      return node;
+    }
+    if (old == MEMLEAK_SLOT_EMPTY) {
+      break;
+    }
+  }
+  return NULL;
+}
+
+
+// Add a footer to the table, or to the splay tree if the table has
+// no room for it.
+//
+static void
+memleak_insert(struct leakinfo_s *node)
+{
+  if (! memleak_table_insert(node)) {
+    splay_insert(node);
+  }
+}
+
+
+// Remove the footer for memblock from the table or the splay tree.
+// The splay tree (and its lock) is only searched if it has entries.
+//
+static struct leakinfo_s *
+memleak_delete(void *memblock)
+{
+  struct leakinfo_s *node = memleak_table_delete(memblock);
+
+  if (node == NULL
+      && atomic_load_explicit(&memleak_tree_count, memory_order_relaxed) > 0) {
+    node = splay_delete(memblock);
+  }
+  return node;
+}
+
+
+
 /******************************************************************************
  * private operations
  *****************************************************************************/
@@ -335,6 +515,8 @@ memleak_initialize(void)
     srandom(seed);
   }
 
+  memleak_table_init();
+
   // unconditionally enable leak detection for now
   leak_detection_enabled = 1;
   leak_detection_init = 1;
@@ -412,7 +594,7 @@ memleak_get_free_loc(void *appl_ptr, void **sys_ptr, leakinfo_t **info_ptr)
 
   // always try footer
   *sys_ptr = appl_ptr;
-  *info_ptr = splay_delete(appl_ptr);
+  *info_ptr = memleak_delete(appl_ptr);
   if (*info_ptr == NULL) {
     return MEMLEAK_LOC_NONE;
   }
@@ -435,7 +617,7 @@ memleak_get_free_loc(void *appl_ptr, void **sys_ptr, leakinfo_t **info_ptr)
 }
 
 
-// Fill in the leakinfo struct, add metric to CCT, add to splay tree
+// Fill in the leakinfo struct, add metric to CCT, add to footer table
 // (if footer) and print TMSG.
 //
 static void
@@ -469,7 +651,7 @@ memleak_add_leakinfo(const char *name, void *sys_ptr, void *appl_ptr,
     loc_str = "inactive";
   }
   if (loc == MEMLEAK_LOC_FOOT) {
-    splay_insert(info_ptr);
+    memleak_insert(info_ptr);
   }
 
   TMSG(MEMLEAK, "%s: bytes: %ld sys: %p appl: %p info: %p cct: %p (%s)",
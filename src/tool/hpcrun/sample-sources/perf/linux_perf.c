@@ -91,6 +91,7 @@
 #include "sample-sources/ss-errno.h"
  
 #include <hpcrun/cct_insert_backtrace.h>
+#include <hpcrun/cct2metrics.h>
 #include <hpcrun/files.h>
 #include <hpcrun/hpcrun_stats.h>
 #include <hpcrun/loadmap.h>
@@ -99,6 +100,7 @@
 #include <hpcrun/safe-sampling.h>
 #include <hpcrun/sample_event.h>
 #include <hpcrun/sample_sources_registered.h>
+#include <hpcrun/trace_clock.h>
 #include <hpcrun/sample-sources/blame-shift/blame-shift.h>
 #include <hpcrun/utilities/tokenize.h>
 #include <hpcrun/utilities/arch/context-pc.h>
@@ -176,6 +178,15 @@ struct event_threshold_s {
   enum threshold_e threshold_type;
 };
 
+// how the signal handler keeps the counters from sampling the handler
+// itself (HPCRUN_PERF_TOGGLE)
+enum perf_toggle_e {
+  PERF_TOGGLE_ALL,   // disable and re-enable every event: 2 ioctls per event
+  PERF_TOGGLE_EVENT, // the overflowing event disables itself (IOC_REFRESH)
+                     // and is re-armed: 1 ioctl per sample
+  PERF_TOGGLE_NONE   // leave the counters running: no ioctls
+};
+
 //******************************************************************************
 // forward declarations 
 //******************************************************************************
@@ -209,6 +220,14 @@ static event_info_t  *event_desc = NULL;
 
 static struct event_threshold_s default_threshold = {DEFAULT_THRESHOLD, FREQUENCY};
 
+static enum perf_toggle_e perf_toggle = PERF_TOGGLE_ALL;
+
+// attribute the samples drained before the newest one to their own ip
+static bool perf_batch = false;
+
+// records the kernel reports lost are charged to this metric
+static int perf_lost_metric = -1;
+
 static kind_info_t *lnux_kind;
 
 
@@ -239,32 +258,42 @@ perf_was_finalized
 
 /*
  * Enable all the counters
+ * With PERF_TOGGLE_EVENT, each event is armed to disable itself
+ * at its next overflow.
+ * Returns the number of ioctls issued.
  */ 
-static void
+static int
 perf_start_all(int nevents, event_thread_t *event_thread)
 {
-  int i, ret;
+  int i, ret, ioctls = 0;
 
   for(i=0; i<nevents; i++) {
     int fd = event_thread[i].fd;
     if (fd<0) 
       continue; 
  
-    ret = ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    if (perf_toggle == PERF_TOGGLE_EVENT) {
+      ret = ioctl(fd, PERF_EVENT_IOC_REFRESH, 1);
+    } else {
+      ret = ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+    ioctls++;
 
     if (ret == -1) {
       EMSG("Can't enable event with fd: %d: %s", fd, strerror(errno));
     }
   }
+  return ioctls;
 }
 
 /*
  * Disable all the counters
+ * Returns the number of ioctls issued.
  */ 
-static void
+static int
 perf_stop_all(int nevents, event_thread_t *event_thread)
 {
-  int i, ret;
+  int i, ret, ioctls = 0;
 
   for(i=0; i<nevents; i++) {
     int fd = event_thread[i].fd;
@@ -272,10 +301,30 @@ perf_stop_all(int nevents, event_thread_t *event_thread)
       continue; 
  
     ret = ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+    ioctls++;
     if (ret == -1) {
       EMSG("Can't disable event with fd: %d: %s", fd, strerror(errno));
     }
   }
+  return ioctls;
+}
+
+/*
+ * With PERF_TOGGLE_EVENT, re-arm the event that disabled itself at the
+ * overflow that raised this signal (the kernel reports it as POLL_HUP).
+ * Returns the number of ioctls issued.
+ */
+static int
+perf_rearm(siginfo_t *siginfo)
+{
+  if (perf_toggle != PERF_TOGGLE_EVENT || siginfo->si_code != POLL_HUP)
+    return 0;
+
+  int ret = ioctl(siginfo->si_fd, PERF_EVENT_IOC_REFRESH, 1);
+  if (ret == -1) {
+    EMSG("Can't re-arm event with fd: %d: %s", siginfo->si_fd, strerror(errno));
+  }
+  return 1;
 }
 
 static int
@@ -499,13 +548,13 @@ get_fd_index(int nevents, int fd, event_thread_t *event_thread)
 }
 
 
-static sample_val_t*
-record_sample(event_thread_t *current, perf_mmap_data_t *mmap_data,
-    void* context, sample_val_t* sv)
+/*
+ * compute the count a sample stands for, and update the running
+ * statistics of the event's metric
+ */
+static double
+sample_counter(event_thread_t *current, perf_mmap_data_t *mmap_data)
 {
-  if (current == NULL || current->event == NULL || current->event->metric < 0)
-    return NULL;
-
   // ----------------------------------------------------------------------------
   // for event with frequency, we need to increase the counter by its period
   // sampling taken by perf event kernel
@@ -554,14 +603,47 @@ record_sample(event_thread_t *current, perf_mmap_data_t *mmap_data,
   const double delta    = counter - info_aux->threshold_mean;
   info_aux->threshold_mean += delta / info_aux->num_samples;
 
+  return counter;
+}
+
+/*
+ * record a sample in the cct.  A sample drained from the buffer behind
+ * a newer one (use_ip) was not taken at the context of the signal, so
+ * it is attributed to the ip the kernel recorded with it when possible.
+ */
+static sample_val_t*
+record_sample(event_thread_t *current, perf_mmap_data_t *mmap_data,
+    void* context, bool use_ip, sample_val_t* sv)
+{
+  if (current == NULL || current->event == NULL || current->event->metric < 0)
+    return NULL;
+
+  double counter = sample_counter(current, mmap_data);
+
   // ----------------------------------------------------------------------------
   // update the cct and add callchain if necessary
   // ----------------------------------------------------------------------------
-  sampling_info_t info = {.sample_clock = 0, .sample_data = mmap_data};
+  // with the perf trace clock, the kernel stamps samples with
+  // CLOCK_MONOTONIC_RAW (see perf_util_attr_init) and the trace can
+  // use the sample's own time.
+  uint64_t sample_clock = 0;
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,1,0)
+  if (hpcrun_trace_clock_source() == HPCTRACE_CLOCK_PERF) {
+    sample_clock = mmap_data->time;
+  }
+#endif
+  sampling_info_t info = {.sample_clock = sample_clock, .sample_data = mmap_data};
 
-  *sv = hpcrun_sample_callpath(context, current->event->metric,
-        (hpcrun_metricVal_t) {.r=counter},
-        0/*skipInner*/, 0/*isSync*/, &info);
+  hpcrun_sample_val_init(sv);
+  if (use_ip && mmap_data->ip != 0) {
+    *sv = hpcrun_sample_ip((void *) (uintptr_t) mmap_data->ip,
+          current->event->metric, (hpcrun_metricVal_t) {.r=counter}, &info);
+  }
+  if (sv->sample_node == NULL) {
+    *sv = hpcrun_sample_callpath(context, current->event->metric,
+          (hpcrun_metricVal_t) {.r=counter},
+          0/*skipInner*/, 0/*isSync*/, &info);
+  }
 
   blame_shift_apply(current->event->metric, sv->sample_node, 
                     counter /*metricIncr*/);
@@ -569,6 +651,25 @@ record_sample(event_thread_t *current, perf_mmap_data_t *mmap_data,
   return sv;
 }
 
+/*
+ * charge the records the kernel could not write to the ring buffer
+ * to the partial call paths: we don't know where they were taken
+ */
+static void
+record_lost(perf_mmap_data_t *mmap_data)
+{
+  if (perf_lost_metric < 0 || mmap_data->lost == 0)
+    return;
+
+  thread_data_t *td = hpcrun_get_thread_data();
+  epoch_t *epoch = td->core_profile_trace_data.epoch;
+  if (epoch == NULL)
+    return;
+
+  cct_metric_data_increment(perf_lost_metric, epoch->csdata.partial_unw_root,
+        (cct_metric_data_t) {.i=mmap_data->lost});
+}
+
 /***
  * (1) ensure that the default rate for frequency-based sampling is below the maximum.
  * (2) if the environment variable HPCRUN_PERF_COUNT is set, use it to set the threshold
@@ -596,6 +697,41 @@ set_default_threshold()
   TMSG(LINUX_PERF, "default threshold = %d", default_threshold.threshold_val);
 }
 
+/***
+ * set how the signal handler stops the counters while it runs from the
+ * environment variable HPCRUN_PERF_TOGGLE: "all" (default), "event" or "none"
+ */
+static void
+set_toggle_mode()
+{
+  const char *val_str = getenv("HPCRUN_PERF_TOGGLE");
+  if (val_str == NULL || strcasecmp(val_str, "all") == 0) {
+    perf_toggle = PERF_TOGGLE_ALL;
+  } else if (strcasecmp(val_str, "event") == 0) {
+    perf_toggle = PERF_TOGGLE_EVENT;
+  } else if (strcasecmp(val_str, "none") == 0) {
+    perf_toggle = PERF_TOGGLE_NONE;
+  } else {
+    EMSG("Unknown HPCRUN_PERF_TOGGLE value '%s', using 'all'", val_str);
+    perf_toggle = PERF_TOGGLE_ALL;
+  }
+  TMSG(LINUX_PERF, "toggle mode = %d", perf_toggle);
+}
+
+/***
+ * if the environment variable HPCRUN_PERF_BATCH is set to a non-zero
+ * value, the samples the signal handler finds in the buffer before the
+ * newest one are attributed to their own ip instead of to the context
+ * of the signal
+ */
+static void
+set_batch_mode()
+{
+  const char *val_str = getenv("HPCRUN_PERF_BATCH");
+  perf_batch = (val_str != NULL && atoi(val_str) != 0);
+  TMSG(LINUX_PERF, "batch mode = %d", perf_batch);
+}
+
 /******************************************************************************
  * method functions
  *****************************************************************************/
@@ -826,6 +962,8 @@ METHOD_FN(process_event_list, int lush_metrics)
   int i=0;
 
   set_default_threshold();
+  set_toggle_mode();
+  set_batch_mode();
 
   // ----------------------------------------------------------------------
   // for each perf's event, create the metric descriptor which will be used later
@@ -909,6 +1047,9 @@ METHOD_FN(process_event_list, int lush_metrics)
     m->is_frequency_metric = (event_desc[i].attr.freq == 1);
     event_desc[i].metric_desc = m;
   }
+  if (num_events > 0)
+    perf_lost_metric = hpcrun_set_new_metric_info(lnux_kind, "PERF_LOST_RECORDS");
+
   hpcrun_close_kind(lnux_kind);
 
   if (num_events > 0)
@@ -1032,6 +1173,7 @@ perf_event_handler(
 
   if (! hpcrun_safe_enter_async(pc)) {
     hpcrun_stats_num_samples_blocked_async_inc();
+    hpcrun_stats_perf_signal_inc(perf_rearm(siginfo));
 
     HPCTOOLKIT_APPLICATION_ERRNO_RESTORE();
 
@@ -1039,7 +1181,7 @@ perf_event_handler(
   }
 
   // ----------------------------------------------------------------------------
-  // disable all counters
+  // disable all counters (unless the toggle mode says otherwise)
   // ----------------------------------------------------------------------------
 
   sample_source_t *self = &obj_name();
@@ -1054,7 +1196,12 @@ perf_event_handler(
     return 0; // tell monitor that the signal has been handled
   }
 
-  perf_stop_all(nevents, event_thread);
+  // ioctls issued to stop and restart the counters for this signal
+  int ioctls = 0;
+
+  if (perf_toggle == PERF_TOGGLE_ALL) {
+    ioctls += perf_stop_all(nevents, event_thread);
+  }
 
   // ----------------------------------------------------------------------------
   // check #1: check if signal generated by kernel for profiling
@@ -1063,7 +1210,10 @@ perf_event_handler(
   if (siginfo->si_code < 0) {
     TMSG(LINUX_PERF, "signal si_code %d < 0 indicates not from kernel", 
          siginfo->si_code);
-    perf_start_all(nevents, event_thread);
+    if (perf_toggle == PERF_TOGGLE_ALL) {
+      ioctls += perf_start_all(nevents, event_thread);
+    }
+    hpcrun_stats_perf_signal_inc(ioctls);
 
     HPCTOOLKIT_APPLICATION_ERRNO_RESTORE();
 
@@ -1075,6 +1225,12 @@ perf_event_handler(
   // if sampling disabled explicitly for this thread, skip all processing
   // ----------------------------------------------------------------------------
   if (hpcrun_thread_suppress_sample) {
+    // the counters of this thread stay stopped
+    if (perf_toggle != PERF_TOGGLE_ALL) {
+      ioctls += perf_stop_all(nevents, event_thread);
+    }
+    hpcrun_stats_perf_signal_inc(ioctls);
+
     HPCTOOLKIT_APPLICATION_ERRNO_RESTORE();
 
     return 0; // tell monitor that the signal has been handled
@@ -1116,7 +1272,10 @@ perf_event_handler(
        siginfo->si_code, fd);
     hpcrun_safe_exit();
 
-    perf_start_all(nevents, event_thread);
+    if (perf_toggle == PERF_TOGGLE_ALL) {
+      ioctls += perf_start_all(nevents, event_thread);
+    }
+    hpcrun_stats_perf_signal_inc(ioctls);
 
     HPCTOOLKIT_APPLICATION_ERRNO_RESTORE();
 
@@ -1128,6 +1287,7 @@ perf_event_handler(
   // ----------------------------------------------------------------------------
 
   int more_data = 0;
+  long records = 0, lost = 0;
   do {
     perf_mmap_data_t mmap_data;
     memset(&mmap_data, 0, sizeof(perf_mmap_data_t));
@@ -1138,14 +1298,27 @@ perf_event_handler(
     sample_val_t sv;
     memset(&sv, 0, sizeof(sample_val_t));
 
-    if (mmap_data.header_type == PERF_RECORD_SAMPLE)
-      record_sample(current, &mmap_data, context, &sv);
+    if (mmap_data.header_type == PERF_RECORD_SAMPLE) {
+      // only the newest sample was taken at the context of this signal
+      record_sample(current, &mmap_data, context, perf_batch && more_data, &sv);
+      records++;
+    } else if (mmap_data.lost > 0) {
+      record_lost(&mmap_data);
+      lost += mmap_data.lost;
+    }
 
     kernel_block_handler(current, sv, &mmap_data);
 
   } while (more_data);
 
-  perf_start_all(nevents, event_thread);
+  hpcrun_stats_perf_records_inc(records, lost);
+
+  if (perf_toggle == PERF_TOGGLE_ALL) {
+    ioctls += perf_start_all(nevents, event_thread);
+  } else {
+    ioctls += perf_rearm(siginfo);
+  }
+  hpcrun_stats_perf_signal_inc(ioctls);
 
   hpcrun_safe_exit();
 
@@ -48,6 +48,7 @@
 
 #include <linux/version.h>
 #include <ctype.h>
+#include <time.h>
 
 
 /******************************************************************************
@@ -55,6 +56,7 @@
  *****************************************************************************/
 
 #include <hpcrun/cct_insert_backtrace.h>
+#include <hpcrun/trace_clock.h>
 #include <lib/support-lean/OSUtil.h>     // hostid
 
 #include <include/linux_info.h>
@@ -402,6 +404,14 @@ perf_util_attr_init(
   attr->exclude_kernel = EXCLUDE;
   attr->exclude_hv     = EXCLUDE;
 
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,1,0)
+  if (hpcrun_trace_clock_source() == HPCTRACE_CLOCK_PERF) {
+    /* stamp samples in the trace clock's domain */
+    attr->use_clockid = 1;
+    attr->clockid     = CLOCK_MONOTONIC_RAW;
+  }
+#endif
+
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(3,7,0)
   attr->exclude_callchain_user   = EXCLUDE_CALLCHAIN;
   attr->exclude_callchain_kernel = EXCLUDE_CALLCHAIN;
@@ -107,6 +107,9 @@ typedef struct perf_mmap_data_s {
   // only for PERF_RECORD_SWITCH
   u64 	context_switch_time;
 
+  // only for PERF_RECORD_LOST and PERF_RECORD_LOST_SAMPLES
+  u64   lost;
+
 } perf_mmap_data_t;
 
 
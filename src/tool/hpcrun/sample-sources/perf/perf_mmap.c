@@ -51,6 +51,7 @@
 
 #include <assert.h>
 #include <errno.h>
+#include <stdlib.h>
 #include <sys/mman.h>
 #include <string.h>
 #include <unistd.h>
@@ -86,8 +87,11 @@
 #define PERF_DATA_PAGE_EXP        1      // use 2^PERF_DATA_PAGE_EXP pages
 #define PERF_DATA_PAGES           (1 << PERF_DATA_PAGE_EXP)
 
-#define PERF_MMAP_SIZE(pagesz)    ((pagesz) * (PERF_DATA_PAGES + 1))
-#define PERF_TAIL_MASK(pagesz)    (((pagesz) * PERF_DATA_PAGES) - 1)
+// the number of data pages can be set with HPCRUN_PERF_MMAP_PAGES
+#define PERF_MMAP_PAGES_ENV       "HPCRUN_PERF_MMAP_PAGES"
+
+#define PERF_MMAP_SIZE(pagesz)    ((pagesz) * (data_pages + 1))
+#define PERF_TAIL_MASK(pagesz)    (((pagesz) * data_pages) - 1)
 
 
 
@@ -96,8 +100,7 @@
  *****************************************************************************/
 
 static void
-skip_perf_data(pe_mmap_t *current_perf_mmap, size_t sz) 
-__attribute__ ((unused));
+skip_perf_data(pe_mmap_t *current_perf_mmap, size_t sz);
 
 
 
@@ -107,6 +110,7 @@ __attribute__ ((unused));
 
 static int pagesize      = 0;
 static size_t tail_mask  = 0;
+static int data_pages    = PERF_DATA_PAGES;
 
 
 /******************************************************************************
@@ -291,12 +295,16 @@ perf_sample_callchain(pe_mmap_t *current_perf_mmap, perf_mmap_data_t* mmap_data)
       // simplest solution I can come up.
       mmap_data->nr = (num_records < MAX_CALLCHAIN_FRAMES ? num_records : MAX_CALLCHAIN_FRAMES);
 
-      // read the IPs for the frames
-      if (perf_read( current_perf_mmap, mmap_data->ips, num_records * sizeof(u64)) != 0) {
+      // read the IPs for the frames we keep and skip the rest, so that
+      // the fields after the callchain are read from the right place
+      if (perf_read( current_perf_mmap, mmap_data->ips, mmap_data->nr * sizeof(u64)) != 0) {
         // the data seems invalid
         mmap_data->nr = 0;
         TMSG(LINUX_PERF, "unable to read all %d frames", mmap_data->nr);
       }
+      else if (num_records > mmap_data->nr) {
+        skip_perf_data(current_perf_mmap, (num_records - mmap_data->nr) * sizeof(u64));
+      }
     }
   } else {
     TMSG(LINUX_PERF, "unable to read the number of frames" );
@@ -321,6 +329,18 @@ skip_perf_data(pe_mmap_t *current_perf_mmap, size_t sz)
   hdr->data_tail += sz;
 }
 
+//----------------------------------------------------------
+// move the tail to the end of the current record, whatever
+// part of it has been parsed
+//----------------------------------------------------------
+static void
+skip_perf_data_to(pe_mmap_t *current_perf_mmap, u64 record_end)
+{
+  u64 data_head = perf_mmap_read_head(current_perf_mmap);
+
+  current_perf_mmap->data_tail = (record_end < data_head ? record_end : data_head);
+}
+
 /**
  * parse mmapped buffer and copy the values into perf_mmap_data_t mmap_info.
  * we assume mmap_info is already initialized.
@@ -448,16 +468,39 @@ read_perf_buffer(event_thread_t *current, perf_mmap_data_t *mmap_info)
     return 0;
   }
 
+  if (hdr.size < sizeof(pe_header_t)) {
+    // the buffer is corrupted: drop what is left of it
+    skip_perf_data(current_perf_mmap, num_of_more_perf_data(current_perf_mmap));
+    return 0;
+  }
+
+  // the record ends hdr.size bytes after its header; whatever we do
+  // not parse below is skipped
+  u64 record_end = current_perf_mmap->data_tail - sizeof(pe_header_t) + hdr.size;
+
   mmap_info->header_type = hdr.type;
   mmap_info->header_misc = hdr.misc;
 
   if (hdr.type == PERF_RECORD_SAMPLE) {
-      if (hdr.size <= 0) {
-        return 0;
-      }
       int sample_type = current->event->attr.sample_type;
       parse_buffer(sample_type, current, mmap_info);
 
+  } else if (hdr.type == PERF_RECORD_LOST) {
+      // the ring buffer was full
+      u64 id;
+      perf_read_u64(current_perf_mmap, &id);
+      perf_read_u64(current_perf_mmap, &mmap_info->lost);
+      TMSG(LINUX_PERF, "[%d] lost records %d",
+    		 current->fd, mmap_info->lost);
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,2,0)
+  } else if (hdr.type == PERF_RECORD_LOST_SAMPLES) {
+      // samples dropped before they reached the buffer (e.g., PEBS)
+      perf_read_u64(current_perf_mmap, &mmap_info->lost);
+      TMSG(LINUX_PERF, "[%d] lost samples %d",
+    		 current->fd, mmap_info->lost);
+#endif
+
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(4,3,0)
   } else if (hdr.type == PERF_RECORD_SWITCH) {
       // only available since kernel 4.3
@@ -478,27 +521,17 @@ read_perf_buffer(event_thread_t *current, perf_mmap_data_t *mmap_info)
       if (type & PERF_SAMPLE_CPU) {
         perf_read( current_perf_mmap, &cpu, sizeof(cpu) ) ;
       }
-#elif LINUX_VERSION_CODE >= KERNEL_VERSION(4,2,0)
-  } else if (hdr.type == PERF_RECORD_LOST_SAMPLES) {
-     u64 lost_samples;
-     perf_read_u64(current_perf_mmap, &lost_samples);
-     TMSG(LINUX_PERF, "[%d] lost samples %d",
-    		 current->fd, lost_samples);
-     skip_perf_data(current_perf_mmap, hdr.size-sizeof(lost_samples))
 #endif
 
   } else {
-      // not a PERF_RECORD_SAMPLE nor PERF_RECORD_SWITCH
-      // skip it
-      if (hdr.size <= 0) {
-        return 0;
-      }
-      //skip_perf_data(current_perf_mmap, hdr.size);
+      // not a record we use: skip it
       TMSG(LINUX_PERF, "[%d] skip header %d  %d : %d bytes",
     		  current->fd,
     		  hdr.type, hdr.misc, hdr.size);
   }
 
+  skip_perf_data_to(current_perf_mmap, record_end);
+
   return (has_more_perf_data(current_perf_mmap));
 }
 
@@ -516,7 +549,10 @@ set_mmap(int perf_fd)
      MAP_SHARED, perf_fd, MMAP_OFFSET_0);
 
   if (map_result == MAP_FAILED) {
-    EMSG("Linux perf mmap failed: %s", strerror(errno));
+    EMSG("Linux perf mmap of %d data pages failed: %s", data_pages, strerror(errno));
+    if (data_pages > PERF_DATA_PAGES) {
+      EMSG("(the limit on perf buffers per user is set by /proc/sys/kernel/perf_event_mlock_kb)");
+    }
     return NULL;
   }
 
@@ -548,6 +584,20 @@ void
 perf_mmap_init()
 {
   pagesize = sysconf(_SC_PAGESIZE);
+
+  // the number of data pages must be a power of 2
+  const char *val_str = getenv(PERF_MMAP_PAGES_ENV);
+  if (val_str != NULL) {
+    long val = atol(val_str);
+    if (val > 0 && (val & (val - 1)) == 0) {
+      data_pages = val;
+    } else {
+      EMSG("%s=%s is not a power of 2, using %d pages",
+           PERF_MMAP_PAGES_ENV, val_str, PERF_DATA_PAGES);
+    }
+  }
+  TMSG(LINUX_PERF, "ring buffer: %d data pages", data_pages);
+
   tail_mask = PERF_TAIL_MASK(pagesize);
 }
 
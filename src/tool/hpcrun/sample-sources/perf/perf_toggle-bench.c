@@ -0,0 +1,378 @@
+// -*-Mode: C++;-*- // technically C99
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+
+//
+// perf_toggle-bench: cost of the linux_perf signal handler's toggle modes
+//
+// A harness (built by 'make check' in <builddir>/src/tool/hpcrun when
+// perf events are enabled) that measures the per-sample cost of the
+// ways linux_perf.c can keep the counters from sampling its own signal
+// handler (HPCRUN_PERF_TOGGLE):
+//
+//   all    disable and re-enable every event in each signal
+//   event  the overflowing event disables itself (PERF_EVENT_IOC_REFRESH)
+//          and only it is re-armed
+//   none   leave the counters running and only drain the ring buffer
+//
+// It opens the events on itself, runs a fixed compute loop once without
+// sampling and once per mode, and reports samples/sec and the overhead
+// per sample against the unsampled run.  The handler does what the
+// hpcrun handler does apart from unwinding: toggle the counters and
+// drain the ring buffer of the event that overflowed.
+//
+// Usage: perf_toggle-bench [-e events] [-p period] [-n iterations] [-s]
+//
+//   -e  number of events (default 4)
+//   -p  sample period (default 200000 events, or ns with -s)
+//   -n  iterations of the compute loop, in millions (default 2000)
+//   -s  use software task-clock events instead of hardware counters
+//
+
+//************************* System Include Files ****************************
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include <linux/perf_event.h>
+
+//*************************** Forward Declarations **************************
+
+#define BENCH_SIGNAL  (SIGRTMIN+4)
+#define MAX_EVENTS    16
+#define MMAP_PAGES    8   // data pages per ring buffer (a power of 2)
+
+enum toggle_e { TOGGLE_ALL, TOGGLE_EVENT, TOGGLE_NONE, TOGGLE_OFF };
+
+static const char* toggle_name[] = { "all", "event", "none", "off" };
+
+typedef struct {
+  int fd;
+  struct perf_event_mmap_page* hdr;
+  char* data;
+  size_t data_size;
+} bench_event_t;
+
+static bench_event_t events[MAX_EVENTS];
+static int nevents = 4;
+static enum toggle_e toggle;
+
+static volatile long num_signals;
+static volatile long num_ioctls;
+static volatile long num_samples;
+
+//***************************************************************************
+// ring buffer and handler
+//***************************************************************************
+
+static void
+drain(bench_event_t* e)
+{
+  uint64_t head = e->hdr->data_head;
+  __sync_synchronize(); // read the data after data_head
+  uint64_t tail = e->hdr->data_tail;
+
+  while (tail + sizeof(struct perf_event_header) <= head) {
+    struct perf_event_header h;
+    char* p = (char*) &h;
+    for (size_t i = 0; i < sizeof(h); i++) {
+      p[i] = e->data[(tail + i) & (e->data_size - 1)];
+    }
+    if (h.size == 0) {
+      break;
+    }
+    if (h.type == PERF_RECORD_SAMPLE) {
+      num_samples++;
+    }
+    tail += h.size;
+  }
+
+  __sync_synchronize(); // finish reading before releasing the space
+  e->hdr->data_tail = head;
+}
+
+
+static void
+set_all(unsigned long request, unsigned long arg)
+{
+  for (int i = 0; i < nevents; i++) {
+    if (ioctl(events[i].fd, request, arg) == -1) {
+      perror("ioctl");
+    }
+    num_ioctls++;
+  }
+}
+
+
+static void
+handler(int sig, siginfo_t* siginfo, void* context)
+{
+  num_signals++;
+
+  if (toggle == TOGGLE_ALL) {
+    set_all(PERF_EVENT_IOC_DISABLE, 0);
+  }
+
+  for (int i = 0; i < nevents; i++) {
+    if (events[i].fd == siginfo->si_fd) {
+      drain(&events[i]);
+      break;
+    }
+  }
+
+  if (toggle == TOGGLE_ALL) {
+    set_all(PERF_EVENT_IOC_ENABLE, 0);
+  }
+  else if (toggle == TOGGLE_EVENT && siginfo->si_code == POLL_HUP) {
+    ioctl(siginfo->si_fd, PERF_EVENT_IOC_REFRESH, 1);
+    num_ioctls++;
+  }
+}
+
+//***************************************************************************
+// events
+//***************************************************************************
+
+static void
+open_events(int software, long period)
+{
+  static const uint64_t hw_config[] = {
+    PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_BRANCH_INSTRUCTIONS, PERF_COUNT_HW_REF_CPU_CYCLES,
+  };
+  long page_size = sysconf(_SC_PAGESIZE);
+
+  for (int i = 0; i < nevents; i++) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    if (software) {
+      attr.type = PERF_TYPE_SOFTWARE;
+      attr.config = PERF_COUNT_SW_TASK_CLOCK;
+    }
+    else {
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = hw_config[i % (sizeof(hw_config) / sizeof(hw_config[0]))];
+    }
+    attr.sample_period = period;
+    attr.sample_type = PERF_SAMPLE_IP | PERF_SAMPLE_TID | PERF_SAMPLE_TIME;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.wakeup_events = 1;
+
+    int fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+    if (fd < 0) {
+      fprintf(stderr, "perf_event_open: %s%s\n", strerror(errno),
+	      software ? "" : " (try -s for software events)");
+      exit(1);
+    }
+
+    size_t len = (1 + MMAP_PAGES) * page_size;
+    void* buf = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (buf == MAP_FAILED) {
+      perror("mmap");
+      exit(1);
+    }
+
+    struct f_owner_ex owner;
+    owner.type = F_OWNER_TID;
+    owner.pid = syscall(SYS_gettid);
+    if (fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_ASYNC) == -1
+	|| fcntl(fd, F_SETSIG, BENCH_SIGNAL) == -1
+	|| fcntl(fd, F_SETOWN_EX, &owner) == -1) {
+      perror("fcntl");
+      exit(1);
+    }
+
+    events[i].fd = fd;
+    events[i].hdr = (struct perf_event_mmap_page*) buf;
+    events[i].data = (char*) buf + page_size;
+    events[i].data_size = MMAP_PAGES * page_size;
+  }
+}
+
+
+static void
+close_events(void)
+{
+  long page_size = sysconf(_SC_PAGESIZE);
+  for (int i = 0; i < nevents; i++) {
+    munmap(events[i].hdr, (1 + MMAP_PAGES) * page_size);
+    close(events[i].fd);
+  }
+}
+
+//***************************************************************************
+// workload
+//***************************************************************************
+
+static double
+now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+static uint64_t
+work(long iterations)
+{
+  uint64_t x = 88172645463325252ULL;
+  for (long i = 0; i < iterations; i++) {
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+  }
+  return x;
+}
+
+
+static double
+run(enum toggle_e mode, int software, long period, long iterations,
+    uint64_t* checksum)
+{
+  toggle = mode;
+  num_signals = num_ioctls = num_samples = 0;
+
+  if (mode != TOGGLE_OFF) {
+    open_events(software, period);
+    for (int i = 0; i < nevents; i++) {
+      ioctl(events[i].fd, PERF_EVENT_IOC_RESET, 0);
+    }
+    if (mode == TOGGLE_EVENT) {
+      set_all(PERF_EVENT_IOC_REFRESH, 1);
+    }
+    else {
+      set_all(PERF_EVENT_IOC_ENABLE, 0);
+    }
+    num_ioctls = 0;
+  }
+
+  double t0 = now();
+  *checksum ^= work(iterations);
+  double t = now() - t0;
+
+  if (mode != TOGGLE_OFF) {
+    set_all(PERF_EVENT_IOC_DISABLE, 0);
+    close_events();
+  }
+  return t;
+}
+
+//***************************************************************************
+
+int
+main(int argc, char* argv[])
+{
+  long period = 0;
+  long iterations = 2000;
+  int software = 0;
+
+  int c;
+  while ((c = getopt(argc, argv, "e:p:n:s")) != -1) {
+    switch (c) {
+    case 'e': nevents = atoi(optarg); break;
+    case 'p': period = atol(optarg); break;
+    case 'n': iterations = atol(optarg); break;
+    case 's': software = 1; break;
+    default:
+      fprintf(stderr, "usage: %s [-e events] [-p period] [-n Miterations] [-s]\n",
+	      argv[0]);
+      return 1;
+    }
+  }
+  if (nevents < 1 || nevents > MAX_EVENTS) {
+    fprintf(stderr, "-e must be between 1 and %d\n", MAX_EVENTS);
+    return 1;
+  }
+  if (period <= 0) {
+    period = 200000;
+  }
+  iterations *= 1000000;
+
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_sigaction = handler;
+  sa.sa_flags = SA_SIGINFO | SA_RESTART;
+  sigemptyset(&sa.sa_mask);
+  sigaction(BENCH_SIGNAL, &sa, NULL);
+
+  uint64_t checksum = 0;
+  double base = run(TOGGLE_OFF, software, period, iterations, &checksum);
+
+  printf("%d %s events, period %ld, unsampled run %.3fs\n", nevents,
+	 software ? "task-clock" : "hardware", period, base);
+  printf("%-6s %10s %10s %8s %9s %12s %16s\n", "mode", "signals", "samples",
+	 "ioctls", "time(s)", "samples/s", "overhead/sample");
+
+  enum toggle_e modes[] = { TOGGLE_ALL, TOGGLE_EVENT, TOGGLE_NONE };
+  for (unsigned int m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+    double t = run(modes[m], software, period, iterations, &checksum);
+    long signals = num_signals;
+    printf("%-6s %10ld %10ld %8.2f %9.3f %12.0f %13.2f us\n",
+	   toggle_name[modes[m]], signals, (long) num_samples,
+	   signals ? (double) num_ioctls / signals : 0.0, t,
+	   num_samples / t,
+	   signals ? (t - base) / signals * 1e6 : 0.0);
+  }
+
+  return (checksum == 42); // keep the loop
+}
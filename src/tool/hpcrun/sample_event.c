@@ -67,6 +67,7 @@
 #include "handling_sample.h"
 #include "unwind.h"
 #include <utilities/arch/context-pc.h>
+#include <utilities/ip-normalized.h>
 #include "hpcrun-malloc.h"
 #include "sample_event.h"
 #include "sample_sources_all.h"
@@ -298,7 +299,9 @@ hpcrun_sample_callpath(void* context, int metricId,
 
     TMSG(TRACE, "Changed persistent id to indicate mutation of func_proxy node");
 
-    hpcrun_trace_append(&td->core_profile_trace_data, func_proxy, metricId);
+    uint64_t sample_clock = (data != NULL) ? data->sample_clock : 0;
+    hpcrun_trace_append(&td->core_profile_trace_data, func_proxy, metricId,
+			sample_clock);
     TMSG(TRACE, "Appended func_proxy node to trace");
   }
 
@@ -317,6 +320,75 @@ hpcrun_sample_callpath(void* context, int metricId,
   return ret;
 }
 
+
+//
+// Record a sample at an instruction pointer reported by the sample
+// source (e.g., a record drained from the perf ring buffer) rather
+// than at a context.  There is no unwind, so the ip is recorded under
+// the partial unwind root, followed by the kernel call chain (if any)
+// in data.  If the ip is not in a known load module, nothing is
+// recorded and the sample node is NULL.
+//
+sample_val_t
+hpcrun_sample_ip(void* ip, int metricId,
+		 hpcrun_metricVal_t metricIncr, sampling_info_t *data)
+{
+  sample_val_t ret;
+  hpcrun_sample_val_init(&ret);
+
+  if (monitor_block_shootdown()) {
+    monitor_unblock_shootdown();
+    return ret;
+  }
+
+  if (! hpctoolkit_sampling_is_active() || hpcrun_is_sampling_disabled()) {
+    monitor_unblock_shootdown();
+    return ret;
+  }
+
+#ifndef HPCRUN_STATIC_LINK
+  if (! hpcrun_dlopen_read_lock()) {
+    TMSG(SAMPLE_CALLPATH, "skipping ip sample for dlopen lock");
+    hpcrun_stats_num_samples_blocked_dlopen_inc();
+    monitor_unblock_shootdown();
+    return ret;
+  }
+#endif
+
+  thread_data_t* td = hpcrun_get_thread_data();
+  epoch_t* epoch = td->core_profile_trace_data.epoch;
+
+  if (epoch != NULL) {
+    epoch = hpcrun_check_for_new_loadmap(epoch);
+
+    frame_t frm;
+    memset(&frm, 0, sizeof(frame_t));
+    frm.ip_norm = hpcrun_normalize_ip(ip, NULL);
+    frm.the_function = frm.ip_norm;
+
+    if (frm.ip_norm.lm_id != HPCRUN_FMT_LMId_NULL) {
+      TMSG(SAMPLE_CALLPATH, "%s taking ip sample @ %p", __func__, ip);
+      hpcrun_stats_num_samples_total_inc();
+      hpcrun_stats_num_samples_attempted_inc();
+      hpcrun_stats_num_samples_partial_inc();
+
+      void *data_aux = (data != NULL) ? data->sample_data : NULL;
+      ret.sample_node =
+        hpcrun_cct_insert_backtrace_w_metric(epoch->csdata.partial_unw_root,
+                                             metricId, &frm, &frm,
+                                             (cct_metric_data_t) metricIncr,
+                                             data_aux);
+    }
+  }
+
+#ifndef HPCRUN_STATIC_LINK
+  hpcrun_dlopen_read_unlock();
+#endif
+  monitor_unblock_shootdown();
+
+  return ret;
+}
+
 static int const PTHREAD_CTXT_SKIP_INNER = 1;
 
 cct_node_t*
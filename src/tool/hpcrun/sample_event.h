@@ -109,6 +109,10 @@ extern sample_val_t hpcrun_sample_callpath(void *context, int metricId,
 		                   hpcrun_metricVal_t metricIncr,
 				   int skipInner, int isSync, sampling_info_t *data);
 
+extern sample_val_t hpcrun_sample_ip(void *ip, int metricId,
+				     hpcrun_metricVal_t metricIncr,
+				     sampling_info_t *data);
+
 extern cct_node_t* hpcrun_gen_thread_ctxt(void *context);
 
 extern cct_node_t* hpcrun_sample_callpath_w_bt(void *context,
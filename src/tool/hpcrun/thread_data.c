@@ -234,14 +234,15 @@ core_profile_trace_data_init(core_profile_trace_data_t * cptd, int id, cct_ctxt_
   // ----------------------------------------
   // tracing
   // ----------------------------------------
-  cptd->trace_min_time_us = 0;
-  cptd->trace_max_time_us = 0;
+  cptd->trace_min_time = 0;
+  cptd->trace_max_time = 0;
 
   // ----------------------------------------
   // IO support
   // ----------------------------------------
   cptd->hpcrun_file  = NULL;
   cptd->trace_buffer = NULL;
+  hpctrace_fmt_block_init(&cptd->trace_block, NULL);
 
   // ----------------------------------------
   // perf event support
@@ -353,6 +354,12 @@ hpcrun_thread_data_init(int id, cct_ctxt_t* thr_ctxt, int is_child, size_t n_sou
   td->btbuf_sav = td->btbuf_end;  // FIXME: is this needed?
 
   hpcrun_bt_init(&(td->bt), NEW_BACKTRACE_INIT_SZ);
+  hpcrun_unw_cache_init(&(td->unw_cache), BACKTRACE_INIT_SZ);
+
+  td->path_memo.root  = NULL;
+  td->path_memo.len   = 0;
+  td->path_memo.entry = hpcrun_malloc(sizeof(cct_path_memo_entry_t)
+				      * CCT_PATH_MEMO_SZ);
 
   // ----------------------------------------
   // trampoline
@@ -92,6 +92,27 @@ typedef struct gpu_data_t {
 } gpu_data_t;
 
 
+// the deepest backtrace prefix remembered by cct_path_memo_t
+#define CCT_PATH_MEMO_SZ 128
+
+typedef struct cct_path_memo_entry_t {
+  ip_normalized_t   ip_norm;  // frame
+  lush_assoc_info_t as_info;
+  cct_node_t*       node;     // insertion cursor after the frame
+} cct_path_memo_entry_t;
+
+// the path inserted by the previous backtrace of this thread, so that
+// the next backtrace can resume insertion below the common prefix
+// instead of at the root (see cct_insert_backtrace.c)
+typedef struct cct_path_memo_t {
+  cct_node_t* root;        // where the path was inserted; NULL if none
+  long        generation;  // hpcrun_cct_generation() at that time
+  bool        retain_recursion;
+  uint32_t    len;         // valid entries, outermost frame first
+  cct_path_memo_entry_t* entry;
+} cct_path_memo_t;
+
+
 
 /* ******
    TODO:
@@ -193,7 +214,7 @@ typedef struct thread_data_t {
   // core_profile_trace_data contains the following
   // epoch: loadmap + cct + cct_ctxt
   // cct2metrics map: associate a metric_set with
-  // tracing: trace_min_time_us and trace_max_time_us
+  // tracing: trace_min_time and trace_max_time
   // IO support file handle: hpcrun_file;
   // Perf event support
   // ----------------------------------------
@@ -225,6 +246,10 @@ typedef struct thread_data_t {
 
   backtrace_t bt;     // backtrace used for unwinding
 
+  unw_cache_t unw_cache; // outer frames of the last complete unwind
+
+  cct_path_memo_t path_memo; // path of the last inserted backtrace
+
   // ----------------------------------------
   // trampoline
   // ----------------------------------------
@@ -49,7 +49,6 @@
 //*********************************************************************
 
 #include <stdio.h>
-#include <sys/time.h>
 #include <assert.h>
 #include <limits.h>
 
@@ -63,10 +62,13 @@
 #include "disabled.h"
 #include "env.h"
 #include "files.h"
+#include "hpcrun_stats.h"
 #include "monitor.h"
 #include "rank.h"
 #include "string.h"
 #include "trace.h"
+#include "trace_clock.h"
+#include "trace_writer.h"
 #include "thread_data.h"
 #include "sample_prob.h"
 
@@ -90,7 +92,8 @@
 //*********************************************************************
 
 static void hpcrun_trace_file_validate(int valid, char *op);
-static inline void hpcrun_trace_append_with_time_real(core_profile_trace_data_t *cptd, unsigned int call_path_id, uint metric_id, uint64_t microtime);
+static hpctrace_hdr_flags_t hpcrun_trace_hdr_flags(void);
+static inline void hpcrun_trace_append_with_time_real(core_profile_trace_data_t *cptd, unsigned int call_path_id, uint metric_id, uint64_t time);
 
 
 //*********************************************************************
@@ -99,6 +102,9 @@ static inline void hpcrun_trace_append_with_time_real(core_profile_trace_data_t
 
 static int tracing = 0;
 
+// write records in compact blocks (HPCRUN_TRACE_FORMAT)
+static int trace_compact = 0;
+
 //*********************************************************************
 // interface operations
 //*********************************************************************
@@ -115,7 +121,20 @@ hpcrun_trace_init()
 {
   if (getenv(HPCRUN_TRACE)) {
       tracing = 1;
-      TMSG(TRACE, "Tracing is ON");
+      hpcrun_trace_clock_init();
+      hpcrun_trace_writer_init();
+
+      char *format = getenv(HPCRUN_TRACE_FORMAT);
+      trace_compact = 0;
+      if (format != NULL) {
+        if (strcmp(format, "compact") == 0) {
+          trace_compact = 1;
+        }
+        else if (strcmp(format, "fixed") != 0) {
+          EMSG("unknown %s value '%s', using 'fixed'", HPCRUN_TRACE_FORMAT, format);
+        }
+      }
+      TMSG(TRACE, "Tracing is ON (%s records)", trace_compact ? "compact" : "fixed");
   }
 }
 
@@ -142,42 +161,56 @@ hpcrun_trace_open(core_profile_trace_data_t * cptd)
     fd = hpcrun_open_trace_file(cptd->id);
     hpcrun_trace_file_validate(fd >= 0, "open");
     cptd->trace_buffer = hpcrun_malloc(HPCRUN_TraceBufferSz);
-    ret = hpcio_outbuf_attach(&cptd->trace_outbuf, fd, cptd->trace_buffer,
-			      HPCRUN_TraceBufferSz, HPCIO_OUTBUF_UNLOCKED);
+    void *spare = hpcrun_trace_writer_spare(HPCRUN_TraceBufferSz);
+    if (spare != NULL) {
+      ret = hpcio_outbuf_attach_async(&cptd->trace_outbuf, fd,
+				      cptd->trace_buffer, spare,
+				      HPCRUN_TraceBufferSz, HPCIO_OUTBUF_UNLOCKED,
+				      hpcrun_trace_writer_handoff);
+    }
+    else {
+      ret = hpcio_outbuf_attach(&cptd->trace_outbuf, fd, cptd->trace_buffer,
+				HPCRUN_TraceBufferSz, HPCIO_OUTBUF_UNLOCKED);
+    }
     hpcrun_trace_file_validate(ret == HPCFMT_OK, "open");
 
-    hpctrace_hdr_flags_t flags = hpctrace_hdr_flags_NULL;
-#ifdef DATACENTRIC_TRACE
-    flags.fields.isDataCentric = true;
-#else
-    flags.fields.isDataCentric = false;
-#endif
+    hpctrace_fmt_block_init(&cptd->trace_block, NULL);
+    if (trace_compact) {
+      cptd->trace_block.buf = hpcrun_malloc(HPCTRACE_FMT_BlockMaxLen);
+    }
 
-    ret = hpctrace_fmt_hdr_outbuf(flags, &cptd->trace_outbuf);
+    hpctrace_hdr_flags_t flags = hpcrun_trace_hdr_flags();
+    ret = hpctrace_fmt_hdr_outbuf(flags, hpcrun_trace_clock_calibration(),
+				  &cptd->trace_outbuf);
     hpcrun_trace_file_validate(ret == HPCFMT_OK, "write header to");
   }
   TMSG(TRACE, "Trace open done");
 }
 
 
+// microtime is wall-clock microseconds (e.g., from device timers) and
+// is mapped into the domain of the trace clock.
 void
 hpcrun_trace_append_with_time(core_profile_trace_data_t *st, unsigned int call_path_id, uint metric_id, uint64_t microtime)
 {
 	if (tracing && hpcrun_sample_prob_active()) {
-        hpcrun_trace_append_with_time_real(st, call_path_id, metric_id, microtime);
+        uint64_t time = hpcrun_trace_clock_from_wall_us(microtime);
+        hpcrun_trace_append_with_time_real(st, call_path_id, metric_id, time);
 	}
 }
 
 
+// sample_clock is the sample's own timestamp in trace clock units
+// (PERF_SAMPLE_TIME with the perf clock), or 0 to read the clock now.
 void
-hpcrun_trace_append(core_profile_trace_data_t *cptd, cct_node_t* node, uint metric_id)
+hpcrun_trace_append(core_profile_trace_data_t *cptd, cct_node_t* node, uint metric_id,
+		    uint64_t sample_clock)
 {
   if (tracing && hpcrun_sample_prob_active()) {
-    struct timeval tv;
-    int ret = gettimeofday(&tv, NULL);
-    assert(ret == 0 && "in trace_append: gettimeofday failed!");
-    uint64_t microtime = ((uint64_t)tv.tv_usec
-			  + (((uint64_t)tv.tv_sec) * 1000000));
+    uint64_t time = sample_clock;
+    if (time == 0) {
+      time = hpcrun_trace_clock_now();
+    }
 
     // mark the leaf of a call path recorded in a trace record for retention
     // so that the call path associated with the trace record can be recovered.
@@ -185,7 +218,7 @@ hpcrun_trace_append(core_profile_trace_data_t *cptd, cct_node_t* node, uint metr
 
     int32_t call_path_id = hpcrun_cct_persistent_id(node);
 
-    hpcrun_trace_append_with_time_real(cptd, call_path_id, metric_id, microtime);
+    hpcrun_trace_append_with_time_real(cptd, call_path_id, metric_id, time);
   }
 }
 
@@ -198,11 +231,25 @@ hpcrun_trace_close(core_profile_trace_data_t * cptd)
   if (tracing && hpcrun_sample_prob_active()) {
 
     TMSG(TRACE, "Trace active close code");
-    int ret = hpcio_outbuf_close(&cptd->trace_outbuf);
+    int ret = HPCFMT_OK;
+    if (cptd->trace_block.buf != NULL) {
+      ret = hpctrace_fmt_block_outbuf(&cptd->trace_block, &cptd->trace_outbuf);
+    }
+    if (ret == HPCFMT_OK) {
+      ret = hpcio_outbuf_close(&cptd->trace_outbuf);
+    }
     if (ret != HPCFMT_OK) {
       EMSG("unable to flush and close trace file");
     }
 
+    hpcio_outbuf_t *outbuf = &cptd->trace_outbuf;
+    if (outbuf->flags & HPCIO_OUTBUF_ASYNC) {
+      TMSG(TRACE, "async trace: %ld handoffs, %ld stalls, %ld records dropped",
+	   outbuf->handoffs, outbuf->stalls, outbuf->drops);
+      hpcrun_stats_trace_async_inc(outbuf->handoffs, outbuf->stalls,
+				   outbuf->drops);
+    }
+
     int rank = hpcrun_get_rank();
     if (rank >= 0) {
       hpcrun_rename_trace_file(rank, cptd->id);
@@ -215,32 +262,49 @@ hpcrun_trace_close(core_profile_trace_data_t * cptd)
 // private operations
 //*********************************************************************
 
-static inline void hpcrun_trace_append_with_time_real(core_profile_trace_data_t *cptd, unsigned int call_path_id, uint metric_id, uint64_t microtime)
+static inline void hpcrun_trace_append_with_time_real(core_profile_trace_data_t *cptd, unsigned int call_path_id, uint metric_id, uint64_t time)
 {
-    if (cptd->trace_min_time_us == 0) {
-        cptd->trace_min_time_us = microtime;
+    if (cptd->trace_min_time == 0) {
+        cptd->trace_min_time = time;
     }
     
     // TODO: should we need this check???
-    if(cptd->trace_max_time_us < microtime) {
-        cptd->trace_max_time_us = microtime;
+    if(cptd->trace_max_time < time) {
+        cptd->trace_max_time = time;
     }
     
     hpctrace_fmt_datum_t trace_datum;
-    trace_datum.time = microtime;
+    trace_datum.time = time;
     trace_datum.cpId = (uint32_t)call_path_id;
     //TODO: was not in GPU version
     trace_datum.metricId = (uint32_t)metric_id;
     
-    hpctrace_hdr_flags_t flags = hpctrace_hdr_flags_NULL;
+    hpctrace_hdr_flags_t flags = hpcrun_trace_hdr_flags();
+
+    int ret = HPCFMT_OK;
+    if (cptd->trace_block.buf != NULL) {
+      if (hpctrace_fmt_block_append(&cptd->trace_block, &trace_datum, flags)) {
+        ret = hpctrace_fmt_block_outbuf(&cptd->trace_block, &cptd->trace_outbuf);
+      }
+    }
+    else {
+      ret = hpctrace_fmt_datum_outbuf(&trace_datum, flags, &cptd->trace_outbuf);
+    }
+    hpcrun_trace_file_validate(ret == HPCFMT_OK, "append");
+}
+
+
+static hpctrace_hdr_flags_t
+hpcrun_trace_hdr_flags(void)
+{
+  hpctrace_hdr_flags_t flags = hpctrace_hdr_flags_NULL;
 #ifdef DATACENTRIC_TRACE
-    flags.fields.isDataCentric = true;
+  flags.fields.isDataCentric = true;
 #else
-    flags.fields.isDataCentric = false;
+  flags.fields.isDataCentric = false;
 #endif
-    
-    int ret = hpctrace_fmt_datum_outbuf(&trace_datum, flags, &cptd->trace_outbuf);
-    hpcrun_trace_file_validate(ret == HPCFMT_OK, "append");
+  flags.fields.isCompact = trace_compact;
+  return flags;
 }
 
 
@@ -0,0 +1,357 @@
+// -*-Mode: C++;-*- // technically C99
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+
+//***************************************************************************
+//
+// File:
+//   trace_clock.c
+//
+// Purpose:
+//   Clock used to timestamp trace records; see trace_clock.h.
+//
+// Description:
+//   Reading the clock happens inside the sample handler, so it must be
+//   cheap and async-signal safe.  Everything else (choosing the source,
+//   calibrating the TSC, taking the wall time pair recorded in the
+//   trace header) is done once at process initialization.
+//
+//***************************************************************************
+
+//*********************************************************************
+// global includes
+//*********************************************************************
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__x86_64__)
+#include <cpuid.h>
+#endif
+
+
+//*********************************************************************
+// local includes
+//*********************************************************************
+
+#include "env.h"
+#include "trace_clock.h"
+
+#include <messages/messages.h>
+
+#include <lib/support-lean/timer.h>
+
+
+//*********************************************************************
+// macros
+//*********************************************************************
+
+#define NS_PER_SEC        1000000000ULL
+
+// length of the TSC calibration interval, when cpuid does not report
+// the TSC frequency; each process spins for it at initialization
+#define TSC_CALIBRATE_NS  1000000ULL
+
+// fixed point shift for the TSC tick -> nanosecond multiplier
+#define TSC_MULT_SHIFT    32
+
+
+//*********************************************************************
+// local variables
+//*********************************************************************
+
+static hpctrace_clock_source_t clock_source = HPCTRACE_CLOCK_MONOTONIC_RAW;
+
+static hpctrace_hdr_clock_t clock_calibration;
+
+// TSC conversion: ns = tsc_base_ns + ((tsc - tsc_base) * tsc_mult) >> shift
+static uint64_t tsc_base = 0;
+static uint64_t tsc_base_ns = 0;
+static uint64_t tsc_mult = 0;
+static int tsc_use_rdtscp = 0;
+
+
+//*********************************************************************
+// private operations
+//*********************************************************************
+
+static inline uint64_t
+clock_ns(clockid_t clockid)
+{
+  struct timespec ts;
+  clock_gettime(clockid, &ts);
+  return ((uint64_t) ts.tv_sec) * NS_PER_SEC + (uint64_t) ts.tv_nsec;
+}
+
+
+static inline uint64_t
+monotonic_raw_ns(void)
+{
+#ifdef CLOCK_MONOTONIC_RAW
+  return clock_ns(CLOCK_MONOTONIC_RAW);
+#else
+  return clock_ns(CLOCK_MONOTONIC);
+#endif
+}
+
+
+static inline uint64_t
+wall_us(void)
+{
+  uint64_t us = 0;
+  time_getTimeReal(&us);
+  return us;
+}
+
+
+static inline uint64_t
+tsc_read(void)
+{
+  return tsc_use_rdtscp ? time_getTSCP() : time_getTSC();
+}
+
+
+static inline uint64_t
+tsc_ns(void)
+{
+  uint64_t delta = tsc_read() - tsc_base;
+  return tsc_base_ns +
+    (uint64_t) (((unsigned __int128) delta * tsc_mult) >> TSC_MULT_SHIFT);
+}
+
+
+// The TSC is only usable as a clock if it ticks at a constant rate
+// across frequency changes and sleep states (cpuid "invariant TSC").
+static int
+tsc_is_usable(void)
+{
+#if defined(__x86_64__)
+  unsigned int eax, ebx, ecx, edx;
+
+  if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx)
+      || !(edx & (1 << 8))) {
+    return 0;
+  }
+  if (__get_cpuid(0x80000001, &eax, &ebx, &ecx, &edx)) {
+    tsc_use_rdtscp = ((edx & (1 << 27)) != 0);
+  }
+  return 1;
+#else
+  return 0;
+#endif
+}
+
+
+// The nominal TSC frequency in Hz from cpuid leaf 0x15 (TSC to core
+// crystal clock ratio), or 0 if the processor does not report it.
+static uint64_t
+tsc_cpuid_hz(void)
+{
+#if defined(__x86_64__)
+  unsigned int eax, ebx, ecx, edx;
+
+  if (__get_cpuid_max(0, NULL) < 0x15) {
+    return 0;
+  }
+  __cpuid(0x15, eax, ebx, ecx, edx);
+  if (eax == 0 || ebx == 0 || ecx == 0) {
+    return 0;
+  }
+  return ((uint64_t) ecx) * ebx / eax;
+#else
+  return 0;
+#endif
+}
+
+
+// Measure the TSC rate against CLOCK_MONOTONIC_RAW.  Use the frequency
+// reported by cpuid if there is one, which needs no waiting; otherwise
+// busy-wait for TSC_CALIBRATE_NS.
+static int
+tsc_calibrate(void)
+{
+  uint64_t hz = tsc_cpuid_hz();
+  if (hz != 0) {
+    tsc_mult = (uint64_t) ((((unsigned __int128) NS_PER_SEC) << TSC_MULT_SHIFT) / hz);
+    tsc_base = tsc_read();
+    tsc_base_ns = monotonic_raw_ns();
+
+    TMSG(TRACE, "TSC frequency from cpuid: %"PRIu64" Hz (rdtscp = %d)",
+         hz, tsc_use_rdtscp);
+    return 1;
+  }
+
+  uint64_t ns0 = monotonic_raw_ns();
+  uint64_t tsc0 = tsc_read();
+
+  uint64_t ns1, tsc1;
+  do {
+    ns1 = monotonic_raw_ns();
+    tsc1 = tsc_read();
+  } while (ns1 - ns0 < TSC_CALIBRATE_NS);
+
+  if (tsc1 <= tsc0) {
+    return 0;
+  }
+
+  tsc_mult = (uint64_t)
+    ((((unsigned __int128) (ns1 - ns0)) << TSC_MULT_SHIFT) / (tsc1 - tsc0));
+  tsc_base = tsc1;
+  tsc_base_ns = ns1;
+
+  TMSG(TRACE, "TSC calibrated: %"PRIu64" ticks in %"PRIu64" ns (rdtscp = %d)",
+       tsc1 - tsc0, ns1 - ns0, tsc_use_rdtscp);
+  return 1;
+}
+
+
+static hpctrace_clock_source_t
+clock_source_from_env(void)
+{
+  char* str = getenv(HPCRUN_TRACE_CLOCK);
+
+  if (str == NULL || strcmp(str, "monotonic") == 0) {
+    return HPCTRACE_CLOCK_MONOTONIC_RAW;
+  }
+  if (strcmp(str, "tsc") == 0) {
+    return HPCTRACE_CLOCK_TSC;
+  }
+  if (strcmp(str, "perf") == 0) {
+    return HPCTRACE_CLOCK_PERF;
+  }
+  if (strcmp(str, "gettimeofday") == 0) {
+    return HPCTRACE_CLOCK_WALL_US;
+  }
+
+  EMSG("unknown %s value '%s', using 'monotonic'", HPCRUN_TRACE_CLOCK, str);
+  return HPCTRACE_CLOCK_MONOTONIC_RAW;
+}
+
+
+//*********************************************************************
+// interface operations
+//*********************************************************************
+
+void
+hpcrun_trace_clock_init(void)
+{
+  clock_source = clock_source_from_env();
+
+  if (clock_source == HPCTRACE_CLOCK_TSC
+      && !(tsc_is_usable() && tsc_calibrate())) {
+    EMSG("no invariant TSC available, tracing with 'monotonic' clock");
+    clock_source = HPCTRACE_CLOCK_MONOTONIC_RAW;
+  }
+
+  // Bracket the wall clock reading between two trace clock readings
+  // and use their midpoint to halve the calibration error.
+  clock_calibration.source = clock_source;
+  if (clock_source == HPCTRACE_CLOCK_WALL_US) {
+    clock_calibration.clockBase = 0;
+    clock_calibration.wallBase = 0;
+  }
+  else {
+    uint64_t before = hpcrun_trace_clock_now();
+    uint64_t wall_ns = clock_ns(CLOCK_REALTIME);
+    uint64_t after = hpcrun_trace_clock_now();
+
+    clock_calibration.clockBase = before + (after - before) / 2;
+    clock_calibration.wallBase = wall_ns;
+  }
+
+  TMSG(TRACE, "trace clock: source %d, base %"PRIu64", wall %"PRIu64,
+       (int) clock_source, clock_calibration.clockBase,
+       clock_calibration.wallBase);
+}
+
+
+hpctrace_clock_source_t
+hpcrun_trace_clock_source(void)
+{
+  return clock_source;
+}
+
+
+uint64_t
+hpcrun_trace_clock_now(void)
+{
+  switch (clock_source) {
+  case HPCTRACE_CLOCK_TSC:
+    return tsc_ns();
+  case HPCTRACE_CLOCK_WALL_US:
+    return wall_us();
+  default:
+    return monotonic_raw_ns();
+  }
+}
+
+
+const hpctrace_hdr_clock_t*
+hpcrun_trace_clock_calibration(void)
+{
+  return &clock_calibration;
+}
+
+
+uint64_t
+hpcrun_trace_clock_to_wall_us(uint64_t time)
+{
+  return hpctrace_fmt_time_to_wall_us(&clock_calibration, time);
+}
+
+
+uint64_t
+hpcrun_trace_clock_from_wall_us(uint64_t microtime)
+{
+  if (clock_source == HPCTRACE_CLOCK_WALL_US) {
+    return microtime;
+  }
+  return microtime * 1000 - clock_calibration.wallBase
+    + clock_calibration.clockBase;
+}
@@ -0,0 +1,91 @@
+// -*-Mode: C++;-*- // technically C99
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+
+//***************************************************************************
+//
+// File:
+//   trace_clock.h
+//
+// Purpose:
+//   Clock used to timestamp trace records.
+//
+// Description:
+//   The trace clock is selected once per process with the environment
+//   variable HPCRUN_TRACE_CLOCK:
+//
+//     monotonic     clock_gettime(CLOCK_MONOTONIC_RAW) (default)
+//     tsc           rdtsc/rdtscp, calibrated against CLOCK_MONOTONIC_RAW
+//     perf          the PERF_SAMPLE_TIME of linux perf samples, with
+//                   CLOCK_MONOTONIC_RAW for samples from other sources
+//     gettimeofday  microseconds of wall time (pre-1.02 trace format)
+//
+//   Apart from gettimeofday, all clocks return nanoseconds.  The
+//   calibration record written into each trace header maps them back
+//   to wall time.
+//
+//***************************************************************************
+
+#ifndef hpcrun_trace_clock_h
+#define hpcrun_trace_clock_h
+
+#include <stdint.h>
+
+#include <lib/prof-lean/hpcrun-fmt.h>
+
+void hpcrun_trace_clock_init(void);
+
+hpctrace_clock_source_t hpcrun_trace_clock_source(void);
+
+// N.B.: async-signal safe
+uint64_t hpcrun_trace_clock_now(void);
+
+const hpctrace_hdr_clock_t* hpcrun_trace_clock_calibration(void);
+
+uint64_t hpcrun_trace_clock_to_wall_us(uint64_t time);
+uint64_t hpcrun_trace_clock_from_wall_us(uint64_t microtime);
+
+#endif // hpcrun_trace_clock_h
@@ -0,0 +1,261 @@
+// -*-Mode: C++;-*- // technically C99
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+
+//***************************************************************************
+//
+// File:
+//   trace_writer.c
+//
+// Purpose:
+//   Background thread that writes full trace buffers; see
+//   trace_writer.h.
+//
+// Description:
+//   Handoffs come from sample handlers, so they only push the outbuf
+//   on a lock-free stack and write one byte to a pipe to wake the
+//   writer.  The writer takes the whole stack at once, so there is no
+//   ABA problem, and an outbuf is never pushed twice because its
+//   spare stays busy until the writer is done with it.
+//
+//   The writer is not monitored and blocks all signals, so it never
+//   takes samples itself.
+//
+//***************************************************************************
+
+//*********************************************************************
+// global includes
+//*********************************************************************
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+
+//*********************************************************************
+// local includes
+//*********************************************************************
+
+#include "env.h"
+#include "monitor.h"
+#include "trace_writer.h"
+
+#include <memory/hpcrun-malloc.h>
+#include <messages/messages.h>
+
+#include <lib/prof-lean/hpcfmt.h>
+#include <lib/prof-lean/stdatomic.h>
+
+
+//*********************************************************************
+// macros
+//*********************************************************************
+
+#define ASYNC_BUDGET_DEFAULT_MB  256
+
+
+//*********************************************************************
+// local variables
+//*********************************************************************
+
+static int writer_active = 0;
+
+static int wakeup_fd[2] = { -1, -1 };
+
+// outbufs whose spare is waiting to be written
+static _Atomic(hpcio_outbuf_t *) pending = ATOMIC_VAR_INIT(NULL);
+
+// bytes left for spare buffers
+static atomic_long spare_budget = ATOMIC_VAR_INIT(0);
+
+
+//*********************************************************************
+// private operations
+//*********************************************************************
+
+static void *
+trace_writer_loop(void *arg)
+{
+  sigset_t mask;
+  char buf[64];
+
+  sigfillset(&mask);
+  pthread_sigmask(SIG_BLOCK, &mask, NULL);
+
+  for (;;) {
+    ssize_t ret = read(wakeup_fd[0], buf, sizeof(buf));
+    if (ret < 0 && errno != EINTR) {
+      EMSG("trace writer: read failed, errno %d", errno);
+      writer_active = 0;
+    }
+
+    hpcio_outbuf_t *outbuf = atomic_exchange(&pending, NULL);
+    while (outbuf != NULL) {
+      // once the spare is written, the outbuf may be pushed again
+      hpcio_outbuf_t *next = outbuf->next;
+      hpcio_outbuf_write_spare(outbuf);
+      outbuf = next;
+    }
+
+    if (! writer_active) {
+      break;
+    }
+  }
+  return NULL;
+}
+
+
+//*********************************************************************
+// interface operations
+//*********************************************************************
+
+// Also called in the child after fork, where the writer thread no
+// longer exists.
+void
+hpcrun_trace_writer_init(void)
+{
+  writer_active = 0;
+  atomic_store(&pending, NULL);
+  atomic_store(&spare_budget, 0);
+  if (wakeup_fd[0] >= 0) {
+    close(wakeup_fd[0]);
+    close(wakeup_fd[1]);
+    wakeup_fd[0] = wakeup_fd[1] = -1;
+  }
+
+  char *str = getenv(HPCRUN_TRACE_ASYNC);
+  if (str == NULL || atoi(str) == 0) {
+    return;
+  }
+
+  long budget = ASYNC_BUDGET_DEFAULT_MB;
+  str = getenv(HPCRUN_TRACE_ASYNC_BUDGET);
+  if (str != NULL) {
+    budget = atol(str);
+    if (budget <= 0) {
+      EMSG("bad %s value '%s', using %d", HPCRUN_TRACE_ASYNC_BUDGET, str,
+	   ASYNC_BUDGET_DEFAULT_MB);
+      budget = ASYNC_BUDGET_DEFAULT_MB;
+    }
+  }
+
+  if (pipe(wakeup_fd) != 0) {
+    EMSG("trace writer: unable to create pipe, tracing synchronously");
+    wakeup_fd[0] = wakeup_fd[1] = -1;
+    return;
+  }
+  fcntl(wakeup_fd[0], F_SETFD, FD_CLOEXEC);
+  fcntl(wakeup_fd[1], F_SETFD, FD_CLOEXEC);
+  // a full pipe already guarantees a wakeup
+  fcntl(wakeup_fd[1], F_SETFL, O_NONBLOCK);
+
+  pthread_t thread;
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+  writer_active = 1;
+  monitor_disable_new_threads();
+  int rc = pthread_create(&thread, &attr, trace_writer_loop, NULL);
+  monitor_enable_new_threads();
+  pthread_attr_destroy(&attr);
+
+  if (rc != 0) {
+    EMSG("trace writer: unable to create thread (%d), tracing synchronously", rc);
+    writer_active = 0;
+    return;
+  }
+
+  atomic_store(&spare_budget, budget << 20);
+  TMSG(TRACE, "async trace writer started, budget %ld MB", budget);
+}
+
+
+int
+hpcrun_trace_writer_isactive(void)
+{
+  return writer_active;
+}
+
+
+void*
+hpcrun_trace_writer_spare(size_t size)
+{
+  if (! writer_active) {
+    return NULL;
+  }
+  if (atomic_fetch_sub(&spare_budget, (long) size) < (long) size) {
+    atomic_fetch_add(&spare_budget, (long) size);
+    TMSG(TRACE, "async trace budget used up, tracing synchronously");
+    return NULL;
+  }
+  return hpcrun_malloc(size);
+}
+
+
+int
+hpcrun_trace_writer_handoff(hpcio_outbuf_t *outbuf)
+{
+  if (! writer_active) {
+    return HPCFMT_ERR;
+  }
+
+  hpcio_outbuf_t *head = atomic_load(&pending);
+  do {
+    outbuf->next = head;
+  } while (! atomic_compare_exchange_weak(&pending, &head, outbuf));
+
+  int save_errno = errno;
+  if (write(wakeup_fd[1], "", 1) < 0) {
+    // EAGAIN: the writer has wakeups queued
+  }
+  errno = save_errno;
+
+  return HPCFMT_OK;
+}
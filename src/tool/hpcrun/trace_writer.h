@@ -0,0 +1,85 @@
+// -*-Mode: C++;-*- // technically C99
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+
+//***************************************************************************
+//
+// File:
+//   trace_writer.h
+//
+// Purpose:
+//   Background thread that writes full trace buffers.
+//
+// Description:
+//   With HPCRUN_TRACE_ASYNC set, each thread's trace outbuf gets a
+//   spare buffer (see hpcio_outbuf_attach_async).  When a buffer
+//   fills, it is handed off to one writer thread per process, and the
+//   sampling thread continues in the spare.  HPCRUN_TRACE_ASYNC_BUDGET
+//   bounds the memory for spare buffers in MB (default 256); threads
+//   beyond the budget write their traces synchronously.
+//
+//***************************************************************************
+
+#ifndef hpcrun_trace_writer_h
+#define hpcrun_trace_writer_h
+
+#include <stddef.h>
+
+#include <lib/prof-lean/hpcio-buffer.h>
+
+// start the writer thread, if enabled; called at process init
+void hpcrun_trace_writer_init(void);
+
+int hpcrun_trace_writer_isactive(void);
+
+// returns a spare buffer of size bytes, or NULL if not enabled or the
+// budget is used up
+void* hpcrun_trace_writer_spare(size_t size);
+
+// N.B.: async-signal safe
+int hpcrun_trace_writer_handoff(hpcio_outbuf_t *outbuf);
+
+#endif // hpcrun_trace_writer_h
@@ -65,6 +65,7 @@
 
 #include <unwind/common/unw-throw.h>
 #include <hpcrun/hpcrun_stats.h>
+#include <hpcrun/hpcrun_dlfns.h>
 
 #include <monitor.h>
 
@@ -82,6 +83,11 @@
 static void lush_assoc_info2str(char* buf, size_t len, lush_assoc_info_t info);
 static void lush_lip2str(char* buf, size_t len, lush_lip_t* lip);
 
+static frame_t* unw_cache_lookup(unw_cache_t* cache, size_t* pos,
+				 hpcrun_unw_cursor_t* cursor);
+static void unw_cache_update(unw_cache_t* cache, frame_t* inner,
+			     frame_t* outer, size_t n_kept, fence_enum_t fence);
+
 //***************************************************************************
 // interface functions
 //***************************************************************************
@@ -148,6 +154,16 @@ hpcrun_bt_init(backtrace_t* bt, size_t size)
   bt->len = 0;
 }
 
+void
+hpcrun_unw_cache_init(unw_cache_t* cache, size_t size)
+{
+  cache->frames = (frame_t*) hpcrun_malloc(sizeof(frame_t) * size);
+  cache->size   = size;
+  cache->len    = 0;
+  cache->fence  = FENCE_BAD;
+  cache->dl_generation = 0;
+}
+
 frame_t*
 hpcrun_skip_chords(frame_t* bt_outer, frame_t* bt_inner, 
 		   int skip)
@@ -199,6 +215,15 @@ hpcrun_generate_backtrace_no_trampoline(backtrace_info_t* bt,
   td->btbuf_cur   = td->btbuf_beg; // innermost
   td->btbuf_sav   = td->btbuf_end;
 
+  // unwind cache: position of the next cached frame to compare
+  // against (counting down from the innermost), and the number of
+  // cached frames spliced into this backtrace
+  unw_cache_t* cache = &(td->unw_cache);
+  bool use_cache = ENABLED(USE_UNW_CACHE) &&
+    cache->dl_generation == hpcrun_dlclose_generation();
+  size_t cache_pos = cache->len;
+  size_t n_spliced = 0;
+
   hpcrun_unw_cursor_t cursor;
   hpcrun_unw_init_cursor(&cursor, context);
 
@@ -233,6 +258,26 @@ hpcrun_generate_backtrace_no_trampoline(backtrace_info_t* bt,
 	break;
       }
     }
+
+    if (use_cache) {
+      frame_t* hit = unw_cache_lookup(cache, &cache_pos, &cursor);
+      if (hit) {
+	// this frame and all outer frames are as cached: copy them
+	// (innermost first) instead of stepping through them
+	n_spliced = cache_pos + 1;
+	for (size_t i = n_spliced; i > 0; i--) {
+	  hpcrun_ensure_btbuf_avail();
+	  *(td->btbuf_cur++) = cache->frames[i - 1];
+	}
+	TMSG(UNW_CACHE, "splice %d cached frames at sp = %p",
+	     n_spliced, cursor.sp);
+	hpcrun_stats_unw_cache_hit_inc((long) n_spliced);
+
+	bt->fence = cache->fence;
+	ret = STEP_STOP;
+	break;
+      }
+    }
     
     hpcrun_ensure_btbuf_avail();
 
@@ -269,6 +314,10 @@ hpcrun_generate_backtrace_no_trampoline(backtrace_info_t* bt,
   frame_t* bt_beg  = td->btbuf_beg;      // innermost, inclusive
   frame_t* bt_last = td->btbuf_cur - 1; // outermost, inclusive
 
+  if (ENABLED(USE_UNW_CACHE) && ret == STEP_STOP && ! bt->has_tramp) {
+    unw_cache_update(cache, bt_beg, bt_last, n_spliced, bt->fence);
+  }
+
   if (skipInner) {
     if (ENABLED(USE_TRAMP)){
       //
@@ -379,6 +428,90 @@ hpcrun_generate_backtrace(backtrace_info_t* bt,
 // private operations 
 //***************************************************************************
 
+//
+// Unwind cache.
+//
+// A frame of the current unwind may be taken from the cache when its
+// pc, sp and bp equal those of a cached frame, and every return
+// address slot (ra_loc) from that frame outward still holds the pc of
+// the next cached frame.  Together these mean the frame has not
+// returned since it was cached, so neither have its callers.  Frames
+// whose return address is not in memory (ra_loc == NULL) stop the
+// check, so unwinders that do not report ra_loc never use the cache.
+//
+// Stacks grow down: sp increases from inner to outer frames, in both
+// the current unwind and the cache, so one scan of the cache (from the
+// innermost cached frame outward) serves the whole unwind.
+//
+
+static bool
+unw_cache_valid_from(unw_cache_t* cache, size_t pos)
+{
+  // the outermost frame alone has no return address to check
+  if (pos == 0) {
+    return false;
+  }
+  for (size_t i = pos; i > 0; i--) {
+    void** ra_loc = (void**) cache->frames[i].ra_loc;
+    if (ra_loc == NULL ||
+	*ra_loc != cache->frames[i - 1].cursor.pc_unnorm) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// *pos counts down from cache->len: cache->frames[*pos - 1] is the
+// innermost frame not yet passed over.  Returns the matching cached
+// frame, leaving its index in *pos, or NULL.
+static frame_t*
+unw_cache_lookup(unw_cache_t* cache, size_t* pos, hpcrun_unw_cursor_t* cursor)
+{
+  size_t i = *pos;
+
+  while (i > 0 && (uintptr_t) cache->frames[i - 1].cursor.sp
+	 < (uintptr_t) cursor->sp) {
+    i--;
+  }
+  *pos = i;
+
+  for (; i > 0 && cache->frames[i - 1].cursor.sp == cursor->sp; i--) {
+    frame_t* x = &(cache->frames[i - 1]);
+    if (x->cursor.pc_unnorm == cursor->pc_unnorm &&
+	x->cursor.bp == cursor->bp &&
+	unw_cache_valid_from(cache, i - 1)) {
+      *pos = i - 1;
+      return x;
+    }
+  }
+  return NULL;
+}
+
+// Record the backtrace [inner, outer] (innermost first).  Its
+// outermost n_kept frames came from the cache, and are already in
+// place at cache->frames[0 .. n_kept).
+static void
+unw_cache_update(unw_cache_t* cache, frame_t* inner, frame_t* outer,
+		 size_t n_kept, fence_enum_t fence)
+{
+  size_t len = outer - inner + 1;
+
+  if (len > cache->size) {
+    size_t size = 2 * len;
+    frame_t* frames = (frame_t*) hpcrun_malloc(sizeof(frame_t) * size);
+    memcpy(frames, cache->frames, sizeof(frame_t) * n_kept);
+    cache->frames = frames;
+    cache->size = size;
+  }
+
+  for (size_t i = n_kept; i < len; i++) {
+    cache->frames[i] = *(outer - i);
+  }
+  cache->len = len;
+  cache->fence = fence;
+  cache->dl_generation = hpcrun_dlclose_generation();
+}
+
 static void
 lush_assoc_info2str(char* buf, size_t len, lush_assoc_info_t info)
 {
@@ -87,6 +87,21 @@ typedef struct backtrace_t {
   frame_t* cur;    // current insertion position
 } backtrace_t;
 
+//
+// unw_cache_t holds the frames of the last complete unwind of a
+// thread, outermost first, so that a later unwind that reaches one of
+// these frames unchanged can splice in the cached outer frames
+// instead of stepping through them (see backtrace.c)
+//
+
+typedef struct unw_cache_t {
+  frame_t*     frames;    // [0] is the outermost frame
+  size_t       len;       // # of cached frames
+  size_t       size;      // # of frames allocated
+  fence_enum_t fence;     // fence that stopped the cached unwind
+  long         dl_generation; // hpcrun_dlclose_generation() at that time
+} unw_cache_t;
+
 typedef struct bt_iter_t {
   frame_t* cur;
   backtrace_t* bt;
@@ -109,6 +124,8 @@ void hpcrun_bt_dump(frame_t* unwind, const char* tag);
 
 void     hpcrun_bt_init(backtrace_t* bt, size_t size);
 
+void     hpcrun_unw_cache_init(unw_cache_t* cache, size_t size);
+
 bool     hpcrun_backtrace_std(backtrace_t* bt, ucontext_t* context);
 
 bool hpcrun_generate_backtrace(backtrace_info_t* bt,
@@ -0,0 +1,256 @@
+// -*-Mode: C++;-*- // technically C99
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+
+
+//
+// uw_recipe_index-stress: concurrent lookups in the unwind recipe map
+//
+// A harness (built by 'make check' in <builddir>/src/tool/hpcrun) that
+// measures lookups/sec of the two structures uw_recipe_map_lookup
+// consults: the concurrent skip list (cskl_inrange_find, which takes a
+// shared reader lock) and the lock-free sorted index of
+// uw_recipe_index.c.
+//
+// Usage: uw_recipe_index-stress [nfuncs] [lookups-per-thread] [max-threads]
+//
+// The map is filled with nfuncs adjacent intervals of random length,
+// like the functions of a large load module; each thread then looks up
+// uniformly random addresses.  Thread counts double from 1 up to
+// max-threads.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+#include <lib/prof-lean/cskiplist.h>
+#include "uw_recipe_index.h"
+
+#define SKIPLIST_HEIGHT 8
+
+typedef struct {
+  uintptr_t start;
+  uintptr_t end;
+  uw_recipe_index_item_t item;
+} func_t;
+
+typedef struct {
+  int which;
+  long lookups;
+  unsigned long seed;
+  long found;
+} worker_t;
+
+static cskiplist_t *skiplist;
+static uw_recipe_index_t index_;
+static uintptr_t lo_addr, hi_addr;
+
+static pthread_barrier_t barrier;
+
+static void *
+bench_alloc(size_t size)
+{
+  return malloc(size);
+}
+
+static int
+func_cmp(void *lhs, void *rhs)
+{
+  func_t *l = (func_t *)lhs;
+  func_t *r = (func_t *)rhs;
+  if (l->start < r->start) return -1;
+  if (l->start > r->start) return 1;
+  return 0;
+}
+
+static int
+func_inrange(void *fp, void *addr)
+{
+  func_t *f = (func_t *)fp;
+  uintptr_t a = (uintptr_t)addr;
+  if (a < f->start) return 1;
+  if (a >= f->end) return -1;
+  return 0;
+}
+
+static inline unsigned long
+xorshift(unsigned long *s)
+{
+  unsigned long x = *s;
+  x ^= x << 13;
+  x ^= x >> 7;
+  x ^= x << 17;
+  return *s = x;
+}
+
+static double
+now(void)
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+static void *
+worker(void *arg)
+{
+  worker_t *w = (worker_t *)arg;
+  uintptr_t span = hi_addr - lo_addr;
+  long found = 0;
+
+  pthread_barrier_wait(&barrier);
+
+  for (long i = 0; i < w->lookups; i++) {
+    uintptr_t addr = lo_addr + xorshift(&w->seed) % span;
+    void *f = (w->which == 0)
+      ? cskl_inrange_find(skiplist, (void *)addr)
+      : uw_recipe_index_find(&index_, addr);
+    found += (f != NULL);
+  }
+  w->found = found;
+
+  pthread_barrier_wait(&barrier);
+  return NULL;
+}
+
+static double
+run(int which, int nthreads, long lookups)
+{
+  pthread_t tid[nthreads];
+  worker_t w[nthreads];
+
+  pthread_barrier_init(&barrier, NULL, nthreads + 1);
+  for (int t = 0; t < nthreads; t++) {
+    w[t].which = which;
+    w[t].lookups = lookups;
+    w[t].seed = 0x9e3779b97f4a7c15UL * (t + 1);
+    pthread_create(&tid[t], NULL, worker, &w[t]);
+  }
+
+  pthread_barrier_wait(&barrier);
+  double t0 = now();
+  pthread_barrier_wait(&barrier);
+  double t1 = now();
+
+  long found = 0;
+  for (int t = 0; t < nthreads; t++) {
+    pthread_join(tid[t], NULL);
+    found += w[t].found;
+  }
+  pthread_barrier_destroy(&barrier);
+
+  if (found != lookups * nthreads) {
+    printf("error: %ld of %ld lookups missed\n", lookups * nthreads - found,
+	   lookups * nthreads);
+    exit(1);
+  }
+  return (lookups * nthreads) / (t1 - t0);
+}
+
+int
+main(int argc, char **argv)
+{
+  long nfuncs = (argc > 1) ? atol(argv[1]) : 20000;
+  long lookups = (argc > 2) ? atol(argv[2]) : 2000000;
+  int max_threads = (argc > 3) ? atoi(argv[3]) : 8;
+
+  if (nfuncs <= 0 || lookups <= 0 || max_threads <= 0) {
+    printf("Usage: %s [nfuncs] [lookups-per-thread] [max-threads]\n", argv[0]);
+    exit(1);
+  }
+
+  cskl_init();
+  func_t *lsentinel = bench_alloc(sizeof(func_t));
+  func_t *rsentinel = bench_alloc(sizeof(func_t));
+  lsentinel->start = lsentinel->end = 0;
+  rsentinel->start = rsentinel->end = UINTPTR_MAX;
+  skiplist = cskl_new(lsentinel, rsentinel, SKIPLIST_HEIGHT,
+		      func_cmp, func_inrange, bench_alloc);
+  uw_recipe_index_init(&index_, bench_alloc);
+
+  // insert in shuffled order, the way samples discover functions
+  func_t *funcs = bench_alloc(nfuncs * sizeof(func_t));
+  unsigned long seed = 88172645463325252UL;
+  uintptr_t addr = lo_addr = 0x400000;
+  for (long i = 0; i < nfuncs; i++) {
+    funcs[i].start = addr;
+    addr += 16 + xorshift(&seed) % 2048;
+    funcs[i].end = addr;
+  }
+  hi_addr = addr;
+  for (long i = nfuncs - 1; i > 0; i--) {
+    long j = xorshift(&seed) % (i + 1);
+    func_t tmp = funcs[i]; funcs[i] = funcs[j]; funcs[j] = tmp;
+  }
+
+  for (long i = 0; i < nfuncs; i++) {
+    func_t *f = &funcs[i];
+    cskl_insert(skiplist, f, bench_alloc);
+    f->item.start = f->start;
+    f->item.end = f->end;
+    f->item.val = f;
+    uw_recipe_index_add(&index_, &f->item);
+    uw_recipe_index_miss(&index_);
+  }
+  // flush whatever is still pending
+  while (uw_recipe_index_find(&index_, funcs[nfuncs - 1].start) == NULL ||
+	 atomic_load(&index_.npending) > 0) {
+    for (long i = 0; i < 4 * nfuncs + 1; i++) uw_recipe_index_miss(&index_);
+  }
+
+  printf("%ld intervals, %ld lookups per thread\n", nfuncs, lookups);
+  printf("%8s %16s %16s %8s\n", "threads", "skiplist/sec", "index/sec", "ratio");
+  for (int n = 1; n <= max_threads; n *= 2) {
+    double s = run(0, n, lookups);
+    double x = run(1, n, lookups);
+    printf("%8d %16.0f %16.0f %8.2f\n", n, s, x, x / s);
+  }
+
+  return 0;
+}
@@ -0,0 +1,254 @@
+// -*-Mode: C++;-*- // technically C99
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+
+//******************************************************************************
+// local includes
+//******************************************************************************
+
+#include "uw_recipe_index.h"
+
+//******************************************************************************
+// macros
+//******************************************************************************
+
+// publish once the pending list is this fraction of the array ...
+#define PENDING_FRACTION 8
+
+// ... or once this many misses per array entry have piled up
+#define MISSES_PER_ENTRY 4
+
+//******************************************************************************
+// private operations
+//******************************************************************************
+
+static uw_recipe_index_array_t *
+index_array_new(uw_recipe_index_t *idx, size_t n)
+{
+  uw_recipe_index_array_t *a =
+    idx->m_alloc(sizeof(uw_recipe_index_array_t) +
+		 n * sizeof(uw_recipe_index_entry_t));
+  if (a) a->n = n;
+  return a;
+}
+
+// qsort is not async-signal safe; a shell sort of the pending batch is
+// all we need, since it is merged with an already sorted array.
+static void
+index_entries_sort(uw_recipe_index_entry_t *e, size_t n)
+{
+  size_t gap = 1;
+  while (gap < n / 3) gap = 3 * gap + 1;
+
+  for (; gap > 0; gap /= 3) {
+    for (size_t i = gap; i < n; i++) {
+      uw_recipe_index_entry_t tmp = e[i];
+      size_t j = i;
+      for (; j >= gap && e[j - gap].start > tmp.start; j -= gap)
+	e[j] = e[j - gap];
+      e[j] = tmp;
+    }
+  }
+}
+
+static void
+index_publish(uw_recipe_index_t *idx)
+{
+  uw_recipe_index_item_t *pending =
+    atomic_exchange_explicit(&idx->pending, NULL, memory_order_acquire);
+  if (pending == NULL) return;
+
+  long k = 0;
+  for (uw_recipe_index_item_t *it = pending; it; it = it->next) k++;
+  atomic_fetch_sub_explicit(&idx->npending, k, memory_order_relaxed);
+
+  uw_recipe_index_array_t *old =
+    atomic_load_explicit(&idx->array, memory_order_relaxed);
+  size_t n = old ? old->n : 0;
+
+  uw_recipe_index_array_t *a = index_array_new(idx, n + k);
+  if (a == NULL) return;
+
+  // sort the new batch into the front of the array, then merge the old
+  // entries in from the back; the write position never overtakes the
+  // unmerged part of the batch.
+  size_t j = 0;
+  for (uw_recipe_index_item_t *it = pending; it; it = it->next, j++) {
+    a->entry[j].start = it->start;
+    a->entry[j].end   = it->end;
+    a->entry[j].val   = it->val;
+  }
+  index_entries_sort(a->entry, k);
+
+  size_t i = n + k, o = n, b = k;
+  while (o > 0) {
+    if (b > 0 && a->entry[b - 1].start > old->entry[o - 1].start)
+      a->entry[--i] = a->entry[--b];
+    else
+      a->entry[--i] = old->entry[--o];
+  }
+
+  atomic_store_explicit(&idx->array, a, memory_order_release);
+  atomic_store_explicit(&idx->misses, 0, memory_order_relaxed);
+}
+
+static inline int
+overlaps(uintptr_t s0, uintptr_t e0, uintptr_t s1, uintptr_t e1)
+{
+  return s0 < e1 && s1 < e0;
+}
+
+//******************************************************************************
+// interface operations
+//******************************************************************************
+
+void
+uw_recipe_index_init(uw_recipe_index_t *idx, mem_alloc m_alloc)
+{
+  atomic_init(&idx->array, NULL);
+  atomic_init(&idx->pending, NULL);
+  atomic_init(&idx->npending, 0);
+  atomic_init(&idx->misses, 0);
+  atomic_init(&idx->publishing, false);
+  idx->m_alloc = m_alloc;
+}
+
+
+void *
+uw_recipe_index_find(uw_recipe_index_t *idx, uintptr_t addr)
+{
+  uw_recipe_index_array_t *a =
+    atomic_load_explicit(&idx->array, memory_order_acquire);
+  if (a == NULL) return NULL;
+
+  // find the last entry whose start is <= addr
+  size_t lo = 0, hi = a->n;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (a->entry[mid].start <= addr) lo = mid + 1;
+    else hi = mid;
+  }
+  if (lo == 0) return NULL;
+
+  uw_recipe_index_entry_t *e = &a->entry[lo - 1];
+  return (addr < e->end) ? e->val : NULL;
+}
+
+
+void
+uw_recipe_index_add(uw_recipe_index_t *idx, uw_recipe_index_item_t *item)
+{
+  uw_recipe_index_item_t *head =
+    atomic_load_explicit(&idx->pending, memory_order_relaxed);
+  do {
+    item->next = head;
+  } while (!atomic_compare_exchange_weak_explicit(&idx->pending, &head, item,
+						  memory_order_release,
+						  memory_order_relaxed));
+  atomic_fetch_add_explicit(&idx->npending, 1, memory_order_relaxed);
+}
+
+
+void
+uw_recipe_index_miss(uw_recipe_index_t *idx)
+{
+  long m = atomic_fetch_add_explicit(&idx->misses, 1, memory_order_relaxed) + 1;
+  long k = atomic_load_explicit(&idx->npending, memory_order_relaxed);
+  if (k <= 0) return;
+
+  uw_recipe_index_array_t *a =
+    atomic_load_explicit(&idx->array, memory_order_relaxed);
+  long n = a ? (long) a->n : 0;
+  if (k * PENDING_FRACTION < n && m < MISSES_PER_ENTRY * n) return;
+
+  if (atomic_exchange_explicit(&idx->publishing, true, memory_order_acquire))
+    return;
+  index_publish(idx);
+  atomic_store_explicit(&idx->publishing, false, memory_order_release);
+}
+
+
+void
+uw_recipe_index_remove_range_unsynch(uw_recipe_index_t *idx,
+				     uintptr_t start, uintptr_t end)
+{
+  // pending list
+  uw_recipe_index_item_t *head =
+    atomic_load_explicit(&idx->pending, memory_order_relaxed);
+  uw_recipe_index_item_t **prev = &head;
+  long removed = 0;
+  for (uw_recipe_index_item_t *it = *prev; it; it = *prev) {
+    if (overlaps(it->start, it->end, start, end)) {
+      *prev = it->next;
+      removed++;
+    } else {
+      prev = &it->next;
+    }
+  }
+  atomic_store_explicit(&idx->pending, head, memory_order_relaxed);
+  atomic_fetch_sub_explicit(&idx->npending, removed, memory_order_relaxed);
+
+  // published array
+  uw_recipe_index_array_t *a =
+    atomic_load_explicit(&idx->array, memory_order_relaxed);
+  if (a == NULL) return;
+
+  size_t keep = 0;
+  for (size_t i = 0; i < a->n; i++)
+    if (!overlaps(a->entry[i].start, a->entry[i].end, start, end)) keep++;
+  if (keep == a->n) return;
+
+  uw_recipe_index_array_t *b = index_array_new(idx, keep);
+  if (b == NULL) {
+    atomic_store_explicit(&idx->array, NULL, memory_order_release);
+    return;
+  }
+  size_t j = 0;
+  for (size_t i = 0; i < a->n; i++)
+    if (!overlaps(a->entry[i].start, a->entry[i].end, start, end))
+      b->entry[j++] = a->entry[i];
+  atomic_store_explicit(&idx->array, b, memory_order_release);
+}
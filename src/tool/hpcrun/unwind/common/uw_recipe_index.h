@@ -0,0 +1,168 @@
+// -*-Mode: C++;-*- // technically C99
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+
+//
+// A read-optimized index in front of the unwind recipe map.
+//
+// The recipe map keeps its intervals in a concurrent skip list whose
+// readers take a shared reader lock; every lookup therefore writes a
+// cache line that all sampling threads share.  The index is a sorted
+// array of (start, end, value) triples that readers search with a
+// single acquire load and a binary search, never writing shared
+// memory.  Writers never modify a published array: intervals that
+// become ready are pushed on a lock-free pending list, and once
+// enough lookups have missed the index, one thread merges the pending
+// list with the current array into a fresh copy and publishes it with
+// a release store.
+//
+// Published arrays are never reclaimed, since a reader may still be
+// searching one.  To keep the retired copies in check, a publication
+// normally waits until the pending list holds an eighth of the
+// published size, so array sizes grow geometrically; a pending interval
+// that keeps missing is published anyway after a number of misses
+// proportional to the array size.
+//
+// Removing a range is not synchronized with readers or publishers; the
+// caller must hold whatever lock excludes them, as the recipe map does
+// when it processes an unmap.
+//
+
+#ifndef UW_RECIPE_INDEX_H
+#define UW_RECIPE_INDEX_H
+
+//******************************************************************************
+// system includes
+//******************************************************************************
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+//******************************************************************************
+// local includes
+//******************************************************************************
+
+#include <lib/prof-lean/stdatomic.h>
+#include <lib/prof-lean/mem_manager.h>
+
+//******************************************************************************
+// types
+//******************************************************************************
+
+// an interval awaiting publication; embedded in the caller's value so
+// that adding to the index never allocates.
+typedef struct uw_recipe_index_item_s {
+  uintptr_t start;
+  uintptr_t end;
+  void *val;
+  struct uw_recipe_index_item_s *next;
+} uw_recipe_index_item_t;
+
+typedef struct uw_recipe_index_entry_s {
+  uintptr_t start;
+  uintptr_t end;
+  void *val;
+} uw_recipe_index_entry_t;
+
+typedef struct uw_recipe_index_array_s {
+  size_t n;
+  uw_recipe_index_entry_t entry[];
+} uw_recipe_index_array_t;
+
+typedef _Atomic(uw_recipe_index_array_t *) atomic_uw_recipe_index_array_ptr;
+typedef _Atomic(uw_recipe_index_item_t *) atomic_uw_recipe_index_item_ptr;
+
+typedef struct uw_recipe_index_s {
+  atomic_uw_recipe_index_array_ptr array;
+  atomic_uw_recipe_index_item_ptr pending;
+  atomic_long npending;
+  atomic_long misses;
+  atomic_bool publishing;
+  mem_alloc m_alloc;
+} uw_recipe_index_t;
+
+//******************************************************************************
+// interface operations
+//******************************************************************************
+
+void
+uw_recipe_index_init(uw_recipe_index_t *idx, mem_alloc m_alloc);
+
+/*
+ * Return the value of the interval containing addr, or NULL if the
+ * index does not (yet) cover addr.  Wait-free; never writes shared
+ * memory.
+ */
+void *
+uw_recipe_index_find(uw_recipe_index_t *idx, uintptr_t addr);
+
+/*
+ * Queue the interval [item->start, item->end) with value item->val for
+ * the next publication.  Lock-free; item must stay valid until it is
+ * published or removed.
+ */
+void
+uw_recipe_index_add(uw_recipe_index_t *idx, uw_recipe_index_item_t *item);
+
+/*
+ * Record that a lookup of a ready interval had to go around the index,
+ * and publish the pending intervals if enough of them or enough misses
+ * have accumulated.  Only one thread publishes at a time; the others
+ * return at once.
+ */
+void
+uw_recipe_index_miss(uw_recipe_index_t *idx);
+
+/*
+ * Drop every interval that overlaps [start, end) from both the
+ * published array and the pending list.  Not thread safe.
+ */
+void
+uw_recipe_index_remove_range_unsynch(uw_recipe_index_t *idx,
+				     uintptr_t start, uintptr_t end);
+
+#endif // UW_RECIPE_INDEX_H
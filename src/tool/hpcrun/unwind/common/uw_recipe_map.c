@@ -82,6 +82,7 @@
 #include <main.h>
 #include "thread_data.h"
 #include "uw_recipe_map.h"
+#include "uw_recipe_index.h"
 #include "unwind-interval.h"
 #include <fnbounds/fnbounds_interface.h>
 #include <lib/prof-lean/cskiplist.h>
@@ -119,6 +120,7 @@ typedef struct ilmstat_btuwi_pair_s {
   load_module_t *lm;
   _Atomic(tree_stat_t) stat;
   bitree_uwi_t *btuwi;
+  uw_recipe_index_item_t index_item;
 } ilmstat_btuwi_pair_t;
 
 //******************************************************************************
@@ -271,6 +273,10 @@ ilmstat_btuwi_pair_free(ilmstat_btuwi_pair_t* pair, unwinder_t uw)
 // The concrete representation of the abstract data type unwind recipe map.
 static cskiplist_t *addr2recipe_map[NUM_UNWINDERS];
 
+// Lock-free sorted copy of the READY entries of addr2recipe_map, which
+// answers most lookups without touching the skip list's reader lock.
+static uw_recipe_index_t addr2recipe_index[NUM_UNWINDERS];
+
 // memory allocator for creating addr2recipe_map
 // and inserting entries into addr2recipe_map:
 static mem_alloc my_alloc = hpcrun_malloc;
@@ -574,6 +580,9 @@ uw_recipe_map_notify_unmap(void *start, void *end)
   // Remove intervals in the range [start, end) from the unwind interval tree.
   TMSG(UW_RECIPE_MAP, "uw_recipe_map_delete_range from %p to %p", start, end);
   unwinder_t uw;
+  for (uw = 0; uw < NUM_UNWINDERS; uw++)
+    uw_recipe_index_remove_range_unsynch(&addr2recipe_index[uw],
+					 (uintptr_t)start, (uintptr_t)end);
   for (uw = 0; uw < NUM_UNWINDERS; uw++)
     cskl_inrange_del_bulk_unsynch(addr2recipe_map[uw], start, ((void*)((char *) end) - 1), cskl_ilmstat_btuwi_free[uw]);
 
@@ -621,10 +630,12 @@ uw_recipe_map_init(void)
   ilmstat_btuwi_pair_t* rsentinel =
 	  ilmstat_btuwi_pair_build(UINTPTR_MAX, UINTPTR_MAX, NULL, NEVER, my_alloc );
   unwinder_t uw;
-  for (uw = 0; uw < NUM_UNWINDERS; uw++)
+  for (uw = 0; uw < NUM_UNWINDERS; uw++) {
     addr2recipe_map[uw] =
       cskl_new(lsentinel, rsentinel, SKIPLIST_HEIGHT,
 	       ilmstat_btuwi_pair_cmp, ilmstat_btuwi_pair_inrange, my_alloc);
+    uw_recipe_index_init(&addr2recipe_index[uw], my_alloc);
+  }
 
   uw_recipe_map_notify_init();
 
@@ -634,6 +645,22 @@ uw_recipe_map_init(void)
 }
 
 
+static bool
+uw_recipe_map_found(ilmstat_btuwi_pair_t *ilm_btui, void *addr,
+		    unwindr_info_t *unwr_info)
+{
+  TMSG(UW_RECIPE_MAP_LOOKUP, "found in unwind tree: addr %p", addr);
+
+  bitree_uwi_t *btuwi = ilm_btui->btuwi;
+  unwr_info->btuwi    = bitree_uwi_inrange(btuwi, (uintptr_t)addr);
+  unwr_info->treestat = READY;
+  unwr_info->lm         = ilm_btui->lm;
+  unwr_info->interval   = ilm_btui->interval;
+
+  return (unwr_info->btuwi != NULL);
+}
+
+
 /*
  *
  */
@@ -655,9 +682,14 @@ uw_recipe_map_lookup(void *addr, unwinder_t uw, unwindr_info_t *unwr_info)
   unwr_info->interval.start = 0;
   unwr_info->interval.end   = 0;
 
-  // check if addr is already in the range of an interval key in the map
+  // fast path: the index holds only READY entries
   ilmstat_btuwi_pair_t* ilm_btui =
-    uw_recipe_map_inrange_find((uintptr_t)addr, uw);
+    uw_recipe_index_find(&addr2recipe_index[uw], (uintptr_t)addr);
+  if (ilm_btui)
+    return uw_recipe_map_found(ilm_btui, addr, unwr_info);
+
+  // check if addr is already in the range of an interval key in the map
+  ilm_btui = uw_recipe_map_inrange_find((uintptr_t)addr, uw);
 
   if (!ilm_btui) {
 	load_module_t *lm;
@@ -718,6 +750,12 @@ uw_recipe_map_lookup(void *addr, unwinder_t uw, unwindr_info_t *unwr_info)
       ilm_btui->btuwi = bitree_uwi_rebalance(btuwi_stat.first, btuwi_stat.count);
       atomic_store_explicit(&ilm_btui->stat, READY, memory_order_release);
 
+      uw_recipe_index_item_t *item = &ilm_btui->index_item;
+      item->start = ilm_btui->interval.start;
+      item->end   = ilm_btui->interval.end;
+      item->val   = ilm_btui;
+      uw_recipe_index_add(&addr2recipe_index[uw], item);
+
       td->current_jmp_buf = oldjmp;   // restore the outer sigjmp
 
     } else {
@@ -736,13 +774,7 @@ uw_recipe_map_lookup(void *addr, unwinder_t uw, unwindr_info_t *unwr_info)
     }
   }
 
-  TMSG(UW_RECIPE_MAP_LOOKUP, "found in unwind tree: addr %p", addr);
+  uw_recipe_index_miss(&addr2recipe_index[uw]);
 
-  bitree_uwi_t *btuwi = ilm_btui->btuwi;
-  unwr_info->btuwi    = bitree_uwi_inrange(btuwi, (uintptr_t)addr);
-  unwr_info->treestat = READY;
-  unwr_info->lm         = ilm_btui->lm;
-  unwr_info->interval   = ilm_btui->interval;
-
-  return (unwr_info->btuwi != NULL);
+  return uw_recipe_map_found(ilm_btui, addr, unwr_info);
 }
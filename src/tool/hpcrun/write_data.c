@@ -67,6 +67,7 @@
 #include "write_data.h"
 #include "loadmap.h"
 #include "sample_prob.h"
+#include "trace_clock.h"
 
 #include <messages/messages.h>
 
@@ -175,11 +176,18 @@ lazy_open_data_file(core_profile_trace_data_t * cptd)
   char pidStr[bufSZ];
   snprintf(pidStr, bufSZ, "%u", OSUtil_pid());
 
+  // the profile records trace bounds in wall-clock microseconds
+  uint64_t traceMinTime = 0, traceMaxTime = 0;
+  if (cptd->trace_min_time != 0 && cptd->trace_max_time != 0) {
+    traceMinTime = hpcrun_trace_clock_to_wall_us(cptd->trace_min_time);
+    traceMaxTime = hpcrun_trace_clock_to_wall_us(cptd->trace_max_time);
+  }
+
   char traceMinTimeStr[bufSZ];
-  snprintf(traceMinTimeStr, bufSZ, "%"PRIu64, cptd->trace_min_time_us);
+  snprintf(traceMinTimeStr, bufSZ, "%"PRIu64, traceMinTime);
 
   char traceMaxTimeStr[bufSZ];
-  snprintf(traceMaxTimeStr, bufSZ, "%"PRIu64, cptd->trace_max_time_us);
+  snprintf(traceMaxTimeStr, bufSZ, "%"PRIu64, traceMaxTime);
 
   //
   // ==== file hdr =====
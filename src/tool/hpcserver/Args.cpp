@@ -120,6 +120,10 @@ Options: General\n\
                            indicates that the port will be auto-negotiated with\n\
                            the client. Specifying 1 indicates that the xml will\n\
                            be transferred on the main data port.\n\
+  -j, --jobs <num>     Use <num> threads to compute and compress timelines\n\
+                           (default 1). Each timeline is sent as soon as it is\n\
+                           ready. Ignored by the MPI version, and when hpcserver\n\
+                           is built without OpenMP.\n\
 \n\
 ";
 
@@ -149,6 +153,8 @@ CmdLineParser::OptArgDesc Args::optArgs[] = {
      CLP::isOptArg_long },
   {  'x' , "xmlport",       CLP::ARG_REQ,  CLP::DUPOPT_CLOB, NULL,
      CLP::isOptArg_long },
+  {  'j' , "jobs",       CLP::ARG_REQ,  CLP::DUPOPT_CLOB, NULL,
+     CLP::isOptArg_long },
   CmdLineParser_OptArgDesc_NULL_MACRO // SGI's compiler requires this version
 };
 
@@ -178,6 +184,7 @@ Args::Ctor()
   compression = true;
   mainPort = DEFAULT_PORT;//21590
   xmlPort = 0;
+  jobs = 1;
 }
 
 
@@ -270,6 +277,12 @@ Args::parse(int argc, const char* const argv[])
       if (xmlPort < 1024 && xmlPort > 1)
     	   ARG_ERROR("Ports must be greater than 1024.")
     }
+    if (parser.isOpt("jobs")) {
+      const string& arg = parser.getOptArg("jobs");
+      jobs = (int) CmdLineParser::toLong(arg);
+      if (jobs < 1)
+    	   ARG_ERROR("The number of jobs must be at least 1.")
+    }
   }
   catch (const CmdLineParser::ParseError& x) {
     ARG_ERROR(x.what());
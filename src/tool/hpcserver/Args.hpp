@@ -113,6 +113,7 @@ public:
   int mainPort;       // default: 21590
   int xmlPort;        // default: 0
   bool compression;   // default: true
+  int jobs;           // default: 1
 
 private:
   void
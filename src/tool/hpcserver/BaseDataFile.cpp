@@ -61,6 +61,11 @@
 #include "Constants.hpp"
 #include "DebugUtils.hpp"
 
+#include <lib/prof-lean/hpcrun-fmt.h>
+
+#include <cstdlib>
+#include <cstring>
+
 using namespace std;
 
 namespace TraceviewerServer
@@ -99,6 +104,11 @@ namespace TraceviewerServer
 		return masterBuff;
 	}
 
+	int BaseDataFile::getHeaderSize(int file)
+	{
+		return headerSizes[file];
+	}
+
 	/***
 	 * set the data to the specified file
 	 */
@@ -115,6 +125,7 @@ namespace TraceviewerServer
 		processIDs = new int[numFiles];
 		threadIDs = new short[numFiles];
 		offsets = new OffsetPair[numFiles];
+		headerSizes = new int[numFiles];
 
 
 
@@ -128,6 +139,7 @@ namespace TraceviewerServer
 			currentPos += SIZEOF_INT;
 
 			offsets[i].start = masterBuff->getLong(currentPos);
+			headerSizes[i] = readHeaderSize(offsets[i].start, headerSize);
 			//offset.end is the position of the last trace record that is a part of that line
 			if (i > 0)
 				offsets[i-1].end = offsets[i].start - SIZE_OF_TRACE_RECORD;
@@ -161,6 +173,33 @@ namespace TraceviewerServer
 		}
 	}
 
+	/***
+	 * Returns the length of the trace header at start. The database's header
+	 * size is that of the current format, but files written by older versions of
+	 * hpcrun are copied into the database unchanged, and their headers are shorter.
+	 * Headers without the trace magic get defaultSize.
+	 */
+	int BaseDataFile::readHeaderSize(FileOffset start, int defaultSize)
+	{
+		const int len = HPCTRACE_FMT_MagicLen + HPCTRACE_FMT_VersionLen;
+		char hdr[len + 1];
+		int n = 0;
+		FileOffset pos = start;
+		while (n < len && pos < masterBuff->size())
+		{
+			FileOffset pageStart, pageEnd;
+			char* page = masterBuff->getPage(pos, pageStart, pageEnd);
+			for (; n < len && pos < pageEnd; n++, pos++)
+				hdr[n] = page[pos - pageStart];
+			masterBuff->releasePage(pageStart);
+		}
+		hdr[n] = '\0';
+
+		if (n < len || memcmp(hdr, HPCTRACE_FMT_Magic, HPCTRACE_FMT_MagicLen) != 0)
+			return defaultSize;
+		return hpctrace_fmt_hdr_len(atof(hdr + HPCTRACE_FMT_MagicLen));
+	}
+
 //Check if the application is a multi-processing program (like MPI)
 	bool BaseDataFile::isMultiProcess()
 	{
@@ -184,6 +223,7 @@ namespace TraceviewerServer
 		delete[] processIDs;
 		delete[] threadIDs;
 		delete[] offsets;
+		delete[] headerSizes;
 	}
 
 } /* namespace TraceviewerServer */
@@ -81,6 +81,7 @@ public:
 	int getNumberOfFiles();
 	OffsetPair* getOffsets();
 	LargeByteBuffer* getMasterBuffer();
+	int getHeaderSize(int file);
 	void setData(string, int);
 
 	bool isMultiProcess();
@@ -90,11 +91,15 @@ public:
 	int* processIDs;
 	short* threadIDs;
 private:
+	int readHeaderSize(FileOffset start, int defaultSize);
+
 	int type; // Default is Constants::MULTI_PROCESSES | Constants::MULTI_THREADING;
 	LargeByteBuffer* masterBuff;
 	int numFiles;
 
 	OffsetPair* offsets;
+	// Length of each file's trace header, which depends on its format version
+	int* headerSizes;
 };
 
 } /* namespace TraceviewerServer */
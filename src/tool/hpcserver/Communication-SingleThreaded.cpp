@@ -58,6 +58,7 @@
 //***************************************************************************
 
 #include <stdint.h>                     // for uint64_t
+#include <exception>                    // for exception_ptr
 #include <iostream>                     // for operator<<, basic_ostream, etc
 #include <string>                       // for string
 #include <vector>                       // for vector, vector<>::iterator
@@ -75,6 +76,8 @@
 #include "TimeCPID.hpp"                 // for TimeCPID, Time
 #include "TraceDataByRank.hpp"          // for TraceDataByRank
 
+#include <include/hpctoolkit-config.h>  // for ENABLE_OPENMP
+
 
 using namespace std;
 namespace TraceviewerServer {
@@ -101,46 +104,106 @@ void Communication::sendStartGetData(SpaceTimeDataController* contr, int process
 
 
 }
-void Communication::sendEndGetData(DataSocketStream* stream, ProgressBar* prog, SpaceTimeDataController* controller)
+// Keeps the first exception thrown by a thread of sendEndGetData(), which
+// cannot let it leave the parallel loop
+static void saveError(exception_ptr& error, int& failed)
 {
-	// TODO: Make this so that the Lines get sent as soon as they are
-	// filled.
-
-	controller->fillTraces();
-	for (int i = 0; i < controller->tracesLength; i++)
+#ifdef ENABLE_OPENMP
+#pragma omp critical (sendEndGetData_error)
+#endif
 	{
+		if (!error)
+			error = current_exception();
+	}
+#ifdef ENABLE_OPENMP
+#pragma omp atomic write
+#endif
+	failed = 1;
+}
 
-		ProcessTimeline* timeline = controller->traces[i];
-		stream->writeInt( timeline->line());
-		vector<TimeCPID> data = *timeline->data->listCPID;
-		stream->writeInt( data.size());
-		// Begin time
-		stream->writeLong( data[0].timestamp);
-		//End time
-		stream->writeLong( data[data.size() - 1].timestamp);
-
-		DataCompressionLayer comprStr;
-
-		vector<TimeCPID>::iterator it;
-		DEBUGCOUT(2) << "Sending process timeline with " << data.size() << " entries" << endl;
-
-
-		Time currentTime = data[0].timestamp;
-		for (it = data.begin(); it != data.end(); ++it)
+void Communication::sendEndGetData(DataSocketStream* stream, ProgressBar* prog, SpaceTimeDataController* controller)
+{
+	// Lines are read and compressed by up to numJobs threads and each one is
+	// sent as soon as it is ready. The client places lines by the line number
+	// that precedes each one, so completion order is fine.
+	controller->prepareTraces();
+	int numTraces = controller->tracesLength;
+
+	// An exception (e.g. the client closing the socket) must not leave the
+	// OpenMP region: the first one skips the remaining lines and is rethrown
+	// after the loop.
+	exception_ptr error;
+	int failed = 0;
+
+#ifdef ENABLE_OPENMP
+#pragma omp parallel for schedule(dynamic, 1) num_threads(numJobs)
+#endif
+	for (int i = 0; i < numTraces; i++)
+	{
+		int stop;
+#ifdef ENABLE_OPENMP
+#pragma omp atomic read
+#endif
+		stop = failed;
+		if (stop)
+			continue;
+
+		try
 		{
-			comprStr.writeInt( (int)(it->timestamp - currentTime));
-			comprStr.writeInt( it->cpid);
-			currentTime = it->timestamp;
+			ProcessTimeline* timeline = controller->traces[i];
+			timeline->readInData();
+
+			vector<TimeCPID>& data = *timeline->data->listCPID;
+
+			DataCompressionLayer comprStr;
+
+			vector<TimeCPID>::iterator it;
+			DEBUGCOUT(2) << "Sending process timeline with " << data.size() << " entries" << endl;
+
+
+			Time currentTime = data[0].timestamp;
+			for (it = data.begin(); it != data.end(); ++it)
+			{
+				comprStr.writeInt( (int)(it->timestamp - currentTime));
+				comprStr.writeInt( it->cpid);
+				currentTime = it->timestamp;
+			}
+			comprStr.flush();
+			int outputBufferLen = comprStr.getOutputLength();
+			char* outputBuffer = (char*)comprStr.getOutputBuffer();
+
+#ifdef ENABLE_OPENMP
+#pragma omp critical (sendEndGetData)
+#endif
+			{
+				try
+				{
+					stream->writeInt( timeline->line());
+					stream->writeInt( data.size());
+					// Begin time
+					stream->writeLong( data[0].timestamp);
+					//End time
+					stream->writeLong( data[data.size() - 1].timestamp);
+
+					stream->writeInt(outputBufferLen);
+
+					stream->writeRawData(outputBuffer, outputBufferLen);
+					stream->flush();
+					prog->incrementProgress();
+				}
+				catch (...)
+				{
+					saveError(error, failed);
+				}
+			}
+		}
+		catch (...)
+		{
+			saveError(error, failed);
 		}
-		comprStr.flush();
-		int outputBufferLen = comprStr.getOutputLength();
-		char* outputBuffer = (char*)comprStr.getOutputBuffer();
-
-		stream->writeInt(outputBufferLen);
-
-		stream->writeRawData(outputBuffer, outputBufferLen);
-		prog->incrementProgress();
 	}
+	if (error)
+		rethrow_exception(error);
 	stream->flush();
 }
 
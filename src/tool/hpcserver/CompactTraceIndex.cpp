@@ -0,0 +1,204 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// File:
+//   $HeadURL$
+//
+// Purpose:
+//   Locates and decodes the compact blocks of one rank's trace.
+//
+// Description:
+//   [The set of functions, macros, etc. defined in the file]
+//
+//***************************************************************************
+
+#include "CompactTraceIndex.hpp"
+#include "Constants.hpp"
+#include "DebugUtils.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+namespace TraceviewerServer
+{
+	CompactTraceIndex::CompactTraceIndex(LargeByteBuffer* _buffer, FileOffset _dataStart,
+			FileOffset _dataEnd, hpctrace_hdr_flags_t _flags)
+	{
+		buffer = _buffer;
+		dataStart = _dataStart;
+		dataEnd = _dataEnd;
+		flags = _flags;
+		numRecords = 0;
+
+		if (!readIndex())
+			walkBlocks();
+	}
+
+	CompactTraceIndex::~CompactTraceIndex()
+	{
+	}
+
+	hpctrace_hdr_flags_t CompactTraceIndex::readFlags(LargeByteBuffer* buffer,
+			FileOffset dataStart, int headerSize)
+	{
+		hpctrace_hdr_flags_t flags = hpctrace_hdr_flags_NULL;
+		if (headerSize >= hpctrace_fmt_hdr_len(HPCTRACE_FMT_Version_101))
+		{
+			FileOffset loc = dataStart - headerSize + HPCTRACE_FMT_MagicLen
+					+ HPCTRACE_FMT_VersionLen + HPCTRACE_FMT_EndianLen;
+			flags.bits = buffer->getLong(loc);
+		}
+		return flags;
+	}
+
+	Long CompactTraceIndex::getNumberOfRecords()
+	{
+		return numRecords;
+	}
+
+	int CompactTraceIndex::getNumberOfBlocks()
+	{
+		return blockStart.size() - 1;
+	}
+
+	/*
+	 * Reads the block index that hpcprof writes at the end of the trace. Only
+	 * the trailer and the offsets are read; the blocks are trusted to be there.
+	 */
+	bool CompactTraceIndex::readIndex()
+	{
+		if (dataEnd - dataStart < HPCTRACE_FMT_BlockHdrLen + HPCTRACE_FMT_TrailerLen)
+			return false;
+
+		FileOffset trailer = dataEnd - HPCTRACE_FMT_TrailerLen;
+		unsigned char tag[8];
+		readBytes(trailer + 2 * SIZEOF_LONG, sizeof(tag), tag);
+		if (memcmp(tag, HPCTRACE_FMT_IndexTag, sizeof(tag)) != 0)
+			return false;
+
+		Long numBlocks = buffer->getLong(trailer);
+		Long records = buffer->getLong(trailer + SIZEOF_LONG);
+		FileOffset index = trailer - numBlocks * HPCTRACE_FMT_IndexEntryLen;
+		if (numBlocks < 0 || records < 0
+				|| index < dataStart + HPCTRACE_FMT_BlockHdrLen
+				|| records > numBlocks * HPCTRACE_FMT_BlockRecords)
+			return false;
+
+		blockStart.reserve(numBlocks + 1);
+		for (Long b = 0; b < numBlocks; b++)
+		{
+			FileOffset offset = buffer->getLong(index + b * HPCTRACE_FMT_IndexEntryLen);
+			blockStart.push_back(dataStart + offset);
+		}
+		// the index is framed as a block, so its header ends the last block
+		blockStart.push_back(index - HPCTRACE_FMT_BlockHdrLen);
+		numRecords = records;
+		return true;
+	}
+
+	/*
+	 * Without an index (hpcrun's own files), step from block header to block
+	 * header. A truncated final block is left out.
+	 */
+	void CompactTraceIndex::walkBlocks()
+	{
+		blockStart.clear();
+		numRecords = 0;
+
+		FileOffset pos = dataStart;
+		while (pos + HPCTRACE_FMT_BlockHdrLen <= dataEnd)
+		{
+			unsigned char hdr[HPCTRACE_FMT_BlockHdrLen];
+			readBytes(pos, sizeof(hdr), hdr);
+			FileOffset len = ByteUtilities::readInt((char*) hdr) & 0xffffffffLL;
+			int count = ByteUtilities::readInt((char*) hdr + SIZEOF_INT);
+			if (count <= 0 || count > HPCTRACE_FMT_BlockRecords
+					|| pos + HPCTRACE_FMT_BlockHdrLen + len > dataEnd)
+				break;
+			blockStart.push_back(pos);
+			numRecords += count;
+			pos += HPCTRACE_FMT_BlockHdrLen + len;
+			if (count < HPCTRACE_FMT_BlockRecords)
+				break;
+		}
+		blockStart.push_back(pos);
+		DEBUGCOUT(2) << "Walked " << getNumberOfBlocks() << " trace blocks" << endl;
+	}
+
+	bool CompactTraceIndex::decodeBlock(int b, vector<hpctrace_fmt_datum_t>& records)
+	{
+		records.resize(HPCTRACE_FMT_BlockRecords);
+		FileOffset len = blockStart[b + 1] - blockStart[b];
+		bytes.resize(len);
+		readBytes(blockStart[b], len, &bytes[0]);
+
+		size_t blockLen;
+		int count = hpctrace_fmt_block_decode(&bytes[0], len, flags, &records[0],
+				&blockLen);
+		records.resize(max(count, 0));
+		return count > 0;
+	}
+
+	void CompactTraceIndex::readBytes(FileOffset pos, FileOffset len, unsigned char* dst)
+	{
+		while (len > 0)
+		{
+			FileOffset pageStart, pageEnd;
+			char* page = buffer->getPage(pos, pageStart, pageEnd);
+			FileOffset n = min(len, pageEnd - pos);
+			memcpy(dst, page + (pos - pageStart), n);
+			buffer->releasePage(pos);
+			pos += n;
+			dst += n;
+			len -= n;
+		}
+	}
+
+} /* namespace TraceviewerServer */
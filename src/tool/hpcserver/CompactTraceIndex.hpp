@@ -0,0 +1,112 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// File:
+//   $HeadURL$
+//
+// Purpose:
+//   Random access to the records of a rank whose trace is in compact
+//   blocks (trace format 1.03; see hpcrun-fmt.h).
+//
+// Description:
+//   Holds the file offset of each block, taken from the block index at
+//   the end of the rank's trace, or found by walking the block headers
+//   when the trace has no index. Blocks are decoded on demand.
+//
+//***************************************************************************
+
+#ifndef COMPACTTRACEINDEX_HPP_
+#define COMPACTTRACEINDEX_HPP_
+
+#include <vector>
+
+#include "ByteUtilities.hpp" // Long
+#include "FileUtils.hpp" // FileOffset
+#include "LargeByteBuffer.hpp"
+
+#include <lib/prof-lean/hpcrun-fmt.h>
+
+namespace TraceviewerServer
+{
+	class CompactTraceIndex
+	{
+	public:
+		// The trace data of the rank is [dataStart, dataEnd).
+		CompactTraceIndex(LargeByteBuffer* buffer, FileOffset dataStart,
+				FileOffset dataEnd, hpctrace_hdr_flags_t flags);
+		virtual ~CompactTraceIndex();
+
+		// The flags of the trace header that ends at dataStart, or
+		// hpctrace_hdr_flags_NULL for headers older than version 1.03.
+		static hpctrace_hdr_flags_t readFlags(LargeByteBuffer* buffer,
+				FileOffset dataStart, int headerSize);
+
+		Long getNumberOfRecords();
+		int getNumberOfBlocks();
+
+		// Decodes block b; its records are b * HPCTRACE_FMT_BlockRecords onward.
+		// Returns false, with no records, if the block is corrupt.
+		bool decodeBlock(int b, std::vector<hpctrace_fmt_datum_t>& records);
+
+	private:
+		bool readIndex();
+		void walkBlocks();
+		void readBytes(FileOffset pos, FileOffset len, unsigned char* dst);
+
+		LargeByteBuffer* buffer;
+		FileOffset dataStart;
+		FileOffset dataEnd;
+		hpctrace_hdr_flags_t flags;
+		// file offset of each block, plus the end of the last one
+		std::vector<FileOffset> blockStart;
+		Long numRecords;
+		std::vector<unsigned char> bytes;
+	};
+
+} /* namespace TraceviewerServer */
+#endif /* COMPACTTRACEINDEX_HPP_ */
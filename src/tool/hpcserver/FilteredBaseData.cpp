@@ -65,6 +65,7 @@
 #include <iostream>
 
 
+#include "Constants.hpp"
 #include "DebugUtils.hpp"
 #include "FilteredBaseData.hpp"
 
@@ -72,13 +73,22 @@ namespace TraceviewerServer {
 FilteredBaseData::FilteredBaseData(string filename, int _headerSize) {
 	baseDataFile = new BaseDataFile(filename, _headerSize);
 	headerSize = _headerSize;
+	traceFile = filename;
+	lodIndex = NULL;
 	baseOffsets = baseDataFile->getOffsets();
+	compactIndex.assign(baseDataFile->getNumberOfFiles(), NULL);
+	compactChecked.assign(baseDataFile->getNumberOfFiles(), false);
+	pthread_mutex_init(&compactLock, NULL);
 	//Filters are default, which is allow everything, so this will initialize the vector
 	filter();
 
 }
 
 FilteredBaseData::~FilteredBaseData() {
+	for (unsigned int i = 0; i < compactIndex.size(); i++)
+		delete compactIndex[i];
+	pthread_mutex_destroy(&compactLock);
+	delete lodIndex;
 	delete baseDataFile;
 }
 
@@ -104,7 +114,13 @@ void FilteredBaseData::filter()
 
 FileOffset FilteredBaseData::getMinLoc(int pseudoRank) {
 	assert((unsigned int)pseudoRank < rankMapping.size());
-	return baseOffsets[rankMapping[pseudoRank]].start + headerSize;
+	int fileRank = rankMapping[pseudoRank];
+	return baseOffsets[fileRank].start + baseDataFile->getHeaderSize(fileRank);
+}
+
+int FilteredBaseData::getHeaderSize(int pseudoRank) {
+	assert((unsigned int)pseudoRank < rankMapping.size());
+	return baseDataFile->getHeaderSize(rankMapping[pseudoRank]);
 }
 
 FileOffset FilteredBaseData::getMaxLoc(int pseudoRank){
@@ -120,6 +136,51 @@ int FilteredBaseData::getInt(FileOffset position)
 {
 	return baseDataFile->getMasterBuffer()->getInt(position);
 }
+char* FilteredBaseData::getPage(FileOffset position, FileOffset& pageStart, FileOffset& pageEnd)
+{
+	return baseDataFile->getMasterBuffer()->getPage(position, pageStart, pageEnd);
+}
+void FilteredBaseData::releasePage(FileOffset position)
+{
+	baseDataFile->getMasterBuffer()->releasePage(position);
+}
+
+//Reads the level-of-detail index cached next to the trace file, or builds it
+void FilteredBaseData::loadLODIndex()
+{
+	if (!lodIndex)
+		lodIndex = new TraceLODIndex(traceFile, baseDataFile, headerSize);
+}
+//Returns NULL if the index has not been loaded or was not built
+const vector<TimeCPID>* FilteredBaseData::getLODSamples(int pseudoRank)
+{
+	if (!lodIndex)
+		return NULL;
+	assert((unsigned int)pseudoRank < rankMapping.size());
+	return lodIndex->getSamples(rankMapping[pseudoRank]);
+}
+
+CompactTraceIndex* FilteredBaseData::getCompactIndex(int pseudoRank)
+{
+	assert((unsigned int)pseudoRank < rankMapping.size());
+	int fileRank = rankMapping[pseudoRank];
+
+	pthread_mutex_lock(&compactLock);
+	if (!compactChecked[fileRank])
+	{
+		LargeByteBuffer* buffer = baseDataFile->getMasterBuffer();
+		int fileHeaderSize = baseDataFile->getHeaderSize(fileRank);
+		FileOffset start = baseOffsets[fileRank].start + fileHeaderSize;
+		hpctrace_hdr_flags_t flags = CompactTraceIndex::readFlags(buffer, start, fileHeaderSize);
+		if (flags.fields.isCompact)
+			compactIndex[fileRank] = new CompactTraceIndex(buffer, start,
+					baseOffsets[fileRank].end + SIZE_OF_TRACE_RECORD, flags);
+		compactChecked[fileRank] = true;
+	}
+	CompactTraceIndex* index = compactIndex[fileRank];
+	pthread_mutex_unlock(&compactLock);
+	return index;
+}
 
 int FilteredBaseData::getNumberOfRanks()
 {
@@ -64,9 +64,13 @@
 #include "BaseDataFile.hpp"
 #include "FilterSet.hpp"
 #include "FileUtils.hpp"//For FileOffset
+#include "TraceLODIndex.hpp"
+#include "TimeCPID.hpp"
+#include "CompactTraceIndex.hpp"
 
 #include <vector>
 #include <stdint.h>
+#include <pthread.h>
 
 using std::vector;
 namespace TraceviewerServer
@@ -80,8 +84,16 @@ namespace TraceviewerServer
 
 		FileOffset getMinLoc(int pseudoRank);
 		FileOffset getMaxLoc(int pseudoRank);
+		// Length of the trace header just before getMinLoc(pseudoRank)
+		int getHeaderSize(int pseudoRank);
 		int64_t getLong(FileOffset position);
 		int getInt(FileOffset position);
+		char* getPage(FileOffset position, FileOffset& pageStart, FileOffset& pageEnd);
+		void releasePage(FileOffset position);
+		void loadLODIndex();
+		const vector<TimeCPID>* getLODSamples(int pseudoRank);
+		// NULL unless the rank's trace is in compact blocks
+		CompactTraceIndex* getCompactIndex(int pseudoRank);
 		int getNumberOfRanks();
 		int* getProcessIDs();
 		short* getThreadIDs();
@@ -96,6 +108,12 @@ namespace TraceviewerServer
 		//pool to the real ranks from the filtered pool.
 		vector<int> rankMapping;
 		int headerSize;
+		string traceFile;
+		TraceLODIndex* lodIndex; // NULL until loadLODIndex()
+		// by file rank, found on first use; compactLock guards both
+		vector<CompactTraceIndex*> compactIndex;
+		vector<bool> compactChecked;
+		pthread_mutex_t compactLock;
 	};
 
 
@@ -112,6 +112,7 @@ namespace TraceviewerServer
 		int PartialPageSize = fileSize % mmPageSize;
 		numPages = FullPages + (PartialPageSize == 0 ? 0 : 1);
 		pageManagementList = new LRUList<VersatileMemoryPage>(numPages);
+		pthread_mutex_init(&pageLock, NULL);
 
 		FileDescriptor fd = open(sPath.c_str(), O_RDONLY);
 
@@ -121,7 +122,7 @@ namespace TraceviewerServer
 		{
 			FileOffset mapping_len = min( mmPageSize, sizeRemaining);
 
-			masterBuffer.push_back(VersatileMemoryPage(mmPageSize*i, mapping_len, fd, pageManagementList));
+			masterBuffer.push_back(new VersatileMemoryPage(mmPageSize*i, mapping_len, fd, pageManagementList));
 
 			sizeRemaining -= mapping_len;
 
@@ -133,19 +134,47 @@ namespace TraceviewerServer
 	{
 		int Page = pos / mmPageSize;
 		int loc = pos % mmPageSize;
-		char* p2D = masterBuffer[Page].get() + loc;
+		pthread_mutex_lock(&pageLock);
+		char* p2D = masterBuffer[Page]->get() + loc;
 		int val = ByteUtilities::readInt(p2D);
+		pthread_mutex_unlock(&pageLock);
 		return val;
 	}
 	Long LargeByteBuffer::getLong(FileOffset pos)
 	{
 		int Page = pos / mmPageSize;
 		int loc = pos % mmPageSize;
-		char* p2D = masterBuffer[Page].get() + loc;
+		pthread_mutex_lock(&pageLock);
+		char* p2D = masterBuffer[Page]->get() + loc;
 		Long val = ByteUtilities::readLong(p2D);
+		pthread_mutex_unlock(&pageLock);
 		return val;
 
 	}
+	/*
+	 * Maps and pins the page holding pos and returns its first byte. pageStart and
+	 * pageEnd are set to the file range [pageStart, pageEnd) the page covers. The
+	 * pointer remains valid until releasePage() is called with any position in the
+	 * page, which lets callers decode a run of records with a single page lookup.
+	 */
+	char* LargeByteBuffer::getPage(FileOffset pos, FileOffset& pageStart, FileOffset& pageEnd)
+	{
+		int Page = pos / mmPageSize;
+		pageStart = Page * mmPageSize;
+		pageEnd = min(pageStart + mmPageSize, fileSize);
+		pthread_mutex_lock(&pageLock);
+		char* bytes = masterBuffer[Page]->get();
+		masterBuffer[Page]->pin();
+		pthread_mutex_unlock(&pageLock);
+		return bytes;
+	}
+	void LargeByteBuffer::releasePage(FileOffset pos)
+	{
+		int Page = pos / mmPageSize;
+		pthread_mutex_lock(&pageLock);
+		masterBuffer[Page]->unpin();
+		pthread_mutex_unlock(&pageLock);
+	}
 	//Could very well be a template, but we only use it for uint64_t
 	uint64_t LargeByteBuffer::lcm(uint64_t _a, uint64_t _b)
 	{
@@ -194,8 +223,11 @@ namespace TraceviewerServer
 	}
 	LargeByteBuffer::~LargeByteBuffer()
 	{
+		for (int i = 0; i < numPages; i++)
+			delete masterBuffer[i];
 		masterBuffer.clear();
 		delete pageManagementList;
+		pthread_mutex_destroy(&pageLock);
 
 	}
 }
@@ -68,6 +68,7 @@
 #include <string>
 #include <vector>
 #include <stdint.h>
+#include <pthread.h>
 
 namespace TraceviewerServer
 {
@@ -80,12 +81,17 @@ namespace TraceviewerServer
 		FileOffset size();
 		Long getLong(FileOffset);
 		int getInt(FileOffset);
+		char* getPage(FileOffset, FileOffset&, FileOffset&);
+		void releasePage(FileOffset);
 	private:
 		static uint64_t lcm(uint64_t, uint64_t);
 		static uint64_t getRamSize();
-		vector<VersatileMemoryPage> masterBuffer;
+		// The LRU list keeps pointers to the pages, so they must not move
+		vector<VersatileMemoryPage*> masterBuffer;
 		int numPages;
 		LRUList<VersatileMemoryPage>* pageManagementList;
+		// Serializes mapping, unmapping, and the LRU list so timelines can be read concurrently
+		pthread_mutex_t pageLock;
 
 	};
 
@@ -70,6 +70,7 @@ namespace TraceviewerServer
 	extern bool useCompression;
 	extern int mainPortNumber;
 	extern int xmlPortNumber;
+	extern int numJobs;
 	class Server
 	{
 
@@ -106,6 +106,9 @@ namespace TraceviewerServer
 
 	ProcessTimeline* SpaceTimeDataController::getNextTrace()
 	{
+		//Read or build the level-of-detail index when the first timeline is
+		//requested rather than when the database is opened
+		dataTrace->loadLODIndex();
 		if (attributes->lineNum
 				< min(attributes->numPixelsV, attributes->endProcess - attributes->begProcess))
 		{
@@ -124,24 +127,34 @@ namespace TraceviewerServer
 		traces[NextPtl->line()] = NextPtl;
 	}
 
+	//Creates a ProcessTimeline for every requested line without reading its data,
+	//so that the lines can then be read independently of each other.
 	//Don't call if in MPI mode
-	void SpaceTimeDataController::fillTraces()
+	void SpaceTimeDataController::prepareTraces()
 	{
 		//Traces might be null. resetTraces will fix that.
 		resetTraces();
 
-
-		//Taken straight from TimelineThread
 		ProcessTimeline* nextTrace = getNextTrace();
 		while (nextTrace != NULL)
 		{
-			nextTrace->readInData();
 			addNextTrace(nextTrace);
 
 			nextTrace = getNextTrace();
 		}
 	}
 
+	//Don't call if in MPI mode
+	void SpaceTimeDataController::fillTraces()
+	{
+		prepareTraces();
+
+		for (int i = 0; i < tracesLength; i++)
+		{
+			traces[i]->readInData();
+		}
+	}
+
 	 int* SpaceTimeDataController::getValuesXProcessID()
 	{
 		return dataTrace->getProcessIDs();
@@ -79,6 +79,7 @@ namespace TraceviewerServer
 		void setInfo(Time, Time, int);
 		ProcessTimeline* getNextTrace();
 		void addNextTrace(ProcessTimeline*);
+		void prepareTraces();
 		void fillTraces();
 		ProcessTimeline* fillTrace(bool);
 		void applyFilters(FilterSet filters);
@@ -61,6 +61,8 @@
 #include <algorithm>
 #include <cstdlib> // previously: cmath but it causes ambuguity in abs function for gcc 4.4.6
 #include "Constants.hpp"
+#include "ByteUtilities.hpp"
+#include "DebugUtils.hpp"
 #include <iostream>
 
 namespace TraceviewerServer
@@ -75,6 +77,14 @@ namespace TraceviewerServer
 		minloc = data->getMinLoc(rank);
 		maxloc = data->getMaxLoc(rank);
 		numPixelsH = _numPixelH;
+		pageBytes = NULL;
+		lodSamples = data->getLODSamples(rank);
+		readClock(data->getHeaderSize(rank));
+
+		compact = data->getCompactIndex(rank);
+		blockNum = -1;
+		if (compact)
+			maxloc = getAbsoluteLocation(compact->getNumberOfRecords() - 1);
 
 		
 		listCPID = new vector<TimeCPID>();
@@ -94,8 +104,19 @@ namespace TraceviewerServer
 		// get the number of records data to display
 		 Long numRec = 1 + getNumberOfRecords(startLoc, endLoc);
 
+		listCPID->reserve(min(numRec, (Long)numPixelsH) + 2);
+
+		// --------------------------------------------------------------------------------------------------
+		// get the first data if necessary: the leftmost time is still bigger than the lower limit
+		//	similarly, we add to the list
+		// --------------------------------------------------------------------------------------------------
+		if (startLoc > minloc)
+		{
+			listCPID->push_back(getData(startLoc - SIZE_OF_TRACE_RECORD));
+		}
+
 		// --------------------------------------------------------------------------------------------------
-		// if the data-to-display is fit in the display zone, we don't need to use recursive binary search
+		// if the data-to-display is fit in the display zone, we don't need to sample pixels
 		//	we just simply display everything from the file
 		// --------------------------------------------------------------------------------------------------
 		if (numRec <= numPixelsH)
@@ -113,7 +134,7 @@ namespace TraceviewerServer
 			// the data is too big: try to fit the "big" data into the display
 
 			//fills in the rest of the data for this process timeline
-			sampleTimeLine(startLoc, endLoc, 0, numPixelsH, 0, pixelLength, timeStart);
+			sampleTimeLine(startLoc, endLoc, numPixelsH, pixelLength, timeStart);
 		}
 		// --------------------------------------------------------------------------------------------------
 		// get the last data if necessary: the rightmost time is still less then the upper limit
@@ -121,54 +142,63 @@ namespace TraceviewerServer
 		// --------------------------------------------------------------------------------------------------
 		if (endLoc < maxloc)
 		{
-			 TimeCPID dataLast = getData(endLoc);
-			addSample(listCPID->size(), dataLast);
-		}
-
-		// --------------------------------------------------------------------------------------------------
-		// get the first data if necessary: the leftmost time is still bigger than the lower limit
-		//	similarly, we add to the list
-		// --------------------------------------------------------------------------------------------------
-		if (startLoc > minloc)
-		{
-			 TimeCPID dataFirst = getData(startLoc - SIZE_OF_TRACE_RECORD);
-			addSample(0, dataFirst);
+			listCPID->push_back(getData(endLoc));
 		}
 		postProcess();
+		releasePage();
 	}
 	/*******************************************************************************************
-	 * Recursive method that fills in times and timeLine with the correct data from the file.
-	 * Takes in two pixel locations as endpoints and finds the timestamp that owns the pixel
-	 * in between these two. It then recursively calls itself twice - once with the beginning
-	 * location and the newfound location as endpoints and once with the newfound location
-	 * and the end location as endpoints. Effectively updates times and timeLine by calculating
-	 * the index in which to insert the next data. This way, it keeps times and timeLine sorted.
-	 * @author Reed Landrum and Michael Franco
+	 * Appends to listCPID the record that owns each pixel strictly between 0 and endPixel, in
+	 * pixel order. Pixel times increase monotonically, so the search for each pixel resumes
+	 * from the previous pixel's record: it gallops right (starting with the expected number
+	 * of records per pixel) until it passes the pixel's time, bisects the last step down to
+	 * two adjacent records, and lets findTimeInInterval() pick the closer one. The samples
+	 * are the same ones the former recursive bisection over [0, endPixel) produced, but each
+	 * pixel costs O(log(records per pixel)) reads and nothing is inserted mid-vector.
 	 * @param minLoc The beginning location in the file to bound the search.
 	 * @param maxLoc The end location in the file to bound the search.
-	 * @param startPixel The beginning pixel in the image that corresponds to minLoc.
-	 * @param endPixel The end pixel in the image that corresponds to maxLoc.
-	 * @param minIndex An index used for calculating the index in which the data is to be inserted.
-	 * @return Returns the index that shows the size of the recursive subtree that has been read.
-	 * Used for calculating the index in which the data is to be inserted.
+	 * @param endPixel The number of pixels in the image; pixel 0 corresponds to minLoc.
 	 ******************************************************************************************/
-	int TraceDataByRank::sampleTimeLine(FileOffset minLoc, FileOffset maxLoc, int startPixel,
-			int endPixel, int minIndex, double pixelLength, Time startingTime)
+	void TraceDataByRank::sampleTimeLine(FileOffset minLoc, FileOffset maxLoc, int endPixel,
+			double pixelLength, Time startingTime)
 	{
-		int midPixel = (startPixel + endPixel) / 2;
-		if (midPixel == startPixel)
-			return 0;
-
-		Long loc = findTimeInInterval((long)(midPixel * pixelLength + startingTime), minLoc,
-				maxLoc);
-		 TimeCPID nextData = getData(loc);
-		addSample(minIndex, nextData);
-		int addedLeft = sampleTimeLine(minLoc, loc, startPixel, midPixel, minIndex,
-				pixelLength, startingTime);
-		int addedRight = sampleTimeLine(loc, maxLoc, midPixel, endPixel,
-				minIndex + addedLeft + 1, pixelLength, startingTime);
-
-		return (addedLeft + addedRight + 1);
+		FileOffset l_index = getRelativeLocation(minLoc);
+		FileOffset maxIndex = getRelativeLocation(maxLoc);
+		FileOffset stride = max((FileOffset) 1, (maxIndex - l_index) / endPixel);
+
+		for (int pixel = 1; pixel < endPixel; pixel++)
+		{
+			Time time = (long)(pixel * pixelLength + startingTime);
+
+			// narrow (with the index) or gallop: afterwards time(l_index) <= time < time(r_index),
+			// unless the search is pinned at either end of [minLoc, maxLoc]
+			FileOffset r_index = l_index;
+			if (lodSamples)
+			{
+				r_index = maxIndex;
+				narrowToBlock(time, l_index, r_index);
+			}
+			for (FileOffset step = stride; !lodSamples && r_index < maxIndex; step *= 2)
+			{
+				r_index = min(l_index + step, maxIndex);
+				if (getTime(getAbsoluteLocation(r_index)) > time)
+					break;
+				l_index = r_index;
+			}
+			while (r_index - l_index > 1)
+			{
+				FileOffset m_index = l_index + (r_index - l_index) / 2;
+				if (getTime(getAbsoluteLocation(m_index)) > time)
+					r_index = m_index;
+				else
+					l_index = m_index;
+			}
+
+			FileOffset loc = findTimeInInterval(time, getAbsoluteLocation(l_index),
+					getAbsoluteLocation(r_index));
+			listCPID->push_back(getData(loc));
+			l_index = getRelativeLocation(loc);
+		}
 	}
 
 
@@ -189,9 +219,10 @@ namespace TraceviewerServer
 
 		FileOffset l_index = getRelativeLocation(l_boundOffset);
 		FileOffset r_index = getRelativeLocation(r_boundOffset);
+		narrowToBlock(time, l_index, r_index);
 
-		Time l_time = data->getLong(l_boundOffset);
-		Time r_time = data->getLong(r_boundOffset);
+		Time l_time = getTime(getAbsoluteLocation(l_index));
+		Time r_time = getTime(getAbsoluteLocation(r_index));
 	
 		// apply "Newton's method" to find target time
 		while (r_index - l_index > 1)
@@ -220,7 +251,7 @@ namespace TraceviewerServer
 			if (predicted_index >= r_index)
 				predicted_index = r_index - 1;
 
-			Time temp = data->getLong(getAbsoluteLocation(predicted_index));
+			Time temp = getTime(getAbsoluteLocation(predicted_index));
 			if (time >= temp)
 			{
 				l_index = predicted_index;
@@ -235,8 +266,8 @@ namespace TraceviewerServer
 		FileOffset l_offset = getAbsoluteLocation(l_index);
 		FileOffset r_offset = getAbsoluteLocation(r_index);
 
-		l_time = data->getLong(l_offset);
-		r_time = data->getLong(r_offset);
+		l_time = getTime(l_offset);
+		r_time = getTime(r_offset);
 
 		int leftDiff = time - l_time;
 		int rightDiff = r_time - time;
@@ -248,6 +279,43 @@ namespace TraceviewerServer
 		else
 			return maxloc;
 	}
+	/*********************************************************************************
+	 * Shrinks the search interval [l_index, r_index] (record indices, r_index > l_index)
+	 * to the one index block that brackets time, without reading the trace file. The
+	 * result still has r_index > l_index, time(l_index) <= time unless l_index is
+	 * unchanged, and time(r_index) > time unless r_index is unchanged, so searches
+	 * over it find the same records as over the whole interval.
+	 ********************************************************************************/
+	void TraceDataByRank::narrowToBlock(Time time, FileOffset& l_index, FileOffset& r_index)
+	{
+		if (!lodSamples || r_index - l_index <= (FileOffset) TraceLODIndex::LOD_BLOCK)
+			return;
+
+		// find the first sample later than time
+		FileOffset lo = 0, hi = lodSamples->size();
+		while (lo < hi)
+		{
+			FileOffset mid = lo + (hi - lo) / 2;
+			if (hpctrace_fmt_time_to_wall_us(&clock, (*lodSamples)[mid].timestamp) > time)
+				hi = mid;
+			else
+				lo = mid + 1;
+		}
+		FileOffset blockEnd = lo << TraceLODIndex::LOD_SHIFT;
+
+		FileOffset newL = l_index;
+		if (lo > 0)
+			newL = min(max(blockEnd - TraceLODIndex::LOD_BLOCK, l_index), r_index - 1);
+		// the index may end early (at a damaged compact block); past its
+		// last sample, nothing bounds time from above
+		FileOffset newR = r_index;
+		if (lo < (FileOffset) lodSamples->size())
+			newR = min(max(blockEnd, newL + 1), r_index);
+
+		l_index = newL;
+		r_index = newR;
+	}
+
 	FileOffset TraceDataByRank::getAbsoluteLocation(FileOffset relativePosition)
 	{
 		return minloc + (relativePosition * SIZE_OF_TRACE_RECORD);
@@ -257,57 +325,139 @@ namespace TraceviewerServer
 	{
 		return (absolutePosition - minloc) / SIZE_OF_TRACE_RECORD;
 	}
-	void TraceDataByRank::addSample(unsigned int index, TimeCPID dataCpid)
+	/*********************************************************************************
+	 * Returns the bytes of the trace record at location, or NULL if the record
+	 * straddles two pages. Records are decoded straight from the page most recently
+	 * read, so consecutive reads pay for one page lookup rather than one per field.
+	 * That page stays pinned until releasePage().
+	 ********************************************************************************/
+	char* TraceDataByRank::getRecord(FileOffset location)
 	{
-		if (index == listCPID->size())
+		if (!pageBytes || location < pageStart
+				|| location + SIZE_OF_TRACE_RECORD > pageEnd)
 		{
-			listCPID->push_back(dataCpid);
+			releasePage();
+			pageBytes = data->getPage(location, pageStart, pageEnd);
+			if (location + SIZE_OF_TRACE_RECORD > pageEnd)
+			{
+				releasePage();
+				return NULL;
+			}
 		}
-		else
+		return pageBytes + (location - pageStart);
+	}
+
+	void TraceDataByRank::releasePage()
+	{
+		if (pageBytes)
 		{
-			vector<TimeCPID>::iterator it = listCPID->begin();
-			it += index;
-			listCPID->insert(it, dataCpid);
+			data->releasePage(pageStart);
+			pageBytes = NULL;
 		}
 	}
 
-	TimeCPID TraceDataByRank::getData(FileOffset location)
+	/*********************************************************************************
+	 * Returns the record at location of a trace in compact blocks, decoding its
+	 * block unless it was the last one decoded. A block that fails to decode
+	 * reads as records with time 0.
+	 ********************************************************************************/
+	const hpctrace_fmt_datum_t& TraceDataByRank::getCompactRecord(FileOffset location)
 	{
+		FileOffset index = getRelativeLocation(location);
+		int b = index / HPCTRACE_FMT_BlockRecords;
+		if (b != blockNum)
+		{
+			if (!compact->decodeBlock(b, blockRecords))
+				DEBUGCOUT(1) << "Corrupt trace block " << b << " of rank " << rank << endl;
+			blockRecords.resize(HPCTRACE_FMT_BlockRecords);
+			blockNum = b;
+		}
+		return blockRecords[index % HPCTRACE_FMT_BlockRecords];
+	}
 
-		 Time time = data->getLong(location);
-		 int CPID = data->getInt(location + SIZEOF_LONG);
+	TimeCPID TraceDataByRank::getData(FileOffset location)
+	{
+		if (compact)
+		{
+			const hpctrace_fmt_datum_t& datum = getCompactRecord(location);
+			return TimeCPID(hpctrace_fmt_time_to_wall_us(&clock, datum.time), datum.cpId);
+		}
+		char* record = getRecord(location);
+		if (!record)
+		{
+			Time time = hpctrace_fmt_time_to_wall_us(&clock, data->getLong(location));
+			int CPID = data->getInt(location + SIZEOF_LONG);
+			return TimeCPID(time, CPID);
+		}
+		Time time = hpctrace_fmt_time_to_wall_us(&clock, ByteUtilities::readLong(record));
+		int CPID = ByteUtilities::readInt(record + SIZEOF_LONG);
 		TimeCPID ToReturn(time, CPID);
 		return ToReturn;
 	}
 
+	Time TraceDataByRank::getTime(FileOffset location)
+	{
+		if (compact)
+			return hpctrace_fmt_time_to_wall_us(&clock, getCompactRecord(location).time);
+		char* record = getRecord(location);
+		Long time = record ? ByteUtilities::readLong(record) : data->getLong(location);
+		return hpctrace_fmt_time_to_wall_us(&clock, time);
+	}
+
+	/*********************************************************************************
+	 * Reads the clock calibration from this rank's trace header. Headers older
+	 * than version 1.02 have none: their records are already wall-clock microseconds.
+	 ********************************************************************************/
+	void TraceDataByRank::readClock(int headerSize)
+	{
+		clock.source = HPCTRACE_CLOCK_WALL_US;
+		clock.clockBase = 0;
+		clock.wallBase = 0;
+
+		if (headerSize >= hpctrace_fmt_hdr_len(HPCTRACE_FMT_Version_102))
+		{
+			FileOffset loc = minloc - headerSize + HPCTRACE_FMT_ClockOffset;
+			clock.source = data->getLong(loc);
+			clock.clockBase = data->getLong(loc + SIZEOF_LONG);
+			clock.wallBase = data->getLong(loc + 2 * SIZEOF_LONG);
+		}
+	}
+
 	Long TraceDataByRank::getNumberOfRecords(FileOffset start, FileOffset end)
 	{
 		return (end - start) / SIZE_OF_TRACE_RECORD;
 	}
 
 	/*********************************************************************************************
-	 * Removes unnecessary samples:
+	 * Removes unnecessary samples: a sample with the same timestamp as the sample kept before it.
+	 * As before, the final two samples are never compared with each other. Compacts in place
+	 * in one pass; 'len' tracks the length the list would have after each removal.
 	 ********************************************************************************************/
 
 	void TraceDataByRank::postProcess()
 	{
-		int len = listCPID->size();
-		for (int i = 0; i < len - 2; i++)
+		vector<TimeCPID>& list = *listCPID;
+		int len = list.size();
+		int next = 1; // first sample not yet moved into place
+		int i = 0;    // last sample in place
+		for (; i < len - 2; i++)
 		{
-
-			while (i < len - 1 && (*listCPID)[i].timestamp == (*listCPID)[i + 1].timestamp)
+			while (i < len - 1 && list[i].timestamp == list[next].timestamp)
 			{
-				vector<TimeCPID>::iterator it = listCPID->begin();
-				it += (i + 1);
-				listCPID->erase(it);
+				next++;
 				len--;
 			}
-
+			if (i < len - 1)
+				list[i + 1] = list[next++];
 		}
+		while (next < (int) list.size())
+			list[++i] = list[next++];
+		list.erase(list.begin() + len, list.end());
 	}
 
 	TraceDataByRank::~TraceDataByRank()
 	{
+		releasePage();
 		listCPID->clear();
 		delete listCPID;
 	}
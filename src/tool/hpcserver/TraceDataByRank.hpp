@@ -63,9 +63,12 @@
 #include <vector>
 
 #include "TimeCPID.hpp"
+#include "CompactTraceIndex.hpp"
 #include "FilteredBaseData.hpp"
 #include "FileUtils.hpp"//FileOffset
 
+#include <lib/prof-lean/hpcrun-fmt.h> // hpctrace_hdr_clock_t
+
 namespace TraceviewerServer
 {
 
@@ -77,7 +80,7 @@ namespace TraceviewerServer
 		virtual ~TraceDataByRank();
 
 		void getData(Time timeStart, Time timeRange, double pixelLength);
-		int sampleTimeLine(FileOffset minLoc, FileOffset maxLoc, int startPixel, int endPixel, int minIndex, double pixelLength, Time startingTime);
+		void sampleTimeLine(FileOffset minLoc, FileOffset maxLoc, int endPixel, double pixelLength, Time startingTime);
 		FileOffset findTimeInInterval(Time time, FileOffset l_boundOffset, FileOffset r_boundOffset);
 
 
@@ -86,16 +89,35 @@ namespace TraceviewerServer
 		int rank;
 	private:
 		FilteredBaseData* data;
+		// every TraceLODIndex::LOD_BLOCK-th record of this rank; NULL without an index
+		const vector<TimeCPID>* lodSamples;
 
 		FileOffset minloc;
 		FileOffset maxloc;
 		int numPixelsH;
+		// maps record timestamps to the wall-clock microseconds used by the viewer
+		hpctrace_hdr_clock_t clock;
+		// the trace file page most recently read from, [pageStart, pageEnd)
+		char* pageBytes;
+		FileOffset pageStart;
+		FileOffset pageEnd;
+		// for a trace in compact blocks (NULL otherwise), the block most
+		// recently decoded. Locations are then minloc + index * SIZE_OF_TRACE_RECORD
+		// as for fixed size records, though they are not file offsets.
+		CompactTraceIndex* compact;
+		vector<hpctrace_fmt_datum_t> blockRecords;
+		int blockNum;
 
 		FileOffset getAbsoluteLocation(FileOffset);
 
 		FileOffset getRelativeLocation(FileOffset);
-		void addSample(unsigned int, TimeCPID);
+		void narrowToBlock(Time, FileOffset&, FileOffset&);
+		char* getRecord(FileOffset);
+		const hpctrace_fmt_datum_t& getCompactRecord(FileOffset);
+		void releasePage();
 		TimeCPID getData(FileOffset);
+		Time getTime(FileOffset);
+		void readClock(int headerSize);
 		Long getNumberOfRecords(FileOffset, FileOffset);
 		void postProcess();
 	};
@@ -0,0 +1,279 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// File:
+//   $HeadURL$
+//
+// Purpose:
+//   Builds, reads, and writes the level-of-detail index of a merged trace.
+//
+// Description:
+//   [The set of functions, macros, etc. defined in the file]
+//
+//***************************************************************************
+
+#include "TraceLODIndex.hpp"
+#include "CompactTraceIndex.hpp"
+#include "Constants.hpp"
+#include "DataOutputFileStream.hpp"
+#include "DebugUtils.hpp"
+#include "FileUtils.hpp"
+
+#include <cstdio>   // rename, remove
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <sys/stat.h>
+#include <unistd.h> // access, getpid
+
+using namespace std;
+
+namespace TraceviewerServer
+{
+	#define LOD_FILE_SUFFIX ".lod"
+	#define LOD_MAGIC "HPCTRLOD"
+	#define LOD_MAGIC_LEN 8
+	#define LOD_HEADER_LEN (LOD_MAGIC_LEN + 3 * SIZEOF_INT + 2 * SIZEOF_LONG)
+
+	TraceLODIndex::TraceLODIndex(string tracePath, BaseDataFile* data, int headerSize)
+	{
+		string lodPath = tracePath + LOD_FILE_SUFFIX;
+		available = false;
+
+		struct stat traceInfo;
+		if (stat(tracePath.c_str(), &traceInfo) != 0)
+			return;
+		FileOffset traceSize = traceInfo.st_size;
+		Long traceMTime = traceInfo.st_mtime;
+
+		if (read(lodPath, traceSize, traceMTime, headerSize, data->getNumberOfFiles()))
+		{
+			DEBUGCOUT(1) << "Read trace index " << lodPath << endl;
+			available = true;
+			return;
+		}
+		if (!canWrite(lodPath))
+		{
+			DEBUGCOUT(1) << "Cannot store trace index " << lodPath << ", not building it" << endl;
+			return;
+		}
+		build(data);
+		available = true;
+		write(lodPath, traceSize, traceMTime, headerSize);
+	}
+
+	TraceLODIndex::~TraceLODIndex()
+	{
+	}
+
+	const vector<TimeCPID>* TraceLODIndex::getSamples(int fileRank)
+	{
+		return available ? &samples[fileRank] : NULL;
+	}
+
+	// The cache is written to a temporary file in its directory and renamed
+	// into place, which needs write access to the directory
+	bool TraceLODIndex::canWrite(string lodPath)
+	{
+		size_t slash = lodPath.rfind('/');
+		string dir = (slash == string::npos) ? "." : lodPath.substr(0, slash + 1);
+		return access(dir.c_str(), W_OK) == 0;
+	}
+
+	/*
+	 * Reads every LOD_BLOCK-th record of each rank. This touches the whole file
+	 * once, which is why the result is cached.
+	 */
+	void TraceLODIndex::build(BaseDataFile* data)
+	{
+		LargeByteBuffer* buffer = data->getMasterBuffer();
+		OffsetPair* offsets = data->getOffsets();
+		int numFiles = data->getNumberOfFiles();
+
+		samples.clear();
+		samples.resize(numFiles);
+		for (int i = 0; i < numFiles; i++)
+		{
+			int fileHeaderSize = data->getHeaderSize(i);
+			FileOffset start = offsets[i].start + fileHeaderSize;
+			hpctrace_hdr_flags_t flags = CompactTraceIndex::readFlags(buffer, start, fileHeaderSize);
+			if (flags.fields.isCompact)
+			{
+				CompactTraceIndex index(buffer, start,
+						offsets[i].end + SIZE_OF_TRACE_RECORD, flags);
+				buildCompact(index, samples[i]);
+				continue;
+			}
+			for (FileOffset pos = start; pos <= offsets[i].end;
+					pos += LOD_BLOCK * SIZE_OF_TRACE_RECORD)
+			{
+				samples[i].push_back(TimeCPID(buffer->getLong(pos),
+						buffer->getInt(pos + SIZEOF_LONG)));
+			}
+		}
+		DEBUGCOUT(1) << "Built trace index for " << numFiles << " ranks" << endl;
+	}
+
+	void TraceLODIndex::buildCompact(CompactTraceIndex& index, vector<TimeCPID>& rankSamples)
+	{
+		vector<hpctrace_fmt_datum_t> records;
+		int decoded = -1;
+		for (Long r = 0; r < index.getNumberOfRecords(); r += LOD_BLOCK)
+		{
+			int b = r / HPCTRACE_FMT_BlockRecords;
+			if (b != decoded)
+			{
+				index.decodeBlock(b, records);
+				decoded = b;
+			}
+			unsigned int k = r % HPCTRACE_FMT_BlockRecords;
+			if (k >= records.size())
+			{
+				// a damaged block: the samples must stay sorted by time, so
+				// the rank's index ends here (cf. narrowToBlock)
+				DEBUGCOUT(1) << "Trace index stops at damaged block " << b << endl;
+				break;
+			}
+			rankSamples.push_back(TimeCPID(records[k].time, records[k].cpId));
+		}
+	}
+
+	bool TraceLODIndex::read(string lodPath, FileOffset traceSize, Long traceMTime,
+			int headerSize, int numFiles)
+	{
+		ifstream in(lodPath.c_str(), ios_base::binary | ios_base::in);
+		if (!in)
+			return false;
+		stringstream contents;
+		contents << in.rdbuf();
+		string bytes = contents.str();
+		char* buf = &bytes[0];
+		FileOffset len = bytes.size();
+
+		if (len < LOD_HEADER_LEN || memcmp(buf, LOD_MAGIC, LOD_MAGIC_LEN) != 0)
+			return false;
+		FileOffset pos = LOD_MAGIC_LEN;
+		int fileHeaderSize = ByteUtilities::readInt(buf + pos);
+		pos += SIZEOF_INT;
+		int fileShift = ByteUtilities::readInt(buf + pos);
+		pos += SIZEOF_INT;
+		int fileNumFiles = ByteUtilities::readInt(buf + pos);
+		pos += SIZEOF_INT;
+		FileOffset fileTraceSize = ByteUtilities::readLong(buf + pos);
+		pos += SIZEOF_LONG;
+		Long fileTraceMTime = ByteUtilities::readLong(buf + pos);
+		pos += SIZEOF_LONG;
+		if (fileHeaderSize != headerSize || fileShift != LOD_SHIFT
+				|| fileNumFiles != numFiles || fileTraceSize != traceSize
+				|| fileTraceMTime != traceMTime)
+			return false;
+
+		samples.clear();
+		samples.resize(numFiles);
+		for (int i = 0; i < numFiles; i++)
+		{
+			if (pos + SIZEOF_INT > len)
+				return false;
+			int count = ByteUtilities::readInt(buf + pos);
+			pos += SIZEOF_INT;
+			if (count < 0 || pos + (FileOffset) count * SIZE_OF_TRACE_RECORD > len)
+				return false;
+			samples[i].reserve(count);
+			for (int j = 0; j < count; j++)
+			{
+				samples[i].push_back(TimeCPID(ByteUtilities::readLong(buf + pos),
+						ByteUtilities::readInt(buf + pos + SIZEOF_LONG)));
+				pos += SIZE_OF_TRACE_RECORD;
+			}
+		}
+		return pos == len;
+	}
+
+	/*
+	 * Writes to a temporary file and renames it into place, so that servers
+	 * opening the same database at once never read a partial index. A database
+	 * we cannot write to just goes without the cache.
+	 */
+	void TraceLODIndex::write(string lodPath, FileOffset traceSize, Long traceMTime,
+			int headerSize)
+	{
+		stringstream tmpName;
+		tmpName << lodPath << ".tmp." << getpid();
+		string tmpPath = tmpName.str();
+
+		DataOutputFileStream out(tmpPath.c_str());
+		if (!out)
+		{
+			DEBUGCOUT(1) << "Could not write trace index " << lodPath << endl;
+			return;
+		}
+		out.write(LOD_MAGIC, LOD_MAGIC_LEN);
+		out.writeInt(headerSize);
+		out.writeInt(LOD_SHIFT);
+		out.writeInt(samples.size());
+		out.writeLong(traceSize);
+		out.writeLong(traceMTime);
+		for (unsigned int i = 0; i < samples.size(); i++)
+		{
+			out.writeInt(samples[i].size());
+			for (unsigned int j = 0; j < samples[i].size(); j++)
+			{
+				out.writeLong(samples[i][j].timestamp);
+				out.writeInt(samples[i][j].cpid);
+			}
+		}
+		out.close();
+
+		if (!out || rename(tmpPath.c_str(), lodPath.c_str()) != 0)
+		{
+			DEBUGCOUT(1) << "Could not write trace index " << lodPath << endl;
+			remove(tmpPath.c_str());
+		}
+	}
+
+} /* namespace TraceviewerServer */
@@ -0,0 +1,110 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// File:
+//   $HeadURL$
+//
+// Purpose:
+//   Level-of-detail index over the merged trace file: the timestamp and
+//   cpid of every 2^LOD_SHIFT-th record of each rank.
+//
+// Description:
+//   The finest level is stored; coarser levels are strided views of the
+//   same samples. The index is built once per database and cached next to
+//   the merged trace as "<trace>.lod". The cache records the trace's size,
+//   modification time, and header size, and is rebuilt when any differ.
+//   Building reads the whole trace, so it is skipped (and the index left
+//   empty) when the cache could not be written, e.g. for a read-only
+//   database; timelines are then searched without it.
+//
+//***************************************************************************
+
+#ifndef TRACELODINDEX_HPP_
+#define TRACELODINDEX_HPP_
+
+#include <string>
+#include <vector>
+
+#include "BaseDataFile.hpp"
+#include "ByteUtilities.hpp" // Long
+#include "CompactTraceIndex.hpp"
+#include "TimeCPID.hpp"
+
+namespace TraceviewerServer
+{
+	class TraceLODIndex
+	{
+	public:
+		static const int LOD_SHIFT = 10;
+		static const Long LOD_BLOCK = 1 << LOD_SHIFT; // records per sample
+
+		TraceLODIndex(string tracePath, BaseDataFile* data, int headerSize);
+		virtual ~TraceLODIndex();
+
+		// Samples of the rank at position fileRank of the merged trace. Sample j
+		// is record j*LOD_BLOCK of the rank; timestamps are as stored in the file.
+		// The samples of a compact rank end early at a damaged block. NULL if the
+		// index was not built.
+		const vector<TimeCPID>* getSamples(int fileRank);
+
+	private:
+		bool read(string lodPath, FileOffset traceSize, Long traceMTime,
+				int headerSize, int numFiles);
+		void build(BaseDataFile* data);
+		void buildCompact(CompactTraceIndex& index, vector<TimeCPID>& rankSamples);
+		void write(string lodPath, FileOffset traceSize, Long traceMTime,
+				int headerSize);
+
+		static bool canWrite(string lodPath);
+
+		bool available;
+		vector<vector<TimeCPID> > samples;
+	};
+
+} /* namespace TraceviewerServer */
+#endif /* TRACELODINDEX_HPP_ */
@@ -61,6 +61,9 @@ extern void filterTest();
 extern void progBarTest();
 extern void compressionTest();
 extern void lruTest();
+extern void traceSamplingTest();
+extern void compactTraceTest();
+extern void oldHeaderTest();
 
 int main(int argc, char** argv)
 {
@@ -68,5 +71,8 @@ int main(int argc, char** argv)
 	compressionTest();
 	progBarTest();
 	filterTest();
+	traceSamplingTest();
+	compactTraceTest();
+	oldHeaderTest();
 }
 
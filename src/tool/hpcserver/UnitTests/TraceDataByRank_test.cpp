@@ -0,0 +1,584 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// File:
+//   $HeadURL$
+//
+// Purpose:
+//   [The purpose of this file]
+//
+// Description:
+//   [The set of functions, macros, etc. defined in the file]
+//
+// Checks TraceDataByRank::getData() against the recursive pixel bisection
+// it replaced, on a generated trace database.
+
+#undef NDEBUG
+
+#include "../TraceDataByRank.hpp"
+#include "../FilteredBaseData.hpp"
+#include "../ByteUtilities.hpp"
+#include "../Constants.hpp"
+
+#include <lib/prof-lean/hpcrun-fmt.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+#include <unistd.h>
+using namespace std;
+
+using namespace TraceviewerServer;
+
+// Shorter than HPCTRACE_FMT_HeaderLen, so records are read as wall-clock
+// microseconds.
+#define TEST_HEADER_SIZE 24
+
+// The sampler TraceDataByRank used before the single sweep: recursive
+// bisection over pixels with mid-vector inserts.
+class RecursiveSampler
+{
+public:
+	RecursiveSampler(FilteredBaseData* _data, int rank, int _numPixelsH)
+	{
+		data = _data;
+		minloc = data->getMinLoc(rank);
+		maxloc = data->getMaxLoc(rank);
+		numPixelsH = _numPixelsH;
+	}
+
+	void getData(Time timeStart, Time timeRange, double pixelLength)
+	{
+		FileOffset startLoc = findTimeInInterval(timeStart, minloc, maxloc);
+		Time endTime = timeStart + timeRange;
+		FileOffset endLoc = min(
+				findTimeInInterval(endTime, minloc, maxloc) + SIZE_OF_TRACE_RECORD, maxloc);
+		Long numRec = 1 + (endLoc - startLoc) / SIZE_OF_TRACE_RECORD;
+		if (numRec <= numPixelsH)
+		{
+			for (FileOffset i = startLoc; i <= endLoc; i += SIZE_OF_TRACE_RECORD)
+				list.push_back(getData(i));
+		}
+		else
+		{
+			sampleTimeLine(startLoc, endLoc, 0, numPixelsH, 0, pixelLength, timeStart);
+		}
+		if (endLoc < maxloc)
+			addSample(list.size(), getData(endLoc));
+		if (startLoc > minloc)
+			addSample(0, getData(startLoc - SIZE_OF_TRACE_RECORD));
+		postProcess();
+	}
+
+	vector<TimeCPID> list;
+
+private:
+	int sampleTimeLine(FileOffset minLoc, FileOffset maxLoc, int startPixel,
+			int endPixel, int minIndex, double pixelLength, Time startingTime)
+	{
+		int midPixel = (startPixel + endPixel) / 2;
+		if (midPixel == startPixel)
+			return 0;
+
+		Long loc = findTimeInInterval((long)(midPixel * pixelLength + startingTime), minLoc,
+				maxLoc);
+		addSample(minIndex, getData(loc));
+		int addedLeft = sampleTimeLine(minLoc, loc, startPixel, midPixel, minIndex,
+				pixelLength, startingTime);
+		int addedRight = sampleTimeLine(loc, maxLoc, midPixel, endPixel,
+				minIndex + addedLeft + 1, pixelLength, startingTime);
+		return (addedLeft + addedRight + 1);
+	}
+
+	FileOffset findTimeInInterval(Time time, FileOffset l_boundOffset,
+			FileOffset r_boundOffset)
+	{
+		if (l_boundOffset == r_boundOffset)
+			return l_boundOffset;
+
+		FileOffset l_index = (l_boundOffset - minloc) / SIZE_OF_TRACE_RECORD;
+		FileOffset r_index = (r_boundOffset - minloc) / SIZE_OF_TRACE_RECORD;
+		Time l_time = getTime(l_boundOffset);
+		Time r_time = getTime(r_boundOffset);
+
+		while (r_index - l_index > 1)
+		{
+			FileOffset predicted_index;
+			double invrate = (r_index - l_index) / (r_time - l_time);
+			Time mtime = (r_time - l_time) / 2;
+			if (time <= mtime)
+				predicted_index = max((Long) ((time - l_time) * invrate) + l_index, l_index);
+			else
+				predicted_index = min((r_index - (long) ((r_time - time) * invrate)), r_index);
+			if (predicted_index <= l_index)
+				predicted_index = l_index + 1;
+			if (predicted_index >= r_index)
+				predicted_index = r_index - 1;
+
+			Time temp = getTime(minloc + predicted_index * SIZE_OF_TRACE_RECORD);
+			if (time >= temp)
+			{
+				l_index = predicted_index;
+				l_time = temp;
+			}
+			else
+			{
+				r_index = predicted_index;
+				r_time = temp;
+			}
+		}
+		FileOffset l_offset = minloc + l_index * SIZE_OF_TRACE_RECORD;
+		FileOffset r_offset = minloc + r_index * SIZE_OF_TRACE_RECORD;
+		l_time = getTime(l_offset);
+		r_time = getTime(r_offset);
+
+		int leftDiff = time - l_time;
+		int rightDiff = r_time - time;
+		bool is_left_closer = abs(leftDiff) < abs(rightDiff);
+		if (is_left_closer)
+			return l_offset;
+		else if (r_offset < maxloc)
+			return r_offset;
+		else
+			return maxloc;
+	}
+
+	void addSample(unsigned int index, TimeCPID dataCpid)
+	{
+		list.insert(list.begin() + index, dataCpid);
+	}
+
+	void postProcess()
+	{
+		int len = list.size();
+		for (int i = 0; i < len - 2; i++)
+		{
+			while (i < len - 1 && list[i].timestamp == list[i + 1].timestamp)
+			{
+				list.erase(list.begin() + i + 1);
+				len--;
+			}
+		}
+	}
+
+	TimeCPID getData(FileOffset location)
+	{
+		return TimeCPID(getTime(location), data->getInt(location + SIZEOF_LONG));
+	}
+
+	Time getTime(FileOffset location)
+	{
+		return data->getLong(location);
+	}
+
+	FilteredBaseData* data;
+	FileOffset minloc;
+	FileOffset maxloc;
+	int numPixelsH;
+};
+
+static void writeInt(FILE* f, int x)
+{
+	char buf[SIZEOF_INT];
+	ByteUtilities::writeInt(buf, x);
+	fwrite(buf, 1, SIZEOF_INT, f);
+}
+
+static void writeLong(FILE* f, Long x)
+{
+	char buf[SIZEOF_LONG];
+	ByteUtilities::writeLong(buf, x);
+	fwrite(buf, 1, SIZEOF_LONG, f);
+}
+
+// Writes a merged trace database whose ranks have 'numRecords[i]' records
+// each, spaced by random gaps of 1 to 'maxGap[i]' microseconds. Runs of
+// identical call paths are common, as in real traces.
+static void writeTraceDB(const char* path, const vector<int>& numRecords,
+		const vector<int>& maxGap)
+{
+	FILE* f = fopen(path, "w");
+	assert(f);
+	int numFiles = numRecords.size();
+	writeInt(f, 0); // type
+	writeInt(f, numFiles);
+
+	Long offset = 2 * SIZEOF_INT + numFiles * (2 * SIZEOF_INT + SIZEOF_LONG);
+	for (int i = 0; i < numFiles; i++)
+	{
+		writeInt(f, i);  // process id
+		writeInt(f, -1); // thread id
+		writeLong(f, offset);
+		offset += TEST_HEADER_SIZE + (Long) numRecords[i] * SIZE_OF_TRACE_RECORD;
+	}
+	for (int i = 0; i < numFiles; i++)
+	{
+		for (int j = 0; j < TEST_HEADER_SIZE; j++)
+			fputc(0, f);
+		Long time = 1000000 + rand() % 1000;
+		int cpid = 1;
+		for (int j = 0; j < numRecords[i]; j++)
+		{
+			time += 1 + rand() % maxGap[i];
+			if (rand() % 4 == 0)
+				cpid = 1 + rand() % 50;
+			writeLong(f, time);
+			writeInt(f, cpid);
+		}
+	}
+	writeInt(f, 0); // end of file marker
+	fclose(f);
+}
+
+void traceSamplingTest()
+{
+	srand(2713);
+	char path[] = "/tmp/hpcserver-sampling-XXXXXX";
+	int fd = mkstemp(path);
+	assert(fd >= 0);
+	close(fd);
+
+	// dense, sparse, tiny, and bursty ranks
+	vector<int> numRecords, maxGap;
+	numRecords.push_back(200000); maxGap.push_back(10);
+	numRecords.push_back(3000);   maxGap.push_back(5000);
+	numRecords.push_back(5);      maxGap.push_back(100);
+	numRecords.push_back(50000);  maxGap.push_back(1000);
+	writeTraceDB(path, numRecords, maxGap);
+
+	int pixelCounts[] = { 1, 2, 3, 7, 100, 1024, 4000 };
+	int numChecks = 0;
+
+	// without the level-of-detail index, with a freshly built one, and with
+	// the one cached next to the trace file by the previous pass
+	for (int pass = 0; pass < 3; pass++)
+	{
+	FilteredBaseData data(path, TEST_HEADER_SIZE);
+	if (pass > 0)
+		data.loadLODIndex();
+
+	for (int rank = 0; rank < (int) numRecords.size(); rank++)
+	{
+		Time first = data.getLong(data.getMinLoc(rank));
+		Time last = data.getLong(data.getMaxLoc(rank));
+		for (unsigned int p = 0; p < sizeof(pixelCounts) / sizeof(pixelCounts[0]); p++)
+		{
+			for (int window = 0; window < 6; window++)
+			{
+				// the whole rank, windows inside it, and windows hanging off either end
+				Time span = last - first;
+				Time timeStart = first - min(first, span / 10) + rand() % (span / 2 + 1);
+				Time timeRange = 1 + rand() % (span + 1);
+				if (window == 0)
+				{
+					timeStart = first;
+					timeRange = span;
+				}
+				int numPixelsH = pixelCounts[p];
+				double pixelLength = timeRange / (double) numPixelsH;
+
+				RecursiveSampler expected(&data, rank, numPixelsH);
+				expected.getData(timeStart, timeRange, pixelLength);
+
+				TraceDataByRank actual(&data, rank, numPixelsH, TEST_HEADER_SIZE);
+				actual.getData(timeStart, timeRange, pixelLength);
+
+				assert(actual.listCPID->size() == expected.list.size());
+				for (unsigned int i = 0; i < expected.list.size(); i++)
+				{
+					assert((*actual.listCPID)[i].timestamp == expected.list[i].timestamp);
+					assert((*actual.listCPID)[i].cpid == expected.list[i].cpid);
+				}
+				numChecks++;
+			}
+		}
+	}
+	}
+	unlink(path);
+	unlink((string(path) + ".lod").c_str());
+
+	cout << "Trace sampling matches recursive bisection in " << numChecks << " timelines" << endl;
+}
+
+
+// One rank's trace file (header and records) in the fixed or the compact
+// format, the latter with or without its block index.
+static string traceFile(const vector<hpctrace_fmt_datum_t>& records, bool compact,
+		bool withIndex)
+{
+	char* bytes;
+	size_t len;
+	FILE* f = open_memstream(&bytes, &len);
+	hpctrace_hdr_flags_t flags = hpctrace_hdr_flags_NULL;
+	flags.fields.isCompact = compact;
+	hpctrace_fmt_hdr_fwrite(flags, &hpctrace_hdr_clock_NULL, f);
+
+	vector<unsigned char> buf(HPCTRACE_FMT_BlockMaxLen);
+	hpctrace_fmt_block_t blk;
+	hpctrace_fmt_block_init(&blk, &buf[0]);
+	vector<hpctrace_fmt_index_entry_t> index;
+	uint64_t offset = 0;
+	for (unsigned int i = 0; i < records.size(); i++)
+	{
+		hpctrace_fmt_datum_t datum = records[i];
+		if (!compact)
+		{
+			hpctrace_fmt_datum_fwrite(&datum, flags, f);
+			continue;
+		}
+		if (blk.nrecords == 0)
+		{
+			hpctrace_fmt_index_entry_t entry = { offset, datum.time };
+			index.push_back(entry);
+		}
+		if (hpctrace_fmt_block_append(&blk, &datum, flags))
+		{
+			offset += HPCTRACE_FMT_BlockHdrLen + blk.len;
+			hpctrace_fmt_block_fwrite(&blk, f);
+		}
+	}
+	if (compact)
+	{
+		hpctrace_fmt_block_fwrite(&blk, f);
+		if (withIndex)
+			hpctrace_fmt_index_fwrite(index.empty() ? NULL : &index[0], index.size(),
+					records.size(), f);
+	}
+	fclose(f);
+	string file(bytes, len);
+	free(bytes);
+	return file;
+}
+
+static void writeFilesDB(const char* path, const vector<string>& files)
+{
+	FILE* f = fopen(path, "w");
+	assert(f);
+	int numFiles = files.size();
+	writeInt(f, 0); // type
+	writeInt(f, numFiles);
+
+	Long offset = 2 * SIZEOF_INT + numFiles * (2 * SIZEOF_INT + SIZEOF_LONG);
+	for (int i = 0; i < numFiles; i++)
+	{
+		writeInt(f, i);  // process id
+		writeInt(f, -1); // thread id
+		writeLong(f, offset);
+		offset += files[i].size();
+	}
+	for (int i = 0; i < numFiles; i++)
+		fwrite(files[i].data(), 1, files[i].size(), f);
+	writeInt(f, 0); // end of file marker
+	fclose(f);
+}
+
+void compactTraceTest()
+{
+	srand(3517);
+	char fixedPath[] = "/tmp/hpcserver-fixed-XXXXXX";
+	char compactPath[] = "/tmp/hpcserver-compact-XXXXXX";
+	close(mkstemp(fixedPath));
+	close(mkstemp(compactPath));
+
+	// full blocks only, a partial last block, a single record, and a rank
+	// whose cpids and times jump around; every other rank has no block index
+	int numRecords[] = { 4 * HPCTRACE_FMT_BlockRecords, 100000, 1, 30000 };
+	int numRanks = sizeof(numRecords) / sizeof(numRecords[0]);
+	vector<string> fixedFiles, compactFiles;
+	size_t fixedSize = 0, compactSize = 0;
+	for (int rank = 0; rank < numRanks; rank++)
+	{
+		vector<hpctrace_fmt_datum_t> records;
+		uint64_t time = 1000000 + rand() % 1000;
+		uint32_t cpid = 1;
+		for (int j = 0; j < numRecords[rank]; j++)
+		{
+			time += 1 + rand() % (rank == 3 ? 1000000 : 100);
+			if (rand() % 4 == 0)
+				cpid = (rank == 3) ? rand() : 1 + rand() % 50;
+			hpctrace_fmt_datum_t datum = { time, cpid, HPCRUN_FMT_MetricId_NULL };
+			records.push_back(datum);
+		}
+		fixedFiles.push_back(traceFile(records, false, false));
+		compactFiles.push_back(traceFile(records, true, rank % 2 == 0));
+		fixedSize += fixedFiles.back().size();
+		compactSize += compactFiles.back().size();
+	}
+	writeFilesDB(fixedPath, fixedFiles);
+	writeFilesDB(compactPath, compactFiles);
+
+	int numChecks = 0;
+	for (int pass = 0; pass < 2; pass++)
+	{
+	FilteredBaseData fixedData(fixedPath, HPCTRACE_FMT_HeaderLen);
+	FilteredBaseData compactData(compactPath, HPCTRACE_FMT_HeaderLen);
+	if (pass > 0)
+	{
+		fixedData.loadLODIndex();
+		compactData.loadLODIndex();
+	}
+
+	for (int rank = 0; rank < numRanks; rank++)
+	{
+		assert(fixedData.getCompactIndex(rank) == NULL);
+		CompactTraceIndex* index = compactData.getCompactIndex(rank);
+		assert(index && index->getNumberOfRecords() == numRecords[rank]);
+
+		Time first = fixedData.getLong(fixedData.getMinLoc(rank));
+		Time last = fixedData.getLong(fixedData.getMaxLoc(rank));
+		int pixelCounts[] = { 1, 7, 1024, 4000 };
+		for (unsigned int p = 0; p < sizeof(pixelCounts) / sizeof(pixelCounts[0]); p++)
+		{
+			for (int window = 0; window < 4; window++)
+			{
+				Time span = last - first;
+				Time timeStart = first + rand() % (span / 2 + 1);
+				Time timeRange = 1 + rand() % (span + 1);
+				if (window == 0)
+				{
+					timeStart = first;
+					timeRange = span;
+				}
+				int numPixelsH = pixelCounts[p];
+				double pixelLength = timeRange / (double) numPixelsH;
+
+				TraceDataByRank expected(&fixedData, rank, numPixelsH, HPCTRACE_FMT_HeaderLen);
+				expected.getData(timeStart, timeRange, pixelLength);
+				TraceDataByRank actual(&compactData, rank, numPixelsH, HPCTRACE_FMT_HeaderLen);
+				actual.getData(timeStart, timeRange, pixelLength);
+
+				assert(actual.listCPID->size() == expected.listCPID->size());
+				for (unsigned int i = 0; i < expected.listCPID->size(); i++)
+				{
+					assert((*actual.listCPID)[i].timestamp == (*expected.listCPID)[i].timestamp);
+					assert((*actual.listCPID)[i].cpid == (*expected.listCPID)[i].cpid);
+				}
+				numChecks++;
+			}
+		}
+	}
+	}
+	unlink(fixedPath);
+	unlink(compactPath);
+	unlink((string(fixedPath) + ".lod").c_str());
+	unlink((string(compactPath) + ".lod").c_str());
+
+	cout << "Compact traces (" << compactSize * 100 / fixedSize
+			<< "% of fixed size) match fixed ones in " << numChecks << " timelines" << endl;
+}
+
+void oldHeaderTest()
+{
+	char path[] = "/tmp/hpcserver-headers-XXXXXX";
+	close(mkstemp(path));
+
+	// hpcprof copies traces into the database as they are, so one database
+	// can hold version 1.00, 1.01 and current headers
+	const char* versions[] = { "01.00", "01.01", NULL };
+	int numRanks = sizeof(versions) / sizeof(versions[0]);
+	vector<string> files;
+	vector<vector<hpctrace_fmt_datum_t> > records(numRanks);
+	for (int rank = 0; rank < numRanks; rank++)
+	{
+		uint64_t time = 1000000 + rank;
+		for (int j = 0; j < 1000; j++)
+		{
+			time += 1 + rand() % 100;
+			hpctrace_fmt_datum_t datum = { time, (uint32_t) j % 7 + 1,
+					HPCRUN_FMT_MetricId_NULL };
+			records[rank].push_back(datum);
+		}
+		if (!versions[rank])
+		{
+			files.push_back(traceFile(records[rank], false, false));
+			continue;
+		}
+		string file = string(HPCTRACE_FMT_Magic) + versions[rank] + HPCTRACE_FMT_Endian;
+		file.resize(hpctrace_fmt_hdr_len(atof(versions[rank])), '\0');
+		for (unsigned int j = 0; j < records[rank].size(); j++)
+		{
+			char buf[SIZE_OF_TRACE_RECORD];
+			ByteUtilities::writeLong(buf, records[rank][j].time);
+			ByteUtilities::writeInt(buf + SIZEOF_LONG, records[rank][j].cpId);
+			file.append(buf, SIZE_OF_TRACE_RECORD);
+		}
+		files.push_back(file);
+	}
+	writeFilesDB(path, files);
+
+	FilteredBaseData data(path, HPCTRACE_FMT_HeaderLen);
+	data.loadLODIndex();
+	for (int rank = 0; rank < numRanks; rank++)
+	{
+		assert(data.getCompactIndex(rank) == NULL);
+		Time first = data.getLong(data.getMinLoc(rank));
+		Time last = data.getLong(data.getMaxLoc(rank));
+		assert(first == records[rank].front().time);
+		assert(last == records[rank].back().time);
+
+		TraceDataByRank timeline(&data, rank, 100, HPCTRACE_FMT_HeaderLen);
+		timeline.getData(first, last - first, (last - first) / 100.0);
+		assert(!timeline.listCPID->empty());
+		for (unsigned int i = 0; i < timeline.listCPID->size(); i++)
+		{
+			Time t = (*timeline.listCPID)[i].timestamp;
+			vector<hpctrace_fmt_datum_t>::iterator it = records[rank].begin();
+			while (it != records[rank].end() && it->time != t)
+				++it;
+			assert(it != records[rank].end()
+					&& (int) it->cpId == (*timeline.listCPID)[i].cpid);
+		}
+	}
+	unlink(path);
+	unlink((string(path) + ".lod").c_str());
+
+	cout << "Trace headers of every version are skipped" << endl;
+}
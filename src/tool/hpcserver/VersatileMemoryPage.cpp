@@ -80,6 +80,7 @@ namespace TraceviewerServer
 		index = mostRecentlyUsed->addNewUnused(this);
 		file = _file;
 		isMapped = false;
+		pinCount = 0;
 		if (MAX_PAGES_TO_ALLOCATE_AT_ONCE <1)
 			cerr<<"Set max pages before creating any VersatileMemoryPages"<<endl;
 	}
@@ -106,6 +107,16 @@ namespace TraceviewerServer
 		return page;
 	}
 
+	void VersatileMemoryPage::pin()
+	{
+		pinCount++;
+	}
+
+	void VersatileMemoryPage::unpin()
+	{
+		pinCount--;
+	}
+
 	void VersatileMemoryPage::mapPage()
 	{
 
@@ -116,7 +127,12 @@ namespace TraceviewerServer
 			cerr << "Trying to double map!"<<endl;
 			return;
 		}
-		if (mostRecentlyUsed->getUsedPageCount() >= MAX_PAGES_TO_ALLOCATE_AT_ONCE)
+		// Only the least recently used page is considered for eviction. If it
+		// is pinned, a reader still holds a pointer into it (see
+		// LargeByteBuffer::getPage()), so map this page over the limit instead;
+		// a later mapping can evict it once it has been unpinned.
+		if (mostRecentlyUsed->getUsedPageCount() >= MAX_PAGES_TO_ALLOCATE_AT_ONCE
+				&& mostRecentlyUsed->getLast()->pinCount == 0)
 		{
 
 			VersatileMemoryPage* toRemove = mostRecentlyUsed->getLast();
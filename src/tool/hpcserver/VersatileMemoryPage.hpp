@@ -77,6 +77,8 @@ namespace TraceviewerServer
 		virtual ~VersatileMemoryPage();
 		static void setMaxPages(int);
 		char* get();
+		void pin();
+		void unpin();
 	private:
 		void mapPage();
 		void unmapPage();
@@ -88,6 +90,8 @@ namespace TraceviewerServer
 		FileDescriptor file;
 
 		bool isMapped;
+		// number of callers holding a pointer into this page; a pinned page is never unmapped
+		int pinCount;
 		LRUList<VersatileMemoryPage>* mostRecentlyUsed;
 
 		// Use MAP_POPULATE if available
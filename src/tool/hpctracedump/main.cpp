@@ -57,6 +57,13 @@
 //
 //***************************************************************************
 
+//***************************************************************************
+// system include files
+//***************************************************************************
+
+#include <inttypes.h>
+#include <string.h>
+
 //***************************************************************************
 // local include files
 //***************************************************************************
@@ -74,11 +81,19 @@ int
 main(int argc, char **argv)
 {
   int ret;
-  if (argc < 2) {
-    fprintf(stderr, "usage: %s <filename>\n", argv[0]);
+  bool showTime = false;
+
+  int argi = 1;
+  if (argi < argc && strcmp(argv[argi], "-t") == 0) {
+    // print each record's wall-clock time (ns since the epoch)
+    showTime = true;
+    argi++;
+  }
+  if (argi >= argc) {
+    fprintf(stderr, "usage: %s [-t] <filename>\n", argv[0]);
     exit(-1);
   }
-  char *fileName = argv[1];
+  char *fileName = argv[argi];
   char* infsBuf = new char[HPCIO_RWBufferSz];
 
   FILE* infs = hpcio_fopen_r(fileName);
@@ -103,11 +118,14 @@ main(int argc, char **argv)
     exit(-1);
   }
 
+  hpctrace_fmt_block_t blk;
+  hpctrace_fmt_block_init(&blk, NULL);
+
   // read and dump trace records until EOF 
   while ( !feof(infs) ) {
     hpctrace_fmt_datum_t datum;
 
-    ret = hpctrace_fmt_datum_fread(&datum, hdr.flags, infs);
+    ret = hpctrace_fmt_datum_fread(&datum, hdr.flags, &blk, infs);
 
     if (ret == HPCFMT_EOF) {
       break;
@@ -117,7 +135,13 @@ main(int argc, char **argv)
       exit(-1);
     }
 
-    printf("%d\n", datum.cpId);
+    if (showTime) {
+      uint64_t wall_ns = hpctrace_fmt_time_to_wall_ns(&hdr.clock, datum.time);
+      printf("%" PRIu64 " %d\n", wall_ns, datum.cpId);
+    }
+    else {
+      printf("%d\n", datum.cpId);
+    }
   }
 
   hpcio_fclose(infs);